@@ -21,6 +21,7 @@ struct enum_data {
 void AddStrcut(AeXMLNode& node, std::string& code_string, std::string struct_name) {
     code_string += ("\nstruct " + struct_name + " {\n");
     std::vector<std::string> load_codes;
+    std::vector<std::string> paths;  // compiled once per thread, see AeXMLPath
 
     for (auto& element : node.data->elements) {
         std::vector<std::string> types = COM_ENCODE.split<std::string>(element.value, " ");
@@ -28,19 +29,22 @@ void AddStrcut(AeXMLNode& node, std::string& code_string, std::string struct_nam
             std::string key = element.key + ".name";
             std::string enum_name = enum_define->getXMLValue<std::string>(key.c_str());
             code_string += (indent + enum_name + " " + element.key + ";\n");
-            load_codes.push_back(element.key + " = property_->getXMLValue<" + enum_name + ">(\"" + element.key + "\");");
+            load_codes.push_back(element.key + " = property_->getXMLValue<" + enum_name + ">(" + element.key + "_path);");
+            paths.push_back(element.key);
         } else {
             if (types.size() != 2) {
                 if (element.key.compare("name") == 0) {
                     load_codes.push_back(element.key + " = property_->data->key;");
                 } else {
-                    load_codes.push_back(element.key + " = property_->getXMLValue<" + types[0] + ">(\"" + element.key + "\");");
+                    load_codes.push_back(element.key + " = property_->getXMLValue<" + types[0] + ">(" + element.key + "_path);");
+                    paths.push_back(element.key);
                 }
                 code_string += (indent + types[0] + " " + element.key + ";\n");
             } else {
                 std::string type1 = "AeArray<" + types[0] + ", " + types[1] + ">";
-                load_codes.push_back(element.key + " = property_->getXMLValues<" + types[0] + ", " + types[1] + ">(\"" +
-                                     element.key + "\");");
+                load_codes.push_back(element.key + " = property_->getXMLValues<" + types[0] + ", " + types[1] + ">(" +
+                                     element.key + "_path);");
+                paths.push_back(element.key);
                 code_string += (indent + type1 + " " + element.key + ";\n");
             }
         }
@@ -49,6 +53,9 @@ void AddStrcut(AeXMLNode& node, std::string& code_string, std::string struct_nam
     // read xml
     code_string += ("\n" + indent + "AeXMLNode* property_;\n");
     code_string += (indent + "void read(AeXMLNode& node) {\n");
+    for (auto& path : paths) {
+        code_string += (indent + indent + "static thread_local const AeXMLPath " + path + "_path(\"" + path + "\");\n");
+    }
     code_string += (indent + indent + "property_ = &node;\n");
     for (auto& load_code : load_codes) {
         code_string += (indent + indent + load_code + "\n");
@@ -168,11 +168,14 @@ struct AeBaseData {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath type_path("type");
+        static thread_local const AeXMLPath oid_path("oid");
+        static thread_local const AeXMLPath eid_path("eid");
         property_ = &node;
         name = property_->data->key;
-        type = property_->getXMLValue<AE_GAMEOBJECT_TYPE>("type");
-        oid = property_->getXMLValue<ID>("oid");
-        eid = property_->getXMLValue<ID>("eid");
+        type = property_->getXMLValue<AE_GAMEOBJECT_TYPE>(type_path);
+        oid = property_->getXMLValue<ID>(oid_path);
+        eid = property_->getXMLValue<ID>(eid_path);
     }
     void reset() { read(*property_); }
 };
@@ -185,11 +188,15 @@ struct AeUIBaseData {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath position_path("position");
+        static thread_local const AeXMLPath size_path("size");
+        static thread_local const AeXMLPath alignType_path("alignType");
+        static thread_local const AeXMLPath font_oid_path("font_oid");
         property_ = &node;
-        position = property_->getXMLValues<int, 2>("position");
-        size = property_->getXMLValues<int, 2>("size");
-        alignType = property_->getXMLValue<AE_ALIGN_TYPE>("alignType");
-        font_oid = property_->getXMLValue<ID>("font_oid");
+        position = property_->getXMLValues<int, 2>(position_path);
+        size = property_->getXMLValues<int, 2>(size_path);
+        alignType = property_->getXMLValue<AE_ALIGN_TYPE>(alignType_path);
+        font_oid = property_->getXMLValue<ID>(font_oid_path);
     }
     void reset() { read(*property_); }
 };
@@ -206,15 +213,23 @@ struct AeGameObjectDataComponentTransform {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath position_path("position");
+        static thread_local const AeXMLPath scale_path("scale");
+        static thread_local const AeXMLPath faceEular_path("faceEular");
+        static thread_local const AeXMLPath rotateSpeed_path("rotateSpeed");
+        static thread_local const AeXMLPath revoluteSpeed_path("revoluteSpeed");
+        static thread_local const AeXMLPath revoluteFixAxis_path("revoluteFixAxis");
+        static thread_local const AeXMLPath targetAnimationOID_path("targetAnimationOID");
+        static thread_local const AeXMLPath targetBoneName_path("targetBoneName");
         property_ = &node;
-        position = property_->getXMLValues<float, 3>("position");
-        scale = property_->getXMLValues<float, 3>("scale");
-        faceEular = property_->getXMLValues<float, 3>("faceEular");
-        rotateSpeed = property_->getXMLValues<float, 3>("rotateSpeed");
-        revoluteSpeed = property_->getXMLValues<float, 3>("revoluteSpeed");
-        revoluteFixAxis = property_->getXMLValues<bool, 3>("revoluteFixAxis");
-        targetAnimationOID = property_->getXMLValue<ID>("targetAnimationOID");
-        targetBoneName = property_->getXMLValue<std::string>("targetBoneName");
+        position = property_->getXMLValues<float, 3>(position_path);
+        scale = property_->getXMLValues<float, 3>(scale_path);
+        faceEular = property_->getXMLValues<float, 3>(faceEular_path);
+        rotateSpeed = property_->getXMLValues<float, 3>(rotateSpeed_path);
+        revoluteSpeed = property_->getXMLValues<float, 3>(revoluteSpeed_path);
+        revoluteFixAxis = property_->getXMLValues<bool, 3>(revoluteFixAxis_path);
+        targetAnimationOID = property_->getXMLValue<ID>(targetAnimationOID_path);
+        targetBoneName = property_->getXMLValue<std::string>(targetBoneName_path);
     }
     void reset() { read(*property_); }
 };
@@ -235,19 +250,31 @@ struct AeGameObjectDataComponentCamera {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath renderType_path("renderType");
+        static thread_local const AeXMLPath renderSize_path("renderSize");
+        static thread_local const AeXMLPath lookAtTransformOID_path("lookAtTransformOID");
+        static thread_local const AeXMLPath up_path("up");
+        static thread_local const AeXMLPath fov_path("fov");
+        static thread_local const AeXMLPath fnear_path("fnear");
+        static thread_local const AeXMLPath ffar_path("ffar");
+        static thread_local const AeXMLPath aperture_path("aperture");
+        static thread_local const AeXMLPath speed_path("speed");
+        static thread_local const AeXMLPath cullingDistance_path("cullingDistance");
+        static thread_local const AeXMLPath raytracingDepth_path("raytracingDepth");
+        static thread_local const AeXMLPath postProcessingOID_path("postProcessingOID");
         property_ = &node;
-        renderType = property_->getXMLValue<AE_RENDER_TYPE>("renderType");
-        renderSize = property_->getXMLValues<int, 2>("renderSize");
-        lookAtTransformOID = property_->getXMLValue<ID>("lookAtTransformOID");
-        up = property_->getXMLValues<float, 3>("up");
-        fov = property_->getXMLValue<float>("fov");
-        fnear = property_->getXMLValue<float>("fnear");
-        ffar = property_->getXMLValue<float>("ffar");
-        aperture = property_->getXMLValue<float>("aperture");
-        speed = property_->getXMLValue<float>("speed");
-        cullingDistance = property_->getXMLValue<float>("cullingDistance");
-        raytracingDepth = property_->getXMLValue<int>("raytracingDepth");
-        postProcessingOID = property_->getXMLValue<ID>("postProcessingOID");
+        renderType = property_->getXMLValue<AE_RENDER_TYPE>(renderType_path);
+        renderSize = property_->getXMLValues<int, 2>(renderSize_path);
+        lookAtTransformOID = property_->getXMLValue<ID>(lookAtTransformOID_path);
+        up = property_->getXMLValues<float, 3>(up_path);
+        fov = property_->getXMLValue<float>(fov_path);
+        fnear = property_->getXMLValue<float>(fnear_path);
+        ffar = property_->getXMLValue<float>(ffar_path);
+        aperture = property_->getXMLValue<float>(aperture_path);
+        speed = property_->getXMLValue<float>(speed_path);
+        cullingDistance = property_->getXMLValue<float>(cullingDistance_path);
+        raytracingDepth = property_->getXMLValue<int>(raytracingDepth_path);
+        postProcessingOID = property_->getXMLValue<ID>(postProcessingOID_path);
     }
     void reset() { read(*property_); }
 };
@@ -262,13 +289,19 @@ struct AeGameObjectDataComponentPostProcessing {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath vert_path("vert");
+        static thread_local const AeXMLPath tesc_path("tesc");
+        static thread_local const AeXMLPath tese_path("tese");
+        static thread_local const AeXMLPath geom_path("geom");
+        static thread_local const AeXMLPath frag_path("frag");
+        static thread_local const AeXMLPath param_path("param");
         property_ = &node;
-        vert = property_->getXMLValue<std::string>("vert");
-        tesc = property_->getXMLValue<std::string>("tesc");
-        tese = property_->getXMLValue<std::string>("tese");
-        geom = property_->getXMLValue<std::string>("geom");
-        frag = property_->getXMLValue<std::string>("frag");
-        param = property_->getXMLValues<float, 4>("param");
+        vert = property_->getXMLValue<std::string>(vert_path);
+        tesc = property_->getXMLValue<std::string>(tesc_path);
+        tese = property_->getXMLValue<std::string>(tese_path);
+        geom = property_->getXMLValue<std::string>(geom_path);
+        frag = property_->getXMLValue<std::string>(frag_path);
+        param = property_->getXMLValues<float, 4>(param_path);
     }
     void reset() { read(*property_); }
 };
@@ -281,11 +314,15 @@ struct AeGameObjectDataComponentLight {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath lightType_path("lightType");
+        static thread_local const AeXMLPath color_path("color");
+        static thread_local const AeXMLPath intensity_path("intensity");
+        static thread_local const AeXMLPath coneAngle_path("coneAngle");
         property_ = &node;
-        lightType = property_->getXMLValue<AE_LIGHT_TYPE>("lightType");
-        color = property_->getXMLValues<float, 3>("color");
-        intensity = property_->getXMLValue<float>("intensity");
-        coneAngle = property_->getXMLValue<float>("coneAngle");
+        lightType = property_->getXMLValue<AE_LIGHT_TYPE>(lightType_path);
+        color = property_->getXMLValues<float, 3>(color_path);
+        intensity = property_->getXMLValue<float>(intensity_path);
+        coneAngle = property_->getXMLValue<float>(coneAngle_path);
     }
     void reset() { read(*property_); }
 };
@@ -296,9 +333,11 @@ struct AeGameObjectDataComponentLine {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath targetTransformOID_path("targetTransformOID");
+        static thread_local const AeXMLPath color_path("color");
         property_ = &node;
-        targetTransformOID = property_->getXMLValue<ID>("targetTransformOID");
-        color = property_->getXMLValues<float, 3>("color");
+        targetTransformOID = property_->getXMLValue<ID>(targetTransformOID_path);
+        color = property_->getXMLValues<float, 3>(color_path);
     }
     void reset() { read(*property_); }
 };
@@ -310,10 +349,13 @@ struct AeGameObjectDataComponentModel {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath obj_path("obj");
+        static thread_local const AeXMLPath outlineWidth_path("outlineWidth");
+        static thread_local const AeXMLPath materialOID_path("materialOID");
         property_ = &node;
-        obj = property_->getXMLValue<std::string>("obj");
-        outlineWidth = property_->getXMLValue<float>("outlineWidth");
-        materialOID = property_->getXMLValue<ID>("materialOID");
+        obj = property_->getXMLValue<std::string>(obj_path);
+        outlineWidth = property_->getXMLValue<float>(outlineWidth_path);
+        materialOID = property_->getXMLValue<ID>(materialOID_path);
     }
     void reset() { read(*property_); }
 };
@@ -329,14 +371,21 @@ struct AeGameObjectDataComponentAnimation {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath obj_path("obj");
+        static thread_local const AeXMLPath outlineWidth_path("outlineWidth");
+        static thread_local const AeXMLPath actionState_path("actionState");
+        static thread_local const AeXMLPath actionSpeed_path("actionSpeed");
+        static thread_local const AeXMLPath actionID_path("actionID");
+        static thread_local const AeXMLPath actionPlayType_path("actionPlayType");
+        static thread_local const AeXMLPath materialOID_path("materialOID");
         property_ = &node;
-        obj = property_->getXMLValue<std::string>("obj");
-        outlineWidth = property_->getXMLValue<float>("outlineWidth");
-        actionState = property_->getXMLValue<AE_ACTION_STATE>("actionState");
-        actionSpeed = property_->getXMLValue<float>("actionSpeed");
-        actionID = property_->getXMLValue<int>("actionID");
-        actionPlayType = property_->getXMLValue<AE_ACTION_PLAY_TYPE>("actionPlayType");
-        materialOID = property_->getXMLValue<ID>("materialOID");
+        obj = property_->getXMLValue<std::string>(obj_path);
+        outlineWidth = property_->getXMLValue<float>(outlineWidth_path);
+        actionState = property_->getXMLValue<AE_ACTION_STATE>(actionState_path);
+        actionSpeed = property_->getXMLValue<float>(actionSpeed_path);
+        actionID = property_->getXMLValue<int>(actionID_path);
+        actionPlayType = property_->getXMLValue<AE_ACTION_PLAY_TYPE>(actionPlayType_path);
+        materialOID = property_->getXMLValue<ID>(materialOID_path);
     }
     void reset() { read(*property_); }
 };
@@ -348,10 +397,13 @@ struct AeGameObjectDataComponentPlane {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath planeType_path("planeType");
+        static thread_local const AeXMLPath materialOID_path("materialOID");
+        static thread_local const AeXMLPath targetCameraOID_path("targetCameraOID");
         property_ = &node;
-        planeType = property_->getXMLValue<AE_PLANE_TYPE>("planeType");
-        materialOID = property_->getXMLValue<ID>("materialOID");
-        targetCameraOID = property_->getXMLValue<ID>("targetCameraOID");
+        planeType = property_->getXMLValue<AE_PLANE_TYPE>(planeType_path);
+        materialOID = property_->getXMLValue<ID>(materialOID_path);
+        targetCameraOID = property_->getXMLValue<ID>(targetCameraOID_path);
     }
     void reset() { read(*property_); }
 };
@@ -361,8 +413,9 @@ struct AeGameObjectDataComponentCubemap {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath image_path("image");
         property_ = &node;
-        image = property_->getXMLValue<std::string>("image");
+        image = property_->getXMLValue<std::string>(image_path);
     }
     void reset() { read(*property_); }
 };
@@ -395,31 +448,55 @@ struct AeGameObjectDataComponentParticle {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath image_path("image");
+        static thread_local const AeXMLPath alpha_path("alpha");
+        static thread_local const AeXMLPath reborn_path("reborn");
+        static thread_local const AeXMLPath bornTargetTranformOID_path("bornTargetTranformOID");
+        static thread_local const AeXMLPath count_once_path("count_once");
+        static thread_local const AeXMLPath count_period_path("count_period");
+        static thread_local const AeXMLPath count_total_path("count_total");
+        static thread_local const AeXMLPath count_range_path("count_range");
+        static thread_local const AeXMLPath life_second_path("life_second");
+        static thread_local const AeXMLPath life_range_path("life_range");
+        static thread_local const AeXMLPath init_pos_volume_path("init_pos_volume");
+        static thread_local const AeXMLPath init_pos_volume_range_path("init_pos_volume_range");
+        static thread_local const AeXMLPath init_pos_radius_path("init_pos_radius");
+        static thread_local const AeXMLPath init_pos_radius_range_path("init_pos_radius_range");
+        static thread_local const AeXMLPath init_pos_degree_path("init_pos_degree");
+        static thread_local const AeXMLPath init_pos_degree_range_path("init_pos_degree_range");
+        static thread_local const AeXMLPath init_speed_path("init_speed");
+        static thread_local const AeXMLPath init_speed_range_path("init_speed_range");
+        static thread_local const AeXMLPath force_path("force");
+        static thread_local const AeXMLPath force_range_path("force_range");
+        static thread_local const AeXMLPath size_path("size");
+        static thread_local const AeXMLPath size_range_path("size_range");
+        static thread_local const AeXMLPath color_path("color");
+        static thread_local const AeXMLPath color_range_path("color_range");
         property_ = &node;
-        image = property_->getXMLValue<std::string>("image");
-        alpha = property_->getXMLValue<bool>("alpha");
-        reborn = property_->getXMLValue<bool>("reborn");
-        bornTargetTranformOID = property_->getXMLValue<ID>("bornTargetTranformOID");
-        count_once = property_->getXMLValue<int>("count_once");
-        count_period = property_->getXMLValue<int>("count_period");
-        count_total = property_->getXMLValue<int>("count_total");
-        count_range = property_->getXMLValue<int>("count_range");
-        life_second = property_->getXMLValue<int>("life_second");
-        life_range = property_->getXMLValue<int>("life_range");
-        init_pos_volume = property_->getXMLValues<float, 3>("init_pos_volume");
-        init_pos_volume_range = property_->getXMLValues<float, 3>("init_pos_volume_range");
-        init_pos_radius = property_->getXMLValue<float>("init_pos_radius");
-        init_pos_radius_range = property_->getXMLValue<float>("init_pos_radius_range");
-        init_pos_degree = property_->getXMLValue<float>("init_pos_degree");
-        init_pos_degree_range = property_->getXMLValue<float>("init_pos_degree_range");
-        init_speed = property_->getXMLValues<float, 3>("init_speed");
-        init_speed_range = property_->getXMLValues<float, 3>("init_speed_range");
-        force = property_->getXMLValues<float, 3>("force");
-        force_range = property_->getXMLValues<float, 3>("force_range");
-        size = property_->getXMLValues<float, 2>("size");
-        size_range = property_->getXMLValues<float, 2>("size_range");
-        color = property_->getXMLValues<float, 3>("color");
-        color_range = property_->getXMLValues<float, 3>("color_range");
+        image = property_->getXMLValue<std::string>(image_path);
+        alpha = property_->getXMLValue<bool>(alpha_path);
+        reborn = property_->getXMLValue<bool>(reborn_path);
+        bornTargetTranformOID = property_->getXMLValue<ID>(bornTargetTranformOID_path);
+        count_once = property_->getXMLValue<int>(count_once_path);
+        count_period = property_->getXMLValue<int>(count_period_path);
+        count_total = property_->getXMLValue<int>(count_total_path);
+        count_range = property_->getXMLValue<int>(count_range_path);
+        life_second = property_->getXMLValue<int>(life_second_path);
+        life_range = property_->getXMLValue<int>(life_range_path);
+        init_pos_volume = property_->getXMLValues<float, 3>(init_pos_volume_path);
+        init_pos_volume_range = property_->getXMLValues<float, 3>(init_pos_volume_range_path);
+        init_pos_radius = property_->getXMLValue<float>(init_pos_radius_path);
+        init_pos_radius_range = property_->getXMLValue<float>(init_pos_radius_range_path);
+        init_pos_degree = property_->getXMLValue<float>(init_pos_degree_path);
+        init_pos_degree_range = property_->getXMLValue<float>(init_pos_degree_range_path);
+        init_speed = property_->getXMLValues<float, 3>(init_speed_path);
+        init_speed_range = property_->getXMLValues<float, 3>(init_speed_range_path);
+        force = property_->getXMLValues<float, 3>(force_path);
+        force_range = property_->getXMLValues<float, 3>(force_range_path);
+        size = property_->getXMLValues<float, 2>(size_path);
+        size_range = property_->getXMLValues<float, 2>(size_range_path);
+        color = property_->getXMLValues<float, 3>(color_path);
+        color_range = property_->getXMLValues<float, 3>(color_range_path);
     }
     void reset() { read(*property_); }
 };
@@ -443,22 +520,37 @@ struct AeGameObjectDataComponentMaterial {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath vert_path("vert");
+        static thread_local const AeXMLPath tesc_path("tesc");
+        static thread_local const AeXMLPath tese_path("tese");
+        static thread_local const AeXMLPath geom_path("geom");
+        static thread_local const AeXMLPath frag_path("frag");
+        static thread_local const AeXMLPath alpha_path("alpha");
+        static thread_local const AeXMLPath baseColor_path("baseColor");
+        static thread_local const AeXMLPath baseValueRate_path("baseValueRate");
+        static thread_local const AeXMLPath metallic_path("metallic");
+        static thread_local const AeXMLPath roughness_path("roughness");
+        static thread_local const AeXMLPath emissive_path("emissive");
+        static thread_local const AeXMLPath baseMap_path("baseMap");
+        static thread_local const AeXMLPath cubeMap_path("cubeMap");
+        static thread_local const AeXMLPath normalMap_path("normalMap");
+        static thread_local const AeXMLPath metallicRoughnessMap_path("metallicRoughnessMap");
         property_ = &node;
-        vert = property_->getXMLValue<std::string>("vert");
-        tesc = property_->getXMLValue<std::string>("tesc");
-        tese = property_->getXMLValue<std::string>("tese");
-        geom = property_->getXMLValue<std::string>("geom");
-        frag = property_->getXMLValue<std::string>("frag");
-        alpha = property_->getXMLValue<bool>("alpha");
-        baseColor = property_->getXMLValues<float, 4>("baseColor");
-        baseValueRate = property_->getXMLValue<float>("baseValueRate");
-        metallic = property_->getXMLValue<float>("metallic");
-        roughness = property_->getXMLValue<float>("roughness");
-        emissive = property_->getXMLValue<float>("emissive");
-        baseMap = property_->getXMLValue<std::string>("baseMap");
-        cubeMap = property_->getXMLValue<std::string>("cubeMap");
-        normalMap = property_->getXMLValue<std::string>("normalMap");
-        metallicRoughnessMap = property_->getXMLValue<std::string>("metallicRoughnessMap");
+        vert = property_->getXMLValue<std::string>(vert_path);
+        tesc = property_->getXMLValue<std::string>(tesc_path);
+        tese = property_->getXMLValue<std::string>(tese_path);
+        geom = property_->getXMLValue<std::string>(geom_path);
+        frag = property_->getXMLValue<std::string>(frag_path);
+        alpha = property_->getXMLValue<bool>(alpha_path);
+        baseColor = property_->getXMLValues<float, 4>(baseColor_path);
+        baseValueRate = property_->getXMLValue<float>(baseValueRate_path);
+        metallic = property_->getXMLValue<float>(metallic_path);
+        roughness = property_->getXMLValue<float>(roughness_path);
+        emissive = property_->getXMLValue<float>(emissive_path);
+        baseMap = property_->getXMLValue<std::string>(baseMap_path);
+        cubeMap = property_->getXMLValue<std::string>(cubeMap_path);
+        normalMap = property_->getXMLValue<std::string>(normalMap_path);
+        metallicRoughnessMap = property_->getXMLValue<std::string>(metallicRoughnessMap_path);
     }
     void reset() { read(*property_); }
 };
@@ -488,10 +580,13 @@ struct AeGameObjectDataComponentGrid {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath column_path("column");
+        static thread_local const AeXMLPath row_path("row");
+        static thread_local const AeXMLPath color_path("color");
         property_ = &node;
-        column = property_->getXMLValue<int>("column");
-        row = property_->getXMLValue<int>("row");
-        color = property_->getXMLValues<float, 3>("color");
+        column = property_->getXMLValue<int>(column_path);
+        row = property_->getXMLValue<int>(row_path);
+        color = property_->getXMLValues<float, 3>(color_path);
     }
     void reset() { read(*property_); }
 };
@@ -508,15 +603,23 @@ struct AeGameObjectDataComponentRenderSetting {
 
     AeXMLNode* property_;
     void read(AeXMLNode& node) {
+        static thread_local const AeXMLPath FPS_path("FPS");
+        static thread_local const AeXMLPath normal_path("normal");
+        static thread_local const AeXMLPath mesh_path("mesh");
+        static thread_local const AeXMLPath msaa_path("msaa");
+        static thread_local const AeXMLPath gamma_path("gamma");
+        static thread_local const AeXMLPath exposure_path("exposure");
+        static thread_local const AeXMLPath lineWidth_path("lineWidth");
+        static thread_local const AeXMLPath clearColor_path("clearColor");
         property_ = &node;
-        FPS = property_->getXMLValue<int>("FPS");
-        normal = property_->getXMLValue<bool>("normal");
-        mesh = property_->getXMLValue<bool>("mesh");
-        msaa = property_->getXMLValue<int>("msaa");
-        gamma = property_->getXMLValue<float>("gamma");
-        exposure = property_->getXMLValue<float>("exposure");
-        lineWidth = property_->getXMLValue<float>("lineWidth");
-        clearColor = property_->getXMLValues<float, 4>("clearColor");
+        FPS = property_->getXMLValue<int>(FPS_path);
+        normal = property_->getXMLValue<bool>(normal_path);
+        mesh = property_->getXMLValue<bool>(mesh_path);
+        msaa = property_->getXMLValue<int>(msaa_path);
+        gamma = property_->getXMLValue<float>(gamma_path);
+        exposure = property_->getXMLValue<float>(exposure_path);
+        lineWidth = property_->getXMLValue<float>(lineWidth_path);
+        clearColor = property_->getXMLValues<float, 4>(clearColor_path);
     }
     void reset() { read(*property_); }
 };
@@ -0,0 +1,214 @@
+#include "common.h"
+#include <filesystem>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+AeMappedFile::~AeMappedFile() { close(); }
+
+bool AeMappedFile::open(const char *path) {
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    file = handle;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    view = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        close();
+        return false;
+    }
+    viewSize = size_t(fileSize.QuadPart);
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void *address = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file
+    if (address == MAP_FAILED) return false;
+    view = (const unsigned char *)address;
+    viewSize = size_t(info.st_size);
+#endif
+    return true;
+}
+
+void AeMappedFile::close() {
+#ifdef _WIN32
+    if (view) UnmapViewOfFile(view);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (view) munmap((void *)view, viewSize);
+#endif
+    view = nullptr;
+    viewSize = 0;
+}
+
+SINGLETON_INSTANCE(AeImageCache)
+AeImageCache::AeImageCache() {}
+AeImageCache::~AeImageCache() {}
+
+// Entry layout: this header, then the pixels or blocks of every layer, each with its mip levels. 64 bytes keeps the pixels
+// aligned for SIMD copies.
+struct QeImageCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t keyHash;
+    uint64_t sourceHash;
+    uint64_t dataSize;
+    int32_t width;
+    int32_t height;
+    int32_t bytes;
+    int32_t layers;
+    int32_t levels;
+    int32_t blockFormat;  // AeBlockFormat, eBlockFormat_none for pixels
+    unsigned char reserved[8];
+};
+static_assert(sizeof(QeImageCacheHeader) == 64, "cache header size");
+
+const char IMAGE_CACHE_MAGIC[4] = {'A', 'E', 'I', 'C'};
+const uint32_t IMAGE_CACHE_VERSION = 3;  // bump when a decoder's output changes
+
+uint64_t hashImageCache(const void *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;  // FNV-1a
+    return hash;
+}
+
+// Hash of the size and write time of every source; false when one is missing.
+bool hashImageSources(const std::vector<std::string> &sources, uint64_t &hash) {
+    hash = hashImageCache(&IMAGE_CACHE_VERSION, sizeof(IMAGE_CACHE_VERSION));
+    for (const std::string &source : sources) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(source, error);
+        if (error) return false;
+        int64_t time = std::filesystem::last_write_time(source, error).time_since_epoch().count();
+        if (error) return false;
+        hash = hashImageCache(source.data(), source.size(), hash);
+        hash = hashImageCache(&size, sizeof(size), hash);
+        hash = hashImageCache(&time, sizeof(time), hash);
+    }
+    return true;
+}
+
+size_t getImageCacheLayerSize(int width, int height, int bytes, int levels, AeBlockFormat blockFormat) {
+    if (blockFormat == eBlockFormat_none) return AeTextureEncode::getMipmapSize(width, height, bytes, levels);
+    return AeTextureEncode::getCompressedSize(width, height, blockFormat, levels);
+}
+
+std::string getImageCacheName(uint64_t keyHash, uint64_t sourceHash) {
+    char name[40];
+    snprintf(name, sizeof(name), "%016llx-%016llx.img", (unsigned long long)keyHash, (unsigned long long)sourceHash);
+    return name;
+}
+
+void AeImageCache::setDirectory(const char *path) {
+    directory = path ? path : "";
+    if (!directory.empty() && directory.back() != '/' && directory.back() != '\\') directory += '/';
+}
+
+bool AeImageCache::load(const std::string &key, const std::vector<std::string> &sources, AeCachedImage &image) {
+    if (directory.empty()) return false;
+    uint64_t keyHash = hashImageCache(key.data(), key.size()), sourceHash;
+    if (!hashImageSources(sources, sourceHash)) return false;
+    if (!image.file.open((directory + getImageCacheName(keyHash, sourceHash)).c_str())) return false;
+
+    QeImageCacheHeader header;
+    if (image.file.size() < sizeof(header)) return false;
+    memcpy(&header, image.file.data(), sizeof(header));
+    if (memcmp(header.magic, IMAGE_CACHE_MAGIC, 4) != 0 || header.version != IMAGE_CACHE_VERSION ||
+        header.keyHash != keyHash || header.sourceHash != sourceHash || header.dataSize != image.file.size() - sizeof(header) ||
+        header.levels < 1 || header.levels > 32 || header.blockFormat < eBlockFormat_none ||
+        header.blockFormat > eBlockFormat_BC7 ||
+        header.dataSize != uint64_t(header.layers) * getImageCacheLayerSize(header.width, header.height, header.bytes,
+                                                                             header.levels, AeBlockFormat(header.blockFormat))) {
+        image.file.close();
+        return false;
+    }
+
+    image.data = image.file.data() + sizeof(header);
+    image.dataSize = size_t(header.dataSize);
+    image.width = header.width;
+    image.height = header.height;
+    image.bytes = header.bytes;
+    image.layers = header.layers;
+    image.levels = header.levels;
+    image.blockFormat = AeBlockFormat(header.blockFormat);
+    return true;
+}
+
+bool AeImageCache::save(const std::string &key, const std::vector<std::string> &sources, const unsigned char *data,
+                        size_t dataSize, int width, int height, int bytes, int layers, int levels,
+                        AeBlockFormat blockFormat) {
+    if (directory.empty() || dataSize != layers * getImageCacheLayerSize(width, height, bytes, levels, blockFormat)) return false;
+    uint64_t keyHash = hashImageCache(key.data(), key.size()), sourceHash;
+    if (!hashImageSources(sources, sourceHash)) return false;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string name = getImageCacheName(keyHash, sourceHash);
+    std::string path = directory + name;
+    std::string temporary = path + ".tmp";
+
+    QeImageCacheHeader header = {};
+    memcpy(header.magic, IMAGE_CACHE_MAGIC, 4);
+    header.version = IMAGE_CACHE_VERSION;
+    header.keyHash = keyHash;
+    header.sourceHash = sourceHash;
+    header.dataSize = dataSize;
+    header.width = width;
+    header.height = height;
+    header.bytes = bytes;
+    header.layers = layers;
+    header.levels = levels;
+    header.blockFormat = blockFormat;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write((const char *)&header, sizeof(header));
+        file.write((const char *)data, dataSize);
+        if (!file.good()) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    // a reader only ever sees a complete entry
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    // entries of the same key made from older sources
+    std::string prefix = name.substr(0, 17);
+    for (const auto &entry : std::filesystem::directory_iterator(directory, error)) {
+        std::string entryName = entry.path().filename().string();
+        if (entryName != name && entryName.compare(0, prefix.size(), prefix) == 0) {
+            std::error_code removeError;
+            std::filesystem::remove(entry.path(), removeError);
+        }
+    }
+    return true;
+}
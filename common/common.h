@@ -1,15 +1,26 @@
 #pragma once
 
+#ifdef _WIN32
 #define DllExport __declspec(dllexport)
 #define DllImport __declspec(dllimport)
+#else
+#define DllExport __attribute__((visibility("default")))
+#define DllImport
+#define strtok_s strtok_r
+#endif
 
 #include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <climits>
 #include <vector>
 #include <map>
 #include <chrono>
 #include <fstream>
 #include <random>
 #include <iostream>
+#include <functional>
+#include <string_view>
 
 #define CASE_STR(r) \
     case r:         \
@@ -140,6 +151,8 @@ struct AeArrayBase<T, 4> {
 
 template <class T, int N>
 struct DllExport AeArray : public AeArrayBase<T, N> {
+    using AeArrayBase<T, N>::elements;
+
     AeArray();
     AeArray(std::initializer_list<T> l);
     template <class T2, int N2>
@@ -449,6 +462,8 @@ enum DllExport QeAssetType {
 
 struct AeJSONNode;
 struct AeXMLNode;
+class AeXMLDocument;
+class AeJSONDocument;
 
 MANAGER_KEY_CLASS(Common);
 class DllExport AeCommonManager {
@@ -458,6 +473,9 @@ class DllExport AeCommonManager {
     AeJSONNode *getJSON(const char *_filePath);
     AeXMLNode *getXML(const char *_filePath);
     void removeXML(std::string path);
+    bool saveXML(const char *_filePath);  // the tree of getXML, with an AeXMLWriter kept for the path
+    AeXMLDocument *getXMLDocument(const char *_filePath);  // mapped and parsed once, see AeXMLDocument
+    AeJSONDocument *getJSONDocument(const char *_filePath);  // parsed once, see AeJSONDocument
 
     std::vector<char> loadFile(const char *_filePath);
 };
@@ -469,6 +487,47 @@ struct AeNode {
 };
 
 struct AeXMLNode;
+typedef uint32_t AeXMLAtom;  // an interned XML key, see AeXMLPath
+
+// Dot-separated key path compiled once: its keys are interned to atoms, so AeXMLNode lookups hop one node per key
+// and compare integers. The last resolution is kept and reused while the path reads the same node and no AeXMLNode
+// was edited or deleted since. Trees may be read from any number of threads while none edits them; a path, whose
+// cache a read writes, is used from one thread at a time.
+class DllExport AeXMLPath {
+   public:
+    explicit AeXMLPath(const char *path);
+    static AeXMLAtom getAtom(std::string_view key);   // thread-safe
+    static AeXMLAtom findAtom(std::string_view key);  // thread-safe; 0, which no key has, for a key never interned
+
+    std::vector<AeXMLAtom> atoms;
+
+   private:
+    friend struct AeXMLNode;
+    mutable const AeXMLNode *cachedStart = nullptr;
+    mutable AeXMLNode *cachedNode = nullptr;
+    mutable int cachedElement = -1;  // in cachedNode->data->elements, -1 for the value of cachedNode
+    mutable uint64_t cachedGeneration = 0;
+};
+
+// The numbers of a value, parsed when an AeXMLSnapshot was compiled: 1 to 4 of them split by single spaces. They stand
+// for the value only while it still has the text they came from, so edits of the tree need not drop them.
+struct AeXMLNumbers {
+    int32_t text;  // offset of the text from this record, in the image
+    uint32_t textSize;
+    uint16_t slot;  // 0 for the value of the node, 1 + the index in elements for an element
+    uint8_t count;
+    uint8_t bInteger;  // every number is an integer an int holds
+    int32_t ints[4];
+    float floats[4];
+
+    bool hasXMLText(const std::string &value) const {
+        return value.size() == textSize && memcmp((const char *)this + text, value.data(), textSize) == 0;
+    }
+    // Numbers as ConvertTo would read them, false for the types and values it has to read instead.
+    template <class T>
+    bool getXMLNumbers(T *values, int n) const;
+};
+
 struct AeXMLData {
     std::string version;
     std::vector<std::string> comments;
@@ -477,6 +536,25 @@ struct AeXMLData {
     std::vector<AeNode> elements;
     std::vector<AeXMLNode *> nexts;
     AeXMLNode *parent = nullptr;
+
+    // Lookup index built by the loaders and rebuilt by the edits of AeXMLNode, so lookups only read it: the atoms of
+    // the keys of nexts and elements, and open-addressed slots (position + 1) into them once there are many. Code
+    // writing key, elements or nexts directly calls AeXMLNode::invalidateXMLIndex, on the parent too for a key.
+    std::vector<AeXMLAtom> nextAtoms;
+    std::vector<AeXMLAtom> elementAtoms;
+    std::vector<uint32_t> nextSlots;
+    std::vector<uint32_t> elementSlots;
+
+    const AeXMLNumbers *numbers = nullptr;  // in the AeXMLSnapshot image the node was loaded from, by slot
+    uint32_t numberCount = 0;
+
+    // The text of the node in the last write of the AeXMLWriter with the id textWriter: textOffset from the start of
+    // its parent, or of the text for the root. Edits set bDirty on the node and its parents; a write copies the text
+    // of the others.
+    uint32_t textOffset = 0;
+    uint32_t textSize = 0;
+    uint32_t textWriter = 0;
+    bool bDirty = true;
 };
 
 struct DllExport AeXMLNode {
@@ -487,16 +565,32 @@ struct DllExport AeXMLNode {
 
     AeXMLNode *getXMLNode(const char *key);
     AeXMLNode *getXMLNode(std::vector<std::string> &keys);
+    AeXMLNode *getXMLNode(const AeXMLPath &path, size_t keyNum = SIZE_MAX);  // the first keyNum keys of path
 
+    // The attribute of the last key on the node of the keys before it, else the text of the child of this node
+    // with the last key.
     template <class T>
     T getXMLValue(const char *key);
     template <class T>
     AeXMLNode *getXMLValue(T &value, const char *key);
+    template <class T>
+    T getXMLValue(const AeXMLPath &path);
+    template <class T>
+    AeXMLNode *getXMLValue(T &value, const AeXMLPath &path);
+    // The text getXMLValue reads, and its AeXMLNumbers when the node came from an AeXMLSnapshot. A key string interns
+    // nothing: a key no index has yet cannot be on these nodes either.
+    const std::string *findXMLValue(const AeXMLPath &path, AeXMLNode **owner = nullptr,
+                                    const AeXMLNumbers **numbers = nullptr);
+    const std::string *findXMLValue(const char *key, AeXMLNode **owner = nullptr, const AeXMLNumbers **numbers = nullptr);
 
     template <class T, int N>
     AeArray<T, N> getXMLValues(const char *key);
     template <class T, int N>
     AeXMLNode *getXMLValues(AeArray<T, N> &value, const char *key);
+    template <class T, int N>
+    AeArray<T, N> getXMLValues(const AeXMLPath &path);
+    template <class T, int N>
+    AeXMLNode *getXMLValues(AeArray<T, N> &value, const AeXMLPath &path);
 
     AeXMLNode *copyXMLNode();
     void copyXMLValue(AeXMLNode *to);
@@ -510,6 +604,22 @@ struct DllExport AeXMLNode {
     void setXMLValue(const char *key, const char *value);
 
     void outputXML(const char *path, int level = 0, std::string *content = nullptr);
+
+    void invalidateXMLIndex();  // rebuilds the index of this node, expireXMLPaths and setXMLDirty
+    void buildXMLIndex();
+    void buildXMLTreeIndex();  // of this node and every node below it
+    static void expireXMLPaths();  // no AeXMLPath keeps its last resolution
+    void setXMLDirty();
+    AeXMLNode *getXMLNext(AeXMLAtom atom);  // the first child with the key
+    AeXMLNode *getXMLNext(std::string_view key);
+    int getXMLElementIndex(AeXMLAtom atom);  // in data->elements, -1 without the key
+    int getXMLElementIndex(std::string_view key);
+
+   private:
+    template <class T, class K>
+    AeXMLNode *readXMLValue(T &value, const K &key);
+    template <class T, int N, class K>
+    AeXMLNode *readXMLValues(AeArray<T, N> &value, const K &key);
 };
 
 struct AeJSONNode;
@@ -543,6 +653,105 @@ struct DllExport AeJSONNode {
     bool getJSONfValue(float *output, int length, ...);
 };
 
+// Bit reader with a 64-bit refill buffer. Deflate packs bits from the least significant bit (bMSB = false),
+// JPEG from the most significant bit (bMSB = true). Reads past the end return zero bits and set isOverrun().
+template <bool bMSB>
+class DllExport AeBitStream {
+   public:
+    AeBitStream(const unsigned char *data = nullptr, size_t size = 0);
+    void set(const unsigned char *data, size_t size);
+
+    unsigned int peek(unsigned int readCount);  // readCount <= 32
+    void consume(unsigned int readCount);
+    unsigned int read(unsigned int readCount);
+    void alignToByte();
+
+    size_t getBitPosition();
+    void setBitPosition(size_t bitPosition);
+    bool isOverrun();
+
+    const unsigned char *data;
+    size_t size;
+
+   private:
+    void refill();
+
+    uint64_t buffer;
+    unsigned int bitCount;
+    size_t bytePosition;
+};
+using AeBitStreamLSB = AeBitStream<false>;
+using AeBitStreamMSB = AeBitStream<true>;
+
+enum DllExport AeInflateStatus {
+    eInflate_needInput = 0,   // every input byte is used, call setInput with the next chunk
+    eInflate_outputFull = 1,  // the output buffer is full, call inflate again
+    eInflate_done = 2,        // last block decoded and the Adler-32 matched
+    eInflate_error = 3,
+};
+
+// Resumable inflate. Input is given in chunks with setInput, output is read in chunks with inflate. Decoding
+// runs in a 32KB sliding window, so memory doesn't depend on the stream size. An input chunk is read in
+// place and must stay valid until inflate returns eInflate_needInput; only the unfinished tail is copied.
+struct QeHuffmanTree;
+class DllExport AeInflateStream {
+   public:
+    AeInflateStream(bool bZlib = true);
+    ~AeInflateStream();
+    AeInflateStream(const AeInflateStream &) = delete;
+    AeInflateStream &operator=(const AeInflateStream &) = delete;
+
+    void reset();
+    void setInput(const unsigned char *in, size_t size);
+    AeInflateStatus inflate(unsigned char *out, size_t outSize, size_t *written);
+
+   private:
+    enum State {
+        eState_zlibHeader,
+        eState_blockHeader,
+        eState_stored,
+        eState_huffman,
+        eState_adler,
+        eState_done,
+        eState_error,
+    };
+
+    bool nextInput();
+    void stashInput();
+    bool decodeStep();
+    void endBlock();
+    void updateAdler();
+
+    bool bZlib;
+    State state;
+    bool bFinal;
+    size_t storedRemain;
+    unsigned int adler;
+    size_t adlerEnd;  // window bytes already added to adler
+    QeHuffmanTree *treeLL;
+    QeHuffmanTree *treeD;
+
+    std::vector<unsigned char> window;
+    size_t windowEnd;   // decoded bytes in the window
+    size_t windowRead;  // bytes already returned by inflate
+
+    AeBitStreamLSB stream;
+    std::vector<unsigned char> pending;  // unfinished tail of earlier chunks, then the head of the current one
+    size_t pendingExternal;              // bytes at the end of pending copied from the current chunk
+    const unsigned char *input;          // current chunk
+    size_t inputSize;
+    size_t inputCopied;  // bytes of the current chunk already appended to pending
+};
+
+// Pixel layout an image decoder writes. eImageFormat_native keeps the channels stored in the file.
+enum DllExport AeImageFormat {
+    eImageFormat_native = 0,
+    eImageFormat_RGBA8 = 1,
+    eImageFormat_BGRA8 = 2,
+    eImageFormat_R8 = 3,
+    eImageFormat_RG8 = 4,
+};
+
 class DllExport AeCommonEncode {
     SINGLETON_CLASS(AeCommonEncode);
 
@@ -551,12 +760,31 @@ class DllExport AeCommonEncode {
     // QeAssetModel* decodeOBJ(char* buffer);
     // QeAssetModel* decodeGLB(char* buffer);
     // QeAssetMaterial* decodeMTL(char* buffer);
-    std::vector<unsigned char> decodeJPEG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes);
-    std::vector<unsigned char> decodeBMP(unsigned char *buffer, int *width, int *height, int *bytes);
-    std::vector<unsigned char> decodePNG(unsigned char *buffer, int *width, int *height, int *bytes);
-    std::vector<unsigned char> decodeDeflate(unsigned char *in, unsigned int size);
+    // Baseline, extended and progressive 8-bit Huffman JPEG, grey or YCbCr with any sampling factors.
+    // bParallel decodes on COM_THREAD: restart segments in parallel when the file has them, otherwise the IDCT and
+    // the colour conversion of every MCU row. scale 2, 4 or 8 decodes at 1/scale of the size (rounded up) through
+    // reduced IDCTs; width and height return the scaled size.
+    std::vector<unsigned char> decodeJPEG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                                          AeImageFormat format = eImageFormat_native, bool bParallel = false,
+                                          unsigned int scale = 1);
+    std::vector<unsigned char> decodeBMP(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                                         AeImageFormat format = eImageFormat_native);
+    std::vector<unsigned char> decodePNG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                                         AeImageFormat format = eImageFormat_native);
+    // The same decoders writing into memory of the caller. allocate gets the byte size once width, height and bytes
+    // are set and returns where the rows go, or nullptr to stop. False when the file fails or allocate stops it.
+    bool decodeJPEG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                    const std::function<unsigned char *(size_t size)> &allocate, AeImageFormat format = eImageFormat_native,
+                    bool bParallel = false, unsigned int scale = 1);
+    bool decodeBMP(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                   const std::function<unsigned char *(size_t size)> &allocate, AeImageFormat format = eImageFormat_native);
+    bool decodePNG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                   const std::function<unsigned char *(size_t size)> &allocate, AeImageFormat format = eImageFormat_native);
+    std::vector<unsigned char> decodeDeflate(unsigned char *in, size_t size);
+    size_t decodeDeflate(unsigned char *in, size_t size, unsigned char *out, size_t outSize);  // returns bytes written
+    void unfilterPNGScanline(unsigned char *recon, const unsigned char *scanline, const unsigned char *prevline, size_t linebytes,
+                             size_t bytewidth, unsigned char filterType, bool bSIMD = true);
 
-    int readBits(const unsigned char *stream, size_t *bitPointer, size_t readCount, bool bLeft = false, bool bNegative = false);
     std::string trim(std::string s);
 
     template <class T>
@@ -570,6 +798,435 @@ class DllExport AeCommonEncode {
 };
 #define COM_ENCODE AeCommonEncode::getInstance()
 
+enum DllExport AeMipmapFilter {
+    eMipmapFilter_box = 0,
+    eMipmapFilter_kaiser = 1,  // Kaiser-windowed sinc, sharper than box
+};
+
+// GPU block-compressed formats, 4x4 pixels per block.
+enum DllExport AeBlockFormat {
+    eBlockFormat_none = 0,  // uncompressed
+    eBlockFormat_BC1 = 1,   // RGB and 1-bit alpha, 8 bytes
+    eBlockFormat_BC3 = 2,   // RGBA, 16 bytes
+    eBlockFormat_BC4 = 3,   // R, 8 bytes
+    eBlockFormat_BC5 = 4,   // RG, 16 bytes
+    eBlockFormat_BC7 = 5,   // RGBA, 16 bytes
+};
+
+enum DllExport AeBlockQuality {
+    eBlockQuality_fast = 0,
+    eBlockQuality_normal = 1,
+    eBlockQuality_high = 2,
+};
+
+// Processing of decoded 8-bit images for upload.
+class DllExport AeTextureEncode {
+    SINGLETON_CLASS(AeTextureEncode);
+
+    static unsigned int getMipLevels(int width, int height);  // down to 1x1
+    static size_t getMipmapSize(int width, int height, int bytes, unsigned int levels);  // levels 0 to levels - 1
+    // chain holds level 0 and has room for getMipmapSize; levels 1 to levels - 1 are written after it, each half the
+    // size of the one before (rounded down, at least 1). bSRGB filters the colour channels in linear light; with 4
+    // bytes the last one is alpha and stays linear. bParallel splits the rows of each level on COM_THREAD.
+    void generateMipmaps(unsigned char *chain, int width, int height, int bytes, unsigned int levels,
+                         AeMipmapFilter filter = eMipmapFilter_box, bool bSRGB = false, bool bParallel = false);
+
+    static size_t getBlockBytes(AeBlockFormat format);  // 0 for eBlockFormat_none
+    static size_t getCompressedSize(int width, int height, AeBlockFormat format, unsigned int levels = 1);
+    // RGBA8 chain, laid out as generateMipmaps writes it, to blocks level after level. Blocks past the edge repeat the
+    // last row and column. BC1 keeps pixels with alpha below 128 transparent; BC4 reads R and BC5 R and G. BC7 uses
+    // mode 6, and eBlockQuality_high also tries mode 5 with every channel rotation. bParallel splits block rows on
+    // COM_THREAD.
+    std::vector<unsigned char> encodeBlocks(const unsigned char *chain, int width, int height, unsigned int levels,
+                                            AeBlockFormat format, AeBlockQuality quality = eBlockQuality_normal,
+                                            bool bParallel = false);
+    // Into out, getCompressedSize bytes.
+    void encodeBlocks(const unsigned char *chain, int width, int height, unsigned int levels, AeBlockFormat format,
+                      unsigned char *out, AeBlockQuality quality = eBlockQuality_normal, bool bParallel = false);
+    // Reference decoder back to an RGBA8 chain. BC4 gives (R, 0, 0, 255) and BC5 (R, G, 0, 255); BC7 decodes modes 4
+    // to 6, the others come out as zero.
+    std::vector<unsigned char> decodeBlocks(const unsigned char *blocks, int width, int height, unsigned int levels,
+                                            AeBlockFormat format);
+    // Peak signal-to-noise ratio in dB of two RGBA8 images over the channels in channelMask (bit c for channel c).
+    static double getPSNR(const unsigned char *a, const unsigned char *b, size_t pixels, unsigned int channelMask = 0xF);
+};
+#define COM_TEXTURE AeTextureEncode::getInstance()
+
+// Worker threads shared by the engine, one less than the hardware threads. parallelFor also runs tasks on the
+// calling thread, so it can be called from inside another task without waiting on itself.
+struct QeThreadPoolData;
+class DllExport AeThreadPool {
+    SINGLETON_CLASS(AeThreadPool);
+
+    size_t getThreadCount();  // workers plus the calling thread
+    void parallelFor(size_t count, const std::function<void(size_t)> &task);  // task(0) ... task(count - 1)
+
+   private:
+    QeThreadPoolData *data;
+};
+#define COM_THREAD AeThreadPool::getInstance()
+
+// Read-only mapping of a whole file. Empty when the file cannot be opened or is empty.
+class DllExport AeMappedFile {
+   public:
+    AeMappedFile() {}
+    ~AeMappedFile();
+    AeMappedFile(const AeMappedFile &) = delete;
+    AeMappedFile &operator=(const AeMappedFile &) = delete;
+
+    bool open(const char *path);
+    void close();
+    const unsigned char *data() const { return view; }
+    size_t size() const { return viewSize; }
+
+   private:
+    const unsigned char *view = nullptr;
+    size_t viewSize = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
+
+// Bump allocator for many small objects that die together. Blocks are blockSize or larger and are only freed by
+// clear and the destructor, which run no destructors of what was created.
+class DllExport AeArena {
+   public:
+    AeArena(size_t _blockSize = 16384) : blockSize(_blockSize) {}
+    ~AeArena();
+    AeArena(const AeArena &) = delete;
+    AeArena &operator=(const AeArena &) = delete;
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    template <class T>
+    T *create() {
+        return new (allocate(sizeof(T), alignof(T))) T();
+    }
+    std::string_view copyString(std::string_view s);
+    void clear();
+
+   private:
+    std::vector<char *> blocks;
+    char *current = nullptr;
+    size_t remaining = 0;
+    size_t blockSize;
+};
+
+struct AeXMLAttribute {
+    std::string_view key;
+    std::string_view value;
+    AeXMLAttribute *next = nullptr;
+};
+
+struct AeXMLComment {
+    std::string_view text;
+    AeXMLComment *next = nullptr;
+};
+
+// Element of an AeXMLDocument. Keys, values and comments view the source buffer, or the arena once an edit of the
+// document replaced them.
+struct DllExport AeXMLElement {
+    std::string_view key;
+    std::string_view value;
+    AeXMLComment *comments = nullptr;  // written before the element
+    AeXMLAttribute *attributes = nullptr;
+    AeXMLElement *parent = nullptr;
+    AeXMLElement *children = nullptr;
+    AeXMLElement *lastChild = nullptr;
+    AeXMLElement *next = nullptr;
+
+    // Dot-separated paths, as AeXMLNode::getXMLNode and getXMLValue read them.
+    AeXMLElement *getXMLNode(std::string_view path);
+    AeXMLAttribute *getXMLAttribute(std::string_view key);
+    AeXMLElement *getXMLValue(std::string_view &value, std::string_view path);
+    template <class T>
+    T getXMLValue(std::string_view path);
+};
+
+// Compiled image of an AeXMLNode tree, which loads without parsing any text. COM_MGR.getXML saves one next to each XML
+// file as <file>.snapshot and maps it instead of the file while the file keeps its size and write time. Everything in
+// it is an offset, so it loads wherever it is mapped: a string table, the nodes breadth first so the children of a
+// node are consecutive, their elements and comments, and the AeXMLNumbers of every value that is numbers.
+class DllExport AeXMLSnapshot {
+   public:
+    static const uint32_t VERSION = 1;  // bump when the layout changes
+
+    static bool hashSource(const char *path, uint64_t &hash);  // of its size and write time; false when it is missing
+    static void compile(AeXMLNode *root, uint64_t sourceHash, std::vector<char> &image);
+    // nullptr for an image of another version or source. The nodes point into the image, which has to outlive them.
+    static AeXMLNode *decode(const unsigned char *image, size_t size, uint64_t sourceHash);
+
+    static bool save(AeXMLNode *root, const char *sourcePath);
+    static AeXMLNode *load(const char *sourcePath, AeMappedFile &file);  // nullptr when the snapshot is stale
+};
+
+// XML DOM over a buffer it keeps alive, a mapped file or one handed over. Elements, attributes and comments live in
+// one arena and view the buffer, so a parse makes a few allocations and the destructor frees them at once. Reads what
+// AeCommonEncode::decodeXML reads: the version, comments, elements with double-quoted attributes and their text,
+// all trimmed, no entities.
+class DllExport AeXMLDocument {
+   public:
+    AeXMLDocument() {}
+    AeXMLDocument(const AeXMLDocument &) = delete;
+    AeXMLDocument &operator=(const AeXMLDocument &) = delete;
+
+    bool open(const char *path);
+    bool parse(std::vector<char> &&_buffer);
+    void clear();
+    AeXMLElement *getRoot() const { return root; }
+    std::string_view getVersion() const { return version; }
+
+    // Edits copy the new text into the arena; the buffer is never written.
+    void setXMLKey(AeXMLElement *element, std::string_view key);
+    void setXMLValue(AeXMLElement *element, std::string_view value);
+    void setXMLValue(AeXMLElement *element, std::string_view key, std::string_view value);
+    AeXMLElement *addXMLNode(AeXMLElement *parent, std::string_view key);
+    void removeXMLNode(AeXMLElement *element);  // its memory stays in the arena until clear
+
+    // The text AeXMLNode::outputXML writes for the same tree.
+    void outputXML(std::string &content) const;
+    void outputXML(const char *path) const;
+
+   private:
+    bool parse(const char *text, size_t size);
+
+    AeMappedFile file;
+    std::vector<char> buffer;
+    AeArena arena;
+    AeXMLElement *root = nullptr;
+    std::string_view version;
+};
+
+// Writes AeXMLNode trees, for AeXMLNode::outputXML too, into a buffer it keeps between writes. Values are escaped: &
+// and < in text, and " too in attributes. Writing the same root again only writes the nodes edited since
+// (AeXMLData::bDirty) and copies the text of the others from the last write; addXMLNode keeps that right for moved
+// nodes.
+class DllExport AeXMLWriter {
+   public:
+    AeXMLWriter();
+    AeXMLWriter(const AeXMLWriter &) = delete;
+    AeXMLWriter &operator=(const AeXMLWriter &) = delete;
+
+    const std::string &write(AeXMLNode *root);  // valid until the next write
+    bool save(AeXMLNode *root, const char *path);
+    size_t getWrittenNodeCount() const { return writtenNodeCount; }  // by the last write, the copied ones not counted
+
+    static void writeXMLNode(const AeXMLNode *node, int level, std::string &content);  // the whole subtree
+
+   private:
+    void writeXMLNode(AeXMLNode *node, int level, size_t lastStart);
+
+    uint32_t id;
+    const AeXMLNode *lastRoot = nullptr;
+    std::string text;
+    std::string lastText;
+    size_t writtenNodeCount = 0;
+};
+
+enum AeXMLEvent {
+    eXMLEvent_end = 0,      // the root element closed
+    eXMLEvent_error,
+    eXMLEvent_version,      // value
+    eXMLEvent_comment,      // value, before the element it belongs to
+    eXMLEvent_startElement,  // key
+    eXMLEvent_attribute,     // key and value, after startElement
+    eXMLEvent_text,          // value, after the attributes; never empty
+    eXMLEvent_endElement,    // key of the element it closes
+};
+
+// Pull reader of XML: every next is one event, so a caller handles elements while the text is read and builds nodes
+// only for what it keeps. Reads what AeCommonEncode::decodeXML reads, trimmed, without recursion, and decodes the
+// entities AeXMLWriter writes in values. The text is a mapped file, a buffer or a stream read in chunks. Keys and
+// values view it and stay valid until the next call of next, or as long as the reader for a file or a buffer; a
+// value with entities views the reader until the next call.
+class DllExport AeXMLReader {
+   public:
+    AeXMLReader() {}
+    AeXMLReader(const AeXMLReader &) = delete;
+    AeXMLReader &operator=(const AeXMLReader &) = delete;
+
+    bool open(const char *path);
+    void open(const char *_text, size_t _size);  // not copied
+    void open(std::istream &_stream, size_t _chunkSize = 65536);
+
+    AeXMLEvent next();
+    std::string_view getKey() const { return key; }
+    std::string_view getValue() const { return value; }
+    size_t getDepth() const { return keyStarts.size(); }  // open elements, with the one of start and endElement
+
+    // After startElement: skip to its endElement, or read everything up to it into a node as decodeXML builds it.
+    bool skipXMLElement();
+    AeXMLNode *readXMLNode(AeXMLNode *parent = nullptr);
+    AeXMLNode *readXMLDocument();  // from the start; the root gets the version
+
+   private:
+    enum QeReadState { eRead_content, eRead_tag, eRead_text, eRead_end, eRead_error };
+
+    void reset();
+    bool fillXML(size_t n = 1);
+    bool hasXML(size_t n) { return size - pos >= n || fillXML(n); }  // bytes from pos
+    size_t findXML(size_t from, char c);  // from pos, npos at the end of the text
+    size_t findXML(size_t from, std::string_view token);
+    AeXMLEvent endXMLElement();
+    AeXMLEvent failXML();
+    std::string_view unescapeXML(std::string_view s);
+
+    AeMappedFile file;
+    std::istream *stream = nullptr;
+    std::vector<char> chunk;
+    size_t chunkSize = 0;
+    const char *text = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+
+    QeReadState state = eRead_content;
+    std::string keyStack;  // keys of the open elements, back to back
+    std::vector<size_t> keyStarts;
+    bool bPop = false;  // the last event closed the top of keyStack
+    std::string_view key;
+    std::string_view value;
+    std::string unescaped;  // a value with entities
+};
+
+enum AeJSONType {
+    eJSON_null = 0,
+    eJSON_bool = 1,
+    eJSON_int = 2,
+    eJSON_double = 3,
+    eJSON_string = 4,
+    eJSON_array = 5,
+    eJSON_object = 6,
+};
+
+struct AeJSONMember;
+class AeJSONPath;
+
+// Value of an AeJSONDocument. Numbers are parsed once, while the document is built. An array of numbers only keeps
+// them as contiguous floats, and as ints too when all of them are integers an int holds; it has no elements.
+struct DllExport AeJSONValue {
+    AeJSONType type = eJSON_null;
+    uint32_t size = 0;  // elements, members, or numbers of a numeric array
+    bool boolean = false;
+    int64_t integer = 0;  // eJSON_int
+    double number = 0;    // eJSON_int and eJSON_double
+    std::string_view string;
+    AeJSONValue *elements = nullptr;
+    AeJSONMember *members = nullptr;  // in file order
+    const uint32_t *slots = nullptr;  // open-addressed (member + 1) by key hash, for objects of more than 8 members
+    const float *floats = nullptr;
+    const int *ints = nullptr;
+
+    AeJSONValue *getJSONMember(std::string_view key) const;  // the first with the key, nullptr if this is no object
+    AeJSONValue *getJSONMember(std::string_view key, uint32_t hash) const;  // hash from AeJSONPath::hashKey
+    AeJSONValue *getJSONElement(size_t index) const;         // nullptr out of range or for a numeric array
+    // The first value at the keys, looking into every element of the arrays on the way, as AeJSONNode::getJSONValue.
+    AeJSONValue *getJSONValue(std::initializer_list<std::string_view> keys) const;
+    AeJSONValue *getJSONValue(const AeJSONPath &path) const;
+    bool isJSONNumber() const { return type == eJSON_int || type == eJSON_double; }
+    int64_t getJSONInt(int64_t defaultValue = 0) const;  // doubles truncate
+    double getJSONNumber(double defaultValue = 0) const;
+};
+
+struct AeJSONMember {
+    std::string_view key;
+    uint32_t hash = 0;  // AeJSONPath::hashKey of key
+    AeJSONValue value;
+};
+
+// Keys and indices compiled once, as "accessors[2].count" or "meshes.primitives.attributes". Keys are hashed here
+// and matched against the hashes the document keeps, so a lookup compares key text only when they match. A key on
+// an array looks into every element of it, as AeJSONValue::getJSONValue does; an index picks one.
+class DllExport AeJSONPath {
+   public:
+    explicit AeJSONPath(const char *path);
+    static uint32_t hashKey(std::string_view key);
+
+    struct Step {
+        std::string key;
+        uint32_t hash = 0;
+        uint32_t index = UINT32_MAX;  // the element for [index], UINT32_MAX for key
+    };
+    std::vector<Step> steps;
+};
+
+// JSON DOM in two stages. The first finds every structural character, string and scalar start of the text 64 bytes
+// at a time, with SSE2 where there is one; the second walks that index and builds values in an arena. Strings view the
+// buffer the document keeps, or the arena when they had escapes.
+class DllExport AeJSONDocument {
+   public:
+    AeJSONDocument() {}
+    AeJSONDocument(const AeJSONDocument &) = delete;
+    AeJSONDocument &operator=(const AeJSONDocument &) = delete;
+
+    bool open(const char *path);
+    bool parse(std::vector<char> &&_buffer);
+    void clear();
+    AeJSONValue *getRoot() const { return root; }
+
+    // Offsets of the structural characters, opening quotes and scalar starts, the input of the second stage.
+    static bool indexJSON(const char *text, size_t size, std::vector<uint32_t> &index);
+
+   private:
+    std::vector<char> buffer;
+    AeArena arena;
+    AeJSONValue *root = nullptr;
+};
+
+// Decoded pixels of one or more layers of the same size, mapped from the cache directory. Each layer holds its mip
+// levels back to back, as AeTextureEncode::generateMipmaps writes them.
+struct DllExport AeCachedImage {
+    AeMappedFile file;
+    const unsigned char *data = nullptr;
+    size_t dataSize = 0;  // all layers
+    int width = 0;
+    int height = 0;
+    int bytes = 0;
+    int layers = 0;
+    int levels = 0;
+    AeBlockFormat blockFormat = eBlockFormat_none;
+};
+
+// A DDS or KTX2 file mapped from disk, with the mip chains of its layers ready to upload as they are. Holds
+// BC1/3/4/5/7 blocks or 8-bit RGBA/BGRA pixels; supercompressed KTX2, volumes and arrays are refused. Cube faces are
+// the file's layers in the order +X, -X, +Y, -Y, +Z, -Z.
+struct DllExport AeTextureContainer {
+    AeMappedFile file;
+    const unsigned char *data = nullptr;  // payload, level data of all layers
+    size_t dataSize = 0;
+    std::vector<size_t> regionOffsets;  // layer l, level m at [l * levels + m], from data
+    int width = 0;
+    int height = 0;
+    int layers = 0;
+    int levels = 0;
+    AeBlockFormat blockFormat = eBlockFormat_none;
+    AeImageFormat pixelFormat = eImageFormat_RGBA8;  // RGBA8 or BGRA8 when blockFormat is none
+    bool bSRGB = false;
+    bool bColorSpace = false;  // whether the file states bSRGB: a DX10 DDS or a KTX2 does, a legacy DDS does not
+    bool bCubeMap = false;
+
+    bool open(const char *path);  // false when the file is missing, malformed or of another format
+
+   private:
+    bool openDDS();
+    bool openKTX2();
+};
+
+// Decoded images kept on disk, so the next launch maps them instead of decoding the sources again. key names the
+// decode (path, pixel format and so on) and sources are the files it reads. An entry is named by the hash of the key
+// and of the size and write time of every source, so a changed source misses and its old entry is replaced.
+class DllExport AeImageCache {
+    SINGLETON_CLASS(AeImageCache);
+
+    void setDirectory(const char *path);  // empty turns the cache off
+    bool load(const std::string &key, const std::vector<std::string> &sources, AeCachedImage &image);
+    bool save(const std::string &key, const std::vector<std::string> &sources, const unsigned char *data, size_t dataSize,
+              int width, int height, int bytes, int layers, int levels = 1, AeBlockFormat blockFormat = eBlockFormat_none);
+
+   private:
+    std::string directory;
+};
+#define COM_IMAGE_CACHE AeImageCache::getInstance()
+
 class DllExport QeTimer {
    public:
     QeTimer();
@@ -615,7 +1272,7 @@ class DllExport AeLog {
                    const char *output_path_xml_setting_path = "setting.path.log");
     void switchOutput(bool turn_on, const char *output_path = nullptr);
     std::string stack(int from, int to);
-    void print(std::string &msg, bool bShowStack = false, int stackLevel = 5);
+    void print(const std::string &msg, bool bShowStack = false, int stackLevel = 5);
 
     bool isOutput();
 };
@@ -0,0 +1,229 @@
+#include "common.h"
+
+uint32_t readContainer32(const unsigned char *data) {
+    return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+uint64_t readContainer64(const unsigned char *data) {
+    return uint64_t(readContainer32(data)) | (uint64_t(readContainer32(data + 4)) << 32);
+}
+
+const int MAX_CONTAINER_SIZE = 65536;  // keeps the size sums far from overflow
+
+// Bytes of one layer of a level.
+size_t getContainerImageSize(int width, int height, AeBlockFormat blockFormat) {
+    if (blockFormat == eBlockFormat_none) return size_t(width) * height * 4;
+    return AeTextureEncode::getCompressedSize(width, height, blockFormat);
+}
+
+bool AeTextureContainer::open(const char *path) {
+    file.close();
+    data = nullptr;
+    dataSize = 0;
+    regionOffsets.clear();
+    if (!file.open(path)) return false;
+
+    bool bOpen = false;
+    if (file.size() >= 4 && memcmp(file.data(), "DDS ", 4) == 0)
+        bOpen = openDDS();
+    else if (file.size() >= 12 && memcmp(file.data(), "\xABKTX 20\xBB\r\n\x1A\n", 12) == 0)
+        bOpen = openKTX2();
+    if (!bOpen) {
+        file.close();
+        regionOffsets.clear();
+        data = nullptr;
+        dataSize = 0;
+    }
+    return bOpen;
+}
+
+// DDS: the 124-byte header after the magic, then an optional DX10 header, then every layer with its mip levels.
+bool AeTextureContainer::openDDS() {
+    const unsigned char *header = file.data() + 4;
+    if (file.size() < 128 || readContainer32(header) != 124 || readContainer32(header + 72) != 32) return false;
+
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000, DDPF_FOURCC = 0x4, DDPF_RGB = 0x40;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200, DDSCAPS2_CUBEMAP_ALLFACES = 0xFC00, DDSCAPS2_VOLUME = 0x200000;
+    const uint32_t flags = readContainer32(header + 4), caps2 = readContainer32(header + 108);
+    height = int(readContainer32(header + 8));
+    width = int(readContainer32(header + 12));
+    levels = flags & DDSD_MIPMAPCOUNT ? std::max(1, int(readContainer32(header + 24))) : 1;
+    if (caps2 & DDSCAPS2_VOLUME) return false;
+    bCubeMap = (caps2 & DDSCAPS2_CUBEMAP) != 0;
+    if (bCubeMap && (caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES) return false;
+    layers = bCubeMap ? 6 : 1;
+    bSRGB = bColorSpace = false;
+    blockFormat = eBlockFormat_none;
+    size_t offset = 128;
+
+    const unsigned char *pixelDescription = header + 76;
+    const uint32_t pixelFlags = readContainer32(pixelDescription);
+    if (pixelFlags & DDPF_FOURCC) {
+        const unsigned char *fourCC = pixelDescription + 4;
+        if (memcmp(fourCC, "DXT1", 4) == 0)
+            blockFormat = eBlockFormat_BC1;
+        else if (memcmp(fourCC, "DXT5", 4) == 0)
+            blockFormat = eBlockFormat_BC3;
+        else if (memcmp(fourCC, "ATI1", 4) == 0 || memcmp(fourCC, "BC4U", 4) == 0)
+            blockFormat = eBlockFormat_BC4;
+        else if (memcmp(fourCC, "ATI2", 4) == 0 || memcmp(fourCC, "BC5U", 4) == 0)
+            blockFormat = eBlockFormat_BC5;
+        else if (memcmp(fourCC, "DX10", 4) == 0) {
+            if (file.size() < 148) return false;
+            const unsigned char *extended = file.data() + 128;
+            const uint32_t RESOURCE_DIMENSION_TEXTURE2D = 3, RESOURCE_MISC_TEXTURECUBE = 0x4;
+            if (readContainer32(extended + 4) != RESOURCE_DIMENSION_TEXTURE2D || readContainer32(extended + 12) != 1)
+                return false;  // arrays of more than one texture
+            bCubeMap = (readContainer32(extended + 8) & RESOURCE_MISC_TEXTURECUBE) != 0;
+            layers = bCubeMap ? 6 : 1;
+            const uint32_t format = readContainer32(extended);  // DXGI_FORMAT
+            switch (format) {
+                case 28:
+                case 29:
+                    pixelFormat = eImageFormat_RGBA8;
+                    break;
+                case 87:
+                case 91:
+                    pixelFormat = eImageFormat_BGRA8;
+                    break;
+                case 71:
+                case 72:
+                    blockFormat = eBlockFormat_BC1;
+                    break;
+                case 77:
+                case 78:
+                    blockFormat = eBlockFormat_BC3;
+                    break;
+                case 80:
+                    blockFormat = eBlockFormat_BC4;
+                    break;
+                case 83:
+                    blockFormat = eBlockFormat_BC5;
+                    break;
+                case 98:
+                case 99:
+                    blockFormat = eBlockFormat_BC7;
+                    break;
+                default:
+                    return false;
+            }
+            bSRGB = format == 29 || format == 91 || format == 72 || format == 78 || format == 99;
+            bColorSpace = true;
+            offset = 148;
+        } else
+            return false;
+    } else if (pixelFlags & DDPF_RGB) {
+        const uint32_t bits = readContainer32(pixelDescription + 8), red = readContainer32(pixelDescription + 12);
+        const uint32_t green = readContainer32(pixelDescription + 16), blue = readContainer32(pixelDescription + 20);
+        if (bits != 32 || green != 0xFF00) return false;
+        if (red == 0xFF && blue == 0xFF0000)
+            pixelFormat = eImageFormat_RGBA8;
+        else if (red == 0xFF0000 && blue == 0xFF)
+            pixelFormat = eImageFormat_BGRA8;
+        else
+            return false;
+    } else
+        return false;
+    if (width <= 0 || height <= 0 || width > MAX_CONTAINER_SIZE || height > MAX_CONTAINER_SIZE ||
+        levels > int(AeTextureEncode::getMipLevels(width, height)))
+        return false;
+
+    size_t size = 0;
+    for (int layer = 0; layer < layers; ++layer) {
+        int levelWidth = width, levelHeight = height;
+        for (int level = 0; level < levels; ++level) {
+            regionOffsets.push_back(size);
+            size += getContainerImageSize(levelWidth, levelHeight, blockFormat);
+            levelWidth = std::max(1, levelWidth / 2);
+            levelHeight = std::max(1, levelHeight / 2);
+        }
+    }
+    if (offset + size > file.size()) return false;
+    data = file.data() + offset;
+    dataSize = size;
+    return true;
+}
+
+// KTX2: the header and a level index of offsets into the file; each level holds every layer, face after face.
+bool AeTextureContainer::openKTX2() {
+    const unsigned char *header = file.data() + 12;
+    if (file.size() < 80) return false;
+    const uint32_t format = readContainer32(header);
+    width = int(readContainer32(header + 8));
+    height = int(readContainer32(header + 12));
+    const uint32_t depth = readContainer32(header + 16), arrayLayers = readContainer32(header + 20);
+    const uint32_t faces = readContainer32(header + 24), supercompression = readContainer32(header + 32);
+    levels = std::max(1, int(readContainer32(header + 28)));
+    if (depth > 1 || arrayLayers > 1 || (faces != 1 && faces != 6) || supercompression != 0) return false;
+    if (width <= 0 || height <= 0 || width > MAX_CONTAINER_SIZE || height > MAX_CONTAINER_SIZE ||
+        levels > int(AeTextureEncode::getMipLevels(width, height)))
+        return false;
+    bCubeMap = faces == 6;
+    layers = int(faces);
+
+    blockFormat = eBlockFormat_none;
+    switch (format) {  // VkFormat
+        case 37:
+        case 43:
+            pixelFormat = eImageFormat_RGBA8;
+            break;
+        case 44:
+        case 50:
+            pixelFormat = eImageFormat_BGRA8;
+            break;
+        case 133:
+        case 134:
+            blockFormat = eBlockFormat_BC1;
+            break;
+        case 137:
+        case 138:
+            blockFormat = eBlockFormat_BC3;
+            break;
+        case 139:
+            blockFormat = eBlockFormat_BC4;
+            break;
+        case 141:
+            blockFormat = eBlockFormat_BC5;
+            break;
+        case 145:
+        case 146:
+            blockFormat = eBlockFormat_BC7;
+            break;
+        default:
+            return false;
+    }
+    bSRGB = format == 43 || format == 50 || format == 134 || format == 138 || format == 146;
+    bColorSpace = true;
+
+    const size_t LEVEL_INDEX = 80, LEVEL_ENTRY = 24;
+    if (LEVEL_INDEX + size_t(levels) * LEVEL_ENTRY > file.size()) return false;
+    std::vector<size_t> levelOffsets(levels);
+    size_t first = file.size(), last = 0;
+    int levelWidth = width, levelHeight = height;
+    for (int level = 0; level < levels; ++level) {
+        const unsigned char *entry = file.data() + LEVEL_INDEX + size_t(level) * LEVEL_ENTRY;
+        const uint64_t offset = readContainer64(entry), length = readContainer64(entry + 8);
+        const size_t imageSize = getContainerImageSize(levelWidth, levelHeight, blockFormat);
+        if (length != uint64_t(imageSize) * layers || offset > file.size() || length > file.size() - offset) return false;
+        levelOffsets[level] = size_t(offset);
+        first = std::min(first, size_t(offset));
+        last = std::max(last, size_t(offset + length));
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    regionOffsets.resize(size_t(layers) * levels);
+    for (int layer = 0; layer < layers; ++layer) {
+        levelWidth = width;
+        levelHeight = height;
+        for (int level = 0; level < levels; ++level) {
+            const size_t imageSize = getContainerImageSize(levelWidth, levelHeight, blockFormat);
+            regionOffsets[size_t(layer) * levels + level] = levelOffsets[level] + layer * imageSize - first;
+            levelWidth = std::max(1, levelWidth / 2);
+            levelHeight = std::max(1, levelHeight / 2);
+        }
+    }
+    data = file.data() + first;
+    dataSize = last - first;
+    return true;
+}
@@ -1,38 +1,56 @@
 #include "common.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define AE_SSE41
+#include <smmintrin.h>
+#endif
+
 SINGLETON_INSTANCE(AeCommonEncode)
 
+// Canonical Huffman decoding table for Deflate. The first HUFFMAN_FIRSTBITS bits of the stream index the
+// primary table; codes longer than that are resolved through a subtable that the primary entry points to.
+const unsigned int HUFFMAN_FIRSTBITS = 9;
+const unsigned char HUFFMAN_INVALID = 0;
+
 struct QeHuffmanTree {
-    unsigned int *tree = nullptr;
+    unsigned char *tableLength = nullptr;     // code length, or total bits of the subtable when > HUFFMAN_FIRSTBITS
+    unsigned short int *tableValue = nullptr;  // symbol, or subtable offset when tableLength > HUFFMAN_FIRSTBITS
     unsigned int numcodes = 0;
 
     ~QeHuffmanTree() {
-        if (tree != nullptr) {
-            delete tree;
-            tree = nullptr;
+        if (tableLength != nullptr) {
+            delete[] tableLength;
+            tableLength = nullptr;
+        }
+        if (tableValue != nullptr) {
+            delete[] tableValue;
+            tableValue = nullptr;
         }
     }
 };
 
+// Canonical Huffman decoding table for JPEG. Codes up to JPEG_HUFFMAN_FIRSTBITS bits are resolved by one lookup
+// of the next JPEG_HUFFMAN_FIRSTBITS bits; longer codes fall back to comparing against the largest code of each
+// length.
+const unsigned int JPEG_HUFFMAN_FIRSTBITS = 9;
+
 struct QeHuffmanTree2 {
-    unsigned int *codes = nullptr;
-    unsigned int *codeBits = nullptr;
-    unsigned int *values = nullptr;
+    unsigned char lookupLength[1 << JPEG_HUFFMAN_FIRSTBITS];  // 0 for longer or invalid codes
+    unsigned char lookupValue[1 << JPEG_HUFFMAN_FIRSTBITS];
+    int maxcode[17];      // largest code of each length, -1 when there is none
+    int valueOffset[17];  // index in values of the first code of each length, minus that code
+    int lookupAC[1 << JPEG_HUFFMAN_FIRSTBITS];  // AC coefficient << 8 | run << 4 | bits, 0 when they don't fit
+    unsigned char values[256];
     size_t size = 0;
 
-    ~QeHuffmanTree2() {
-        if (codes != nullptr) {
-            delete codes;
-            codes = nullptr;
-        }
-        if (codeBits != nullptr) {
-            delete codeBits;
-            codeBits = nullptr;
-        }
-        if (values != nullptr) {
-            delete values;
-            values = nullptr;
-        }
+    QeHuffmanTree2() {
+        memset(lookupLength, 0, sizeof(lookupLength));
+        memset(lookupAC, 0, sizeof(lookupAC));
+        for (int i = 0; i < 17; ++i) maxcode[i] = -1;
     }
 };
 
@@ -45,26 +63,18 @@ const unsigned short int DISTANCEBASE[30] = {1,    2,    3,    4,    5,    7,
                                              1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
 const unsigned short int DISTANCEEXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
                                               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
-const unsigned char ZIGZAGTABLE[64] = {0,  1,  5,  6,  14, 15, 27, 28, 2,  4,  7,  13, 16, 26, 29, 42, 3,  8,  12, 17, 25, 30,
-                                       41, 43, 9,  11, 18, 24, 31, 40, 44, 53, 10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38,
-                                       46, 51, 55, 60, 21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63};
-
-void xadd3(int *xa, int *xb, int *xc, int *xd, int h, int *p, int *n) {
-    *p = *xa + *xb;
-    *n = *xa - *xb;
-    *xa = *p + *xc + h;
-    *xb = *n + *xd + h;
-    *xc = *p - *xc + h;
-    *xd = *n - *xd + h;
-}
-void xmul(int *xa, int *xb, int k1, int k2, int sh, int *p, int *n) {
-    *n = k1 * (*xa + *xb);
-    *p = *xa;
-    *xa = (*n + (k2 - k1) * *xb) >> sh;
-    *xb = (*n - (k2 + k1) * *p) >> sh;
-}
-
-void buildHuffmanTree(QeHuffmanTree *tree, const unsigned int *bitlen, unsigned int numcodes, unsigned maxbitlen) {
+// Natural (row-major) index of each coefficient in JPEG zig-zag order
+const unsigned char ZIGZAGTONATURAL[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+                                           41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+                                           30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+unsigned int reverseBits(unsigned int bits, unsigned int count) {
+    unsigned int ret = 0;
+    for (unsigned int i = 0; i < count; ++i) ret |= ((bits >> i) & 1) << (count - i - 1);
+    return ret;
+}
+
+bool buildHuffmanTree(QeHuffmanTree *tree, const unsigned int *bitlen, unsigned int numcodes, unsigned maxbitlen) {
     tree->numcodes = (unsigned)numcodes;
 
     unsigned int *tree1d = new unsigned int[numcodes];
@@ -78,40 +88,86 @@ void buildHuffmanTree(QeHuffmanTree *tree, const unsigned int *bitlen, unsigned
     unsigned int i = 0, j = 0;
 
     for (i = 0; i < numcodes; ++i) ++blcount[bitlen[i]];
+    blcount[0] = 0;
+
+    // reject over-subscribed code lengths, incomplete ones just leave invalid entries
+    int left = 1;
+    for (i = 1; i <= maxbitlen; ++i) {
+        left = (left << 1) - int(blcount[i]);
+        if (left < 0) {
+            delete[] tree1d;
+            delete[] blcount;
+            delete[] nextcode;
+            return false;
+        }
+    }
     for (i = 1; i <= maxbitlen; ++i) nextcode[i] = (nextcode[i - 1] + blcount[i - 1]) << 1;
     for (i = 0; i < numcodes; ++i)
         if (bitlen[i] != 0) tree1d[i] = nextcode[bitlen[i]]++;
 
-    unsigned int nodefilled = 0;
-    unsigned int treepos = 0;
-
-    tree->tree = new unsigned int[tree->numcodes * 2];
-    for (i = 0; i < numcodes * 2; ++i) tree->tree[i] = UINT_MAX;
+    // Deflate packs Huffman codes starting from the most significant bit, but the stream is read from the
+    // least significant bit, so every code is stored bit-reversed.
+    const unsigned int headsize = 1u << HUFFMAN_FIRSTBITS;
+    const unsigned int mask = headsize - 1;
 
+    unsigned int *maxlens = new unsigned int[headsize];
+    memset(maxlens, 0, headsize * sizeof(unsigned int));
     for (i = 0; i < numcodes; ++i) {
-        for (j = 0; j < bitlen[i]; ++j) {
-            unsigned char bit = (unsigned char)((tree1d[i] >> (bitlen[i] - j - 1)) & 1);
+        if (bitlen[i] <= HUFFMAN_FIRSTBITS) continue;
+        unsigned int index = reverseBits(tree1d[i] >> (bitlen[i] - HUFFMAN_FIRSTBITS), HUFFMAN_FIRSTBITS);
+        if (bitlen[i] > maxlens[index]) maxlens[index] = bitlen[i];
+    }
 
-            if (tree->tree[2 * treepos + bit] == UINT_MAX) {
-                if (j + 1 == bitlen[i]) {
-                    tree->tree[2 * treepos + bit] = i;
-                    treepos = 0;
-                } else {
-                    ++nodefilled;
-                    tree->tree[2 * treepos + bit] = nodefilled + tree->numcodes;
-                    treepos = nodefilled;
-                }
-            } else
-                treepos = tree->tree[2 * treepos + bit] - tree->numcodes;
-        }
+    unsigned int size = headsize;
+    for (i = 0; i < headsize; ++i)
+        if (maxlens[i] > HUFFMAN_FIRSTBITS) size += 1u << (maxlens[i] - HUFFMAN_FIRSTBITS);
+
+    tree->tableLength = new unsigned char[size];
+    tree->tableValue = new unsigned short int[size];
+    memset(tree->tableLength, HUFFMAN_INVALID, size * sizeof(unsigned char));
+    memset(tree->tableValue, 0, size * sizeof(unsigned short int));
+
+    unsigned int pointer = headsize;
+    for (i = 0; i < headsize; ++i) {
+        if (maxlens[i] <= HUFFMAN_FIRSTBITS) continue;
+        tree->tableLength[i] = (unsigned char)maxlens[i];
+        tree->tableValue[i] = (unsigned short int)pointer;
+        pointer += 1u << (maxlens[i] - HUFFMAN_FIRSTBITS);
     }
 
-    for (i = 0; i < tree->numcodes * 2; ++i)
-        if (tree->tree[i] == UINT_MAX) tree->tree[i] = 0;
+    for (i = 0; i < numcodes; ++i) {
+        unsigned int len = bitlen[i];
+        if (len == 0) continue;
+        unsigned int reverse = reverseBits(tree1d[i], len);
+
+        if (len <= HUFFMAN_FIRSTBITS) {
+            // short code, fill every primary entry that starts with it
+            unsigned int num = 1u << (HUFFMAN_FIRSTBITS - len);
+            for (j = 0; j < num; ++j) {
+                unsigned int index = reverse | (j << len);
+                tree->tableLength[index] = (unsigned char)len;
+                tree->tableValue[index] = (unsigned short int)i;
+            }
+        } else {
+            // long code, fill the subtable the primary entry points to
+            unsigned int index = reverse & mask;
+            unsigned int subbits = tree->tableLength[index] - HUFFMAN_FIRSTBITS;
+            unsigned int start = tree->tableValue[index];
+            unsigned int reverse2 = reverse >> HUFFMAN_FIRSTBITS;
+            unsigned int num = 1u << (subbits - (len - HUFFMAN_FIRSTBITS));
+            for (j = 0; j < num; ++j) {
+                unsigned int index2 = start + (reverse2 | (j << (len - HUFFMAN_FIRSTBITS)));
+                tree->tableLength[index2] = (unsigned char)len;
+                tree->tableValue[index2] = (unsigned short int)i;
+            }
+        }
+    }
 
+    if (maxlens != nullptr) delete[] maxlens;
     if (tree1d != nullptr) delete[] tree1d;
     if (blcount != nullptr) delete[] blcount;
     if (nextcode != nullptr) delete[] nextcode;
+    return true;
 }
 
 void buildFixedLZ77HuffmanTree(QeHuffmanTree *treeLL, QeHuffmanTree *treeD) {
@@ -127,25 +183,29 @@ void buildFixedLZ77HuffmanTree(QeHuffmanTree *treeLL, QeHuffmanTree *treeD) {
     // distance 32, 30-31 are unused
     unsigned int bitlenD[32];
     for (i = 0; i < 32; ++i) bitlenD[i] = 5;
-    buildHuffmanTree(treeD, bitlenD, 288, 15);
+    buildHuffmanTree(treeD, bitlenD, 32, 15);
 }
 
-unsigned int huffmanDecodeSymbol(const unsigned char *in, size_t *bitPointer, const QeHuffmanTree *tree) {
-    unsigned int treepos = 0, ret = 0;
+unsigned int huffmanDecodeSymbol(AeBitStreamLSB &stream, const QeHuffmanTree *tree) {
+    unsigned int code = stream.peek(HUFFMAN_FIRSTBITS);
+    unsigned int len = tree->tableLength[code];
+    unsigned int value = tree->tableValue[code];
 
-    while (1) {
-        ret = tree->tree[(treepos << 1) + COM_ENCODE.readBits(in, bitPointer, 1)];
-        if (ret < tree->numcodes)
-            return ret;
-        else
-            treepos = ret - tree->numcodes;
+    if (len > HUFFMAN_FIRSTBITS) {
+        code = value + (stream.peek(len) >> HUFFMAN_FIRSTBITS);
+        len = tree->tableLength[code];
+        value = tree->tableValue[code];
     }
+    if (len == HUFFMAN_INVALID) return UINT_MAX;
+    stream.consume(len);
+    return value;
 }
 
-void buildDynamicLZ77HuffmanTree(QeHuffmanTree *treeLL, QeHuffmanTree *treeD, const unsigned char *in, size_t *bitPointer) {
-    unsigned int HLIT = COM_ENCODE.readBits(in, bitPointer, 5) + 257;
-    unsigned int HDIST = COM_ENCODE.readBits(in, bitPointer, 5) + 1;
-    unsigned int HCLEN = COM_ENCODE.readBits(in, bitPointer, 4) + 4;
+bool buildDynamicLZ77HuffmanTree(QeHuffmanTree *treeLL, QeHuffmanTree *treeD, AeBitStreamLSB &stream) {
+    unsigned int HLIT = stream.read(5) + 257;
+    unsigned int HDIST = stream.read(5) + 1;
+    unsigned int HCLEN = stream.read(4) + 4;
+    if (HLIT > 286 || HDIST > 30) return false;
 
     unsigned int i = 0, j = 0;
     unsigned int bitlenCCL[19];
@@ -153,10 +213,10 @@ void buildDynamicLZ77HuffmanTree(QeHuffmanTree *treeLL, QeHuffmanTree *treeD, co
     // for (i = 0; i < 19; ++i) bitlenCCL[i] = 0;
 
     for (i = 0; i < 19; ++i)
-        if (i < HCLEN) bitlenCCL[CCL_ORDER[i]] = COM_ENCODE.readBits(in, bitPointer, 3);
+        if (i < HCLEN) bitlenCCL[CCL_ORDER[i]] = stream.read(3);
 
     QeHuffmanTree treeCCL;
-    buildHuffmanTree(&treeCCL, bitlenCCL, 19, 7);
+    if (!buildHuffmanTree(&treeCCL, bitlenCCL, 19, 7)) return false;
 
     unsigned int bitlenLL[288];
     unsigned int bitlenD[32];
@@ -165,210 +225,654 @@ void buildDynamicLZ77HuffmanTree(QeHuffmanTree *treeLL, QeHuffmanTree *treeD, co
 
     i = 0;
     while (i < HLIT + HDIST) {
-        unsigned int code = huffmanDecodeSymbol(in, bitPointer, &treeCCL);
+        unsigned int code = huffmanDecodeSymbol(stream, &treeCCL);
+        unsigned int replength = 1;
+        unsigned int value = code;
+
         if (code < 16) {  // No duplicate or duplicate < 3
-            if (i < HLIT)
-                bitlenLL[i] = code;
-            else
-                bitlenD[i - HLIT] = code;
-            ++i;
         } else if (code == 16) {  // not 0, duplicate 3-6
-            unsigned int replength = 3 + COM_ENCODE.readBits(in, bitPointer, 2);
-            unsigned int value;
+            if (i == 0) return false;
+            replength = 3 + stream.read(2);
 
             if (i < HLIT + 1)
                 value = bitlenLL[i - 1];
             else
                 value = bitlenD[i - HLIT - 1];
-
-            for (j = 0; j < replength; ++j) {
-                if (i < HLIT)
-                    bitlenLL[i] = value;
-                else
-                    bitlenD[i - HLIT] = value;
-                ++i;
-            }
         } else if (code == 17) {  // 0, duplicate 3-10, 3 bits
-            unsigned int replength = 3 + COM_ENCODE.readBits(in, bitPointer, 3);
-
-            for (j = 0; j < replength; ++j) {
-                if (i < HLIT)
-                    bitlenLL[i] = 0;
-                else
-                    bitlenD[i - HLIT] = 0;
-                ++i;
-            }
+            replength = 3 + stream.read(3);
+            value = 0;
         } else if (code == 18) {  // 0, duplicate 11-138, 7 bits
-            unsigned int replength = 11 + COM_ENCODE.readBits(in, bitPointer, 7);
+            replength = 11 + stream.read(7);
+            value = 0;
+        } else
+            return false;  // invalid code
 
-            for (j = 0; j < replength; ++j) {
-                if (i < HLIT)
-                    bitlenLL[i] = 0;
-                else
-                    bitlenD[i - HLIT] = 0;
-                ++i;
-            }
+        if (i + replength > HLIT + HDIST || stream.isOverrun()) return false;
+        for (j = 0; j < replength; ++j) {
+            if (i < HLIT)
+                bitlenLL[i] = value;
+            else
+                bitlenD[i - HLIT] = value;
+            ++i;
         }
     }
-    buildHuffmanTree(treeLL, bitlenLL, 288, 15);
-    buildHuffmanTree(treeD, bitlenD, 32, 15);
+    if (bitlenLL[256] == 0) return false;  // no end code
+    return buildHuffmanTree(treeLL, bitlenLL, 288, 15) && buildHuffmanTree(treeD, bitlenD, 32, 15);
 }
 
-void decodeLitLenDis(std::vector<unsigned char> *out, QeHuffmanTree *treeLL, QeHuffmanTree *treeD, unsigned char *in,
-                     size_t *bitPointer) {
-    while (1) {
-        unsigned int codeLL = huffmanDecodeSymbol(in, bitPointer, treeLL);
-        if (codeLL < 256)
-            out->push_back(codeLL);  // literals
+// Inflate output. A fixed buffer is filled in place and never reallocated; with an owner vector the buffer
+// grows geometrically instead.
+struct QeInflateOutput {
+    unsigned char *data = nullptr;
+    size_t size = 0;
+    size_t capacity = 0;
+    std::vector<unsigned char> *owner = nullptr;
+
+    bool reserve(size_t count) {
+        if (size + count <= capacity) return true;
+        if (!owner) return false;
+        size_t newCapacity = capacity * 2;
+        if (newCapacity < size + count) newCapacity = size + count;
+        if (newCapacity < 1024) newCapacity = 1024;
+        owner->resize(newCapacity);
+        data = owner->data();
+        capacity = newCapacity;
+        return true;
+    }
+};
+
+void copyMatch(unsigned char *dst, size_t distance, size_t length) {
+    const unsigned char *src = dst - distance;
+    if (distance == 1) {
+        memset(dst, *src, length);
+        return;
+    }
+    // An overlapping match repeats the last distance bytes. Every copy doubles the repeated span, so the
+    // source and destination of each memcpy never overlap.
+    while (length > 0) {
+        size_t count = size_t(dst - src);
+        if (count > length) count = length;
+        memcpy(dst, src, count);
+        dst += count;
+        length -= count;
+    }
+}
 
-        else if (codeLL > 256 && codeLL < 286) {  // length
+bool decodeLitLenDis(QeInflateOutput *out, QeHuffmanTree *treeLL, QeHuffmanTree *treeD, AeBitStreamLSB &stream) {
+    while (1) {
+        unsigned int codeLL = huffmanDecodeSymbol(stream, treeLL);
+        if (codeLL < 256) {  // literals
+            if (!out->reserve(1)) return false;
+            out->data[out->size++] = (unsigned char)codeLL;
+        } else if (codeLL > 256 && codeLL < 286) {  // length
             unsigned int numextrabitsLen = LENGTHEXTRA[codeLL - 257];
-            unsigned int length = LENGTHBASE[codeLL - 257] + COM_ENCODE.readBits(in, bitPointer, numextrabitsLen);
+            unsigned int length = LENGTHBASE[codeLL - 257] + stream.read(numextrabitsLen);
 
-            unsigned int codeD = huffmanDecodeSymbol(in, bitPointer, treeD);  // 0-29
+            unsigned int codeD = huffmanDecodeSymbol(stream, treeD);  // 0-29
+            if (codeD > 29) return false;
             unsigned int numextrabitsDis = DISTANCEEXTRA[codeD];
-            unsigned int distance = DISTANCEBASE[codeD] + COM_ENCODE.readBits(in, bitPointer, numextrabitsDis);
+            unsigned int distance = DISTANCEBASE[codeD] + stream.read(numextrabitsDis);
+            if (distance > out->size || !out->reserve(length)) return false;
 
-            while (1) {
-                if (distance < length) {
-                    out->insert(out->end(), out->end() - distance, out->end());
-                    length -= distance;
-                } else {
-                    out->insert(out->end(), out->end() - distance, out->end() - distance + length);
-                    break;
-                }
-            }
+            copyMatch(out->data + out->size, distance, length);
+            out->size += length;
         } else
-            break;  // codeLL = 256 or the others
+            return codeLL == 256;  // end of block, or an invalid code
+
+        if (stream.isOverrun()) return false;
     }
 }
 
-void decodeHuffmanLZ77(std::vector<unsigned char> *out, unsigned char *in, size_t *bitPointer, unsigned int BYTE) {
+bool decodeHuffmanLZ77(QeInflateOutput *out, AeBitStreamLSB &stream, unsigned int BYTE) {
     // literal/length, distance for LZ77
     QeHuffmanTree treeLL, treeD;
     // decodeCCL
     if (BYTE == 1)
         buildFixedLZ77HuffmanTree(&treeLL, &treeD);  // fixed Huffman
-    else if (BYTE == 2)
-        buildDynamicLZ77HuffmanTree(&treeLL, &treeD, in,
-                                    bitPointer);  // dynamic Huffman
+    else if (BYTE == 2) {
+        if (!buildDynamicLZ77HuffmanTree(&treeLL, &treeD, stream)) return false;  // dynamic Huffman
+    }
 
-    return decodeLitLenDis(out, &treeLL, &treeD, in, bitPointer);
+    return decodeLitLenDis(out, &treeLL, &treeD, stream);
 }
 
-unsigned int getHuffmanDecodeSymbol(const unsigned char *in, size_t *bitPointer, const QeHuffmanTree2 *tree) {
-    unsigned char codeBits = 0;
-    unsigned int key = 0;
-    size_t oBitPointer = *bitPointer;
+bool checkZlibHeader(const unsigned char *in, size_t size) {
+    // CMF: compression method 8 (Deflate) with a window of at most 32KB
+    // FLG: CMF * 256 + FLG is a multiple of 31, no preset dictionary
+    if (size < 2) return false;
+    if ((in[0] & 0x0F) != 8 || (in[0] >> 4) > 7) return false;
+    if (((unsigned int)in[0] * 256 + in[1]) % 31 != 0) return false;
+    if (in[1] & 0x20) return false;
+    return true;
+}
 
-    for (int i = 0; i < tree->size; ++i) {
-        if (tree->codeBits[i] != codeBits) {
-            *bitPointer = oBitPointer;
-            codeBits = tree->codeBits[i];
-            key = COM_ENCODE.readBits(in, bitPointer, codeBits, true);
+bool decodeDeflateBlocks(QeInflateOutput *out, AeBitStreamLSB &stream) {
+    unsigned int BFINAL = 0;
+    unsigned int BYTE = 0;
+
+    while (!BFINAL) {
+        BFINAL = stream.read(1);
+        BYTE = stream.read(2);
+
+        if (BYTE == 0) {  // No compression
+            stream.alignToByte();
+            unsigned int length = stream.read(16);
+            unsigned int nlength = stream.read(16);
+            size_t bytePos = stream.getBitPosition() / 8;
+            if ((length ^ 0xFFFF) != nlength || bytePos + length > stream.size) return false;
+            if (!out->reserve(length)) return false;
+
+            memcpy(out->data + out->size, stream.data + bytePos, length);
+            out->size += length;
+            stream.setBitPosition((bytePos + length) * 8);
+        } else if (BYTE == 1 || BYTE == 2) {
+            if (!decodeHuffmanLZ77(out, stream, BYTE)) return false;  // fixed or dynamic Huffman
+        } else
+            return false;
+        if (stream.isOverrun()) return false;
+    }
+    return true;
+}
+
+const size_t INFLATE_WINDOW = 32768;     // largest Deflate distance
+const size_t INFLATE_MAXMATCH = 258;     // largest Deflate length
+const size_t INFLATE_BRIDGE = 1024;      // longer than any block header, the largest step that can't be split
+const unsigned int ADLER_MOD = 65521;
+const size_t ADLER_NMAX = 5552;          // bytes that can be summed before the 32-bit sums overflow
+
+AeInflateStream::AeInflateStream(bool bZlib_) : bZlib(bZlib_), treeLL(nullptr), treeD(nullptr) { reset(); }
+
+AeInflateStream::~AeInflateStream() {
+    if (treeLL != nullptr) delete treeLL;
+    if (treeD != nullptr) delete treeD;
+}
+
+void AeInflateStream::reset() {
+    state = bZlib ? eState_zlibHeader : eState_blockHeader;
+    bFinal = false;
+    storedRemain = 0;
+    adler = 1;
+    adlerEnd = 0;
+    window.resize(INFLATE_WINDOW * 2 + INFLATE_MAXMATCH);
+    windowEnd = 0;
+    windowRead = 0;
+    stream.set(nullptr, 0);
+    pending.clear();
+    pendingExternal = 0;
+    input = nullptr;
+    inputSize = 0;
+    inputCopied = 0;
+}
+
+void AeInflateStream::setInput(const unsigned char *in, size_t size) {
+    input = in;
+    inputSize = size;
+    inputCopied = 0;
+    pendingExternal = 0;
+    if (pending.empty()) stream.set(in, size);
+}
+
+bool AeInflateStream::nextInput() {
+    // A step ran past the end of pending, move the next part of the current chunk behind it
+    if (stream.data == input || inputCopied >= inputSize) return false;
+
+    size_t bit = stream.getBitPosition();
+    pending.erase(pending.begin(), pending.begin() + (bit >> 3));
+    size_t count = inputSize - inputCopied;
+    if (count > INFLATE_BRIDGE) count = INFLATE_BRIDGE;
+    pending.insert(pending.end(), input + inputCopied, input + inputCopied + count);
+    inputCopied += count;
+    pendingExternal += count;
+
+    stream.set(pending.data(), pending.size());
+    stream.setBitPosition(bit & 7);
+    return true;
+}
+
+void AeInflateStream::stashInput() {
+    // Keep the bytes the unfinished step needs until the next chunk arrives
+    size_t bit = stream.getBitPosition();
+    if (stream.data == input)
+        pending.assign(input + (bit >> 3), input + inputSize);
+    else
+        pending.erase(pending.begin(), pending.begin() + (bit >> 3));
+    inputCopied = inputSize;
+    pendingExternal = 0;
+
+    stream.set(pending.data(), pending.size());
+    if (!pending.empty()) stream.setBitPosition(bit & 7);
+}
+
+void AeInflateStream::updateAdler() {
+    unsigned int a = adler & 0xFFFF;
+    unsigned int b = adler >> 16;
+    const unsigned char *data = window.data() + adlerEnd;
+    size_t size = windowEnd - adlerEnd;
+
+    while (size > 0) {
+        size_t count = size < ADLER_NMAX ? size : ADLER_NMAX;
+        size -= count;
+        while (count--) {
+            a += *data++;
+            b += a;
         }
-        if (key == tree->codes[i]) return tree->values[i];
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
     }
-    *bitPointer = oBitPointer;
-    return 0;
+    adler = (b << 16) | a;
+    adlerEnd = windowEnd;
 }
 
-void getHuffmanDecodeSymbolfromDCAC(short int *out, unsigned char blocks, const unsigned char *in, size_t *bitPointer,
-                                    const QeHuffmanTree2 *dc, const QeHuffmanTree2 *ac) {
-    int value1 = 0, value2 = 0, value3 = 0;
-    size_t index = 0, index1 = 0;
+void AeInflateStream::endBlock() {
+    if (!bFinal)
+        state = eState_blockHeader;
+    else
+        state = bZlib ? eState_adler : eState_done;
+}
 
-    int j = 0;
-    for (int i = 0; i < blocks; ++i) {
-        value1 = getHuffmanDecodeSymbol(in, bitPointer, dc);
-        value2 = COM_ENCODE.readBits(in, bitPointer, value1, true, true);
-        out[index] = value2;
-        ++index;
+// Decodes one step that can't be split: a header, a symbol or a run of stored bytes. Returns false when the
+// step needs more input than there is, or sets eState_error for a broken stream.
+bool AeInflateStream::decodeStep() {
+    switch (state) {
+        case eState_zlibHeader: {
+            unsigned char header[2];
+            header[0] = (unsigned char)stream.read(8);
+            header[1] = (unsigned char)stream.read(8);
+            if (stream.isOverrun()) return false;
+            state = checkZlibHeader(header, 2) ? eState_blockHeader : eState_error;
+            return true;
+        }
+        case eState_blockHeader: {
+            bFinal = stream.read(1) != 0;
+            unsigned int BYTE = stream.read(2);
+
+            if (BYTE == 0) {  // No compression
+                stream.alignToByte();
+                unsigned int length = stream.read(16);
+                unsigned int nlength = stream.read(16);
+                if (stream.isOverrun()) return false;
+                if ((length ^ 0xFFFF) != nlength) {
+                    state = eState_error;
+                    return false;
+                }
+                storedRemain = length;
+                if (storedRemain == 0)
+                    endBlock();
+                else
+                    state = eState_stored;
+                return true;
+            }
+            if (BYTE == 3) {
+                if (stream.isOverrun()) return false;
+                state = eState_error;
+                return false;
+            }
+
+            if (treeLL != nullptr) delete treeLL;
+            if (treeD != nullptr) delete treeD;
+            treeLL = new QeHuffmanTree();
+            treeD = new QeHuffmanTree();
+            if (BYTE == 1) {
+                if (stream.isOverrun()) return false;
+                buildFixedLZ77HuffmanTree(treeLL, treeD);
+            } else if (!buildDynamicLZ77HuffmanTree(treeLL, treeD, stream) || stream.isOverrun()) {
+                if (!stream.isOverrun()) state = eState_error;
+                return false;
+            }
+            state = eState_huffman;
+            return true;
+        }
+        case eState_stored: {
+            size_t bytePos = stream.getBitPosition() >> 3;
+            if (bytePos >= stream.size) return false;
+            size_t count = stream.size - bytePos;
+            if (count > storedRemain) count = storedRemain;
+            if (count > INFLATE_WINDOW * 2 - windowEnd) count = INFLATE_WINDOW * 2 - windowEnd;
+
+            memcpy(window.data() + windowEnd, stream.data + bytePos, count);
+            windowEnd += count;
+            storedRemain -= count;
+            stream.setBitPosition((bytePos + count) * 8);
+            if (storedRemain == 0) endBlock();
+            return true;
+        }
+        case eState_huffman: {
+            // A symbol takes at most 48 bits, so far from the end of the input symbols are decoded in a loop;
+            // only the last bytes of a chunk go one symbol per step.
+            bool bSafe = (stream.getBitPosition() >> 3) + 16 <= stream.size;
+            unsigned char *data = window.data();
+            do {
+                unsigned int codeLL = huffmanDecodeSymbol(stream, treeLL);
+                if (codeLL < 256) {  // literals
+                    if (stream.isOverrun()) return false;
+                    data[windowEnd++] = (unsigned char)codeLL;
+                } else if (codeLL > 256 && codeLL < 286) {  // length
+                    unsigned int length = LENGTHBASE[codeLL - 257] + stream.read(LENGTHEXTRA[codeLL - 257]);
+                    unsigned int codeD = huffmanDecodeSymbol(stream, treeD);  // 0-29
+                    unsigned int distance = codeD > 29 ? 0 : DISTANCEBASE[codeD] + stream.read(DISTANCEEXTRA[codeD]);
+                    if (stream.isOverrun()) return false;
+                    if (codeD > 29 || distance > windowEnd) {
+                        state = eState_error;
+                        return false;
+                    }
+                    copyMatch(data + windowEnd, distance, length);
+                    windowEnd += length;
+                } else {
+                    if (stream.isOverrun()) return false;
+                    if (codeLL == 256)  // end of block
+                        endBlock();
+                    else
+                        state = eState_error;
+                    return codeLL == 256;
+                }
+            } while (bSafe && windowEnd < INFLATE_WINDOW * 2 && (stream.getBitPosition() >> 3) + 16 <= stream.size);
+            return true;
+        }
+        case eState_adler: {
+            stream.alignToByte();
+            unsigned int value = stream.read(8) << 24;
+            value |= stream.read(8) << 16;
+            value |= stream.read(8) << 8;
+            value |= stream.read(8);
+            if (stream.isOverrun()) return false;
+            updateAdler();
+            state = (value == adler) ? eState_done : eState_error;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
 
-        while (index % 64 != 0) {
-            value1 = getHuffmanDecodeSymbol(in, bitPointer, ac);
-            if (value1 == 0) break;
+AeInflateStatus AeInflateStream::inflate(unsigned char *out, size_t outSize, size_t *written) {
+    *written = 0;
+    while (1) {
+        size_t count = windowEnd - windowRead;
+        if (count > outSize - *written) count = outSize - *written;
+        memcpy(out + *written, window.data() + windowRead, count);
+        windowRead += count;
+        *written += count;
+
+        if (state == eState_error) return eInflate_error;
+        if (windowRead < windowEnd || *written == outSize) return eInflate_outputFull;
+        if (state == eState_done) return eInflate_done;
+
+        // everything is handed out, keep the last 32KB as history
+        if (windowEnd >= INFLATE_WINDOW * 2) {
+            if (bZlib) updateAdler();
+            memmove(window.data(), window.data() + windowEnd - INFLATE_WINDOW, INFLATE_WINDOW);
+            windowEnd = windowRead = adlerEnd = INFLATE_WINDOW;
+        }
 
-            index1 = 0;
-            value2 = COM_ENCODE.readBits((unsigned char *)&value1, &index1, 4);
-            value3 = COM_ENCODE.readBits((unsigned char *)&value1, &index1, 4);
-            index += value3;
+        bool bStall = false;
+        while (windowEnd < INFLATE_WINDOW * 2 && state != eState_done && state != eState_error) {
+            size_t mark = stream.getBitPosition();
+            if (decodeStep()) {
+                // past the copied head of the chunk, read the rest of it in place
+                if (pendingExternal > 0 && stream.getBitPosition() >= (pending.size() - pendingExternal) * 8) {
+                    size_t bit = stream.getBitPosition() - (pending.size() - pendingExternal) * 8;
+                    pending.clear();
+                    pendingExternal = 0;
+                    stream.set(input, inputSize);
+                    stream.setBitPosition(bit);
+                }
+                continue;
+            }
+            if (state == eState_error) break;
 
-            if (value2 > 0)
-                out[index] = COM_ENCODE.readBits(in, bitPointer, value2, true, true);
-            else
-                out[index] = 0;
-            ++index;
+            stream.setBitPosition(mark);
+            if (!nextInput()) {
+                stashInput();
+                bStall = true;
+                break;
+            }
         }
-        index = (index + 63) / 64 * 64;
+        if (bStall && windowRead == windowEnd) return eInflate_needInput;
     }
 }
 
-void idct1(int *x, int *y, int ps, int half) {
-    int p, n;
-    x[0] <<= 9, x[1] <<= 7, x[3] *= 181, x[4] <<= 9, x[5] *= 181, x[7] <<= 7;
-    xmul(&x[6], &x[2], 277, 669, 0, &p, &n);
-    xadd3(&x[0], &x[4], &x[6], &x[2], half, &p, &n);
-    xadd3(&x[1], &x[7], &x[3], &x[5], 0, &p, &n);
-    xmul(&x[5], &x[3], 251, 50, 6, &p, &n);
-    xmul(&x[1], &x[7], 213, 142, 6, &p, &n);
-    y[0 * 8] = (x[0] + x[1]) >> ps;
-    y[1 * 8] = (x[4] + x[5]) >> ps;
-    y[2 * 8] = (x[2] + x[3]) >> ps;
-    y[3 * 8] = (x[6] + x[7]) >> ps;
-    y[4 * 8] = (x[6] - x[7]) >> ps;
-    y[5 * 8] = (x[2] - x[3]) >> ps;
-    y[6 * 8] = (x[4] - x[5]) >> ps;
-    y[7 * 8] = (x[0] - x[1]) >> ps;
+int extendBits(unsigned int value, unsigned int bits) {
+    // JPEG stores negative values as the one's complement of their magnitude
+    if (bits == 0) return 0;
+    if (value < (1u << (bits - 1))) return int(value) - int((1u << bits) - 1);
+    return int(value);
 }
 
-void FastIntegerIDCT(int *i8x8) {
-    int i, b2[64];
-    for (i = 0; i < 8; i++) idct1(i8x8 + i * 8, b2 + i, 9, 1 << 8);
-    for (i = 0; i < 8; i++) idct1(b2 + i * 8, i8x8 + i, 12, 1 << 11);
+bool buildJPEGHuffmanTree(QeHuffmanTree2 *tree, const unsigned char *counts, const unsigned char *values) {
+    memset(tree->lookupLength, 0, sizeof(tree->lookupLength));
+    tree->size = 0;
+
+    unsigned int code = 0;
+    for (unsigned int len = 1; len <= 16; ++len) {
+        unsigned int count = counts[len - 1];
+        if (tree->size + count > 256 || code + count > (1u << len)) return false;  // over-subscribed
+
+        tree->valueOffset[len] = int(tree->size) - int(code);
+        for (unsigned int i = 0; i < count; ++i, ++code, ++tree->size) {
+            tree->values[tree->size] = values[tree->size];
+            if (len > JPEG_HUFFMAN_FIRSTBITS) continue;
+
+            // fill every entry that starts with this code
+            unsigned int shift = JPEG_HUFFMAN_FIRSTBITS - len;
+            for (unsigned int j = 0; j < (1u << shift); ++j) {
+                tree->lookupLength[(code << shift) | j] = (unsigned char)len;
+                tree->lookupValue[(code << shift) | j] = values[tree->size];
+            }
+        }
+        tree->maxcode[len] = count ? int(code) - 1 : -1;
+        code <<= 1;
+    }
+
+    // For AC tables, a run/size symbol and its magnitude bits that fit in the lookup are decoded at once
+    memset(tree->lookupAC, 0, sizeof(tree->lookupAC));
+    for (code = 0; code < (1u << JPEG_HUFFMAN_FIRSTBITS); ++code) {
+        unsigned int len = tree->lookupLength[code];
+        unsigned int run = tree->lookupValue[code] >> 4;
+        unsigned int size = tree->lookupValue[code] & 0x0F;
+        if (len == 0 || size == 0 || len + size > JPEG_HUFFMAN_FIRSTBITS) continue;
+
+        unsigned int bits = (code >> (JPEG_HUFFMAN_FIRSTBITS - len - size)) & ((1u << size) - 1);
+        tree->lookupAC[code] = extendBits(bits, size) * 256 | int(run << 4) | int(len + size);
+    }
+    return true;
 }
 
-AeCommonEncode::AeCommonEncode() {}
-AeCommonEncode::~AeCommonEncode() {}
+unsigned int getHuffmanDecodeSymbol(AeBitStreamMSB &stream, const QeHuffmanTree2 *tree) {
+    unsigned int code = stream.peek(JPEG_HUFFMAN_FIRSTBITS);
+    unsigned int len = tree->lookupLength[code];
+    if (len != 0) {
+        stream.consume(len);
+        return tree->lookupValue[code];
+    }
+    for (len = JPEG_HUFFMAN_FIRSTBITS + 1; len <= 16; ++len) {
+        code = stream.peek(len);
+        if (int(code) <= tree->maxcode[len]) {
+            stream.consume(len);
+            return tree->values[code + tree->valueOffset[len]];
+        }
+    }
+    return 0;
+}
 
-int AeCommonEncode::readBits(const unsigned char *stream, size_t *bitPointer, size_t readCount, bool bLeft, bool bNegative) {
-    size_t bytes;
-    unsigned char bits;
-    size_t move;
-    int ret = 0;
-    size_t i;
-    for (i = 0; i < readCount; ++i) {
-        bytes = (*bitPointer) >> 3;
-        bits = (*bitPointer) % 8;
-        move = i;
-        if (bLeft) {
-            bits = 7 - bits;
-            move = readCount - move - 1;
+// Decodes one 8x8 block, adds the DC prediction and writes the dequantized coefficients in natural order. quant is in
+// zig-zag order, as stored in DQT. Returns the number of coefficients up to the last decoded one, 1 for a DC-only block.
+int decodeJPEGBlock(short int *out, AeBitStreamMSB &stream, const QeHuffmanTree2 *dc, const QeHuffmanTree2 *ac,
+                    const unsigned short int *quant, int &dcPred) {
+    memset(out, 0, 64 * sizeof(out[0]));
+    unsigned int size = getHuffmanDecodeSymbol(stream, dc);
+    if (size > 16) size = 0;  // corrupt
+    dcPred += extendBits(stream.read(size), size);
+    out[0] = short(dcPred * quant[0]);
+
+    int k = 1;
+    int last = 1;
+    while (k < 64) {
+        int fast = ac->lookupAC[stream.peek(JPEG_HUFFMAN_FIRSTBITS)];
+        if (fast != 0) {
+            k += (fast >> 4) & 0x0F;  // run of zeros
+            stream.consume(fast & 0x0F);
+            if (k > 63) break;
+            out[ZIGZAGTONATURAL[k]] = short((fast >> 8) * quant[k]);
+            last = ++k;
+            continue;
         }
-        ret += ((*(stream + bytes) >> bits & 1) << move);
-        (*bitPointer)++;
+
+        unsigned int value = getHuffmanDecodeSymbol(stream, ac);
+        if (value == 0) break;  // end of block
+        unsigned int run = value >> 4;
+        size = value & 0x0F;
+
+        k += run;
+        if (k > 63) break;
+        if (size > 0) {
+            out[ZIGZAGTONATURAL[k]] = short(extendBits(stream.read(size), size) * quant[k]);
+            last = k + 1;
+        }
+        ++k;  // 0xF0 skips 16 zeros
     }
+    return last;
+}
 
-    if (bNegative && readCount > 0) {
-        if (ret == 0) {
-            move = 1;
-            move <<= readCount;
-            ret = int(-1 * (move - 1));
-        } else {
-            i = 0;
-            bytes = readBits((unsigned char *)&ret, &i, readCount - 1);
-            bits = readBits((unsigned char *)&ret, &i, 1);
-
-            if (bits == 0) {
-                move = 1;
-                move <<= readCount;
-                ret = int(-1 * (move - bytes - 1));
+// Larger sizes in a header are treated as corrupt rather than allocated
+const int IMAGE_MAX_DIMENSION = 1 << 16;
+
+unsigned int getImageFormatBytes(AeImageFormat format) {
+    switch (format) {
+        case eImageFormat_RGBA8:
+        case eImageFormat_BGRA8:
+            return 4;
+        case eImageFormat_R8:
+            return 1;
+        case eImageFormat_RG8:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// Pixel layout the final decode stage reads. Grey is expanded to RGB and a missing alpha is 255; R8 and RG8
+// keep the first channels of that RGBA pixel.
+struct QeImageSource {
+    unsigned int channels = 0;  // 1 grey, 2 grey + alpha, 3 RGB, 4 RGBA
+    unsigned int bitDepth = 8;  // 1, 2, 4, 8 or 16
+    bool bBGR = false;          // blue first, BMP
+    const unsigned char *palette = nullptr;  // RGBA entries, indexed pixels when set
+};
+
+template <AeImageFormat F>
+inline void writeImagePixel(unsigned char *dst, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    if constexpr (F == eImageFormat_RGBA8) {
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+        dst[3] = a;
+    } else if constexpr (F == eImageFormat_BGRA8) {
+        dst[0] = b;
+        dst[1] = g;
+        dst[2] = r;
+        dst[3] = a;
+    } else if constexpr (F == eImageFormat_R8) {
+        dst[0] = r;
+    } else if constexpr (F == eImageFormat_RG8) {
+        dst[0] = r;
+        dst[1] = g;
+    }
+}
+
+void writeImagePixel(unsigned char *dst, AeImageFormat format, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+    switch (format) {
+        case eImageFormat_RGBA8:
+            writeImagePixel<eImageFormat_RGBA8>(dst, r, g, b, a);
+            break;
+        case eImageFormat_BGRA8:
+            writeImagePixel<eImageFormat_BGRA8>(dst, r, g, b, a);
+            break;
+        case eImageFormat_R8:
+            writeImagePixel<eImageFormat_R8>(dst, r, g, b, a);
+            break;
+        case eImageFormat_RG8:
+            writeImagePixel<eImageFormat_RG8>(dst, r, g, b, a);
+            break;
+        default:
+            break;
+    }
+}
+
+template <AeImageFormat F>
+void convertImageRow(unsigned char *dst, const unsigned char *src, size_t width, const QeImageSource &source) {
+    const size_t step = (F == eImageFormat_R8) ? 1 : (F == eImageFormat_RG8) ? 2 : 4;
+    size_t x = 0;
+
+    if (source.bitDepth == 8 && source.palette == nullptr) {
+        const int r = source.bBGR ? 2 : 0;
+        const int b = source.bBGR ? 0 : 2;
+        switch (source.channels) {
+            case 1:
+                for (x = 0; x < width; ++x, dst += step) writeImagePixel<F>(dst, src[x], src[x], src[x], 0xFF);
+                break;
+            case 2:
+                for (x = 0; x < width; ++x, src += 2, dst += step) writeImagePixel<F>(dst, src[0], src[0], src[0], src[1]);
+                break;
+            case 3:
+                for (x = 0; x < width; ++x, src += 3, dst += step) writeImagePixel<F>(dst, src[r], src[1], src[b], 0xFF);
+                break;
+            case 4:
+                for (x = 0; x < width; ++x, src += 4, dst += step) writeImagePixel<F>(dst, src[r], src[1], src[b], src[3]);
+                break;
+        }
+        return;
+    }
+
+    // palette, packed 1/2/4-bit and 16-bit samples
+    const unsigned int maxValue = (1u << source.bitDepth) - 1;
+    size_t sampleIndex = 0;
+    for (x = 0; x < width; ++x, dst += step) {
+        unsigned char c[4] = {0, 0, 0, 0xFF};
+        for (unsigned int k = 0; k < source.channels; ++k, ++sampleIndex) {
+            unsigned int value = 0;
+            if (source.bitDepth == 16)
+                value = src[sampleIndex * 2];  // big-endian, keep the high byte
+            else if (source.bitDepth == 8)
+                value = src[sampleIndex];
+            else {
+                size_t bit = sampleIndex * source.bitDepth;
+                value = (src[bit >> 3] >> (8 - source.bitDepth - (bit & 7))) & maxValue;
+                if (source.palette == nullptr) value = value * 255 / maxValue;
             }
+            c[k] = (unsigned char)value;
         }
+        if (source.palette != nullptr) {
+            const unsigned char *entry = source.palette + c[0] * 4;
+            writeImagePixel<F>(dst, entry[0], entry[1], entry[2], entry[3]);
+        } else if (source.channels <= 2)
+            writeImagePixel<F>(dst, c[0], c[0], c[0], source.channels == 2 ? c[1] : 0xFF);
+        else
+            writeImagePixel<F>(dst, c[0], c[1], c[2], c[3]);
+    }
+}
+
+void convertImageRow(unsigned char *dst, const unsigned char *src, size_t width, const QeImageSource &source, AeImageFormat format) {
+    switch (format) {
+        case eImageFormat_RGBA8:
+            convertImageRow<eImageFormat_RGBA8>(dst, src, width, source);
+            break;
+        case eImageFormat_BGRA8:
+            convertImageRow<eImageFormat_BGRA8>(dst, src, width, source);
+            break;
+        case eImageFormat_R8:
+            convertImageRow<eImageFormat_R8>(dst, src, width, source);
+            break;
+        case eImageFormat_RG8:
+            convertImageRow<eImageFormat_RG8>(dst, src, width, source);
+            break;
+        default:
+            break;
     }
-    return ret;
 }
 
+AeCommonEncode::AeCommonEncode() {}
+AeCommonEncode::~AeCommonEncode() {}
+
 std::string AeCommonEncode::trim(std::string s) {
     if (!s.length()) return s;
     s.erase(0, s.find_first_not_of(" \t\n\r\f\v"));
@@ -439,18 +943,14 @@ AeJSONNode *AeCommonEncode::decodeJSON(const char *buffer, int &index) {
                 currentKey = 5;
                 std::vector<std::string> vs;
 
-                std::string s(buffer + lastIndex, currentIndex - lastIndex);
-                char s2[512];
-                strncpy_s(s2, s.c_str(), 512);
-                char *context = NULL;
                 const char *key1 = ",\"\r\n";
-                char *pch = strtok_s(s2, key1, &context);
-
-                while (pch != NULL) {
-                    std::string s(pch);
+                for (int i = lastIndex; i < currentIndex;) {
+                    int length = int(strcspn(buffer + i, key1));
+                    length = std::min(length, currentIndex - i);
+                    std::string s(buffer + i, length);
                     s = trim(s);
                     if (s.length() > 0) vs.push_back(s);
-                    pch = strtok_s(NULL, key1, &context);
+                    i += length + 1;
                 }
                 node->data->eKeysforArrayValues.push_back(key);
                 node->data->eArrayValues.push_back(vs);
@@ -488,6 +988,7 @@ AeXMLNode *AeCommonEncode::decodeXML(const char *buffer, int &index, AeXMLNode *
             case '<': {
                 if (buffer[currentIndex + 1] == '/') {
                     index = int(strchr(buffer + currentIndex, '>') - buffer);
+                    if (parent == nullptr) node->buildXMLTreeIndex();
                     return node;
                 } else if (node->data->key.length()) {
                     node->data->nexts.push_back(decodeXML(buffer, currentIndex, node));
@@ -541,6 +1042,7 @@ AeXMLNode *AeCommonEncode::decodeXML(const char *buffer, int &index, AeXMLNode *
             } break;
             case '/': {
                 index = int(strchr(buffer + currentIndex, '>') - buffer);
+                if (parent == nullptr) node->buildXMLTreeIndex();
                 return node;
             } break;
             case '=': {
@@ -562,284 +1064,1408 @@ AeXMLNode *AeCommonEncode::decodeXML(const char *buffer, int &index, AeXMLNode *
     return nullptr;
 }
 
-std::vector<unsigned char> AeCommonEncode::decodeJPEG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes) {
-    std::vector<unsigned char> ret;
-    // YCbCr(YUV), DCT(Discrete Cosine Transform), Quantization, Zig-zag(Entropy
-    // Coding), RLC(Run Length Coding), Canonical Huffman Code
+void unfilterScanline(unsigned char *recon, const unsigned char *scanline, const unsigned char *prevline, size_t linebytes,
+                      size_t bytewidth, unsigned char filterType) {
+    size_t j = 0;
+    switch (filterType) {
+        case 0:  // none
+            for (j = 0; j != linebytes; ++j) recon[j] = scanline[j];
+            break;
+        case 1:  // sub left X-A
+            for (j = 0; j != bytewidth; ++j) recon[j] = scanline[j];
+            for (j = bytewidth; j < linebytes; ++j) recon[j] = scanline[j] + recon[j - bytewidth];
+            break;
+        case 2:  // sub up X-B
+            if (prevline)
+                for (j = 0; j != linebytes; ++j) recon[j] = scanline[j] + prevline[j];
+            else
+                for (j = 0; j != linebytes; ++j) recon[j] = scanline[j];
+            break;
+        case 3:  // average X-(A+B)/2
+            if (prevline) {
+                for (j = 0; j != bytewidth; ++j) recon[j] = scanline[j] + (prevline[j] >> 1);
+                for (j = bytewidth; j < linebytes; ++j) recon[j] = scanline[j] + ((recon[j - bytewidth] + prevline[j]) >> 1);
+            } else {
+                for (j = 0; j != bytewidth; ++j) recon[j] = scanline[j];
+                for (j = bytewidth; j < linebytes; ++j) recon[j] = scanline[j] + (recon[j - bytewidth] >> 1);
+            }
+            break;
+        case 4:  // peath
+            if (prevline) {
+                for (j = 0; j != bytewidth; ++j) recon[j] = (scanline[j] + prevline[j]);
+                for (j = bytewidth; j < linebytes; ++j) {
+                    unsigned char paethPredictor = 0;
+                    short int a = recon[j - bytewidth];
+                    short int b = prevline[j];
+                    short int c = prevline[j - bytewidth];
+                    short int pa = abs(b - c);
+                    short int pb = abs(a - c);
+                    short int pc = abs(a + b - c - c);
+
+                    if (pc < pa && pc < pb)
+                        paethPredictor = (unsigned char)c;
+                    else if (pb < pa)
+                        paethPredictor = (unsigned char)b;
+                    else
+                        paethPredictor = (unsigned char)a;
+
+                    recon[j] = (scanline[j] + paethPredictor);
+                }
+            } else {
+                for (j = 0; j != bytewidth; ++j) recon[j] = scanline[j];
+                for (j = bytewidth; j < linebytes; ++j) recon[j] = (scanline[j] + recon[j - bytewidth]);
+            }
+            break;
+    }
+}
 
-    unsigned char startKey[2] = {0xFF, 0xD8};    // SOI  Start of Image
-    unsigned char APP0[2] = {0xFF, 0xE0};        // APP0 Application
-    unsigned char quanKey[2] = {0xFF, 0xDB};     // DQT  Define Quantization Table
-    unsigned char frameKey[2] = {0xFF, 0xC0};    // SOF0 Start of Frame
-    unsigned char huffmanKey[2] = {0xFF, 0xC4};  // DHT  Difine Huffman Table
-    unsigned char scanKey[2] = {0xFF, 0xDA};     // SOS  Start of Scan
-    unsigned char endKey[2] = {0xFF, 0xD9};      // EOI  End of Image
+#ifdef AE_SSE2
+// Pixels of 3 or 4 bytes live in the low lanes of a register; N is the pixel size. 3-byte pixels are assembled
+// with shifts, a 3-byte memcpy through the stack stalls store forwarding.
+template <size_t N>
+inline __m128i loadPixel(const unsigned char *p) {
+    int value = 0;
+    if constexpr (N == 3)
+        value = p[0] | (p[1] << 8) | (p[2] << 16);
+    else
+        memcpy(&value, p, N);
+    return _mm_cvtsi32_si128(value);
+}
 
-    if (memcmp(buffer, startKey, 2) != 0) return ret;
+template <size_t N>
+inline void storePixel(unsigned char *p, __m128i v) {
+    int value = _mm_cvtsi128_si32(v);
+    if constexpr (N == 3) {
+        p[0] = (unsigned char)value;
+        p[1] = (unsigned char)(value >> 8);
+        p[2] = (unsigned char)(value >> 16);
+    } else
+        memcpy(p, &value, N);
+}
 
-    unsigned short int length = 0;
-    char *key;
-    unsigned char *data = nullptr;
-    size_t index = 2;
-    unsigned char buf[2];
-    std::vector<unsigned char> dataHuffman;
-    QeHuffmanTree2 DC[2];  // DC00, DC01
-    QeHuffmanTree2 AC[2];  // AC10, AC11
-    unsigned char colorNum;
-    unsigned char *mcusType = nullptr;
-    unsigned char *mcusQuan = nullptr;
-    unsigned char *mcusSize = nullptr;
-    unsigned char *huffmanTreeIndex = nullptr;
-    unsigned int mcuWidth = 0;
-    unsigned int mcuHeight = 0;
-    unsigned int totalmcuSize = 0;
-    unsigned char *quanData[4] = {nullptr, nullptr, nullptr, nullptr};
+inline __m128i absEpi16(__m128i x) {
+#ifdef AE_SSE41
+    return _mm_abs_epi16(x);
+#else
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+#endif
+}
 
-    size_t i = 0, j = 0;
-    while (1) {
-        key = (char *)(buffer + index);
-        // if (memcmp(key, endKey, 2) == 0)	break;
+inline __m128i selectEpi16(__m128i mask, __m128i a, __m128i b) {
+#ifdef AE_SSE41
+    return _mm_blendv_epi8(b, a, mask);
+#else
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+#endif
+}
 
-        buf[0] = *(buffer + index + 3);
-        buf[1] = *(buffer + index + 2);
-        length = *(unsigned short int *)(buf)-2;
-        data = (buffer + index + 4);
+template <size_t N>
+void unfilterSubSIMD(unsigned char *recon, const unsigned char *scanline, size_t linebytes) {
+    __m128i a = _mm_setzero_si128();
+    for (size_t j = 0; j < linebytes; j += N) {
+        a = _mm_add_epi8(a, loadPixel<N>(scanline + j));
+        storePixel<N>(recon + j, a);
+    }
+}
 
-        // else if (memcmp(key, APP0, 2) == 0) {}
-        if (memcmp(key, quanKey, 2) == 0)
-            quanData[data[0] % 16] = data + 1;
-        else if (memcmp(key, frameKey, 2) == 0) {
-            unsigned char colorBits = data[0];
-            buf[1] = data[1];
-            buf[0] = data[2];
-            *width = *(short int *)&buf;
-            buf[1] = data[3];
-            buf[0] = data[4];
-            *height = *(short int *)&buf;
-            colorNum = data[5];
+void unfilterUpSIMD(unsigned char *recon, const unsigned char *scanline, const unsigned char *prevline, size_t linebytes) {
+    size_t j = 0;
+    for (; j + 16 <= linebytes; j += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(scanline + j));
+        __m128i b = _mm_loadu_si128((const __m128i *)(prevline + j));
+        _mm_storeu_si128((__m128i *)(recon + j), _mm_add_epi8(x, b));
+    }
+    for (; j < linebytes; ++j) recon[j] = scanline[j] + prevline[j];
+}
+
+template <size_t N>
+void unfilterAverageSIMD(unsigned char *recon, const unsigned char *scanline, const unsigned char *prevline, size_t linebytes) {
+    // _mm_avg_epu8 rounds up, subtracting the low bit of a ^ b makes it round down like (a + b) >> 1
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for (size_t j = 0; j < linebytes; j += N) {
+        __m128i b = loadPixel<N>(prevline + j);
+        __m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(loadPixel<N>(scanline + j), average);
+        storePixel<N>(recon + j, a);
+    }
+}
 
-            char bits = 0;
-            if (colorNum == 1)
-                bits = colorBits;
+template <size_t N>
+void unfilterPaethSIMD(unsigned char *recon, const unsigned char *scanline, const unsigned char *prevline, size_t linebytes) {
+    // a, b and c are widened to 16 bits so that pa = |b - c|, pb = |a - c| and pc = |a + b - 2c| don't overflow
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero, c = zero;
+    for (size_t j = 0; j < linebytes; j += N) {
+        __m128i b = _mm_unpacklo_epi8(loadPixel<N>(prevline + j), zero);
+        __m128i x = _mm_unpacklo_epi8(loadPixel<N>(scanline + j), zero);
+
+        __m128i pa = _mm_sub_epi16(b, c);
+        __m128i pb = _mm_sub_epi16(a, c);
+        __m128i pc = absEpi16(_mm_add_epi16(pa, pb));
+        pa = absEpi16(pa);
+        pb = absEpi16(pb);
+
+        // ties prefer a, then b, then c
+        __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+        __m128i predictor = selectEpi16(_mm_cmpeq_epi16(smallest, pa), a, selectEpi16(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+        a = _mm_and_si128(_mm_add_epi16(x, predictor), _mm_set1_epi16(0xFF));
+        storePixel<N>(recon + j, _mm_packus_epi16(a, a));
+        c = b;
+    }
+}
+
+template <size_t N>
+void unfilterScanlineSIMD(unsigned char *recon, const unsigned char *scanline, const unsigned char *prevline, size_t linebytes,
+                          unsigned char filterType) {
+    switch (filterType) {
+        case 0:  // none
+            memcpy(recon, scanline, linebytes);
+            break;
+        case 1:  // sub left X-A
+            unfilterSubSIMD<N>(recon, scanline, linebytes);
+            break;
+        case 2:  // sub up X-B
+            if (prevline)
+                unfilterUpSIMD(recon, scanline, prevline, linebytes);
+            else
+                memcpy(recon, scanline, linebytes);
+            break;
+        case 3:  // average X-(A+B)/2
+            if (prevline)
+                unfilterAverageSIMD<N>(recon, scanline, prevline, linebytes);
+            else
+                unfilterScanline(recon, scanline, prevline, linebytes, N, filterType);
+            break;
+        case 4:  // peath, without a previous line the predictor is always a
+            if (prevline)
+                unfilterPaethSIMD<N>(recon, scanline, prevline, linebytes);
             else
-                bits = colorBits * 3;
-            *bytes = (bits + 7) / 8;
+                unfilterSubSIMD<N>(recon, scanline, linebytes);
+            break;
+    }
+}
+#endif
+
+void AeCommonEncode::unfilterPNGScanline(unsigned char *recon, const unsigned char *scanline, const unsigned char *prevline,
+                                         size_t linebytes, size_t bytewidth, unsigned char filterType, bool bSIMD) {
+#ifdef AE_SSE2
+    if (bSIMD && linebytes % bytewidth == 0) {
+        if (bytewidth == 3) {
+            unfilterScanlineSIMD<3>(recon, scanline, prevline, linebytes, filterType);
+            return;
+        }
+        if (bytewidth == 4) {
+            unfilterScanlineSIMD<4>(recon, scanline, prevline, linebytes, filterType);
+            return;
+        }
+        if (filterType == 2 && prevline) {
+            unfilterUpSIMD(recon, scanline, prevline, linebytes);
+            return;
+        }
+    }
+#endif
+    unfilterScanline(recon, scanline, prevline, linebytes, bytewidth, filterType);
+}
 
-            mcusType = new unsigned char[colorNum];
-            mcusQuan = new unsigned char[colorNum];
-            mcusSize = new unsigned char[colorNum];
-            int maxSize = 0;
-            for (i = 0; i < colorNum; ++i) {
-                j = 0;
-                mcusType[i] = data[6 + i * 3];
-                int x = readBits(&data[7 + i * 3], &j, 4);
-                int y = readBits(&data[7 + i * 3], &j, 4);
-                mcusSize[i] = x * y;
-                if (mcusSize[i] > maxSize) {
-                    maxSize = mcusSize[i];
-                    mcuWidth = ((*width) + 7) / 8 / x;
-                    mcuHeight = ((*height) + 7) / 8 / y;
-                }
-                mcusQuan[i] = data[8 + i * 3];
+// JPEG IDCT in fixed point with 12 fractional bits (the IJG "islow" transform). Columns are descaled to 2 extra bits
+// and rows add the +128 level shift, so the row pass ends on plain sample values.
+const int IDCT_0_298631336 = 1223;
+const int IDCT_0_390180644 = 1598;
+const int IDCT_0_541196100 = 2217;
+const int IDCT_0_765366865 = 3135;
+const int IDCT_0_899976223 = 3686;
+const int IDCT_1_175875602 = 4816;
+const int IDCT_1_501321110 = 6149;
+const int IDCT_1_847759065 = 7568;
+const int IDCT_1_961570560 = 8035;
+const int IDCT_2_053119869 = 8410;
+const int IDCT_2_562915447 = 10498;
+const int IDCT_3_072711026 = 12586;
+const int IDCT_COLUMN_BIAS = 1 << 9;
+const int IDCT_ROW_BIAS = (1 << 16) + (128 << 17);
+
+// YCbCr to RGB factors with 12 fractional bits
+const int YCBCR_CR_R = 5743;   // 1.402
+const int YCBCR_CR_G = -2925;  // -0.71414
+const int YCBCR_CB_G = -1410;  // -0.34414
+const int YCBCR_CB_B = 7258;   // 1.772
+
+inline unsigned char clampByte(int v) { return (unsigned int)v > 255 ? (v < 0 ? 0 : 255) : (unsigned char)v; }
+
+// One 8-point pass: out[i] = even[i] + odd[i] and out[7 - i] = even[i] - odd[i], scaled by 4096.
+inline void idctJPEG1D(const int *s, int *even, int *odd) {
+    int p1 = (s[2] + s[6]) * IDCT_0_541196100;
+    int t2 = p1 - s[6] * IDCT_1_847759065;
+    int t3 = p1 + s[2] * IDCT_0_765366865;
+    int t0 = (s[0] + s[4]) * 4096;
+    int t1 = (s[0] - s[4]) * 4096;
+    even[0] = t0 + t3;
+    even[1] = t1 + t2;
+    even[2] = t1 - t2;
+    even[3] = t0 - t3;
+
+    int p3 = s[7] + s[3];
+    int p4 = s[5] + s[1];
+    int p5 = (p3 + p4) * IDCT_1_175875602;
+    p1 = p5 - (s[7] + s[1]) * IDCT_0_899976223;
+    int p2 = p5 - (s[5] + s[3]) * IDCT_2_562915447;
+    p3 *= -IDCT_1_961570560;
+    p4 *= -IDCT_0_390180644;
+    odd[0] = s[1] * IDCT_1_501321110 + p1 + p4;
+    odd[1] = s[3] * IDCT_3_072711026 + p2 + p3;
+    odd[2] = s[5] * IDCT_2_053119869 + p2 + p4;
+    odd[3] = s[7] * IDCT_0_298631336 + p1 + p3;
+}
+
+// Dequantized coefficients in natural order to 8x8 samples, rows stride bytes apart.
+void idctJPEGBlock(unsigned char *out, size_t stride, const short int *in) {
+    int tmp[64], s[8], even[4], odd[4];
+    for (int x = 0; x < 8; ++x) {
+        for (int i = 0; i < 8; ++i) s[i] = in[i * 8 + x];
+        idctJPEG1D(s, even, odd);
+        for (int i = 0; i < 4; ++i) {
+            tmp[i * 8 + x] = (even[i] + IDCT_COLUMN_BIAS + odd[i]) >> 10;
+            tmp[(7 - i) * 8 + x] = (even[i] + IDCT_COLUMN_BIAS - odd[i]) >> 10;
+        }
+    }
+    for (int y = 0; y < 8; ++y, out += stride) {
+        idctJPEG1D(tmp + y * 8, even, odd);
+        for (int i = 0; i < 4; ++i) {
+            out[i] = clampByte((even[i] + IDCT_ROW_BIAS + odd[i]) >> 17);
+            out[7 - i] = clampByte((even[i] + IDCT_ROW_BIAS - odd[i]) >> 17);
+        }
+    }
+}
+
+// Reduced IDCTs for scaled decoding give the average of every 2x2 (N = 4) or 4x4 (N = 2) pixel group of the
+// full IDCT. Averaging folds every frequency onto the N lowest ones, so the factors below fold and transform in
+// one step. Factors with 12 fractional bits.
+const int IDCT_REDUCED_ROW_BIAS = (1 << 13) + (128 << 14);
+
+// out[i] = even[i] + odd[i] and out[N - 1 - i] = even[i] - odd[i]
+template <int N>
+inline void idctJPEGReduced1D(const int *s, int *even, int *odd) {
+    if constexpr (N == 4) {
+        even[0] = s[0] * 1448 + s[2] * 1338 - s[6] * 554;
+        even[1] = s[0] * 1448 - s[2] * 1338 + s[6] * 554;
+        odd[0] = s[1] * 1856 + s[3] * 652 - s[5] * 435 - s[7] * 369;
+        odd[1] = s[1] * 769 - s[3] * 1573 + s[5] * 1051 - s[7] * 153;
+    } else {
+        even[0] = s[0] * 1448;
+        odd[0] = s[1] * 1312 - s[3] * 461 + s[5] * 308 - s[7] * 261;
+    }
+}
+
+template <int N>
+void idctJPEGBlockReduced(unsigned char *out, size_t stride, const short int *in) {
+    int tmp[N * 8], s[8], even[2], odd[2];
+    for (int x = 0; x < 8; ++x) {
+        for (int i = 0; i < 8; ++i) s[i] = in[i * 8 + x];
+        idctJPEGReduced1D<N>(s, even, odd);
+        for (int i = 0; i < N / 2; ++i) {
+            tmp[i * 8 + x] = (even[i] + IDCT_COLUMN_BIAS + odd[i]) >> 10;
+            tmp[(N - 1 - i) * 8 + x] = (even[i] + IDCT_COLUMN_BIAS - odd[i]) >> 10;
+        }
+    }
+    for (int y = 0; y < N; ++y, out += stride) {
+        idctJPEGReduced1D<N>(tmp + y * 8, even, odd);
+        for (int i = 0; i < N / 2; ++i) {
+            out[i] = clampByte((even[i] + IDCT_REDUCED_ROW_BIAS + odd[i]) >> 14);
+            out[N - 1 - i] = clampByte((even[i] + IDCT_REDUCED_ROW_BIAS - odd[i]) >> 14);
+        }
+    }
+}
+
+#ifdef AE_SSE2
+// Eight 32-bit lanes
+struct QeIDCTWide {
+    __m128i lo, hi;
+};
+
+// x * c[even] + y * c[odd] for every 16-bit lane pair
+inline QeIDCTWide idctRotate(__m128i x, __m128i y, int c0, int c1) {
+    __m128i c = _mm_setr_epi16(short(c0), short(c1), short(c0), short(c1), short(c0), short(c1), short(c0), short(c1));
+    return {_mm_madd_epi16(_mm_unpacklo_epi16(x, y), c), _mm_madd_epi16(_mm_unpackhi_epi16(x, y), c)};
+}
+
+inline QeIDCTWide idctWiden(__m128i x) {  // x * 4096
+    return {_mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), x), 4),
+            _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), x), 4)};
+}
+
+inline QeIDCTWide idctAdd(const QeIDCTWide &a, const QeIDCTWide &b) {
+    return {_mm_add_epi32(a.lo, b.lo), _mm_add_epi32(a.hi, b.hi)};
+}
+
+inline QeIDCTWide idctSub(const QeIDCTWide &a, const QeIDCTWide &b) {
+    return {_mm_sub_epi32(a.lo, b.lo), _mm_sub_epi32(a.hi, b.hi)};
+}
+
+template <int S>
+inline void idctButterfly(__m128i &out0, __m128i &out1, const QeIDCTWide &a, const QeIDCTWide &b, __m128i bias) {
+    QeIDCTWide biased = {_mm_add_epi32(a.lo, bias), _mm_add_epi32(a.hi, bias)};
+    QeIDCTWide sum = idctAdd(biased, b);
+    QeIDCTWide dif = idctSub(biased, b);
+    out0 = _mm_packs_epi32(_mm_srai_epi32(sum.lo, S), _mm_srai_epi32(sum.hi, S));
+    out1 = _mm_packs_epi32(_mm_srai_epi32(dif.lo, S), _mm_srai_epi32(dif.hi, S));
+}
+
+// The 1-D transform on all eight lanes at once, see idctJPEG1D.
+template <int S>
+inline void idctPassSIMD(__m128i *row, __m128i bias) {
+    QeIDCTWide t2 = idctRotate(row[2], row[6], IDCT_0_541196100, IDCT_0_541196100 - IDCT_1_847759065);
+    QeIDCTWide t3 = idctRotate(row[2], row[6], IDCT_0_541196100 + IDCT_0_765366865, IDCT_0_541196100);
+    QeIDCTWide t0 = idctWiden(_mm_add_epi16(row[0], row[4]));
+    QeIDCTWide t1 = idctWiden(_mm_sub_epi16(row[0], row[4]));
+    QeIDCTWide x0 = idctAdd(t0, t3), x3 = idctSub(t0, t3);
+    QeIDCTWide x1 = idctAdd(t1, t2), x2 = idctSub(t1, t2);
+
+    QeIDCTWide y0 = idctRotate(row[7], row[3], IDCT_0_298631336 - IDCT_1_961570560, -IDCT_1_961570560);
+    QeIDCTWide y2 = idctRotate(row[7], row[3], -IDCT_1_961570560, IDCT_3_072711026 - IDCT_1_961570560);
+    QeIDCTWide y1 = idctRotate(row[5], row[1], IDCT_2_053119869 - IDCT_0_390180644, -IDCT_0_390180644);
+    QeIDCTWide y3 = idctRotate(row[5], row[1], -IDCT_0_390180644, IDCT_1_501321110 - IDCT_0_390180644);
+    __m128i sum17 = _mm_add_epi16(row[1], row[7]);
+    __m128i sum35 = _mm_add_epi16(row[3], row[5]);
+    QeIDCTWide y4 = idctRotate(sum17, sum35, IDCT_1_175875602 - IDCT_0_899976223, IDCT_1_175875602);
+    QeIDCTWide y5 = idctRotate(sum17, sum35, IDCT_1_175875602, IDCT_1_175875602 - IDCT_2_562915447);
+
+    idctButterfly<S>(row[0], row[7], x0, idctAdd(y3, y4), bias);
+    idctButterfly<S>(row[1], row[6], x1, idctAdd(y2, y5), bias);
+    idctButterfly<S>(row[2], row[5], x2, idctAdd(y1, y5), bias);
+    idctButterfly<S>(row[3], row[4], x3, idctAdd(y0, y4), bias);
+}
+
+// a, b = the low and the high halves of their interleave
+inline void interleaveEpi16(__m128i &a, __m128i &b) {
+    __m128i t = a;
+    a = _mm_unpacklo_epi16(a, b);
+    b = _mm_unpackhi_epi16(t, b);
+}
+
+inline void interleaveEpi8(__m128i &a, __m128i &b) {
+    __m128i t = a;
+    a = _mm_unpacklo_epi8(a, b);
+    b = _mm_unpackhi_epi8(t, b);
+}
+
+void idctJPEGBlockSIMD(unsigned char *out, size_t stride, const short int *in) {
+    __m128i row[8];
+    for (int i = 0; i < 8; ++i) row[i] = _mm_loadu_si128((const __m128i *)(in + i * 8));
+
+    idctPassSIMD<10>(row, _mm_set1_epi32(IDCT_COLUMN_BIAS));
+
+    // transpose so the row pass works on lanes as well
+    interleaveEpi16(row[0], row[4]);
+    interleaveEpi16(row[1], row[5]);
+    interleaveEpi16(row[2], row[6]);
+    interleaveEpi16(row[3], row[7]);
+    interleaveEpi16(row[0], row[2]);
+    interleaveEpi16(row[1], row[3]);
+    interleaveEpi16(row[4], row[6]);
+    interleaveEpi16(row[5], row[7]);
+    interleaveEpi16(row[0], row[1]);
+    interleaveEpi16(row[2], row[3]);
+    interleaveEpi16(row[4], row[5]);
+    interleaveEpi16(row[6], row[7]);
+
+    idctPassSIMD<17>(row, _mm_set1_epi32(IDCT_ROW_BIAS));
+
+    // pack to bytes and transpose back
+    __m128i p0 = _mm_packus_epi16(row[0], row[1]);
+    __m128i p1 = _mm_packus_epi16(row[2], row[3]);
+    __m128i p2 = _mm_packus_epi16(row[4], row[5]);
+    __m128i p3 = _mm_packus_epi16(row[6], row[7]);
+    interleaveEpi8(p0, p2);
+    interleaveEpi8(p1, p3);
+    interleaveEpi8(p0, p1);
+    interleaveEpi8(p2, p3);
+    interleaveEpi8(p0, p2);
+    interleaveEpi8(p1, p3);
+
+    _mm_storel_epi64((__m128i *)out, p0);
+    _mm_storel_epi64((__m128i *)(out + stride), _mm_shuffle_epi32(p0, 0x4E));
+    _mm_storel_epi64((__m128i *)(out + stride * 2), p2);
+    _mm_storel_epi64((__m128i *)(out + stride * 3), _mm_shuffle_epi32(p2, 0x4E));
+    _mm_storel_epi64((__m128i *)(out + stride * 4), p1);
+    _mm_storel_epi64((__m128i *)(out + stride * 5), _mm_shuffle_epi32(p1, 0x4E));
+    _mm_storel_epi64((__m128i *)(out + stride * 6), p3);
+    _mm_storel_epi64((__m128i *)(out + stride * 7), _mm_shuffle_epi32(p3, 0x4E));
+}
+
+// Sum of the four 32-bit lanes of a, b, c and d, in that order
+inline __m128i sumLanes(__m128i a, __m128i b, __m128i c, __m128i d) {
+    __m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+    __m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+    return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+}
+
+// idctJPEGBlockReduced with SSE2. The vertical pass runs on all eight columns at once; the horizontal pass
+// is a dot product of every row with the factors of each output pixel.
+template <int N>
+void idctJPEGBlockReducedSIMD(unsigned char *out, size_t stride, const short int *in) {
+    __m128i row[8];
+    for (int i = 0; i < 8; ++i) row[i] = _mm_loadu_si128((const __m128i *)(in + i * 8));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i columnBias = _mm_set1_epi32(IDCT_COLUMN_BIAS);
+    const __m128i rowBias = _mm_set1_epi32(IDCT_REDUCED_ROW_BIAS);
+
+    __m128i columns[N];
+    if constexpr (N == 4) {
+        QeIDCTWide even0 = idctAdd(idctRotate(row[0], row[2], 1448, 1338), idctRotate(row[6], zero, -554, 0));
+        QeIDCTWide even1 = idctAdd(idctRotate(row[0], row[2], 1448, -1338), idctRotate(row[6], zero, 554, 0));
+        QeIDCTWide odd0 = idctAdd(idctRotate(row[1], row[3], 1856, 652), idctRotate(row[5], row[7], -435, -369));
+        QeIDCTWide odd1 = idctAdd(idctRotate(row[1], row[3], 769, -1573), idctRotate(row[5], row[7], 1051, -153));
+        idctButterfly<10>(columns[0], columns[3], even0, odd0, columnBias);
+        idctButterfly<10>(columns[1], columns[2], even1, odd1, columnBias);
+
+        const __m128i factor0 = _mm_setr_epi16(1448, 1856, 1338, 652, 0, -435, -554, -369);
+        const __m128i factor1 = _mm_setr_epi16(1448, 769, -1338, -1573, 0, 1051, 554, -153);
+        const __m128i factor2 = _mm_setr_epi16(1448, -769, -1338, 1573, 0, -1051, 554, 153);
+        const __m128i factor3 = _mm_setr_epi16(1448, -1856, 1338, -652, 0, 435, -554, 369);
+        __m128i pixels[4];
+        for (int y = 0; y < 4; ++y) {
+            __m128i sum = sumLanes(_mm_madd_epi16(columns[y], factor0), _mm_madd_epi16(columns[y], factor1),
+                                   _mm_madd_epi16(columns[y], factor2), _mm_madd_epi16(columns[y], factor3));
+            pixels[y] = _mm_srai_epi32(_mm_add_epi32(sum, rowBias), 14);
+        }
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(pixels[0], pixels[1]), _mm_packs_epi32(pixels[2], pixels[3]));
+        for (int y = 0; y < 4; ++y, out += stride) {
+            int value = _mm_cvtsi128_si32(packed);
+            memcpy(out, &value, 4);
+            packed = _mm_srli_si128(packed, 4);
+        }
+    } else {
+        QeIDCTWide even0 = idctRotate(row[0], zero, 1448, 0);
+        QeIDCTWide odd0 = idctAdd(idctRotate(row[1], row[3], 1312, -461), idctRotate(row[5], row[7], 308, -261));
+        idctButterfly<10>(columns[0], columns[1], even0, odd0, columnBias);
+
+        const __m128i factor0 = _mm_setr_epi16(1448, 1312, 0, -461, 0, 308, 0, -261);
+        const __m128i factor1 = _mm_setr_epi16(1448, -1312, 0, 461, 0, -308, 0, 261);
+        __m128i sum = sumLanes(_mm_madd_epi16(columns[0], factor0), _mm_madd_epi16(columns[0], factor1),
+                               _mm_madd_epi16(columns[1], factor0), _mm_madd_epi16(columns[1], factor1));
+        __m128i pixels = _mm_srai_epi32(_mm_add_epi32(sum, rowBias), 14);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(pixels, zero), zero);
+        int value = _mm_cvtsi128_si32(packed);
+        out[0] = (unsigned char)value;
+        out[1] = (unsigned char)(value >> 8);
+        out[stride] = (unsigned char)(value >> 16);
+        out[stride + 1] = (unsigned char)(value >> 24);
+    }
+}
+
+// Eight pixels of YCbCr to RGBA, or BGRA when bBGR. Same arithmetic as ycbcrToRGB.
+inline void convertYCbCrSIMD(unsigned char *dst, const unsigned char *y, const unsigned char *cb, const unsigned char *cr,
+                             bool bBGR) {
+    const __m128i signflip = _mm_set1_epi8(-0x80);
+    __m128i yw = _mm_unpacklo_epi8(_mm_set1_epi8(char(0x80)), _mm_loadl_epi64((const __m128i *)y));  // y << 8 | 128
+    __m128i cbw = _mm_unpacklo_epi8(_mm_setzero_si128(), _mm_xor_si128(_mm_loadl_epi64((const __m128i *)cb), signflip));
+    __m128i crw = _mm_unpacklo_epi8(_mm_setzero_si128(), _mm_xor_si128(_mm_loadl_epi64((const __m128i *)cr), signflip));
+
+    __m128i ys = _mm_srli_epi16(yw, 4);
+    __m128i r = _mm_add_epi16(ys, _mm_mulhi_epi16(crw, _mm_set1_epi16(YCBCR_CR_R)));
+    __m128i g = _mm_add_epi16(_mm_add_epi16(ys, _mm_mulhi_epi16(cbw, _mm_set1_epi16(YCBCR_CB_G))),
+                              _mm_mulhi_epi16(crw, _mm_set1_epi16(YCBCR_CR_G)));
+    __m128i b = _mm_add_epi16(ys, _mm_mulhi_epi16(cbw, _mm_set1_epi16(YCBCR_CB_B)));
+    r = _mm_srai_epi16(r, 4);
+    g = _mm_srai_epi16(g, 4);
+    b = _mm_srai_epi16(b, 4);
+
+    __m128i rb = bBGR ? _mm_packus_epi16(b, r) : _mm_packus_epi16(r, b);
+    __m128i ga = _mm_packus_epi16(g, _mm_set1_epi16(0xFF));
+    __m128i t0 = _mm_unpacklo_epi8(rb, ga);
+    __m128i t1 = _mm_unpackhi_epi8(rb, ga);
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(t0, t1));
+    _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(t0, t1));
+}
+#endif
+
+// Fixed point with 4 fractional bits, so the SIMD path can do it in 16-bit lanes and gets the same result.
+inline void ycbcrToRGB(int y, int cb, int cr, unsigned char &r, unsigned char &g, unsigned char &b) {
+    int ys = (y << 4) + 8;
+    cb = (cb - 128) * 256;
+    cr = (cr - 128) * 256;
+    r = clampByte((ys + ((cr * YCBCR_CR_R) >> 16)) >> 4);
+    g = clampByte((ys + ((cb * YCBCR_CB_G) >> 16) + ((cr * YCBCR_CR_G) >> 16)) >> 4);
+    b = clampByte((ys + ((cb * YCBCR_CB_B) >> 16)) >> 4);
+}
+
+template <AeImageFormat F>
+void convertYCbCrRow(unsigned char *dst, const unsigned char *y, const unsigned char *cb, const unsigned char *cr, size_t width) {
+    const size_t step = (F == eImageFormat_native) ? 3 : (F == eImageFormat_R8) ? 1 : (F == eImageFormat_RG8) ? 2 : 4;
+    size_t x = 0;
+#ifdef AE_SSE2
+    if constexpr (F == eImageFormat_RGBA8 || F == eImageFormat_BGRA8) {
+        for (; x + 8 <= width; x += 8, dst += 32) convertYCbCrSIMD(dst, y + x, cb + x, cr + x, F == eImageFormat_BGRA8);
+    }
+#endif
+    unsigned char r, g, b;
+    for (; x < width; ++x, dst += step) {
+        ycbcrToRGB(y[x], cb[x], cr[x], r, g, b);
+        if constexpr (F == eImageFormat_native) {
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+        } else
+            writeImagePixel<F>(dst, r, g, b, 0xFF);
+    }
+}
+
+void convertYCbCrRow(unsigned char *dst, const unsigned char *y, const unsigned char *cb, const unsigned char *cr, size_t width,
+                     AeImageFormat format) {
+    switch (format) {
+        case eImageFormat_native:
+            convertYCbCrRow<eImageFormat_native>(dst, y, cb, cr, width);
+            break;
+        case eImageFormat_RGBA8:
+            convertYCbCrRow<eImageFormat_RGBA8>(dst, y, cb, cr, width);
+            break;
+        case eImageFormat_BGRA8:
+            convertYCbCrRow<eImageFormat_BGRA8>(dst, y, cb, cr, width);
+            break;
+        case eImageFormat_R8:
+            convertYCbCrRow<eImageFormat_R8>(dst, y, cb, cr, width);
+            break;
+        case eImageFormat_RG8:
+            convertYCbCrRow<eImageFormat_RG8>(dst, y, cb, cr, width);
+            break;
+    }
+}
+
+#ifdef AE_SSE2
+inline __m128i loadWidenEpi8(const unsigned char *p) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128());
+}
+#endif
+
+// sums = 3 * nearRow + farRow, the vertical half of the 2x2 triangle filter. Without farRow, sums = nearRow.
+void sumJPEGRows(short int *sums, const unsigned char *nearRow, const unsigned char *farRow, size_t count) {
+    size_t x = 0;
+#ifdef AE_SSE2
+    for (; x + 8 <= count; x += 8) {
+        __m128i sum = loadWidenEpi8(nearRow + x);
+        if (farRow != nullptr) sum = _mm_add_epi16(_mm_add_epi16(sum, _mm_add_epi16(sum, sum)), loadWidenEpi8(farRow + x));
+        _mm_storeu_si128((__m128i *)(sums + x), sum);
+    }
+#endif
+    for (; x < count; ++x) sums[x] = short(farRow != nullptr ? 3 * nearRow[x] + farRow[x] : nearRow[x]);
+}
+
+// Doubles count samples across: out[2x] = (3 * sums[x] + sums[x - 1] + evenBias) >> shift, and out[2x + 1] the same
+// with sums[x + 1] and oddBias. sums[-1] and sums[count] must hold the repeated edge samples.
+void upsampleJPEGH2(unsigned char *out, const short int *sums, size_t count, int evenBias, int oddBias, int shift) {
+    size_t x = 0;
+#ifdef AE_SSE2
+    const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+    for (; x + 8 <= count; x += 8) {
+        __m128i sum = _mm_loadu_si128((const __m128i *)(sums + x));
+        sum = _mm_add_epi16(sum, _mm_add_epi16(sum, sum));
+        __m128i even = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i *)(sums + x - 1)));
+        __m128i odd = _mm_add_epi16(sum, _mm_loadu_si128((const __m128i *)(sums + x + 1)));
+        even = _mm_add_epi16(even, _mm_set1_epi16(short(evenBias)));
+        odd = _mm_add_epi16(odd, _mm_set1_epi16(short(oddBias)));
+        even = _mm_srl_epi16(even, shiftCount);
+        odd = _mm_srl_epi16(odd, shiftCount);
+        _mm_storeu_si128((__m128i *)(out + 2 * x), _mm_unpacklo_epi8(_mm_packus_epi16(even, even), _mm_packus_epi16(odd, odd)));
+    }
+#endif
+    for (; x < count; ++x) {
+        int sum = 3 * sums[x];
+        out[2 * x] = (unsigned char)((sum + sums[x - 1] + evenBias) >> shift);
+        out[2 * x + 1] = (unsigned char)((sum + sums[x + 1] + oddBias) >> shift);
+    }
+}
+
+// Vertical half of the triangle filter alone: out = (3 * nearRow + farRow + bias) >> 2.
+void upsampleJPEGV2(unsigned char *out, const unsigned char *nearRow, const unsigned char *farRow, size_t count, int bias) {
+    size_t x = 0;
+#ifdef AE_SSE2
+    for (; x + 8 <= count; x += 8) {
+        __m128i sum = loadWidenEpi8(nearRow + x);
+        sum = _mm_add_epi16(_mm_add_epi16(sum, _mm_add_epi16(sum, sum)), loadWidenEpi8(farRow + x));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(short(bias))), 2);
+        _mm_storel_epi64((__m128i *)(out + x), _mm_packus_epi16(sum, sum));
+    }
+#endif
+    for (; x < count; ++x) out[x] = (unsigned char)((3 * nearRow[x] + farRow[x] + bias) >> 2);
+}
+
+struct QeJPEGComponent {
+    unsigned char id = 0;
+    unsigned int sampleX = 1;
+    unsigned int sampleY = 1;
+    unsigned short int quant[64];  // zig-zag order
+    const QeHuffmanTree2 *dc = nullptr;
+    const QeHuffmanTree2 *ac = nullptr;
+    size_t planeStride = 0;  // bytes in one sample row
+    size_t planeOffset = 0;  // first sample in an MCU row buffer
+};
+
+// Layout of a frame. An MCU row buffer holds the samples of one MCU row, component after component.
+struct QeJPEGFrame {
+    QeJPEGComponent components[3];
+    unsigned int componentNum = 0;
+    unsigned int maxSampleX = 1;
+    unsigned int maxSampleY = 1;
+    size_t imageWidth = 0;  // before scaling
+    size_t imageHeight = 0;
+    size_t width = 0;
+    size_t height = 0;
+    size_t mcuWidth = 0;
+    size_t mcuHeight = 0;
+    unsigned int blockSize = 8;  // samples per block side, 8 / scale
+    size_t paddedWidth = 0;     // mcuWidth in pixels
+    size_t planeSize = 0;       // bytes of an MCU row buffer
+    size_t restartInterval = 0;  // MCUs per entropy-coded segment, 0 for one segment
+    AeImageFormat format = eImageFormat_native;
+    size_t rowBytes = 0;
+};
+
+// Samples of a component row repeated up to the luma resolution, for sampling ratios the triangle filter doesn't cover.
+const unsigned char *repeatJPEGRow(unsigned char *tmp, const unsigned char *src, size_t width, unsigned int sampleX,
+                                   unsigned int maxSampleX) {
+    if (sampleX == maxSampleX) return src;
+    if (maxSampleX % sampleX == 0) {
+        const unsigned int scale = maxSampleX / sampleX;
+        for (size_t x = 0; x < width; x += scale) memset(tmp + x, src[x / scale], scale);
+    } else {
+        for (size_t x = 0; x < width; ++x) tmp[x] = src[x * sampleX / maxSampleX];
+    }
+    return tmp;
+}
+
+// Row of a component at the luma resolution, for output row `row` of MCU row mcuY. Ratios of 1 or 2 use the triangle
+// filter of libjpeg ("fancy upsampling"): every sample weighs 3/4 of the nearest chroma sample and 1/4 of the next
+// nearest, across and down, with the edge samples repeated. above and below are the neighbouring MCU row buffers.
+// tmp has room for frame.paddedWidth + 16 samples, sums for frame.paddedWidth + 2.
+const unsigned char *upsampleJPEGRow(const QeJPEGFrame &frame, const QeJPEGComponent &component, const unsigned char *plane,
+                                     const unsigned char *above, const unsigned char *below, size_t mcuY, unsigned int row,
+                                     unsigned char *tmp, short int *sums) {
+    const unsigned int ratioX = frame.maxSampleX % component.sampleX == 0 ? frame.maxSampleX / component.sampleX : 0;
+    const unsigned int ratioY = frame.maxSampleY % component.sampleY == 0 ? frame.maxSampleY / component.sampleY : 0;
+    const unsigned char *samples = plane + component.planeOffset;
+    if (ratioX == 0 || ratioX > 2 || ratioY == 0 || ratioY > 2) {
+        const unsigned char *src = samples + (row * component.sampleY / frame.maxSampleY) * component.planeStride;
+        return repeatJPEGRow(tmp, src, frame.width, component.sampleX, frame.maxSampleX);
+    }
+
+    const unsigned int sampleRow = row / ratioY;
+    const unsigned char *nearRow = samples + sampleRow * component.planeStride;
+    const unsigned char *farRow = nullptr;
+    if (ratioY == 2) {
+        // the next nearest row is above for the upper output row, below for the lower one
+        const ptrdiff_t rows = ptrdiff_t(component.sampleY * frame.blockSize);
+        const ptrdiff_t sampleHeight = ptrdiff_t((frame.height * component.sampleY + frame.maxSampleY - 1) / frame.maxSampleY);
+        ptrdiff_t farY = ptrdiff_t(mcuY) * rows + sampleRow + ((row & 1) ? 1 : -1);
+        farY = std::min(std::max(farY, ptrdiff_t(0)), sampleHeight - 1) - ptrdiff_t(mcuY) * rows;
+        if (farY < 0)
+            farRow = above + component.planeOffset + (rows - 1) * component.planeStride;
+        else if (farY >= rows)
+            farRow = below + component.planeOffset;
+        else
+            farRow = samples + farY * component.planeStride;
+    }
+
+    if (ratioX == 1) {
+        if (farRow == nullptr) return nearRow;
+        upsampleJPEGV2(tmp, nearRow, farRow, frame.width, (row & 1) ? 2 : 1);
+        return tmp;
+    }
+    const size_t sampleWidth = (frame.width * component.sampleX + frame.maxSampleX - 1) / frame.maxSampleX;
+    sumJPEGRows(sums + 1, nearRow, farRow, sampleWidth);
+    sums[0] = sums[1];
+    sums[sampleWidth + 1] = sums[sampleWidth];
+    if (farRow != nullptr)
+        upsampleJPEGH2(tmp, sums + 1, sampleWidth, 8, 7, 4);
+    else
+        upsampleJPEGH2(tmp, sums + 1, sampleWidth, 1, 2, 2);
+    return tmp;
+}
+
+// Writes a block of blockSize x blockSize samples. DC-only blocks are a flat colour and skip the IDCT.
+void storeJPEGBlock(unsigned char *dst, size_t stride, const short int *block, int count, unsigned int blockSize) {
+    if (count == 1 || blockSize == 1) {
+        unsigned char value = clampByte(((block[0] + 4) >> 3) + 128);
+        for (unsigned int k = 0; k < blockSize; ++k) memset(dst + k * stride, value, blockSize);
+        return;
+    }
+#ifdef AE_SSE2
+    if (blockSize == 4)
+        idctJPEGBlockReducedSIMD<4>(dst, stride, block);
+    else if (blockSize == 2)
+        idctJPEGBlockReducedSIMD<2>(dst, stride, block);
+    else
+        idctJPEGBlockSIMD(dst, stride, block);
+#else
+    if (blockSize == 4)
+        idctJPEGBlockReduced<4>(dst, stride, block);
+    else if (blockSize == 2)
+        idctJPEGBlockReduced<2>(dst, stride, block);
+    else
+        idctJPEGBlock(dst, stride, block);
+#endif
+}
+
+// Decodes the blocks of MCU mcuX straight into an MCU row buffer.
+void decodeJPEGMCU(const QeJPEGFrame &frame, AeBitStreamMSB &stream, int *dcPred, size_t mcuX, unsigned char *plane) {
+    alignas(16) short int block[64];
+    for (unsigned int i = 0; i < frame.componentNum; ++i) {
+        const QeJPEGComponent &component = frame.components[i];
+        for (unsigned int by = 0; by < component.sampleY; ++by) {
+            for (unsigned int bx = 0; bx < component.sampleX; ++bx) {
+                int count = decodeJPEGBlock(block, stream, component.dc, component.ac, component.quant, dcPred[i]);
+                size_t offset = (by * component.planeStride + mcuX * component.sampleX + bx) * frame.blockSize;
+                storeJPEGBlock(plane + component.planeOffset + offset, component.planeStride, block, count, frame.blockSize);
             }
-            totalmcuSize = mcuWidth * mcuHeight;
-        } else if (memcmp(key, huffmanKey, 2) == 0) {
-            QeHuffmanTree2 *tree = nullptr;
+        }
+    }
+}
 
-            if (data[0] / 16)
-                tree = &AC[data[0] % 16];
-            else
-                tree = &DC[data[0] % 16];
-
-            size_t length = 0;
-            for (i = 0; i < 16; ++i) length += data[1 + i];
-
-            tree->size = length;
-            tree->codeBits = new unsigned int[length];
-            tree->values = new unsigned int[length];
-            tree->codes = new unsigned int[length];
-            tree->codes[0] = 0;
-
-            int itreeIndex = 0;
-            int ntreeIndex = 1;
-            while (data[1 + itreeIndex] == 0) ++itreeIndex;
-            tree->codeBits[0] = itreeIndex + 1;
-            i = 0;
-            while (1) {
-                tree->values[i] = data[17 + i];
-                if ((i + 1) == length) break;
-
-                while (data[1 + itreeIndex] <= ntreeIndex) {
-                    ++itreeIndex;
-                    ntreeIndex = 0;
-                }
-                tree->codes[i + 1] = tree->codes[i] + 1;
-                tree->codeBits[i + 1] = itreeIndex + 1;
+// Coefficients of whole MCU rows, 64 per block in natural order. Each component keeps rows of mcuWidth * sampleX
+// blocks.
+struct QeJPEGCoefficients {
+    std::vector<short int> blocks[3];
+    std::vector<unsigned char> counts[3];  // as returned by decodeJPEGBlock
+    bool bQuantized = false;               // progressive coefficients, dequantized when stored
+
+    void resize(const QeJPEGFrame &frame, size_t mcuRows) {
+        for (unsigned int i = 0; i < frame.componentNum; ++i) {
+            const QeJPEGComponent &component = frame.components[i];
+            size_t count = frame.mcuWidth * component.sampleX * mcuRows * component.sampleY;
+            blocks[i].assign(count * 64, 0);
+            counts[i].assign(count, 1);
+        }
+    }
 
-                if (ntreeIndex == 0) tree->codes[i + 1] <<= (tree->codeBits[i + 1] - tree->codeBits[i]);
+    short int *getBlock(const QeJPEGFrame &frame, unsigned int component, size_t blockX, size_t blockY) {
+        return blocks[component].data() + (blockY * frame.mcuWidth * frame.components[component].sampleX + blockX) * 64;
+    }
+};
 
-                ++ntreeIndex;
-                ++i;
+// Decodes the blocks of MCU (mcuX, mcuY) into the coefficients.
+void decodeJPEGMCU(const QeJPEGFrame &frame, AeBitStreamMSB &stream, int *dcPred, size_t mcuX, size_t mcuY,
+                   QeJPEGCoefficients &coefficients) {
+    for (unsigned int i = 0; i < frame.componentNum; ++i) {
+        const QeJPEGComponent &component = frame.components[i];
+        for (unsigned int by = 0; by < component.sampleY; ++by) {
+            for (unsigned int bx = 0; bx < component.sampleX; ++bx) {
+                size_t blockX = mcuX * component.sampleX + bx, blockY = mcuY * component.sampleY + by;
+                short int *block = coefficients.getBlock(frame, i, blockX, blockY);
+                int count = decodeJPEGBlock(block, stream, component.dc, component.ac, component.quant, dcPred[i]);
+                coefficients.counts[i][(block - coefficients.blocks[i].data()) / 64] = (unsigned char)count;
             }
-        } else if (memcmp(key, scanKey, 2) == 0) {
-            huffmanTreeIndex = new unsigned char[data[0]];
-            for (i = 0; i < data[0]; ++i) huffmanTreeIndex[i] = data[2 + i * 2];
-
-            unsigned char *dataPos = data + length;
-            size_t lengthData = size - (dataPos - buffer);
-            size_t lengthData1 = 0;
-            unsigned char *dataPos1 = nullptr;
-            while (1) {
-                dataPos1 = (unsigned char *)memchr(dataPos + lengthData1, 0xFF, lengthData);
-
-                if (dataPos1[1] == 0) {
-                    lengthData1 = dataPos1 - dataPos + 1;
-                    dataHuffman.insert(dataHuffman.end(), dataPos, dataPos + lengthData1);
-                    dataPos += (lengthData1 + 1);
-                    lengthData -= (lengthData1 + 1);
-                    lengthData1 = 0;
-                } else {
-                    lengthData1 = dataPos1 - dataPos;
-                    dataHuffman.insert(dataHuffman.end(), dataPos, dataPos + lengthData1);
-                    break;
+        }
+    }
+}
+
+// IDCT of coefficient MCU row mcuY into an MCU row buffer.
+void storeJPEGMCURow(const QeJPEGFrame &frame, const QeJPEGCoefficients &coefficients, size_t mcuY, unsigned char *plane) {
+    alignas(16) short int dequantized[64];
+    for (unsigned int i = 0; i < frame.componentNum; ++i) {
+        const QeJPEGComponent &component = frame.components[i];
+        const size_t rowBlocks = frame.mcuWidth * component.sampleX;
+        for (unsigned int by = 0; by < component.sampleY; ++by) {
+            size_t index = (mcuY * component.sampleY + by) * rowBlocks;
+            for (size_t bx = 0; bx < rowBlocks; ++bx, ++index) {
+                const short int *block = coefficients.blocks[i].data() + index * 64;
+                int count = coefficients.counts[i][index];
+                if (coefficients.bQuantized) {
+                    count = 1;
+                    for (unsigned int k = 0; k < 64; ++k) {
+                        unsigned int n = ZIGZAGTONATURAL[k];
+                        dequantized[n] = short(block[n] * component.quant[k]);
+                        if (block[n] != 0) count = k + 1;
+                    }
+                    block = dequantized;
                 }
+                unsigned char *dst = plane + component.planeOffset + (by * component.planeStride + bx) * frame.blockSize;
+                storeJPEGBlock(dst, component.planeStride, block, count, frame.blockSize);
             }
-            break;
         }
-        index += (length + 2 * 2);
     }
+}
 
-    // MCU(Minimum Coded Unit)
-    short int **mcuDatas = new short int *[colorNum];
+// Upsamples and converts MCU row mcuY to output rows. above and below are the buffers of MCU rows mcuY - 1 and
+// mcuY + 1, nullptr at the top and at the bottom of the image.
+void convertJPEGRows(const QeJPEGFrame &frame, const unsigned char *plane, const unsigned char *above,
+                     const unsigned char *below, size_t mcuY, unsigned char *out) {
+    const size_t tmpSize = frame.paddedWidth + 16;
+    std::vector<unsigned char> upsampled(tmpSize * frame.componentNum);
+    std::vector<short int> sums(frame.paddedWidth + 2);
+    QeImageSource grey;
+    grey.channels = 1;
+    for (unsigned int row = 0; row < frame.maxSampleY * frame.blockSize; ++row) {
+        size_t y = mcuY * frame.maxSampleY * frame.blockSize + row;
+        if (y >= frame.height) break;
+        unsigned char *dst = out + y * frame.rowBytes;
+
+        const unsigned char *rows[3];
+        for (unsigned int i = 0; i < frame.componentNum; ++i)
+            rows[i] = upsampleJPEGRow(frame, frame.components[i], plane, above, below, mcuY, row,
+                                      upsampled.data() + i * tmpSize, sums.data());
+        if (frame.componentNum == 3)
+            convertYCbCrRow(dst, rows[0], rows[1], rows[2], frame.width, frame.format);
+        else if (frame.format == eImageFormat_native)
+            memcpy(dst, rows[0], frame.width);
+        else
+            convertImageRow(dst, rows[0], frame.width, grey, frame.format);
+    }
+}
 
-    for (i = 0; i < colorNum; ++i) {
-        mcuDatas[i] = new short int[64 * totalmcuSize * mcusSize[i]];
-        memset(mcuDatas[i], 0, 64 * totalmcuSize * mcusSize[i] * sizeof(mcuDatas[0][0]));
+// Fills the MCU row buffers in order with fill(mcuY, plane) and converts each row once the row below it is filled,
+// so the upsampling sees both neighbours. Only three buffers are used.
+void convertJPEGSerial(const QeJPEGFrame &frame, const std::function<void(size_t, unsigned char *)> &fill, unsigned char *out) {
+    std::vector<unsigned char> planes(frame.planeSize * 3);
+    auto getPlane = [&](size_t mcuY) { return planes.data() + (mcuY % 3) * frame.planeSize; };
+    for (size_t mcuY = 0; mcuY <= frame.mcuHeight; ++mcuY) {
+        if (mcuY < frame.mcuHeight) fill(mcuY, getPlane(mcuY));
+        if (mcuY == 0) continue;
+        convertJPEGRows(frame, getPlane(mcuY - 1), mcuY >= 2 ? getPlane(mcuY - 2) : nullptr,
+                        mcuY < frame.mcuHeight ? getPlane(mcuY) : nullptr, mcuY - 1, out);
     }
+}
+
+// Converts every MCU row of a buffer for the whole image on the thread pool.
+void convertJPEGPlanes(const QeJPEGFrame &frame, const unsigned char *planes, unsigned char *out) {
+    COM_THREAD.parallelFor(frame.mcuHeight, [&](size_t mcuY) {
+        const unsigned char *plane = planes + mcuY * frame.planeSize;
+        convertJPEGRows(frame, plane, mcuY > 0 ? plane - frame.planeSize : nullptr,
+                        mcuY + 1 < frame.mcuHeight ? plane + frame.planeSize : nullptr, mcuY, out);
+    });
+}
 
-    size_t bitPointer = 0;
+// Entropy-coded data with the byte stuffing removed, split at the restart markers.
+struct QeJPEGScan {
+    std::vector<unsigned char> data;
+    std::vector<size_t> segments;  // start of every segment in data
 
-    for (i = 0; i < totalmcuSize; ++i) {  // decode Huffman
-        for (j = 0; j < colorNum; ++j) {
-            index = 0;
-            unsigned char dc = readBits(&huffmanTreeIndex[j], &index, 4);
-            unsigned char ac = readBits(&huffmanTreeIndex[j], &index, 4);
-            getHuffmanDecodeSymbolfromDCAC(mcuDatas[j] + mcusSize[j] * i * 64, mcusSize[j], dataHuffman.data(), &bitPointer,
-                                           &DC[dc], &AC[ac]);
+    void setStream(AeBitStreamMSB &stream, size_t segment) const {
+        if (segment >= segments.size()) {
+            stream.set(nullptr, 0);  // missing segment, decodes as zeros
+            return;
         }
+        size_t end = segment + 1 < segments.size() ? segments[segment + 1] : data.size();
+        stream.set(data.data() + segments[segment], end - segments[segment]);
     }
-    for (i = 0; i < colorNum; ++i) {  // DCn=DCn-1+Diff
-        index = mcusSize[i] * totalmcuSize;
-        for (j = 1; j < index; ++j) mcuDatas[i][j * 64] += mcuDatas[i][(j - 1) * 64];
+};
+
+// Reads from the first byte after the SOS header up to the next marker that isn't RSTn, and returns where that
+// marker starts.
+const unsigned char *readJPEGScan(QeJPEGScan &scan, const unsigned char *p, const unsigned char *end) {
+    scan.data.reserve(end - p);
+    scan.segments.push_back(0);
+    while (p < end) {
+        const unsigned char *marker = (const unsigned char *)memchr(p, 0xFF, end - p);
+        if (marker == nullptr) {
+            scan.data.insert(scan.data.end(), p, end);
+            return end;
+        }
+        scan.data.insert(scan.data.end(), p, marker);
+        if (marker + 1 >= end) return end;
+
+        if (marker[1] == 0x00) {  // stuffed 0xFF
+            scan.data.push_back(0xFF);
+            p = marker + 2;
+        } else if (marker[1] >= 0xD0 && marker[1] <= 0xD7) {  // RST0 - RST7
+            scan.segments.push_back(scan.data.size());
+            p = marker + 2;
+        } else if (marker[1] == 0xFF)  // fill byte
+            p = marker + 1;
+        else
+            return marker;
     }
-    int k = 0;
-    for (i = 0; i < colorNum; ++i) {  // reverse Quantization
-        index = mcusSize[i] * totalmcuSize;
-        for (j = 0; j < index; ++j) {
-            for (k = 0; k < 64; ++k) mcuDatas[i][j * 64 + k] *= quanData[mcusQuan[i]][k];
+    return end;
+}
+
+// One MCU row at a time, each decoded and converted while its buffer is in cache.
+void decodeJPEGSerial(const QeJPEGFrame &frame, const QeJPEGScan &scan, unsigned char *out) {
+    AeBitStreamMSB stream;
+    scan.setStream(stream, 0);
+    int dcPred[3] = {0, 0, 0};
+    size_t segment = 0, mcu = 0;
+
+    convertJPEGSerial(
+        frame,
+        [&](size_t, unsigned char *plane) {
+            for (size_t mcuX = 0; mcuX < frame.mcuWidth; ++mcuX, ++mcu) {
+                if (frame.restartInterval != 0 && mcu != 0 && mcu % frame.restartInterval == 0) {
+                    scan.setStream(stream, ++segment);
+                    dcPred[0] = dcPred[1] = dcPred[2] = 0;
+                }
+                decodeJPEGMCU(frame, stream, dcPred, mcuX, plane);
+            }
+        },
+        out);
+}
+
+// Restart segments are independent, so each is decoded on its own thread into a buffer for the whole image.
+// The MCU rows are converted once every segment is done.
+void decodeJPEGSegments(const QeJPEGFrame &frame, const QeJPEGScan &scan, unsigned char *out) {
+    std::vector<unsigned char> planes(frame.planeSize * frame.mcuHeight);
+    const size_t mcuCount = frame.mcuWidth * frame.mcuHeight;
+    const size_t segmentCount = (mcuCount + frame.restartInterval - 1) / frame.restartInterval;
+
+    COM_THREAD.parallelFor(segmentCount, [&](size_t segment) {
+        AeBitStreamMSB stream;
+        scan.setStream(stream, segment);
+        int dcPred[3] = {0, 0, 0};
+        size_t mcuEnd = std::min(mcuCount, (segment + 1) * frame.restartInterval);
+        for (size_t mcu = segment * frame.restartInterval; mcu < mcuEnd; ++mcu)
+            decodeJPEGMCU(frame, stream, dcPred, mcu % frame.mcuWidth, planes.data() + (mcu / frame.mcuWidth) * frame.planeSize);
+    });
+    convertJPEGPlanes(frame, planes.data(), out);
+}
+
+// Without restart markers the entropy decoding has to run in order. It decodes a batch of MCU rows to
+// coefficients, then the IDCT of the batch runs on every thread. The rows are converted at the end.
+void decodeJPEGRows(const QeJPEGFrame &frame, const QeJPEGScan &scan, unsigned char *out) {
+    const size_t batchRows = std::min(frame.mcuHeight, COM_THREAD.getThreadCount() * 2);
+    std::vector<unsigned char> planes(frame.planeSize * frame.mcuHeight);
+    QeJPEGCoefficients coefficients;
+    coefficients.resize(frame, batchRows);
+    AeBitStreamMSB stream;
+    scan.setStream(stream, 0);
+    int dcPred[3] = {0, 0, 0};
+
+    for (size_t firstRow = 0; firstRow < frame.mcuHeight; firstRow += batchRows) {
+        const size_t rows = std::min(batchRows, frame.mcuHeight - firstRow);
+        for (size_t row = 0; row < rows; ++row) {
+            for (size_t mcuX = 0; mcuX < frame.mcuWidth; ++mcuX) decodeJPEGMCU(frame, stream, dcPred, mcuX, row, coefficients);
         }
+        COM_THREAD.parallelFor(rows, [&](size_t row) {
+            storeJPEGMCURow(frame, coefficients, row, planes.data() + (firstRow + row) * frame.planeSize);
+        });
+    }
+    convertJPEGPlanes(frame, planes.data(), out);
+}
+
+// Components, coefficient band and bit position coded by one scan.
+struct QeJPEGScanHeader {
+    unsigned int componentNum = 0;
+    unsigned int components[3];  // indices in QeJPEGFrame::components
+    unsigned int spectralStart = 0;
+    unsigned int spectralEnd = 63;
+    unsigned int bitHigh = 0;  // 0 for the first scan of a band, else the bit the previous scan stopped at
+    unsigned int bitLow = 0;
+};
+
+// Adds a correction bit to a coefficient that is already non-zero.
+inline void refineJPEGCoefficient(short int &coefficient, AeBitStreamMSB &stream, int bit) {
+    if (stream.read(1) && (coefficient & bit) == 0) coefficient = short(coefficient + (coefficient > 0 ? bit : -bit));
+}
+
+// One block of a progressive scan: the DC coefficient or a band of AC coefficients, either first coded or refined
+// by one bit. eobRun counts the following blocks that have nothing more in this band.
+void decodeJPEGProgressiveBlock(short int *block, AeBitStreamMSB &stream, const QeJPEGComponent &component,
+                                const QeJPEGScanHeader &header, int &dcPred, unsigned int &eobRun) {
+    const int bit = 1 << header.bitLow;
+    if (header.spectralStart == 0) {
+        if (header.bitHigh == 0) {
+            unsigned int size = getHuffmanDecodeSymbol(stream, component.dc);
+            if (size > 16) size = 0;  // corrupt
+            dcPred += extendBits(stream.read(size), size);
+            block[0] = short(dcPred * bit);
+        } else if (stream.read(1))
+            block[0] = short(block[0] | bit);
+        return;
     }
-    short int buffer1[64];
-    for (i = 0; i < colorNum; ++i) {  // reverse Zig-zag
-        index = mcusSize[i] * totalmcuSize;
-        for (j = 0; j < index; ++j) {
-            memcpy(buffer1, &mcuDatas[i][j * 64], 64 * sizeof(mcuDatas[0][0]));
-            for (k = 0; k < 64; ++k) mcuDatas[i][j * 64 + k] = buffer1[ZIGZAGTABLE[k]];
+
+    unsigned int k = header.spectralStart;
+    if (header.bitHigh == 0) {
+        if (eobRun > 0) {
+            --eobRun;
+            return;
+        }
+        for (; k <= header.spectralEnd; ++k) {
+            unsigned int value = getHuffmanDecodeSymbol(stream, component.ac);
+            unsigned int run = value >> 4;
+            unsigned int size = value & 0x0F;
+            if (size == 0) {
+                if (run < 15) {  // end of band for this block and 2^run - 1 + extra more
+                    eobRun = (1u << run) - 1 + stream.read(run);
+                    break;
+                }
+                k += 15;  // 0xF0 skips 16 zeros
+                continue;
+            }
+            k += run;
+            if (k > 63) break;
+            block[ZIGZAGTONATURAL[k]] = short(extendBits(stream.read(size), size) * bit);
         }
+        return;
     }
-    for (i = 0; i < colorNum; ++i) {  // odd lines change signed
-        index = mcusSize[i] * totalmcuSize;
-        for (j = 0; j < index; ++j) {
-            for (k = 0; k < 64; ++k)
-                if (k / 8 % 2 == 1) mcuDatas[i][j * 64 + k] *= -1;
+
+    // Refinement: new coefficients are +-bit, every non-zero one passed on the way gets a correction bit
+    if (eobRun == 0) {
+        for (; k <= header.spectralEnd; ++k) {
+            unsigned int value = getHuffmanDecodeSymbol(stream, component.ac);
+            unsigned int run = value >> 4;
+            short int coefficient = 0;
+            if ((value & 0x0F) == 0) {
+                if (run < 15) {
+                    eobRun = (1u << run) + stream.read(run);
+                    break;
+                }
+            } else
+                coefficient = short(stream.read(1) ? bit : -bit);
+
+            // skip run zero coefficients, the new one goes in the next zero
+            for (; k <= header.spectralEnd; ++k) {
+                short int &current = block[ZIGZAGTONATURAL[k]];
+                if (current != 0)
+                    refineJPEGCoefficient(current, stream, bit);
+                else if (run == 0)
+                    break;
+                else
+                    --run;
+            }
+            if (coefficient != 0 && k <= header.spectralEnd) block[ZIGZAGTONATURAL[k]] = coefficient;
         }
     }
-    int buffer2[64];
-    for (i = 0; i < colorNum; ++i) {  // IDCT
-        index = mcusSize[i] * totalmcuSize;
-        for (j = 0; j < index; ++j) {
-            for (k = 0; k < 64; ++k) buffer2[k] = mcuDatas[i][j * 64 + k];
-            FastIntegerIDCT(buffer2);
-            for (k = 0; k < 64; ++k) mcuDatas[i][j * 64 + k] = buffer2[k];
+    if (eobRun > 0) {
+        for (; k <= header.spectralEnd; ++k) {
+            short int &current = block[ZIGZAGTONATURAL[k]];
+            if (current != 0) refineJPEGCoefficient(current, stream, bit);
         }
+        --eobRun;
     }
-    // YCrCb to RGB
-    double cY, cCb, cCr;
-    ret.resize(*width * *height * *bytes);
-    size_t x = 0;
-    size_t y = 0;
-    if (mcusSize[0] == 1) {
-        for (i = 0; i < totalmcuSize; ++i) {
-            for (j = 0; j < 64; ++j) {
-                index = i * 64 + j;
-                cY = mcuDatas[0][index];
-                cCb = mcuDatas[1][index];
-                cCr = mcuDatas[2][index];
-
-                x = i % mcuWidth * 8 + j % 8;
-                y = i / mcuWidth * 8 + 7 - (j / 8);
-                index = y * *width + x;
-
-                ret[index * 3] = unsigned char(MATH.clamp(int(cY + 1.402 * cCr + 128), 0, 255));                             // R
-                ret[index * 3 + 1] = unsigned char(MATH.clamp(int(cY - 0.3441363 * cCb - 0.71413636 * cCr + 128), 0, 255));  // G
-                ret[index * 3 + 2] = unsigned char(MATH.clamp(int(cY + 1.772 * cCb + 128), 0, 255));                         // B
-            }
+}
+
+// Decodes a scan into the coefficients of the whole image. Used for progressive frames, and for sequential frames
+// that code their components in separate scans.
+void decodeJPEGScan(const QeJPEGFrame &frame, const QeJPEGScanHeader &header, const QeJPEGScan &scan, bool bProgressive,
+                    QeJPEGCoefficients &coefficients) {
+    // A scan of one component isn't interleaved: its MCU is one block, and it only codes the blocks that cover the
+    // component, not the padding up to whole MCUs.
+    size_t unitsX = frame.mcuWidth, unitsY = frame.mcuHeight;
+    if (header.componentNum == 1) {
+        const QeJPEGComponent &component = frame.components[header.components[0]];
+        unitsX = ((frame.imageWidth * component.sampleX + frame.maxSampleX - 1) / frame.maxSampleX + 7) / 8;
+        unitsY = ((frame.imageHeight * component.sampleY + frame.maxSampleY - 1) / frame.maxSampleY + 7) / 8;
+    }
+
+    AeBitStreamMSB stream;
+    scan.setStream(stream, 0);
+    int dcPred[3] = {0, 0, 0};
+    unsigned int eobRun = 0;
+    size_t segment = 0;
+    for (size_t unit = 0; unit < unitsX * unitsY; ++unit) {
+        if (frame.restartInterval != 0 && unit != 0 && unit % frame.restartInterval == 0) {
+            scan.setStream(stream, ++segment);
+            dcPred[0] = dcPred[1] = dcPred[2] = 0;
+            eobRun = 0;
         }
-    } else if (mcusSize[0] == 4) {
-        for (i = 0; i < totalmcuSize; ++i) {
-            for (j = 0; j < 4; ++j) {
-                for (k = 0; k < 64; ++k) {
-                    index = (i * 4 + j) * 64 + k;
-                    cY = mcuDatas[0][index];
-                    index = index / 4;
-                    cCb = mcuDatas[1][index];
-                    cCr = mcuDatas[2][index];
-
-                    x = i % mcuWidth * 16 + j % 2 * 8 + k % 8;
-                    y = i / mcuWidth * 16 + j / 2 * 8 + 7 - (k / 8);
-                    index = y * *width + x;
-
-                    ret[index * 3] = unsigned char(MATH.clamp(int(cY + 1.402 * cCr + 128), 0, 255));  // R
-                    ret[index * 3 + 1] =
-                        unsigned char(MATH.clamp(int(cY - 0.3441363 * cCb - 0.71413636 * cCr + 128), 0, 255));  // G
-                    ret[index * 3 + 2] = unsigned char(MATH.clamp(int(cY + 1.772 * cCb + 128), 0, 255));        // B
+        const size_t unitX = unit % unitsX, unitY = unit / unitsX;
+        for (unsigned int n = 0; n < header.componentNum; ++n) {
+            const unsigned int i = header.components[n];
+            const QeJPEGComponent &component = frame.components[i];
+            const unsigned int blocksX = header.componentNum == 1 ? 1 : component.sampleX;
+            const unsigned int blocksY = header.componentNum == 1 ? 1 : component.sampleY;
+            for (unsigned int by = 0; by < blocksY; ++by) {
+                for (unsigned int bx = 0; bx < blocksX; ++bx) {
+                    short int *block = coefficients.getBlock(frame, i, unitX * blocksX + bx, unitY * blocksY + by);
+                    if (bProgressive)
+                        decodeJPEGProgressiveBlock(block, stream, component, header, dcPred[n], eobRun);
+                    else
+                        coefficients.counts[i][(block - coefficients.blocks[i].data()) / 64] = (unsigned char)decodeJPEGBlock(
+                            block, stream, component.dc, component.ac, component.quant, dcPred[n]);
                 }
             }
         }
     }
-    if (mcusType != nullptr) delete[] mcusType;
-    if (mcusQuan != nullptr) delete[] mcusQuan;
-    if (mcusSize != nullptr) delete[] mcusSize;
-    if (huffmanTreeIndex != nullptr) delete[] huffmanTreeIndex;
+}
 
-    if (mcuDatas != nullptr) {
-        for (i = 0; i < colorNum; ++i)
-            if (mcuDatas[i] != nullptr) delete mcuDatas[i];
-        delete[] mcuDatas;
+// IDCT and conversion of the coefficients of the whole image, on the thread pool when bParallel.
+void convertJPEGCoefficients(const QeJPEGFrame &frame, const QeJPEGCoefficients &coefficients, bool bParallel,
+                             unsigned char *out) {
+    if (!bParallel || COM_THREAD.getThreadCount() == 1 || frame.mcuHeight == 1) {
+        convertJPEGSerial(
+            frame, [&](size_t mcuY, unsigned char *plane) { storeJPEGMCURow(frame, coefficients, mcuY, plane); }, out);
+        return;
     }
+    std::vector<unsigned char> planes(frame.planeSize * frame.mcuHeight);
+    COM_THREAD.parallelFor(frame.mcuHeight, [&](size_t mcuY) {
+        storeJPEGMCURow(frame, coefficients, mcuY, planes.data() + mcuY * frame.planeSize);
+    });
+    convertJPEGPlanes(frame, planes.data(), out);
+}
+
+std::vector<unsigned char> AeCommonEncode::decodeJPEG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                                                      AeImageFormat format, bool bParallel, unsigned int scale) {
+    std::vector<unsigned char> ret;
+    if (!decodeJPEG(buffer, size, width, height, bytes, [&ret](size_t dataSize) {
+            ret.resize(dataSize);
+            return ret.data();
+        }, format, bParallel, scale))
+        ret.clear();
     return ret;
 }
 
-std::vector<unsigned char> AeCommonEncode::decodeBMP(unsigned char *buffer, int *width, int *height, int *bytes) {
+bool AeCommonEncode::decodeJPEG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                                const std::function<unsigned char *(size_t size)> &allocate, AeImageFormat format,
+                                bool bParallel, unsigned int scale) {
+    // YCbCr(YUV), DCT(Discrete Cosine Transform), Quantization, Zig-zag(Entropy
+    // Coding), RLC(Run Length Coding), Canonical Huffman Code
+
+    unsigned char startKey[2] = {0xFF, 0xD8};        // SOI  Start of Image
+    unsigned char APP0[2] = {0xFF, 0xE0};            // APP0 Application
+    unsigned char quanKey[2] = {0xFF, 0xDB};         // DQT  Define Quantization Table
+    unsigned char frameKey[2] = {0xFF, 0xC0};        // SOF0 Start of Frame, baseline
+    unsigned char extendedKey[2] = {0xFF, 0xC1};     // SOF1 Start of Frame, extended sequential
+    unsigned char progressiveKey[2] = {0xFF, 0xC2};  // SOF2 Start of Frame, progressive
+    unsigned char huffmanKey[2] = {0xFF, 0xC4};      // DHT  Difine Huffman Table
+    unsigned char restartKey[2] = {0xFF, 0xDD};      // DRI  Define Restart Interval
+    unsigned char scanKey[2] = {0xFF, 0xDA};         // SOS  Start of Scan
+    unsigned char endKey[2] = {0xFF, 0xD9};          // EOI  End of Image
+
+    if (size < 4 || memcmp(buffer, startKey, 2) != 0) return false;
+
+    unsigned short int length = 0;
+    char *key;
+    unsigned char *data = nullptr;
+    size_t index = 2;
+    unsigned char buf[2];
+    QeJPEGScan scan;
+    QeHuffmanTree2 DC[4];  // DC00 - DC03
+    QeHuffmanTree2 AC[4];  // AC10 - AC13
+    QeJPEGFrame frame;
+    unsigned char mcusQuan[3] = {0, 0, 0};
+    bool bScan = false;
+    bool bProgressive = false;
+    QeJPEGCoefficients coefficients;  // progressive frames, and sequential frames with several scans
+    bool bCoefficients = false;
+    unsigned short int quanTables[4][64];
+    bool bQuanTables[4] = {false, false, false, false};
+
+    size_t i = 0, j = 0;
+    while (index + 2 <= size) {
+        key = (char *)(buffer + index);
+        if (buffer[index] != 0xFF || memcmp(key, endKey, 2) == 0) break;
+        if (buffer[index + 1] == 0xFF) {  // fill byte
+            ++index;
+            continue;
+        }
+        if (buffer[index + 1] == 0x01 || (buffer[index + 1] >= 0xD0 && buffer[index + 1] <= 0xD7)) {  // TEM, RSTn
+            index += 2;
+            continue;
+        }
+        if (index + 4 > size) break;
+
+        buf[0] = *(buffer + index + 3);
+        buf[1] = *(buffer + index + 2);
+        length = *(unsigned short int *)(buf)-2;
+        data = (buffer + index + 4);
+        if (length > size - index - 4) return false;
+
+        // else if (memcmp(key, APP0, 2) == 0) {}
+        if (memcmp(key, quanKey, 2) == 0) {
+            // one segment can hold several tables: precision/id, then 64 values of 8 or 16 bits
+            size_t offset = 0;
+            while (offset < length) {
+                unsigned char *table = data + offset;
+                bool bWide = (table[0] >> 4) != 0;
+                if (offset + 1 + (bWide ? 128 : 64) > length) break;
+                unsigned short int *quan = quanTables[table[0] & 3];
+                for (j = 0; j < 64; ++j)
+                    quan[j] = bWide ? (unsigned short int)(table[1 + j * 2] << 8 | table[2 + j * 2]) : table[1 + j];
+                bQuanTables[table[0] & 3] = true;
+                offset += 1 + (bWide ? 128 : 64);
+            }
+        } else if (memcmp(key, frameKey, 2) == 0 || memcmp(key, extendedKey, 2) == 0 || memcmp(key, progressiveKey, 2) == 0) {
+            if (length < 6 || frame.componentNum != 0) return false;
+            bProgressive = memcmp(key, progressiveKey, 2) == 0;
+            unsigned char colorBits = data[0];
+            buf[1] = data[1];
+            buf[0] = data[2];
+            *height = *(unsigned short int *)&buf;
+            buf[1] = data[3];
+            buf[0] = data[4];
+            *width = *(unsigned short int *)&buf;
+            unsigned char colorNum = data[5];
+            if (colorBits != 8 || (colorNum != 1 && colorNum != 3) || length < 6 + colorNum * 3) return false;
+            if (*width <= 0 || *height <= 0) return false;
+            *bytes = colorNum;
+
+            frame.componentNum = colorNum;
+            for (i = 0; i < colorNum; ++i) {
+                QeJPEGComponent &component = frame.components[i];
+                component.id = data[6 + i * 3];
+                component.sampleX = data[7 + i * 3] >> 4;
+                component.sampleY = data[7 + i * 3] & 0x0F;
+                mcusQuan[i] = data[8 + i * 3] & 3;
+                if (component.sampleX == 0 || component.sampleY == 0 || component.sampleX > 4 || component.sampleY > 4)
+                    return false;
+            }
+            if (colorNum == 1) frame.components[0].sampleX = frame.components[0].sampleY = 1;  // never interleaved
+
+            // MCU(Minimum Coded Unit)
+            for (i = 0; i < frame.componentNum; ++i) {
+                frame.maxSampleX = std::max(frame.maxSampleX, frame.components[i].sampleX);
+                frame.maxSampleY = std::max(frame.maxSampleY, frame.components[i].sampleY);
+            }
+            frame.imageWidth = *width;
+            frame.imageHeight = *height;
+            frame.mcuWidth = (*width + 8 * frame.maxSampleX - 1) / (8 * frame.maxSampleX);
+            frame.mcuHeight = (*height + 8 * frame.maxSampleY - 1) / (8 * frame.maxSampleY);
+        } else if (memcmp(key, huffmanKey, 2) == 0) {
+            // one segment can hold several tables: class/id, 16 code counts, then the values
+            size_t offset = 0;
+            while (offset + 17 <= length) {
+                unsigned char *table = data + offset;
+                QeHuffmanTree2 *tree = (table[0] >> 4) ? &AC[table[0] & 3] : &DC[table[0] & 3];
+
+                size_t count = 0;
+                for (i = 0; i < 16; ++i) count += table[1 + i];
+                if (offset + 17 + count > length || !buildJPEGHuffmanTree(tree, table + 1, table + 17)) break;
+                offset += 17 + count;
+            }
+        } else if (memcmp(key, restartKey, 2) == 0) {
+            if (length >= 2) frame.restartInterval = size_t(data[0]) << 8 | data[1];
+        } else if (memcmp(key, scanKey, 2) == 0) {
+            QeJPEGScanHeader header;
+            header.componentNum = length >= 1 ? data[0] : 0;
+            if (frame.componentNum == 0 || header.componentNum == 0 || header.componentNum > frame.componentNum ||
+                length < 4 + header.componentNum * 2)
+                return false;
+            bool bInOrder = header.componentNum == frame.componentNum;
+            for (j = 0; j < header.componentNum; ++j) {
+                i = 0;
+                while (i < frame.componentNum && frame.components[i].id != data[1 + j * 2]) ++i;
+                if (i == frame.componentNum || !bQuanTables[mcusQuan[i]]) return false;
+                QeJPEGComponent &component = frame.components[i];
+                component.dc = &DC[(data[2 + j * 2] >> 4) & 3];
+                component.ac = &AC[data[2 + j * 2] & 3];
+                memcpy(component.quant, quanTables[mcusQuan[i]], sizeof(component.quant));
+                header.components[j] = (unsigned int)i;
+                bInOrder = bInOrder && i == j;
+            }
+            header.spectralStart = data[1 + header.componentNum * 2];
+            header.spectralEnd = data[2 + header.componentNum * 2];
+            header.bitHigh = data[3 + header.componentNum * 2] >> 4;
+            header.bitLow = data[3 + header.componentNum * 2] & 0x0F;
+
+            // A sequential scan of every component is decoded after the loop, straight to pixels
+            if (!bProgressive && !bCoefficients && bInOrder) {
+                readJPEGScan(scan, data + length, buffer + size);
+                bScan = true;
+                break;
+            }
+
+            // DC and AC coefficients are never in the same progressive scan, and AC scans have one component
+            bool bDC = header.spectralStart == 0;
+            if (bProgressive && (header.spectralStart > header.spectralEnd || header.spectralEnd > 63 || header.bitLow > 13 ||
+                                 bDC != (header.spectralEnd == 0) || (!bDC && header.componentNum != 1)))
+                return false;
+            if (!bCoefficients) {
+                coefficients.resize(frame, frame.mcuHeight);
+                coefficients.bQuantized = bProgressive;
+                bCoefficients = true;
+            }
+            QeJPEGScan progressiveScan;
+            const unsigned char *next = readJPEGScan(progressiveScan, data + length, buffer + size);
+            decodeJPEGScan(frame, header, progressiveScan, bProgressive, coefficients);
+            index = next - buffer;
+            continue;
+        }
+        index += (length + 2 * 2);
+    }
+    if (!bScan && !bCoefficients) return false;
+
+    if (scale != 2 && scale != 4 && scale != 8) scale = 1;
+    frame.blockSize = 8 / scale;
+    *width = (*width + scale - 1) / scale;
+    *height = (*height + scale - 1) / scale;
+    frame.width = *width;
+    frame.height = *height;
+    frame.paddedWidth = frame.mcuWidth * frame.maxSampleX * frame.blockSize;
+    for (i = 0; i < frame.componentNum; ++i) {
+        QeJPEGComponent &component = frame.components[i];
+        component.planeStride = frame.mcuWidth * component.sampleX * frame.blockSize;
+        component.planeOffset = frame.planeSize;
+        frame.planeSize += component.planeStride * component.sampleY * frame.blockSize;
+    }
+
+    if (format != eImageFormat_native) *bytes = getImageFormatBytes(format);
+    frame.format = format;
+    frame.rowBytes = frame.width * *bytes;
+    unsigned char *out = allocate(frame.rowBytes * frame.height);
+    if (out == nullptr) return false;
+
+    if (bCoefficients)
+        convertJPEGCoefficients(frame, coefficients, bParallel, out);
+    else if (!bParallel || COM_THREAD.getThreadCount() == 1 || frame.mcuHeight == 1)
+        decodeJPEGSerial(frame, scan, out);
+    else if (frame.restartInterval != 0 && scan.segments.size() > 1)
+        decodeJPEGSegments(frame, scan, out);
+    else
+        decodeJPEGRows(frame, scan, out);
+    return true;
+}
+
+std::vector<unsigned char> AeCommonEncode::decodeBMP(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                                                     AeImageFormat format) {
     std::vector<unsigned char> ret;
-    if (strncmp((char *)buffer, "BM", 2) != 0) return ret;
+    if (!decodeBMP(buffer, size, width, height, bytes, [&ret](size_t dataSize) {
+            ret.resize(dataSize);
+            return ret.data();
+        }, format))
+        ret.clear();
+    return ret;
+}
+
+bool AeCommonEncode::decodeBMP(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                               const std::function<unsigned char *(size_t size)> &allocate, AeImageFormat format) {
+    if (size < 0x36 || strncmp((char *)buffer, "BM", 2) != 0) return false;
 
+    unsigned int offset = *(unsigned int *)(buffer + 0x0A);  // pixel data
     *width = *(int *)(buffer + 0x12);
     *height = *(int *)(buffer + 0x16);
-    short int *bits = (short int *)(buffer + 0x1C);
-    *bytes = (*bits + 7) / 8;
-    int imageSize = *width * *height * *bytes;
-
-    ret.resize(imageSize);
-    memcpy(ret.data(), buffer + 0x0A, imageSize);
+    unsigned short int bits = *(unsigned short int *)(buffer + 0x1C);
+    unsigned int compression = *(unsigned int *)(buffer + 0x1E);  // 0: BI_RGB, 3: BI_BITFIELDS
+
+    if ((bits != 24 && bits != 32) || (compression != 0 && compression != 3)) return false;
+
+    // rows are stored bottom-up unless the height is negative, each padded to 4 bytes
+    bool bTopDown = *height < 0;
+    if (bTopDown && *height >= -IMAGE_MAX_DIMENSION) *height = -*height;
+    if (*width <= 0 || *height == 0 || *width > IMAGE_MAX_DIMENSION || *height > IMAGE_MAX_DIMENSION) return false;
+    size_t stride = (size_t(*width) * bits / 8 + 3) & ~size_t(3);
+    if (offset > size || stride * *height > size - offset) return false;
+
+    QeImageSource source;
+    source.channels = bits / 8;
+    source.bBGR = true;
+    *bytes = (format == eImageFormat_native) ? source.channels : getImageFormatBytes(format);
+    size_t linebytes = size_t(*width) * *bytes;
+    unsigned char *out = allocate(linebytes * *height);
+    if (out == nullptr) return false;
+
+    for (int y = 0; y < *height; ++y) {
+        const unsigned char *src = buffer + offset + stride * (bTopDown ? y : *height - 1 - y);
+        if (format == eImageFormat_native)
+            memcpy(out + linebytes * y, src, linebytes);
+        else
+            convertImageRow(out + linebytes * y, src, *width, source, format);
+    }
+    return true;
+}
 
+std::vector<unsigned char> AeCommonEncode::decodePNG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                                                     AeImageFormat format) {
+    std::vector<unsigned char> ret;
+    if (!decodePNG(buffer, size, width, height, bytes, [&ret](size_t dataSize) {
+            ret.resize(dataSize);
+            return ret.data();
+        }, format))
+        ret.clear();
     return ret;
 }
 
-std::vector<unsigned char> AeCommonEncode::decodePNG(unsigned char *buffer, int *width, int *height, int *bytes) {
-    std::vector<unsigned char> ret;
+bool AeCommonEncode::decodePNG(unsigned char *buffer, size_t size, int *width, int *height, int *bytes,
+                               const std::function<unsigned char *(size_t size)> &allocate, AeImageFormat format) {
     unsigned char headerKey[8] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
-    if (memcmp(buffer, headerKey, 8) != 0) return ret;
+    if (size < 0x21 || memcmp(buffer, headerKey, 8) != 0) return false;
 
     // IHDR 0x08 - 0x20
     // PLTE
@@ -878,151 +2504,117 @@ std::vector<unsigned char> AeCommonEncode::decodePNG(unsigned char *buffer, int
             break;  // RGBA
     }
     bits *= bitDepth;
+    if (bits == 0 || *width <= 0 || *height <= 0 || *width > IMAGE_MAX_DIMENSION || *height > IMAGE_MAX_DIMENSION) return false;
 
     *bytes = (bits + 7) / 8;
     int CompressionMethod = buffer[0x1A];
     int FilterMethod = buffer[0x1B];
     int InterlaceMethod = buffer[0x1C];
 
-    int index = 0x21;
-    int chunkLength = 0;
+    size_t index = 0x21;
+    size_t chunkLength = 0;
     char *chunkKey = nullptr;
     char *chunkData = nullptr;
 
-    unsigned char endKey[12] = {0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82};
-    std::vector<unsigned char> dataIDAT;
-
-    while (1) {
-        if (memcmp(buffer + index, endKey, 12) == 0) break;
-
-        buf[0] = buffer[index + 3];
-        buf[1] = buffer[index + 2];
-        buf[2] = buffer[index + 1];
-        buf[3] = buffer[index];
-        chunkLength = *(int *)&(buf);
-        chunkKey = (char *)buffer + index + 4;
-
-        if (strncmp(chunkKey, "IDAT", 4) == 0) {
-            size_t oldSize = dataIDAT.size();
-            dataIDAT.resize(oldSize + chunkLength);
-            memcpy(dataIDAT.data() + oldSize, chunkKey + 4, chunkLength);
-        }
-        index += (chunkLength + 4 * 3);
-    }
-
-    std::vector<unsigned char> dataDecode = decodeDeflate(dataIDAT.data(), (unsigned int)dataIDAT.size());
-
-    // decode filter scanline
-    unsigned char *recon = 0;
-    unsigned char *scanline = 0;
-    unsigned char *prevline = 0;
-    unsigned int bytewidth = *bytes;
     unsigned int linebytes = ((*width) * bits + 7) / 8;
+    unsigned int bytewidth = *bytes;
 
-    size_t j = 0;
-    size_t outindex;
-    size_t inindex;
-    unsigned char filterType;
-    ret.resize(linebytes * *height);
-
-    for (index = 0; index < *height; ++index) {
-        outindex = linebytes * index;
-        inindex = (1 + linebytes) * index;
-        filterType = dataDecode[inindex];
-        ++inindex;
-        recon = &ret[outindex];
-        scanline = &dataDecode[inindex];
-
-        switch (filterType) {
-            case 0:  // none
-                for (j = 0; j != linebytes; ++j) recon[j] = scanline[j];
-                break;
-            case 1:  // sub left X-A
-                for (j = 0; j != bytewidth; ++j) recon[j] = scanline[j];
-                for (j = bytewidth; j < linebytes; ++j) recon[j] = scanline[j] + recon[j - bytewidth];
-                break;
-            case 2:  // sub up X-B
-                if (prevline)
-                    for (j = 0; j != linebytes; ++j) recon[j] = scanline[j] + prevline[j];
-                else
-                    for (j = 0; j != linebytes; ++j) recon[j] = scanline[j];
-                break;
-            case 3:  // average X-(A+B)/2
-                if (prevline) {
-                    for (j = 0; j != bytewidth; ++j) recon[j] = scanline[j] + (prevline[j] >> 1);
-                    for (j = bytewidth; j < linebytes; ++j) recon[j] = scanline[j] + ((recon[j - bytewidth] + prevline[j]) >> 1);
-                } else {
-                    for (j = 0; j != bytewidth; ++j) recon[j] = scanline[j];
-                    for (j = bytewidth; j < linebytes; ++j) recon[j] = scanline[j] + (recon[j - bytewidth] >> 1);
-                }
-                break;
-            case 4:  // peath
-                if (prevline) {
-                    for (j = 0; j != bytewidth; ++j) recon[j] = (scanline[j] + prevline[j]);
-                    for (j = bytewidth; j < linebytes; ++j) {
-                        unsigned char paethPredictor = 0;
-                        short int a = recon[j - bytewidth];
-                        short int b = prevline[j];
-                        short int c = prevline[j - bytewidth];
-                        short int pa = abs(b - c);
-                        short int pb = abs(a - c);
-                        short int pc = abs(a + b - c - c);
-
-                        if (pc < pa && pc < pb)
-                            paethPredictor = (unsigned char)c;
-                        else if (pb < pa)
-                            paethPredictor = (unsigned char)b;
-                        else
-                            paethPredictor = (unsigned char)a;
-
-                        recon[j] = (scanline[j] + paethPredictor);
+    // Palette, packed and 16-bit samples, and any requested layout are converted while each row is written, with
+    // the last two unfiltered rows kept aside. A palette image without a requested layout comes out as RGBA8.
+    QeImageSource source;
+    source.channels = bits / bitDepth;
+    source.bitDepth = bitDepth;
+    unsigned char palette[256 * 4];
+    if (colorType == 3) {
+        memset(palette, 0xFF, sizeof(palette));
+        source.palette = palette;
+        if (format == eImageFormat_native) format = eImageFormat_RGBA8;
+    }
+    bool bConvert = format != eImageFormat_native;
+    std::vector<unsigned char> rows;
+    size_t outbytes = linebytes;
+    if (bConvert) {
+        *bytes = getImageFormatBytes(format);
+        outbytes = size_t(*width) * *bytes;
+        rows.resize(size_t(linebytes) * 2);
+    }
+    unsigned char *out = allocate(outbytes * *height);
+    if (out == nullptr) return false;
+
+    // Inflate every IDAT as it is found and unfilter each scanline as soon as it is complete, so only one
+    // filtered row is kept besides the image.
+    AeInflateStream inflater;
+    std::vector<unsigned char> scanline(1 + linebytes);
+    size_t filled = 0;
+    int row = 0;
+    AeInflateStatus status = eInflate_needInput;
+
+    while (index + 12 <= size && status == eInflate_needInput) {
+        chunkLength = (size_t(buffer[index]) << 24) | (size_t(buffer[index + 1]) << 16) | (size_t(buffer[index + 2]) << 8) |
+                      size_t(buffer[index + 3]);
+        chunkKey = (char *)buffer + index + 4;
+        if (strncmp(chunkKey, "IEND", 4) == 0) break;
+        if (chunkLength > size - index - 12) break;
+        chunkData = chunkKey + 4;
+
+        if (strncmp(chunkKey, "PLTE", 4) == 0 && source.palette != nullptr) {
+            for (size_t k = 0; k < chunkLength / 3 && k < 256; ++k) memcpy(palette + k * 4, chunkData + k * 3, 3);
+        } else if (strncmp(chunkKey, "tRNS", 4) == 0 && source.palette != nullptr) {
+            for (size_t k = 0; k < chunkLength && k < 256; ++k) palette[k * 4 + 3] = chunkData[k];
+        } else if (strncmp(chunkKey, "IDAT", 4) == 0) {
+            inflater.setInput((unsigned char *)chunkData, chunkLength);
+            do {
+                size_t written = 0;
+                status = inflater.inflate(scanline.data() + filled, scanline.size() - filled, &written);
+                filled += written;
+                if (filled == scanline.size()) {
+                    if (row == *height) {
+                        status = eInflate_error;  // more data than the image
+                        break;
                     }
-                } else {
-                    for (j = 0; j != bytewidth; ++j) recon[j] = scanline[j];
-                    for (j = bytewidth; j < linebytes; ++j) recon[j] = (scanline[j] + recon[j - bytewidth]);
+                    unsigned char *recon = out + outbytes * row;
+                    unsigned char *prevline = row > 0 ? recon - outbytes : nullptr;
+                    if (bConvert) {
+                        recon = rows.data() + size_t(linebytes) * (row & 1);
+                        prevline = row > 0 ? rows.data() + size_t(linebytes) * ((row - 1) & 1) : nullptr;
+                    }
+                    unfilterPNGScanline(recon, scanline.data() + 1, prevline, linebytes, bytewidth, scanline[0]);
+                    if (bConvert) convertImageRow(out + outbytes * row, recon, *width, source, format);
+                    filled = 0;
+                    ++row;
                 }
-                break;
+            } while (status == eInflate_outputFull);
         }
-        prevline = &ret[outindex];
+        index += (chunkLength + 4 * 3);
     }
-    return ret;
+    return status == eInflate_done && row == *height;
 }
 
-std::vector<unsigned char> AeCommonEncode::decodeDeflate(unsigned char *in, unsigned int size) {
+std::vector<unsigned char> AeCommonEncode::decodeDeflate(unsigned char *in, size_t size) {
     // gzip, zlib, Deflate, LZ77, Canonical Huffman Code, inflate
-    // 78 01 - fastest
-    // 78 5E - fast
-    // 78 9C - default
-    // 78 DA - Best Compression, slowest
-    std::vector<unsigned char> out;
-    if (in[0] != 0x78) return out;
-    if (in[1] != 0x01 && in[1] != 0x5E && in[1] != 0x9C && in[1] != 0xDA) return out;
-
-    in += 2;
-    size_t bitPointer = 0;
-    unsigned int BFINAL = 0;
-    unsigned int BYTE = 0;
-
-    while (!BFINAL) {
-        BFINAL = readBits(in, &bitPointer, 1);
-        BYTE = readBits(in, &bitPointer, 2);
+    std::vector<unsigned char> ret;
+    if (!checkZlibHeader(in, size)) return ret;
 
-        if (BYTE == 0) {  // No compression
+    ret.resize(size * 4);
+    QeInflateOutput out;
+    out.owner = &ret;
+    out.data = ret.data();
+    out.capacity = ret.size();
 
-            while ((bitPointer & 0x7) != 0) ++bitPointer;
-            size_t bytePos = bitPointer / 8;
+    AeBitStreamLSB stream(in + 2, size - 2);
+    decodeDeflateBlocks(&out, stream);
+    ret.resize(out.size);
+    return ret;
+}
 
-            unsigned short int length = *(unsigned short int *)&(in[bytePos]);
-            bytePos += 4;
+size_t AeCommonEncode::decodeDeflate(unsigned char *in, size_t size, unsigned char *out, size_t outSize) {
+    if (!checkZlibHeader(in, size)) return 0;
 
-            out.insert(out.end(), in[bytePos], in[bytePos] + length);
-            bitPointer = bytePos * 8;
-        } else if (BYTE == 1 || BYTE == 2)
-            decodeHuffmanLZ77(&out, in, &bitPointer,
-                              BYTE);  // fixed or dynamic Huffman
+    QeInflateOutput output;
+    output.data = out;
+    output.capacity = outSize;
 
-        else
-            return out;
-    }
-    return out;
+    AeBitStreamLSB stream(in + 2, size - 2);
+    decodeDeflateBlocks(&output, stream);
+    return output.size;
 }
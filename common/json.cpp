@@ -0,0 +1,581 @@
+#include "common.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+int getLowestJSONBit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return int(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// Bit i set where the quotes before and at i are odd, so inside a string from its opening quote on.
+uint64_t prefixJSONXOR(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+struct AeJSONBlock {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t structural = 0;  // {}[]:,
+    uint64_t space = 0;
+};
+
+void classifyJSONBlock(const char *p, AeJSONBlock &block) {
+#ifdef AE_SSE2
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), lower = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}'), colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(','), space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n'), carriage = _mm_set1_epi8('\r');
+    for (int i = 0; i < 4; ++i) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(p + i * 16));
+        const __m128i folded = _mm_or_si128(v, lower);  // [ and ] fold onto { and }
+        const __m128i structural =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        const __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                           _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, carriage)));
+        block.quote |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << (i * 16);
+        block.backslash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << (i * 16);
+        block.structural |= uint64_t(uint16_t(_mm_movemask_epi8(structural))) << (i * 16);
+        block.space |= uint64_t(uint16_t(_mm_movemask_epi8(blank))) << (i * 16);
+    }
+#else
+    for (int i = 0; i < 64; ++i) {
+        const uint64_t bit = 1ull << i;
+        switch (p[i]) {
+            case '"':
+                block.quote |= bit;
+                break;
+            case '\\':
+                block.backslash |= bit;
+                break;
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                block.structural |= bit;
+                break;
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                block.space |= bit;
+                break;
+        }
+    }
+#endif
+}
+
+bool AeJSONDocument::indexJSON(const char *text, size_t size, std::vector<uint32_t> &index) {
+    index.clear();
+    if (size >= UINT32_MAX) return false;
+    uint64_t inString = 0, escapeNext = 0, scalarBefore = 0;  // carried from the block before
+    char tail[64];
+    for (size_t offset = 0; offset < size; offset += 64) {
+        const char *p = text + offset;
+        if (size - offset < 64) {  // spaces after the end, so nothing starts there
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, size - offset);
+            p = tail;
+        }
+        AeJSONBlock block;
+        classifyJSONBlock(p, block);
+
+        // A backslash escapes the character after it unless it is escaped itself; runs of them are rare enough to walk.
+        uint64_t escaped = escapeNext, backslash = block.backslash & ~escapeNext;
+        escapeNext = 0;
+        while (backslash) {
+            const int bit = getLowestJSONBit(backslash);
+            backslash &= backslash - 1;
+            if (bit == 63) {
+                escapeNext = 1;
+            } else {
+                escaped |= 1ull << (bit + 1);
+                backslash &= ~(1ull << (bit + 1));
+            }
+        }
+
+        const uint64_t quotes = block.quote & ~escaped;
+        const uint64_t strings = prefixJSONXOR(quotes) ^ inString;  // opening quotes and contents
+        inString = uint64_t(int64_t(strings) >> 63);
+        const uint64_t scalars = ~(block.structural | block.space | block.quote | strings);
+        uint64_t bits = (block.structural & ~strings) | (quotes & strings) | (scalars & ~(scalars << 1 | scalarBefore));
+        scalarBefore = scalars >> 63;
+
+        const size_t count = index.size();
+        index.resize(count + 64);
+        uint32_t *out = index.data() + count;
+        while (bits) {
+            *out++ = uint32_t(offset + getLowestJSONBit(bits));
+            bits &= bits - 1;
+        }
+        index.resize(out - index.data());
+    }
+    return inString == 0;
+}
+
+// Objects of more members get slots, a power of two at least twice their count.
+const uint32_t JSON_SLOT_MEMBERS = 8;
+
+size_t getJSONSlotCount(uint32_t members) {
+    size_t count = 16;
+    while (count < size_t(members) * 2) count *= 2;
+    return count;
+}
+
+// Second stage: values from the index, recursively, with the elements and members of each open container gathered in
+// a vector of their depth and copied into the arena at once when it closes.
+struct AeJSONBuilder {
+    const char *text;
+    const char *end;
+    const uint32_t *index;
+    size_t indexSize;
+    size_t next = 0;
+    AeArena &arena;
+    std::vector<std::vector<AeJSONValue>> elements;
+    std::vector<std::vector<AeJSONMember>> members;
+    std::vector<std::vector<double>> numbers;
+
+    static const int MAX_DEPTH = 1024;
+
+    AeJSONBuilder(const char *_text, size_t size, const std::vector<uint32_t> &_index, AeArena &_arena)
+        : text(_text), end(_text + size), index(_index.data()), indexSize(_index.size()), arena(_arena) {}
+
+    const char *peek() const { return next < indexSize ? text + index[next] : nullptr; }
+
+    bool parseValue(AeJSONValue &value, int depth);
+    bool parseArray(AeJSONValue &value, int depth);
+    bool parseNumbers(AeJSONValue &value, int depth);
+    bool parseObject(AeJSONValue &value, int depth);
+    bool parseString(const char *p, std::string_view &string);
+    bool parseNumber(const char *p, AeJSONValue &value);
+    bool parseLiteral(const char *p, std::string_view literal);
+};
+
+bool AeJSONBuilder::parseValue(AeJSONValue &value, int depth) {
+    const char *p = peek();
+    if (p == nullptr) return false;
+    ++next;
+    switch (*p) {
+        case '{':
+            return parseObject(value, depth);
+        case '[':
+            return parseArray(value, depth);
+        case '"':
+            value.type = eJSON_string;
+            return parseString(p, value.string);
+        case 't':
+            value.type = eJSON_bool;
+            value.boolean = true;
+            return parseLiteral(p, "true");
+        case 'f':
+            value.type = eJSON_bool;
+            return parseLiteral(p, "false");
+        case 'n':
+            return parseLiteral(p, "null");
+        default:
+            return parseNumber(p, value);
+    }
+}
+
+bool AeJSONBuilder::parseArray(AeJSONValue &value, int depth) {
+    if (depth >= MAX_DEPTH) return false;
+    value.type = eJSON_array;
+    const char *p = peek();
+    if (p && *p == ']') {
+        ++next;
+        return true;
+    }
+    if (parseNumbers(value, depth)) return true;
+
+    if (elements.size() <= size_t(depth)) elements.resize(depth + 1);
+    elements[depth].clear();
+    while (true) {
+        AeJSONValue element;
+        if (!parseValue(element, depth + 1)) return false;
+        elements[depth].push_back(element);
+        p = peek();
+        if (p == nullptr) return false;
+        ++next;
+        if (*p == ']') break;
+        if (*p != ',') return false;
+    }
+
+    const std::vector<AeJSONValue> &values = elements[depth];
+    AeJSONValue *copy = (AeJSONValue *)arena.allocate(values.size() * sizeof(AeJSONValue), alignof(AeJSONValue));
+    for (size_t i = 0; i < values.size(); ++i) new (copy + i) AeJSONValue(values[i]);
+    value.elements = copy;
+    value.size = uint32_t(values.size());
+    return true;
+}
+
+// An array of numbers straight into floats, and ints, without an AeJSONValue for each. Anything else in it rewinds
+// to its first element for parseArray.
+bool AeJSONBuilder::parseNumbers(AeJSONValue &value, int depth) {
+    const size_t first = next;
+    if (numbers.size() <= size_t(depth)) numbers.resize(depth + 1);
+    std::vector<double> &values = numbers[depth];
+    values.clear();
+    bool bInts = true;
+    while (true) {
+        const char *p = peek();
+        AeJSONValue element;
+        if (p == nullptr || (*p != '-' && (*p < '0' || *p > '9')) || !parseNumber(p, element)) break;
+        ++next;
+        bInts = bInts && element.type == eJSON_int && element.integer >= INT_MIN && element.integer <= INT_MAX;
+        values.push_back(element.number);
+        p = peek();
+        if (p == nullptr || (*p != ',' && *p != ']')) break;
+        ++next;
+        if (*p != ']') continue;
+
+        value.size = uint32_t(values.size());
+        float *floats = (float *)arena.allocate(values.size() * sizeof(float), alignof(float));
+        for (size_t i = 0; i < values.size(); ++i) floats[i] = float(values[i]);
+        value.floats = floats;
+        if (bInts) {
+            int *ints = (int *)arena.allocate(values.size() * sizeof(int), alignof(int));
+            for (size_t i = 0; i < values.size(); ++i) ints[i] = int(values[i]);
+            value.ints = ints;
+        }
+        return true;
+    }
+    next = first;
+    return false;
+}
+
+bool AeJSONBuilder::parseObject(AeJSONValue &value, int depth) {
+    if (depth >= MAX_DEPTH) return false;
+    value.type = eJSON_object;
+    const char *p = peek();
+    if (p && *p == '}') {
+        ++next;
+        return true;
+    }
+    if (members.size() <= size_t(depth)) members.resize(depth + 1);
+    members[depth].clear();
+    while (true) {
+        AeJSONMember member;
+        p = peek();
+        if (p == nullptr || *p != '"' || !parseString(p, member.key)) return false;
+        member.hash = AeJSONPath::hashKey(member.key);
+        ++next;
+        p = peek();
+        if (p == nullptr || *p != ':') return false;
+        ++next;
+        if (!parseValue(member.value, depth + 1)) return false;
+        members[depth].push_back(member);
+        p = peek();
+        if (p == nullptr) return false;
+        ++next;
+        if (*p == '}') break;
+        if (*p != ',') return false;
+    }
+
+    const std::vector<AeJSONMember> &values = members[depth];
+    AeJSONMember *copy = (AeJSONMember *)arena.allocate(values.size() * sizeof(AeJSONMember), alignof(AeJSONMember));
+    for (size_t i = 0; i < values.size(); ++i) new (copy + i) AeJSONMember(values[i]);
+    value.members = copy;
+    value.size = uint32_t(values.size());
+    if (value.size > JSON_SLOT_MEMBERS) {
+        const size_t mask = getJSONSlotCount(value.size) - 1;
+        uint32_t *slots = (uint32_t *)arena.allocate((mask + 1) * sizeof(uint32_t), alignof(uint32_t));
+        memset(slots, 0, (mask + 1) * sizeof(uint32_t));
+        for (uint32_t i = 0; i < value.size; ++i) {
+            size_t slot = copy[i].hash & mask;
+            while (slots[slot] && copy[slots[slot] - 1].key != copy[i].key) slot = (slot + 1) & mask;
+            if (!slots[slot]) slots[slot] = i + 1;  // the first of equal keys wins
+        }
+        value.slots = slots;
+    }
+    return true;
+}
+
+void appendJSONUTF8(std::string &out, uint32_t code) {
+    if (code < 0x80) {
+        out += char(code);
+    } else if (code < 0x800) {
+        out += char(0xC0 | (code >> 6));
+        out += char(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += char(0xE0 | (code >> 12));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    } else {
+        out += char(0xF0 | (code >> 18));
+        out += char(0x80 | ((code >> 12) & 0x3F));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    }
+}
+
+bool readJSONHex(const char *p, const char *end, uint32_t &code) {
+    if (end - p < 4) return false;
+    code = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char c = p[i];
+        const int digit = c >= '0' && c <= '9'   ? c - '0'
+                          : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                          : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                                 : -1;
+        if (digit < 0) return false;
+        code = code * 16 + digit;
+    }
+    return true;
+}
+
+// p is the opening quote. Strings without escapes view the text; the others are decoded into the arena.
+bool AeJSONBuilder::parseString(const char *p, std::string_view &string) {
+    const char *begin = p + 1;
+    const char *quote = (const char *)memchr(begin, '"', end - begin);
+    if (quote == nullptr) return false;
+    if (memchr(begin, '\\', quote - begin) == nullptr) {
+        string = std::string_view(begin, quote - begin);
+        return true;
+    }
+
+    std::string decoded;
+    for (p = begin; *p != '"'; ++p) {
+        if (p == end) return false;
+        if (*p != '\\') {
+            decoded += *p;
+            continue;
+        }
+        if (++p == end) return false;
+        switch (*p) {
+            case '"':
+            case '\\':
+            case '/':
+                decoded += *p;
+                break;
+            case 'b':
+                decoded += '\b';
+                break;
+            case 'f':
+                decoded += '\f';
+                break;
+            case 'n':
+                decoded += '\n';
+                break;
+            case 'r':
+                decoded += '\r';
+                break;
+            case 't':
+                decoded += '\t';
+                break;
+            case 'u': {
+                uint32_t code, low;
+                if (!readJSONHex(p + 1, end, code)) return false;
+                p += 4;
+                if (code >= 0xD800 && code < 0xDC00 && end - p > 6 && p[1] == '\\' && p[2] == 'u' &&
+                    readJSONHex(p + 3, end, low) && low >= 0xDC00 && low < 0xE000) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                }
+                appendJSONUTF8(decoded, code);
+            } break;
+            default:
+                return false;
+        }
+    }
+    string = arena.copyString(decoded);
+    return true;
+}
+
+bool AeJSONBuilder::parseLiteral(const char *p, std::string_view literal) {
+    if (size_t(end - p) < literal.size() || std::string_view(p, literal.size()) != literal) return false;
+    const char *after = p + literal.size();
+    return after == end || strchr(" \t\n\r,]}", *after) != nullptr;
+}
+
+// Integers of up to 18 digits exactly; doubles whose digits fit 2^53 with a power of ten up to 22, exactly by one
+// rounding; everything else through strtod.
+bool AeJSONBuilder::parseNumber(const char *p, AeJSONValue &value) {
+    static const double POWERS[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *begin = p;
+    const bool bNegative = p < end && *p == '-';
+    if (bNegative) ++p;
+    if (p == end || *p < '0' || *p > '9') return false;
+    if (*p == '0' && p + 1 < end && p[1] >= '0' && p[1] <= '9') return false;
+
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) mantissa = mantissa * 10 + (*p - '0');
+    const int integerDigits = digits;
+    bool bInteger = true;
+    if (p < end && *p == '.') {
+        bInteger = false;
+        if (++p == end || *p < '0' || *p > '9') return false;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits, --exponent) mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        bInteger = false;
+        ++p;
+        bool bNegativeExponent = false;
+        if (p < end && (*p == '+' || *p == '-')) bNegativeExponent = *p++ == '-';
+        if (p == end || *p < '0' || *p > '9') return false;
+        int written = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) written = std::min(written * 10 + (*p - '0'), 100000);
+        exponent += bNegativeExponent ? -written : written;
+    }
+    if (p < end && !strchr(" \t\n\r,]}", *p)) return false;
+
+    if (bInteger && integerDigits <= 18) {
+        value.type = eJSON_int;
+        value.integer = bNegative ? -int64_t(mantissa) : int64_t(mantissa);
+        value.number = double(value.integer);
+        return true;
+    }
+    value.type = eJSON_double;
+    if (digits <= 19 && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        value.number = exponent < 0 ? double(mantissa) / POWERS[-exponent] : double(mantissa) * POWERS[exponent];
+    } else {
+        std::string copy(begin, p - begin);
+        value.number = strtod(copy.c_str(), nullptr);
+        return true;
+    }
+    if (bNegative) value.number = -value.number;
+    return true;
+}
+
+AeJSONValue *AeJSONValue::getJSONMember(std::string_view key) const { return getJSONMember(key, AeJSONPath::hashKey(key)); }
+
+AeJSONValue *AeJSONValue::getJSONMember(std::string_view key, uint32_t hash) const {
+    if (members == nullptr) return nullptr;
+    if (slots) {
+        const size_t mask = getJSONSlotCount(size) - 1;
+        for (size_t slot = hash & mask; slots[slot]; slot = (slot + 1) & mask) {
+            AeJSONMember &member = members[slots[slot] - 1];
+            if (member.hash == hash && member.key == key) return &member.value;
+        }
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < size; ++i)
+        if (members[i].hash == hash && members[i].key == key) return &members[i].value;
+    return nullptr;
+}
+
+AeJSONValue *AeJSONValue::getJSONElement(size_t index) const {
+    return elements && index < size ? &elements[index] : nullptr;
+}
+
+AeJSONValue *findJSONValue(const AeJSONValue *value, const std::string_view *key, const std::string_view *end) {
+    if (key == end) return const_cast<AeJSONValue *>(value);
+    if (value->type == eJSON_array) {
+        for (uint32_t i = 0; value->elements && i < value->size; ++i) {
+            AeJSONValue *found = findJSONValue(&value->elements[i], key, end);
+            if (found) return found;
+        }
+        return nullptr;
+    }
+    AeJSONValue *member = value->getJSONMember(*key);
+    return member ? findJSONValue(member, key + 1, end) : nullptr;
+}
+
+AeJSONValue *AeJSONValue::getJSONValue(std::initializer_list<std::string_view> keys) const {
+    return findJSONValue(this, keys.begin(), keys.end());
+}
+
+AeJSONValue *findJSONValue(const AeJSONValue *value, const AeJSONPath::Step *step, const AeJSONPath::Step *end) {
+    if (step == end) return const_cast<AeJSONValue *>(value);
+    if (step->index != UINT32_MAX) {
+        AeJSONValue *element = value->getJSONElement(step->index);
+        return element ? findJSONValue(element, step + 1, end) : nullptr;
+    }
+    if (value->type == eJSON_array) {
+        for (uint32_t i = 0; value->elements && i < value->size; ++i) {
+            AeJSONValue *found = findJSONValue(&value->elements[i], step, end);
+            if (found) return found;
+        }
+        return nullptr;
+    }
+    AeJSONValue *member = value->getJSONMember(step->key, step->hash);
+    return member ? findJSONValue(member, step + 1, end) : nullptr;
+}
+
+AeJSONValue *AeJSONValue::getJSONValue(const AeJSONPath &path) const {
+    return findJSONValue(this, path.steps.data(), path.steps.data() + path.steps.size());
+}
+
+AeJSONPath::AeJSONPath(const char *path) {
+    for (const char *p = path; *p;) {
+        if (*p == '.') {
+            ++p;
+        } else if (*p == '[') {
+            Step step;
+            step.index = uint32_t(strtoul(p + 1, (char **)&p, 10));
+            if (*p == ']') ++p;
+            steps.push_back(step);
+        } else {
+            const size_t length = strcspn(p, ".[");
+            Step step;
+            step.key.assign(p, length);
+            step.hash = hashKey(step.key);
+            steps.push_back(step);
+            p += length;
+        }
+    }
+}
+
+// FNV-1a
+uint32_t AeJSONPath::hashKey(std::string_view key) {
+    uint32_t hash = 2166136261u;
+    for (char c : key) hash = (hash ^ (unsigned char)c) * 16777619u;
+    return hash;
+}
+
+int64_t AeJSONValue::getJSONInt(int64_t defaultValue) const {
+    if (type == eJSON_int) return integer;
+    if (type == eJSON_double) return int64_t(number);
+    return defaultValue;
+}
+
+double AeJSONValue::getJSONNumber(double defaultValue) const { return isJSONNumber() ? number : defaultValue; }
+
+bool AeJSONDocument::open(const char *path) {
+    clear();
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) return false;
+    std::vector<char> data(size_t(file.tellg()));
+    file.seekg(0);
+    if (!file.read(data.data(), data.size())) return false;
+    return parse(std::move(data));
+}
+
+bool AeJSONDocument::parse(std::vector<char> &&_buffer) {
+    clear();
+    buffer = std::move(_buffer);
+    std::vector<uint32_t> index;
+    if (indexJSON(buffer.data(), buffer.size(), index)) {
+        AeJSONBuilder builder(buffer.data(), buffer.size(), index, arena);
+        root = arena.create<AeJSONValue>();
+        if (builder.parseValue(*root, 0) && builder.next == index.size()) return true;
+    }
+    clear();
+    return false;
+}
+
+void AeJSONDocument::clear() {
+    arena.clear();
+    root = nullptr;
+    std::vector<char>().swap(buffer);
+}
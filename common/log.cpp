@@ -1,14 +1,29 @@
 #include "common.h"
 #include <ctime>
+#ifdef _WIN32
 #include <windows.h>
 #include <direct.h>
 #include "dbghelp.h"
+#else
+#include <execinfo.h>
+#include <sys/stat.h>
+#endif
 #include <sstream>
 #include <iostream>
 #include <cerrno>
 
 SINGLETON_INSTANCE(AeLog)
 
+void getLocalTime(struct tm &timeinfo) {
+    time_t rawtime;
+    time(&rawtime);
+#ifdef _WIN32
+    localtime_s(&timeinfo, &rawtime);
+#else
+    localtime_r(&rawtime, &timeinfo);
+#endif
+}
+
 namespace AeLib {
 std::string toString(const int &i) {
     std::ostringstream oss;
@@ -82,7 +97,11 @@ bool AeFile::open(const char *output_path_) {
     output_dirs.pop_back();
     if (output_dirs.size() > 0) {
         std::string output_dir = COM_ENCODE.combine<std::string>(output_dirs, "\\");
+#ifdef _WIN32
         _mkdir(output_dir.c_str());
+#else
+        mkdir(output_dir.c_str(), 0755);
+#endif
     }
     ofile->open(output_path_);
     ASSERT(!ofile->fail(), output_path_)
@@ -132,12 +151,9 @@ void AeLog::switchOutput(bool turn_on, const char *output_path) {
         if (file->isOpen()) {
             file->close();
         }
-        time_t rawtime;
         struct tm timeinfo;
         char buffer[128];
-
-        time(&rawtime);
-        localtime_s(&timeinfo, &rawtime);
+        getLocalTime(timeinfo);
 
         strftime(buffer, sizeof(buffer), "%y%m%d%H%M%S", &timeinfo);
         std::string outputPath = output_path;
@@ -154,7 +170,16 @@ void AeLog::removeListener(AeLogListener &listener) { eraseElementFromVector(*li
 
 std::string AeLog::stack(int from, int to) {
     std::string ret = "";
-
+#ifndef _WIN32
+    std::vector<void *> backTrace(to);
+    int nFrame = backtrace(backTrace.data(), to);
+    char **symbols = backtrace_symbols(backTrace.data(), nFrame);
+    for (int iFrame = from; symbols != nullptr && iFrame < nFrame; ++iFrame) {
+        ret.append("\n    ");
+        ret.append(symbols[iFrame]);
+    }
+    free(symbols);
+#else
     void **backTrace = new void *[to];
 
     const USHORT nFrame = CaptureStackBackTrace(from, to, backTrace, nullptr);
@@ -185,19 +210,16 @@ std::string AeLog::stack(int from, int to) {
     SymCleanup(hProcess);
 
     delete[] backTrace;
-
+#endif
     return ret;
 }
 
-void AeLog::print(std::string &msg, bool bShowStack, int stackLevel) {
+void AeLog::print(const std::string &msg, bool bShowStack, int stackLevel) {
     if (this == nullptr) return;
 
-    time_t rawtime;
     struct tm timeinfo;
     char buffer[128];
-
-    time(&rawtime);
-    localtime_s(&timeinfo, &rawtime);
+    getLocalTime(timeinfo);
 
     strftime(buffer, sizeof(buffer), "%y%m%d%H%M%S ", &timeinfo);
     std::string s = buffer;
@@ -6,10 +6,15 @@ SINGLETON_INSTANCE(AeCommonManager)
 
 std::map<std::string, AeXMLNode *> astXMLs;
 std::map<std::string, AeJSONNode *> astJSONs;
+std::map<std::string, AeXMLDocument *> astXMLDocuments;
+std::map<std::string, AeJSONDocument *> astJSONDocuments;
+std::map<std::string, AeMappedFile *> astXMLSnapshots;  // the images the trees in astXMLs were loaded from
+std::map<std::string, AeXMLWriter *> astXMLWriters;     // of saveXML, holding the last text of the trees in astXMLs
 
 AeXMLNode::AeXMLNode() : data(new AeXMLData()) {}
 
 AeXMLNode::~AeXMLNode() {
+    expireXMLPaths();  // no cached path may reach this node again
     std::vector<AeXMLNode *>::iterator it = data->nexts.begin();
     while (it != data->nexts.end()) {
         if ((*it) != nullptr) delete (*it);
@@ -20,21 +25,21 @@ AeXMLNode::~AeXMLNode() {
     data = nullptr;
 }
 
-AeXMLNode *AeXMLNode::getXMLNode(const char *key) { return getXMLNode(COM_ENCODE.split<std::string>(key, ".")); }
+AeXMLNode *AeXMLNode::getXMLNode(const char *key) {
+    std::string_view rest(key);
+    AeXMLNode *current = this;
+    while (current) {
+        size_t dot = rest.find('.');
+        current = current->getXMLNext(rest.substr(0, dot));
+        if (dot == std::string_view::npos) break;
+        rest.remove_prefix(dot + 1);
+    }
+    return current;
+}
 
 AeXMLNode *AeXMLNode::getXMLNode(std::vector<std::string> &keys) {
     AeXMLNode *current = this;
-    for (const auto &key : keys) {
-        bool b = true;
-        for (const auto &node : current->data->nexts) {
-            if (key.compare(node->data->key) == 0) {
-                current = node;
-                b = false;
-                break;
-            }
-        }
-        if (b) return nullptr;
-    }
+    for (size_t i = 0; i < keys.size() && current; ++i) current = current->getXMLNext(keys[i]);
     return current;
 }
 
@@ -54,9 +59,11 @@ void AeXMLNode::copyXMLNode(AeXMLNode *to) {
 
     for (const auto &node : data->nexts) {
         AeXMLNode *new_node = new AeXMLNode();
+        new_node->data->parent = to;
         to->data->nexts.push_back(new_node);
         node->copyXMLNode(new_node);
     }
+    to->invalidateXMLIndex();
 }
 
 void AeXMLNode::copyXMLValue(AeXMLNode *to) {
@@ -64,22 +71,38 @@ void AeXMLNode::copyXMLValue(AeXMLNode *to) {
     to->data->key = data->key;
     to->data->value = data->value;
     to->data->elements = data->elements;
+    to->invalidateXMLIndex();
+    if (to->data->parent) to->data->parent->invalidateXMLIndex();
 }
 
-void AeXMLNode::addXMLNode(AeXMLNode *node) { data->nexts.push_back(node); }
+void AeXMLNode::addXMLNode(AeXMLNode *node) {
+    data->nexts.push_back(node);
+    node->data->parent = this;
+    node->data->textWriter = 0;  // its text elsewhere is not where it goes now
+    invalidateXMLIndex();
+}
 
-void AeXMLNode::setXMLKey(const char *key) { this->data->key = key; }
-void AeXMLNode::setXMLValue(const char *value) { this->data->value = value; }
+void AeXMLNode::setXMLKey(const char *key) {
+    this->data->key = key;
+    invalidateXMLIndex();
+    if (data->parent) data->parent->invalidateXMLIndex();
+}
+void AeXMLNode::setXMLValue(const char *value) {
+    this->data->value = value;
+    setXMLDirty();
+}
 
 void AeXMLNode::setXMLValue(const char *key, const char *value) {
     for (auto &node : data->elements) {
         if (node.key.compare(key) == 0) {
             node.value = value;
+            setXMLDirty();
             return;
         }
     }
     AeNode node = {key, value};
     data->elements.push_back(node);
+    invalidateXMLIndex();
 }
 
 void AeXMLNode::removeXMLNode(AeXMLNode *node) {
@@ -87,6 +110,7 @@ void AeXMLNode::removeXMLNode(AeXMLNode *node) {
         if (data->nexts[i] == node) {
             data->nexts.erase(data->nexts.begin() + i);
             delete node;
+            invalidateXMLIndex();
             return;
         }
     }
@@ -96,65 +120,12 @@ void AeXMLNode::removeXMLNode(AeXMLNode *node) {
 }
 
 void AeXMLNode::outputXML(const char *path, int level, std::string *content) {
-    std::string s;
-
-    if (!content) {
-        content = &s;
-    }
-    std::string space = "";
-    for (int i = 0; i < level; ++i) {
-        space += "    ";
-    }
-    if (data->version.length()) {
-        *content += "<?";
-        *content += data->version;
-        *content += "?>\n";
-    }
-    for (const auto &s : data->comments) {
-        *content += space;
-        *content += "<!--";
-        *content += s;
-        *content += "-->\n";
-    }
-
-    *content += space;
-    *content += "<";
-    *content += data->key;
-    for (const auto &node : data->elements) {
-        *content += " ";
-        *content += node.key;
-        *content += "=\"";
-        *content += node.value;
-        *content += "\"";
-    }
-    if (!data->nexts.size()) {
-        if (data->value.length()) {
-            *content += ">";
-            *content += data->value;
-            *content += "</";
-            *content += data->key;
-            *content += ">\n";
-        } else {
-            *content += " />\n";
-        }
-    } else {
-        *content += ">\n";
-        for (const auto &node : data->nexts) {
-            node->outputXML(nullptr, level + 1, content);
-        }
-
-        *content += space;
-        *content += "</";
-        *content += data->key;
-        *content += ">\n";
-    }
     if (path) {
-        std::ofstream ofile;
-        ofile.open(path);
-
-        ofile << s << std::endl;
-        ofile.close();
+        AeXMLWriter writer;
+        writer.save(this, path);
+        return;
     }
+    if (content) AeXMLWriter::writeXMLNode(this, level, *content);
 }
 
 AeJSONNode::AeJSONNode() : data(new AeJSON) {}
@@ -377,7 +348,7 @@ bool AeJSONNode::getJSONbValue(bool *output, int length, ...) {
     const char **keys1 = new const char *[length];
     for (int i = 0; i < length; ++i) keys1[i] = va_arg(keys, const char *);
 
-    const char *ret = getJSONValue(keys1, length + 1);
+    const char *ret = getJSONValue(keys1, length);
     va_end(keys);
     delete[] keys1;
 
@@ -393,7 +364,7 @@ bool AeJSONNode::getJSONiValue(int *output, int length, ...) {
     const char **keys1 = new const char *[length];
     for (int i = 0; i < length; ++i) keys1[i] = va_arg(keys, const char *);
 
-    const char *ret = getJSONValue(keys1, length + 1);
+    const char *ret = getJSONValue(keys1, length);
     va_end(keys);
     delete[] keys1;
 
@@ -409,7 +380,7 @@ bool AeJSONNode::getJSONfValue(float *output, int length, ...) {
     const char **keys1 = new const char *[length];
     for (int i = 0; i < length; ++i) keys1[i] = va_arg(keys, const char *);
 
-    const char *ret = getJSONValue(keys1, length + 1);
+    const char *ret = getJSONValue(keys1, length);
     va_end(keys);
     delete[] keys1;
 
@@ -426,6 +397,10 @@ AeCommonManager::~AeCommonManager() {
         ++it;
     }
     astXMLs.clear();
+    for (auto &snapshot : astXMLSnapshots) delete snapshot.second;
+    astXMLSnapshots.clear();
+    for (auto &writer : astXMLWriters) delete writer.second;
+    astXMLWriters.clear();
 
     std::map<std::string, AeJSONNode *>::iterator it1 = astJSONs.begin();
     while (it1 != astJSONs.end()) {
@@ -433,6 +408,11 @@ AeCommonManager::~AeCommonManager() {
         ++it1;
     }
     astJSONs.clear();
+
+    for (auto &document : astXMLDocuments) delete document.second;
+    astXMLDocuments.clear();
+    for (auto &document : astJSONDocuments) delete document.second;
+    astJSONDocuments.clear();
 }
 
 void AeCommonManager::removeXML(std::string path) {
@@ -442,6 +422,27 @@ void AeCommonManager::removeXML(std::string path) {
         delete it->second;
         astXMLs.erase(it);
     }
+    std::map<std::string, AeMappedFile *>::iterator snapshot = astXMLSnapshots.find(path);
+    if (snapshot != astXMLSnapshots.end()) {
+        delete snapshot->second;
+        astXMLSnapshots.erase(snapshot);
+    }
+    std::map<std::string, AeXMLWriter *>::iterator writer = astXMLWriters.find(path);
+    if (writer != astXMLWriters.end()) {
+        delete writer->second;
+        astXMLWriters.erase(writer);
+    }
+}
+
+bool AeCommonManager::saveXML(const char *_filePath) {
+    std::map<std::string, AeXMLNode *>::iterator it = astXMLs.find(_filePath);
+    if (it == astXMLs.end() || it->second == nullptr) return false;
+
+    AeXMLWriter *&writer = astXMLWriters[_filePath];
+    if (writer == nullptr) writer = new AeXMLWriter();
+    if (!writer->save(it->second, _filePath)) return false;
+    AeXMLSnapshot::save(it->second, _filePath);  // or the next start parses the file again
+    return true;
 }
 
 std::vector<char> AeCommonManager::loadFile(const char *_filePath) {
@@ -481,11 +482,45 @@ AeXMLNode *AeCommonManager::getXML(const char *_filePath) {
     // std::ifstream file(_filePath, std::ios::ate | std::ios::binary);
     // if (!file.is_open()) return nullptr;
 
-    std::vector<char> buffer = loadFile(_filePath);
-
-    int index = 0;
-    AeXMLNode *head = COM_ENCODE.decodeXML(buffer.data(), index);
+    AeMappedFile *snapshot = new AeMappedFile();
+    AeXMLNode *head = AeXMLSnapshot::load(_filePath, *snapshot);
+    if (head) {
+        astXMLSnapshots[_filePath] = snapshot;
+    } else {
+        delete snapshot;
+        AeXMLReader reader;
+        bool bOpen = reader.open(_filePath);
+        ASSERT(bOpen, _filePath)
+        head = bOpen ? reader.readXMLDocument() : nullptr;
+        if (head) AeXMLSnapshot::save(head, _filePath);  // before anything edits the tree
+    }
     astXMLs[_filePath] = head;
 
     return head;
 }
+
+AeXMLDocument *AeCommonManager::getXMLDocument(const char *_filePath) {
+    std::map<std::string, AeXMLDocument *>::iterator it = astXMLDocuments.find(_filePath);
+    if (it != astXMLDocuments.end()) return it->second;
+
+    AeXMLDocument *document = new AeXMLDocument();
+    if (!document->open(_filePath)) {
+        delete document;
+        return nullptr;
+    }
+    astXMLDocuments[_filePath] = document;
+    return document;
+}
+
+AeJSONDocument *AeCommonManager::getJSONDocument(const char *_filePath) {
+    std::map<std::string, AeJSONDocument *>::iterator it = astJSONDocuments.find(_filePath);
+    if (it != astJSONDocuments.end()) return it->second;
+
+    AeJSONDocument *document = new AeJSONDocument();
+    if (!document->open(_filePath)) {
+        delete document;
+        return nullptr;
+    }
+    astJSONDocuments[_filePath] = document;
+    return document;
+}
@@ -77,8 +77,10 @@ float AeMath::fastSqrt(float _number) {
 
 QeMatrix4x4f AeMath::lookAt(AeArray<float, 3> &_pos, AeArray<float, 3> &_center, AeArray<float, 3> &_up) {
     QeMatrix4x4f _rtn;
-    AeArray<float, 3> _face = normalize(_center - _pos);
-    AeArray<float, 3> _surface = normalize(cross(_face, _up));
+    AeArray<float, 3> _face = _center - _pos;
+    _face = normalize(_face);
+    AeArray<float, 3> _surface = cross(_face, _up);
+    _surface = normalize(_surface);
     AeArray<float, 3> _up1 = cross(_surface, _face);
 
     _rtn._00 = _surface.x;
@@ -129,7 +131,8 @@ AeArray<float, 3> AeMath::move(AeArray<float, 3> &_position, AeArray<float, 3> &
     if (_addMove.z) {
         _move = _face * _addMove.z;
     } else {
-        AeArray<float, 3> _surface = normalize(cross(_face, _up));
+        AeArray<float, 3> _surface = cross(_face, _up);
+        _surface = normalize(_surface);
         // left
         if (_addMove.x) {
             _move = _surface * _addMove.x;
@@ -834,7 +837,8 @@ AeArray<float, 3> AeMath::revolute_axis(AeArray<float, 3> &_position, AeArray<fl
             mat *= rotate_axis(_addRevolute.x, _axis);
         } else {
             AeArray<float, 3> _axis{0.f, 1.f, 0.f};
-            AeArray<float, 3> _surface = normalize(cross(_axis, vecN));
+            AeArray<float, 3> _surface = cross(_axis, vecN);
+            _surface = normalize(_surface);
             if (vecN.z < 0) _surface *= -1;
             mat *= rotate_axis(_addRevolute.x, _surface);
         }
@@ -846,7 +850,8 @@ AeArray<float, 3> AeMath::revolute_axis(AeArray<float, 3> &_position, AeArray<fl
             mat *= rotate_axis(_addRevolute.y, _axis);
         } else {
             AeArray<float, 3> _axis{0.f, 0.f, 1.f};
-            AeArray<float, 3> _surface = normalize(cross(_axis, vecN));
+            AeArray<float, 3> _surface = cross(_axis, vecN);
+            _surface = normalize(_surface);
             if (vecN.y < 0) _surface *= -1;
             mat *= rotate_axis(_addRevolute.y, _surface);
         }
@@ -858,7 +863,8 @@ AeArray<float, 3> AeMath::revolute_axis(AeArray<float, 3> &_position, AeArray<fl
             mat *= rotate_axis(_addRevolute.z, _axis);
         } else {
             AeArray<float, 3> _axis{1.f, 0.f, 0.f};
-            AeArray<float, 3> _surface = normalize(cross(_axis, vecN));
+            AeArray<float, 3> _surface = cross(_axis, vecN);
+            _surface = normalize(_surface);
             if (vecN.z < 0) _surface *= -1;
             // if ((vecN.x == 0 && vecN.y < 0) || (vecN.x < 0 && vecN.y == 0) ||
             // (vecN.x < 0 && vecN.y < 0)|| (vecN.x < 0 && vecN.y > 0)) _surface *= -1;
@@ -945,10 +951,12 @@ QeMatrix4x4f AeMath::getTransformMatrix(AeArray<float, 3> &_translate, AeArray<f
 
     float dis = 1.0f;
     if (bFixSize) {
-        dis = length(camera_world_position - _translate);
+        AeArray<float, 3> distance = camera_world_position - _translate;
+        dis = length(distance);
         dis = dis < 0.1f ? 0.01f : dis / 10;
     }
-    mat *= scale(_scale * dis);
+    AeArray<float, 3> scaled = _scale * dis;
+    mat *= scale(scaled);
     return mat;
 }
 
@@ -0,0 +1,297 @@
+#include "common.h"
+#include <cerrno>
+#include <filesystem>
+#include <unordered_map>
+
+// Image layout: this header, then the node, element, comment and number tables, then the strings. Every table starts
+// on a multiple of 4 and every reference is an offset from the start of the image or, for AeXMLNumbers, from the
+// record.
+struct QeXMLSnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t imageSize;
+    uint32_t nodeCount;
+    uint32_t nodeOffset;
+    uint32_t elementCount;
+    uint32_t elementOffset;
+    uint32_t commentCount;
+    uint32_t commentOffset;
+    uint32_t numberCount;
+    uint32_t numberOffset;
+    uint32_t stringSize;
+    uint32_t stringOffset;
+};
+static_assert(sizeof(QeXMLSnapshotHeader) == 64, "snapshot header size");
+
+struct QeXMLSnapshotString {
+    uint32_t offset;  // in the string table, terminated
+    uint32_t size;
+};
+
+struct QeXMLSnapshotNode {
+    QeXMLSnapshotString key;
+    QeXMLSnapshotString value;
+    QeXMLSnapshotString version;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t firstElement;
+    uint32_t elementCount;
+    uint32_t firstComment;
+    uint32_t commentCount;
+    uint32_t firstNumber;
+    uint32_t numberCount;
+};
+
+struct QeXMLSnapshotElement {
+    QeXMLSnapshotString key;
+    QeXMLSnapshotString value;
+};
+
+const char XML_SNAPSHOT_MAGIC[4] = {'A', 'E', 'X', 'S'};
+const char XML_SNAPSHOT_EXTENSION[] = ".snapshot";
+
+uint64_t hashXMLSnapshot(const void *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;  // FNV-1a
+    return hash;
+}
+
+bool AeXMLSnapshot::hashSource(const char *path, uint64_t &hash) {
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(path, error);
+    if (error) return false;
+    int64_t time = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    if (error) return false;
+    const uint32_t version = VERSION;
+    hash = hashXMLSnapshot(&version, sizeof(version));
+    hash = hashXMLSnapshot(&size, sizeof(size), hash);
+    hash = hashXMLSnapshot(&time, sizeof(time), hash);
+    return true;
+}
+
+// A value ConvertTo reads as strtol and strtof do: 1 to 4 decimal numbers in the range of a float, split by single
+// spaces.
+bool parseXMLSnapshotNumbers(const std::string &value, AeXMLNumbers &numbers) {
+    numbers.count = 0;
+    numbers.bInteger = 1;
+    const char *p = value.c_str();
+    while (true) {
+        const char *begin = p;
+        if (*p == '-') ++p;
+        const char *digits = p;
+        while (*p >= '0' && *p <= '9') ++p;
+        if (p == digits) return false;
+        bool bInteger = p - digits <= 9;
+        if (*p == '.') {
+            bInteger = false;
+            const char *fraction = ++p;
+            while (*p >= '0' && *p <= '9') ++p;
+            if (p == fraction) return false;
+        }
+        if (*p == 'e' || *p == 'E') {
+            bInteger = false;
+            if (p[1] == '+' || p[1] == '-') ++p;
+            const char *exponent = ++p;
+            while (*p >= '0' && *p <= '9') ++p;
+            if (p == exponent) return false;
+        }
+        if ((*p != ' ' && *p != '\0') || numbers.count == 4) return false;
+
+        errno = 0;
+        numbers.floats[numbers.count] = strtof(begin, nullptr);
+        if (errno == ERANGE) return false;  // ConvertTo and strtof disagree out of range
+        numbers.ints[numbers.count] = bInteger ? int32_t(strtol(begin, nullptr, 10)) : 0;
+        numbers.bInteger = numbers.bInteger && bInteger;
+        ++numbers.count;
+        if (*p == '\0') return true;
+        if (*++p == '\0') return false;  // a trailing space
+    }
+}
+
+void AeXMLSnapshot::compile(AeXMLNode *root, uint64_t sourceHash, std::vector<char> &image) {
+    std::vector<AeXMLNode *> order = {root};
+    std::vector<QeXMLSnapshotNode> nodes;
+    std::vector<QeXMLSnapshotElement> elements;
+    std::vector<QeXMLSnapshotString> comments;
+    std::vector<AeXMLNumbers> numbers;
+    std::vector<uint32_t> numberStrings;  // string offset of each number record
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> stringOffsets;
+    auto addString = [&](const std::string &s) {
+        auto it = stringOffsets.emplace(s, uint32_t(strings.size()));
+        if (it.second) strings.append(s.c_str(), s.size() + 1);
+        return QeXMLSnapshotString{it.first->second, uint32_t(s.size())};
+    };
+    auto addNumbers = [&](const std::string &value, uint32_t slot) {
+        AeXMLNumbers record = {};
+        if (slot > UINT16_MAX || !parseXMLSnapshotNumbers(value, record)) return;
+        record.slot = uint16_t(slot);
+        record.textSize = uint32_t(value.size());
+        numbers.push_back(record);
+        numberStrings.push_back(addString(value).offset);
+    };
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        const AeXMLData &data = *order[i]->data;
+        QeXMLSnapshotNode node = {};
+        node.key = addString(data.key);
+        node.value = addString(data.value);
+        node.version = addString(data.version);
+        node.firstChild = uint32_t(order.size());
+        node.childCount = uint32_t(data.nexts.size());
+        order.insert(order.end(), data.nexts.begin(), data.nexts.end());
+        node.firstElement = uint32_t(elements.size());
+        node.elementCount = uint32_t(data.elements.size());
+        for (const AeNode &element : data.elements) elements.push_back({addString(element.key), addString(element.value)});
+        node.firstComment = uint32_t(comments.size());
+        node.commentCount = uint32_t(data.comments.size());
+        for (const std::string &comment : data.comments) comments.push_back(addString(comment));
+        node.firstNumber = uint32_t(numbers.size());
+        addNumbers(data.value, 0);
+        for (size_t j = 0; j < data.elements.size(); ++j) addNumbers(data.elements[j].value, uint32_t(j + 1));
+        node.numberCount = uint32_t(numbers.size()) - node.firstNumber;
+        nodes.push_back(node);
+    }
+
+    QeXMLSnapshotHeader header = {};
+    memcpy(header.magic, XML_SNAPSHOT_MAGIC, 4);
+    header.version = VERSION;
+    header.sourceHash = sourceHash;
+    header.nodeCount = uint32_t(nodes.size());
+    header.nodeOffset = sizeof(header);
+    header.elementCount = uint32_t(elements.size());
+    header.elementOffset = header.nodeOffset + header.nodeCount * sizeof(QeXMLSnapshotNode);
+    header.commentCount = uint32_t(comments.size());
+    header.commentOffset = header.elementOffset + header.elementCount * sizeof(QeXMLSnapshotElement);
+    header.numberCount = uint32_t(numbers.size());
+    header.numberOffset = header.commentOffset + header.commentCount * sizeof(QeXMLSnapshotString);
+    header.stringSize = uint32_t(strings.size());
+    header.stringOffset = header.numberOffset + header.numberCount * sizeof(AeXMLNumbers);
+    header.imageSize = header.stringOffset + header.stringSize;
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        const size_t record = header.numberOffset + i * sizeof(AeXMLNumbers);
+        numbers[i].text = int32_t(header.stringOffset + numberStrings[i] - record);
+    }
+
+    image.resize(size_t(header.imageSize));
+    char *out = image.data();
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + header.nodeOffset, nodes.data(), nodes.size() * sizeof(QeXMLSnapshotNode));
+    memcpy(out + header.elementOffset, elements.data(), elements.size() * sizeof(QeXMLSnapshotElement));
+    memcpy(out + header.commentOffset, comments.data(), comments.size() * sizeof(QeXMLSnapshotString));
+    memcpy(out + header.numberOffset, numbers.data(), numbers.size() * sizeof(AeXMLNumbers));
+    memcpy(out + header.stringOffset, strings.data(), strings.size());
+}
+
+bool checkXMLSnapshotTable(const QeXMLSnapshotHeader &header, uint32_t offset, uint32_t count, size_t recordSize) {
+    return offset % 4 == 0 && offset >= sizeof(header) && offset <= header.imageSize &&
+           count <= (header.imageSize - offset) / recordSize;
+}
+
+AeXMLNode *AeXMLSnapshot::decode(const unsigned char *image, size_t size, uint64_t sourceHash) {
+    QeXMLSnapshotHeader header;
+    if (size < sizeof(header)) return nullptr;
+    memcpy(&header, image, sizeof(header));
+    if (memcmp(header.magic, XML_SNAPSHOT_MAGIC, 4) != 0 || header.version != VERSION || header.sourceHash != sourceHash ||
+        header.imageSize != size || header.nodeCount == 0 ||
+        !checkXMLSnapshotTable(header, header.nodeOffset, header.nodeCount, sizeof(QeXMLSnapshotNode)) ||
+        !checkXMLSnapshotTable(header, header.elementOffset, header.elementCount, sizeof(QeXMLSnapshotElement)) ||
+        !checkXMLSnapshotTable(header, header.commentOffset, header.commentCount, sizeof(QeXMLSnapshotString)) ||
+        !checkXMLSnapshotTable(header, header.numberOffset, header.numberCount, sizeof(AeXMLNumbers)) ||
+        !checkXMLSnapshotTable(header, header.stringOffset, header.stringSize, 1))
+        return nullptr;
+
+    // Every reference is checked before the first node exists.
+    const QeXMLSnapshotNode *nodes = (const QeXMLSnapshotNode *)(image + header.nodeOffset);
+    const QeXMLSnapshotElement *elements = (const QeXMLSnapshotElement *)(image + header.elementOffset);
+    const QeXMLSnapshotString *comments = (const QeXMLSnapshotString *)(image + header.commentOffset);
+    const AeXMLNumbers *numbers = (const AeXMLNumbers *)(image + header.numberOffset);
+    const char *strings = (const char *)image + header.stringOffset;
+    auto checkString = [&](const QeXMLSnapshotString &s) {
+        return s.offset < header.stringSize && s.size < header.stringSize - s.offset;
+    };
+    auto checkRange = [](uint32_t first, uint32_t count, uint32_t total) { return first <= total && count <= total - first; };
+    for (uint32_t i = 0; i < header.nodeCount; ++i) {
+        const QeXMLSnapshotNode &node = nodes[i];
+        if (!checkString(node.key) || !checkString(node.value) || !checkString(node.version) || node.firstChild <= i ||
+            !checkRange(node.firstChild, node.childCount, header.nodeCount) ||
+            !checkRange(node.firstElement, node.elementCount, header.elementCount) ||
+            !checkRange(node.firstComment, node.commentCount, header.commentCount) ||
+            !checkRange(node.firstNumber, node.numberCount, header.numberCount))
+            return nullptr;
+    }
+    for (uint32_t i = 0; i < header.elementCount; ++i)
+        if (!checkString(elements[i].key) || !checkString(elements[i].value)) return nullptr;
+    for (uint32_t i = 0; i < header.commentCount; ++i)
+        if (!checkString(comments[i])) return nullptr;
+    for (uint32_t i = 0; i < header.numberCount; ++i) {
+        const int64_t text = int64_t(header.numberOffset) + i * sizeof(AeXMLNumbers) + numbers[i].text;
+        if (text < header.stringOffset || uint64_t(text) + numbers[i].textSize > header.imageSize || numbers[i].count > 4)
+            return nullptr;
+    }
+
+    std::vector<AeXMLNode *> tree(header.nodeCount);
+    for (AeXMLNode *&node : tree) node = new AeXMLNode();
+    for (uint32_t i = 0; i < header.nodeCount; ++i) {
+        const QeXMLSnapshotNode &node = nodes[i];
+        AeXMLData &data = *tree[i]->data;
+        data.key.assign(strings + node.key.offset, node.key.size);
+        data.value.assign(strings + node.value.offset, node.value.size);
+        data.version.assign(strings + node.version.offset, node.version.size);
+        data.comments.reserve(node.commentCount);
+        for (uint32_t j = 0; j < node.commentCount; ++j) {
+            const QeXMLSnapshotString &comment = comments[node.firstComment + j];
+            data.comments.emplace_back(strings + comment.offset, comment.size);
+        }
+        data.elements.resize(node.elementCount);
+        for (uint32_t j = 0; j < node.elementCount; ++j) {
+            const QeXMLSnapshotElement &element = elements[node.firstElement + j];
+            data.elements[j].key.assign(strings + element.key.offset, element.key.size);
+            data.elements[j].value.assign(strings + element.value.offset, element.value.size);
+        }
+        data.nexts.assign(tree.begin() + node.firstChild, tree.begin() + node.firstChild + node.childCount);
+        for (AeXMLNode *child : data.nexts) child->data->parent = tree[i];
+        data.numbers = node.numberCount ? numbers + node.firstNumber : nullptr;
+        data.numberCount = node.numberCount;
+    }
+    tree[0]->buildXMLTreeIndex();
+    return tree[0];
+}
+
+bool AeXMLSnapshot::save(AeXMLNode *root, const char *sourcePath) {
+    uint64_t sourceHash;
+    if (!root || !hashSource(sourcePath, sourceHash)) return false;
+    std::vector<char> image;
+    compile(root, sourceHash, image);
+
+    std::string path = std::string(sourcePath) + XML_SNAPSHOT_EXTENSION;
+    std::string temporary = path + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(image.data(), image.size());
+        if (!file.good()) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    // a reader only ever sees a complete image
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+AeXMLNode *AeXMLSnapshot::load(const char *sourcePath, AeMappedFile &file) {
+    uint64_t sourceHash;
+    if (!hashSource(sourcePath, sourceHash)) return nullptr;
+    if (!file.open((std::string(sourcePath) + XML_SNAPSHOT_EXTENSION).c_str())) return nullptr;
+    AeXMLNode *root = decode(file.data(), file.size(), sourceHash);
+    if (!root) file.close();
+    return root;
+}
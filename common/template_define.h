@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sstream>
+#include <cstdlib>
 
 template <class T, int N>
 AeArray<T, N>::AeArray() {
@@ -232,7 +233,7 @@ AeArray<T, N> AeArray<T, N>::operator/(const T2 &other) {
 
 template <class T>
 int AeLib::findElementFromVector(std::vector<T> &vec, T element) {
-    std::vector<T>::iterator it = std::find(vec.begin(), vec.end(), element);
+    typename std::vector<T>::iterator it = std::find(vec.begin(), vec.end(), element);
     if (it == vec.end()) return INDEX_NONE;
     return int(it - vec.begin());
 }
@@ -245,6 +246,100 @@ bool AeLib::eraseElementFromVector(std::vector<T> &vec, T element) {
     return true;
 }
 
+template <bool bMSB>
+AeBitStream<bMSB>::AeBitStream(const unsigned char *data, size_t size) {
+    set(data, size);
+}
+
+template <bool bMSB>
+void AeBitStream<bMSB>::set(const unsigned char *data_, size_t size_) {
+    data = data_;
+    size = size_;
+    buffer = 0;
+    bitCount = 0;
+    bytePosition = 0;
+}
+
+template <bool bMSB>
+void AeBitStream<bMSB>::refill() {
+    if (bytePosition + 8 <= size) {
+        // Load 8 bytes at once; the bytes that don't fit are loaded again by the next refill.
+        uint64_t bits = 0;
+        memcpy(&bits, data + bytePosition, 8);  // little-endian
+        if constexpr (bMSB) {
+#ifdef _MSC_VER
+            bits = _byteswap_uint64(bits);
+#else
+            bits = __builtin_bswap64(bits);
+#endif
+            buffer |= bits >> bitCount;
+        } else
+            buffer |= bits << bitCount;
+        bytePosition += (63 - bitCount) >> 3;
+        bitCount |= 56;
+        return;
+    }
+    while (bitCount <= 56) {
+        uint64_t byte = bytePosition < size ? data[bytePosition] : 0;
+        if constexpr (bMSB)
+            buffer |= byte << (56 - bitCount);
+        else
+            buffer |= byte << bitCount;
+        ++bytePosition;
+        bitCount += 8;
+    }
+}
+
+template <bool bMSB>
+unsigned int AeBitStream<bMSB>::peek(unsigned int readCount) {
+    if (readCount == 0) return 0;
+    if (bitCount < readCount) refill();
+    if constexpr (bMSB)
+        return (unsigned int)(buffer >> (64 - readCount));
+    else
+        return (unsigned int)(buffer & ((uint64_t(1) << readCount) - 1));
+}
+
+template <bool bMSB>
+void AeBitStream<bMSB>::consume(unsigned int readCount) {
+    if (bitCount < readCount) refill();
+    if constexpr (bMSB)
+        buffer <<= readCount;
+    else
+        buffer >>= readCount;
+    bitCount -= readCount;
+}
+
+template <bool bMSB>
+unsigned int AeBitStream<bMSB>::read(unsigned int readCount) {
+    unsigned int ret = peek(readCount);
+    consume(readCount);
+    return ret;
+}
+
+template <bool bMSB>
+void AeBitStream<bMSB>::alignToByte() {
+    consume(bitCount & 7);
+}
+
+template <bool bMSB>
+size_t AeBitStream<bMSB>::getBitPosition() {
+    return bytePosition * 8 - bitCount;
+}
+
+template <bool bMSB>
+void AeBitStream<bMSB>::setBitPosition(size_t bitPosition) {
+    buffer = 0;
+    bitCount = 0;
+    bytePosition = bitPosition >> 3;
+    consume(bitPosition & 7);
+}
+
+template <bool bMSB>
+bool AeBitStream<bMSB>::isOverrun() {
+    return getBitPosition() > size * 8;
+}
+
 template <class T>
 T AeCommonEncode::ConvertTo(const std::string &str) {
     if constexpr (std::is_arithmetic<T>::value) {
@@ -304,29 +399,54 @@ T AeXMLNode::getXMLValue(const char *key) {
 
 template <class T>
 AeXMLNode *AeXMLNode::getXMLValue(T &value, const char *key) {
-    std::memset((void *)&value, 0, sizeof value);
-    auto keys = COM_ENCODE.split<std::string>(key, ".");
-    std::vector<std::string> keys1 = keys;
-    keys1.pop_back();
-    AeXMLNode *current = getXMLNode(keys1);
-    if (!current) return nullptr;
-
-    std::string final_key = keys.back();
-
-    for (const auto &node : current->data->elements) {
-        if (final_key.compare(node.key) == 0) {
-            value = COM_ENCODE.ConvertTo<T>(node.value);
-            return current;
-        }
-    }
+    return readXMLValue<T>(value, key);
+}
 
-    current = getXMLNode(final_key.c_str());
-    if (!current) return nullptr;
-    if (final_key.compare(current->data->key.c_str()) == 0) {
-        value = COM_ENCODE.ConvertTo<T>(current->data->value);
-        return current;
-    }
-    return nullptr;
+template <class T>
+T AeXMLNode::getXMLValue(const AeXMLPath &path) {
+    T ret;
+    getXMLValue<T>(ret, path);
+    return ret;
+}
+
+template <class T>
+bool AeXMLNumbers::getXMLNumbers(T *values, int n) const {
+    n = std::min(n, int(count));
+    if constexpr (std::is_same<T, float>::value) {
+        for (int i = 0; i < n; ++i) values[i] = floats[i];
+        return true;
+    } else if constexpr (std::is_same<T, int>::value || std::is_enum<T>::value) {
+        if (!bInteger) return false;
+        for (int i = 0; i < n; ++i) values[i] = static_cast<T>(ints[i]);
+        return true;
+    } else if constexpr (std::is_same<T, bool>::value) {
+        if (!bInteger) return false;
+        for (int i = 0; i < n; ++i)
+            if (ints[i] != 0 && ints[i] != 1) return false;
+        for (int i = 0; i < n; ++i) values[i] = ints[i] != 0;
+        return true;
+    }
+    return false;
+}
+
+template <class T>
+AeXMLNode *AeXMLNode::getXMLValue(T &value, const AeXMLPath &path) {
+    return readXMLValue<T>(value, path);
+}
+
+template <class T, class K>
+AeXMLNode *AeXMLNode::readXMLValue(T &value, const K &key) {
+    if constexpr (std::is_trivially_copyable<T>::value)
+        std::memset((void *)&value, 0, sizeof value);
+    else
+        value = T();
+    AeXMLNode *owner;
+    const AeXMLNumbers *numbers;
+    const std::string *text = findXMLValue(key, &owner, &numbers);
+    if (!text) return nullptr;
+    if (numbers && numbers->getXMLNumbers(&value, 1)) return owner;
+    value = COM_ENCODE.ConvertTo<T>(*text);
+    return owner;
 }
 
 template <class T, int N>
@@ -338,13 +458,43 @@ AeArray<T, N> AeXMLNode::getXMLValues(const char *key) {
 
 template <class T, int N>
 AeXMLNode *AeXMLNode::getXMLValues(AeArray<T, N> &value, const char *key) {
-    std::string str_values;
-    AeXMLNode *ret = getXMLValue<std::string>(str_values, key);
-    auto values = COM_ENCODE.split<T>(str_values, " ");
+    return readXMLValues<T, N>(value, key);
+}
+
+template <class T, int N>
+AeArray<T, N> AeXMLNode::getXMLValues(const AeXMLPath &path) {
+    AeArray<T, N> ret;
+    getXMLValues<T, N>(ret, path);
+    return ret;
+}
+
+template <class T, int N>
+AeXMLNode *AeXMLNode::getXMLValues(AeArray<T, N> &value, const AeXMLPath &path) {
+    return readXMLValues<T, N>(value, path);
+}
+
+template <class T, int N, class K>
+AeXMLNode *AeXMLNode::readXMLValues(AeArray<T, N> &value, const K &key) {
+    AeXMLNode *owner;
+    const AeXMLNumbers *numbers;
+    const std::string *text = findXMLValue(key, &owner, &numbers);
+    if (numbers && numbers->getXMLNumbers(value.elements, N)) return owner;
+    auto values = COM_ENCODE.split<T>(text ? *text : std::string(), " ");
     for (int i = 0; i < N && i < values.size(); ++i) {
         value.elements[i] = values[i];
     }
-    return ret;
+    return text ? owner : nullptr;
+}
+
+template <class T>
+T AeXMLElement::getXMLValue(std::string_view path) {
+    static_assert(!std::is_same<T, const char *>::value, "the text of a view is not terminated");
+    std::string_view value;
+    getXMLValue(value, path);
+    if constexpr (std::is_same<T, std::string_view>::value)
+        return value;
+    else
+        return COM_ENCODE.ConvertTo<T>(std::string(value));
 }
 
 template <class T>
@@ -375,12 +525,12 @@ AeArray<T, N> AeMath::randoms(T start, T range) {
 
     if constexpr (std::is_floating_point<T>::value) {
         std::uniform_real_distribution<T> dis(start, start + range);
-        for (int i = 0; i < size; ++i) ret[i] = dis(gen);
+        for (int i = 0; i < N; ++i) ret[i] = dis(gen);
         return ret;
     }
     else if constexpr (std::is_integral<T>::value) {
         std::uniform_int_distribution<T> dis(start, start + range);
-        for (int i = 0; i < size; ++i) ret[i] = dis(gen);
+        for (int i = 0; i < N; ++i) ret[i] = dis(gen);
         return ret;
     }
     ASSERT(0, "random T NOT supported");
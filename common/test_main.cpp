@@ -0,0 +1,1508 @@
+#include "common.h"
+#include <filesystem>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <new>
+
+// Codec benchmark for lib_common. Decodes every image under a texture directory, every XML file directly in a data
+// directory and every glTF file directly in a model directory, plus a synthetic corpus generated here, and reports
+// time, throughput, allocations and peak memory per codec stage. With --save it writes a hash of every decoded
+// output; with --verify it compares against such a file and fails on any difference.
+//
+//   testCommon [--textures dir] [--xml dir] [--models dir] [--repeat n] [--save file] [--verify file] [--verbose]
+//
+// Run from output/. common/codec_reference.txt holds the hashes of the current decoders.
+
+// Allocation counting. The executable's operator new replaces the default one for the whole process on Linux, so
+// this also sees the allocations made inside lib_common; a Windows DLL keeps its own.
+struct QeAllocationStats {
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> live{0};
+    std::atomic<size_t> peak{0};
+};
+QeAllocationStats allocationStats;
+const size_t ALLOCATION_HEADER = 16;  // keeps the block size, and the 16-byte alignment of malloc
+
+void *operator new(size_t size) {
+    unsigned char *block = (unsigned char *)malloc(size + ALLOCATION_HEADER);
+    if (block == nullptr) throw std::bad_alloc();
+    *(size_t *)block = size;
+    ++allocationStats.count;
+    allocationStats.bytes += size;
+    size_t live = allocationStats.live += size;
+    size_t peak = allocationStats.peak.load();
+    while (live > peak && !allocationStats.peak.compare_exchange_weak(peak, live)) {
+    }
+    return block + ALLOCATION_HEADER;
+}
+void operator delete(void *p) noexcept {
+    if (p == nullptr) return;
+    unsigned char *block = (unsigned char *)p - ALLOCATION_HEADER;
+    allocationStats.live -= *(size_t *)block;
+    free(block);
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+
+// Peak resident set size in KB since the last resetPeakRSS. Linux only, 0 elsewhere.
+void resetPeakRSS() {
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if (file == nullptr) return;
+    fputs("5", file);
+    fclose(file);
+#endif
+}
+
+size_t getPeakRSS() {
+    size_t kb = 0;
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == nullptr) return 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "VmHWM:", 6) == 0) {
+            kb = strtoull(line + 6, nullptr, 10);
+            break;
+        }
+    }
+    fclose(file);
+#endif
+    return kb;
+}
+
+uint64_t hashBytes(const unsigned char *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ data[i]) * 1099511628211ull;  // FNV-1a
+    return hash;
+}
+
+unsigned int readBigEndian(const unsigned char *p) {
+    return (unsigned int)p[0] << 24 | (unsigned int)p[1] << 16 | (unsigned int)p[2] << 8 | (unsigned int)p[3];
+}
+
+void writeBigEndian(std::vector<unsigned char> &out, unsigned int value) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back((unsigned char)(value >> shift));
+}
+
+void writeLittleEndian(std::vector<unsigned char> &out, unsigned int value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back((unsigned char)(value >> (i * 8)));
+}
+
+// Synthetic images -------------------------------------------------------------------------------------------------
+// The writers only need to produce valid files for the decoders, so they keep to the simplest form of each format:
+// fixed-code Deflate for PNG, baseline JPEG with Huffman tables built for the image, uncompressed BMP.
+
+// Gradients with some noise, so the files compress like textures rather than like flat colour or pure noise.
+std::vector<unsigned char> makeSyntheticPixels(int width, int height, int channels, uint32_t seed) {
+    std::vector<unsigned char> pixels(size_t(width) * height * channels);
+    uint32_t state = seed * 2654435761u + 1;
+    size_t index = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            for (int c = 0; c < channels; ++c, ++index) {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                int value = (x * 255 / width * (c + 1) + y * 255 / height * (4 - c)) / 5 + int(state % 17) - 8;
+                if (c == 3) value = 255 - (x + y) % 64;  // alpha
+                pixels[index] = (unsigned char)std::min(255, std::max(0, value));
+            }
+        }
+    }
+    return pixels;
+}
+
+// Deflate and zlib from the least significant bit, Huffman codes from their most significant bit.
+struct QeDeflateWriter {
+    std::vector<unsigned char> out;
+    uint32_t buffer = 0;
+    int count = 0;
+
+    void write(uint32_t bits, int length) {
+        buffer |= bits << count;
+        count += length;
+        while (count >= 8) {
+            out.push_back((unsigned char)buffer);
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+    void writeCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) reversed = reversed << 1 | ((code >> i) & 1);
+        write(reversed, length);
+    }
+    void writeLiteral(unsigned int symbol) {  // fixed literal/length code, RFC 1951 3.2.6
+        if (symbol < 144)
+            writeCode(0x30 + symbol, 8);
+        else if (symbol < 256)
+            writeCode(0x190 + symbol - 144, 9);
+        else if (symbol < 280)
+            writeCode(symbol - 256, 7);
+        else
+            writeCode(0xC0 + symbol - 280, 8);
+    }
+    void flush() {
+        if (count > 0) out.push_back((unsigned char)buffer);
+        buffer = 0;
+        count = 0;
+    }
+};
+
+const unsigned short int DEFLATE_LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const unsigned short int DEFLATE_DISTANCE_BASE[30] = {1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+                                                      33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+                                                      1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+
+// zlib stream of one fixed-code Deflate block with greedy LZ77 matches.
+std::vector<unsigned char> compressZlib(const std::vector<unsigned char> &data) {
+    QeDeflateWriter writer;
+    writer.out = {0x78, 0x01};
+    writer.write(1, 1);  // BFINAL
+    writer.write(1, 2);  // fixed Huffman codes
+
+    const size_t window = 32768;
+    std::vector<int64_t> head(1 << 15, -1);
+    auto hash = [&](size_t pos) { return ((data[pos] << 10) ^ (data[pos + 1] << 5) ^ data[pos + 2]) & 0x7FFF; };
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t length = 0, distance = 0;
+        if (pos + 3 <= data.size()) {
+            int64_t candidate = head[hash(pos)];
+            head[hash(pos)] = int64_t(pos);
+            if (candidate >= 0 && pos - size_t(candidate) <= window) {
+                size_t limit = std::min<size_t>(258, data.size() - pos);
+                while (length < limit && data[size_t(candidate) + length] == data[pos + length]) ++length;
+                distance = pos - size_t(candidate);
+            }
+        }
+        if (length < 3) {
+            writer.writeLiteral(data[pos++]);
+            continue;
+        }
+
+        int i = 28;
+        while (DEFLATE_LENGTH_BASE[i] > length) --i;
+        writer.writeLiteral(257 + i);
+        writer.write(uint32_t(length - DEFLATE_LENGTH_BASE[i]), (i < 8 || i == 28) ? 0 : i / 4 - 1);
+        int j = 29;
+        while (DEFLATE_DISTANCE_BASE[j] > distance) --j;
+        writer.writeCode(j, 5);
+        writer.write(uint32_t(distance - DEFLATE_DISTANCE_BASE[j]), j < 4 ? 0 : j / 2 - 1);
+        for (size_t k = pos + 1; k < pos + length && k + 3 <= data.size(); ++k) head[hash(k)] = int64_t(k);
+        pos += length;
+    }
+    writer.writeLiteral(256);
+    writer.flush();
+
+    uint32_t a = 1, b = 0;  // Adler-32
+    for (unsigned char byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    writeBigEndian(writer.out, b << 16 | a);
+    return writer.out;
+}
+
+uint32_t getCRC32(const unsigned char *data, size_t size) {
+    static uint32_t table[256];
+    if (table[1] == 0) {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    }
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void writePNGChunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, size_t size) {
+    writeBigEndian(out, (unsigned int)size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    writeBigEndian(out, getCRC32(out.data() + start, size + 4));
+}
+
+// 8-bit PNG of any colour type. Rows cycle through the five filter types; colour type 3 uses a 16-entry palette.
+std::vector<unsigned char> writeSyntheticPNG(int width, int height, int colorType, uint32_t seed) {
+    const int channels[7] = {1, 0, 3, 1, 2, 0, 4};
+    const int bytewidth = channels[colorType];
+    std::vector<unsigned char> pixels = makeSyntheticPixels(width, height, bytewidth, seed);
+    if (colorType == 3) {
+        for (unsigned char &index : pixels) index >>= 4;
+    }
+
+    const size_t linebytes = size_t(width) * bytewidth;
+    std::vector<unsigned char> raw;
+    raw.reserve((linebytes + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char *row = pixels.data() + linebytes * y;
+        const unsigned char *prev = y > 0 ? row - linebytes : nullptr;
+        unsigned char filterType = (unsigned char)(y % 5);
+        raw.push_back(filterType);
+        for (size_t i = 0; i < linebytes; ++i) {
+            int a = i >= size_t(bytewidth) ? row[i - bytewidth] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = (prev && i >= size_t(bytewidth)) ? prev[i - bytewidth] : 0;
+            int predictor = 0;
+            if (filterType == 1)
+                predictor = a;
+            else if (filterType == 2)
+                predictor = b;
+            else if (filterType == 3)
+                predictor = (a + b) / 2;
+            else if (filterType == 4) {
+                int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+                predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            }
+            raw.push_back((unsigned char)(row[i] - predictor));
+        }
+    }
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<unsigned char> header;
+    writeBigEndian(header, width);
+    writeBigEndian(header, height);
+    header.insert(header.end(), {8, (unsigned char)colorType, 0, 0, 0});
+    writePNGChunk(png, "IHDR", header.data(), header.size());
+    if (colorType == 3) {
+        unsigned char palette[16 * 3];
+        for (int i = 0; i < 16; ++i) {
+            palette[i * 3] = (unsigned char)(i * 17);
+            palette[i * 3 + 1] = (unsigned char)(255 - i * 17);
+            palette[i * 3 + 2] = (unsigned char)(i * 97);
+        }
+        writePNGChunk(png, "PLTE", palette, sizeof(palette));
+    }
+    std::vector<unsigned char> zlib = compressZlib(raw);
+    for (size_t offset = 0; offset < zlib.size(); offset += 65536)  // IDAT chunks of 64K, like most encoders
+        writePNGChunk(png, "IDAT", zlib.data() + offset, std::min<size_t>(65536, zlib.size() - offset));
+    writePNGChunk(png, "IEND", nullptr, 0);
+    return png;
+}
+
+// Uncompressed bottom-up BMP, 24 or 32 bits.
+std::vector<unsigned char> writeSyntheticBMP(int width, int height, int bits, uint32_t seed) {
+    const int channels = bits / 8;
+    std::vector<unsigned char> pixels = makeSyntheticPixels(width, height, channels, seed);
+    const size_t stride = (size_t(width) * channels + 3) & ~size_t(3);
+
+    std::vector<unsigned char> bmp = {'B', 'M'};
+    writeLittleEndian(bmp, (unsigned int)(54 + stride * height), 4);
+    writeLittleEndian(bmp, 0, 4);
+    writeLittleEndian(bmp, 54, 4);  // pixel data
+    writeLittleEndian(bmp, 40, 4);  // BITMAPINFOHEADER
+    writeLittleEndian(bmp, width, 4);
+    writeLittleEndian(bmp, height, 4);
+    writeLittleEndian(bmp, 1, 2);
+    writeLittleEndian(bmp, bits, 2);
+    for (int i = 0; i < 6; ++i) writeLittleEndian(bmp, 0, 4);
+    for (int y = height - 1; y >= 0; --y) {
+        bmp.insert(bmp.end(), pixels.begin() + size_t(width) * channels * y, pixels.begin() + size_t(width) * channels * (y + 1));
+        bmp.resize(bmp.size() + stride - size_t(width) * channels, 0);
+    }
+    return bmp;
+}
+
+const unsigned char JPEG_ZIGZAG[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+                                       41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+                                       30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+// ITU T.81 Annex K tables, natural order
+const unsigned char JPEG_LUMA_QUANT[64] = {16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+                                           14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+                                           18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+                                           49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+const unsigned char JPEG_CHROMA_QUANT[64] = {17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99,
+                                             99, 99, 47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+                                             99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+// Huffman table built from symbol counts, ITU T.81 Annex K.2: code lengths limited to 16 bits and no all-ones code.
+struct QeJPEGHuffmanTable {
+    unsigned char bits[17] = {};  // codes of each length
+    std::vector<unsigned char> values;
+    unsigned short int code[256] = {};
+    unsigned char size[256] = {};
+
+    void build(const size_t *counts) {
+        int64_t freq[257];
+        int codesize[257], others[257];
+        for (int i = 0; i < 257; ++i) {
+            freq[i] = i < 256 ? int64_t(counts[i]) : 1;  // one reserved code point
+            codesize[i] = 0;
+            others[i] = -1;
+        }
+        while (true) {
+            int c1 = -1, c2 = -1;
+            for (int i = 0; i < 257; ++i) {
+                if (freq[i] == 0) continue;
+                if (c1 < 0 || freq[i] <= freq[c1]) {
+                    c2 = c1;
+                    c1 = i;
+                } else if (c2 < 0 || freq[i] <= freq[c2])
+                    c2 = i;
+            }
+            if (c2 < 0) break;
+            freq[c1] += freq[c2];
+            freq[c2] = 0;
+            for (++codesize[c1]; others[c1] >= 0; ++codesize[c1]) c1 = others[c1];
+            others[c1] = c2;
+            for (++codesize[c2]; others[c2] >= 0; ++codesize[c2]) c2 = others[c2];
+        }
+
+        int lengthCounts[33] = {};
+        for (int i = 0; i < 257; ++i) ++lengthCounts[std::min(codesize[i], 32)];
+        for (int i = 32; i > 16; --i) {
+            while (lengthCounts[i] > 0) {
+                int j = i - 2;
+                while (lengthCounts[j] == 0) --j;
+                lengthCounts[i] -= 2;
+                ++lengthCounts[i - 1];
+                lengthCounts[j + 1] += 2;
+                --lengthCounts[j];
+            }
+        }
+        int longest = 16;
+        while (lengthCounts[longest] == 0) --longest;
+        --lengthCounts[longest];  // the reserved code point
+
+        for (int length = 1; length <= 32; ++length) {
+            for (int symbol = 0; symbol < 256; ++symbol)
+                if (codesize[symbol] == length) values.push_back((unsigned char)symbol);
+        }
+        unsigned int next = 0;
+        size_t index = 0;
+        for (int length = 1; length <= 16; ++length) {
+            bits[length] = (unsigned char)lengthCounts[length];
+            for (int k = 0; k < lengthCounts[length]; ++k, ++index, ++next) {
+                code[values[index]] = (unsigned short int)next;
+                size[values[index]] = (unsigned char)length;
+            }
+            next <<= 1;
+        }
+    }
+};
+
+// Entropy-coded segment bits, most significant first, with 0xFF stuffed.
+struct QeJPEGWriter {
+    std::vector<unsigned char> &out;
+    uint32_t buffer = 0;
+    int count = 0;
+
+    void write(uint32_t bits, int length) {
+        buffer = (buffer << length) | (bits & ((1u << length) - 1));
+        count += length;
+        while (count >= 8) {
+            unsigned char byte = (unsigned char)(buffer >> (count - 8));
+            out.push_back(byte);
+            if (byte == 0xFF) out.push_back(0);
+            count -= 8;
+        }
+    }
+    void flush() {
+        if (count > 0) write(0x7F, 8 - count);  // pad with ones
+    }
+};
+
+int getJPEGCategory(int value) {
+    int magnitude = abs(value), category = 0;
+    while (magnitude > 0) {
+        magnitude >>= 1;
+        ++category;
+    }
+    return category;
+}
+
+void writeJPEGSegment(std::vector<unsigned char> &out, unsigned char marker, const std::vector<unsigned char> &data) {
+    out.insert(out.end(), {0xFF, marker, (unsigned char)((data.size() + 2) >> 8), (unsigned char)(data.size() + 2)});
+    out.insert(out.end(), data.begin(), data.end());
+}
+
+// Baseline JPEG: grey, or YCbCr at 4:4:4 or 4:2:0. restartInterval in MCUs, 0 for none.
+std::vector<unsigned char> writeSyntheticJPEG(int width, int height, int channels, bool bSubsample, int restartInterval,
+                                              uint32_t seed) {
+    std::vector<unsigned char> pixels = makeSyntheticPixels(width, height, channels, seed);
+    const int componentNum = channels == 1 ? 1 : 3;
+    const int sample = (componentNum == 3 && bSubsample) ? 2 : 1;
+
+    // level-shifted planes, chroma averaged down when subsampled
+    std::vector<float> planes[3];
+    int planeWidth[3], planeHeight[3];
+    for (int i = 0; i < componentNum; ++i) {
+        int factor = i == 0 ? 1 : sample;
+        planeWidth[i] = (width + factor - 1) / factor;
+        planeHeight[i] = (height + factor - 1) / factor;
+        planes[i].assign(size_t(planeWidth[i]) * planeHeight[i], 0.0f);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const unsigned char *p = pixels.data() + (size_t(y) * width + x) * channels;
+                float value = p[0];
+                if (componentNum == 3) {
+                    float r = p[0], g = p[1], b = p[2];
+                    value = i == 0 ? 0.299f * r + 0.587f * g + 0.114f * b
+                                   : i == 1 ? -0.168736f * r - 0.331264f * g + 0.5f * b + 128.0f
+                                            : 0.5f * r - 0.418688f * g - 0.081312f * b + 128.0f;
+                }
+                int count = std::min(factor, width - x / factor * factor) * std::min(factor, height - y / factor * factor);
+                planes[i][size_t(y / factor) * planeWidth[i] + x / factor] += value / count;
+            }
+        }
+    }
+
+    unsigned char quant[2][64];
+    for (int k = 0; k < 64; ++k) {  // quality 90
+        quant[0][k] = (unsigned char)std::max(1, (JPEG_LUMA_QUANT[k] * 20 + 50) / 100);
+        quant[1][k] = (unsigned char)std::max(1, (JPEG_CHROMA_QUANT[k] * 20 + 50) / 100);
+    }
+    float cosTable[8][8];
+    for (int u = 0; u < 8; ++u) {
+        for (int x = 0; x < 8; ++x) cosTable[u][x] = std::cos((2 * x + 1) * u * 3.14159265f / 16) * (u == 0 ? 0.70710678f : 1.0f);
+    }
+
+    // quantized blocks in scan order, zig-zag
+    const int mcuWidth = (width + 8 * sample - 1) / (8 * sample);
+    const int mcuHeight = (height + 8 * sample - 1) / (8 * sample);
+    std::vector<short int> blocks;
+    std::vector<unsigned char> blockComponents;
+    for (int my = 0; my < mcuHeight; ++my) {
+        for (int mx = 0; mx < mcuWidth; ++mx) {
+            for (int i = 0; i < componentNum; ++i) {
+                const int factor = i == 0 ? sample : 1;
+                for (int by = 0; by < factor; ++by) {
+                    for (int bx = 0; bx < factor; ++bx) {
+                        float block[64], rows[64];
+                        for (int y = 0; y < 8; ++y) {
+                            for (int x = 0; x < 8; ++x) {
+                                int px = std::min((mx * factor + bx) * 8 + x, planeWidth[i] - 1);
+                                int py = std::min((my * factor + by) * 8 + y, planeHeight[i] - 1);
+                                block[y * 8 + x] = planes[i][size_t(py) * planeWidth[i] + px] - 128.0f;
+                            }
+                        }
+                        for (int y = 0; y < 8; ++y) {
+                            for (int u = 0; u < 8; ++u) {
+                                float sum = 0;
+                                for (int x = 0; x < 8; ++x) sum += block[y * 8 + x] * cosTable[u][x];
+                                rows[y * 8 + u] = sum / 2;
+                            }
+                        }
+                        const unsigned char *table = quant[i == 0 ? 0 : 1];
+                        for (int k = 0; k < 64; ++k) {
+                            int n = JPEG_ZIGZAG[k], u = n % 8, v = n / 8;
+                            float sum = 0;
+                            for (int y = 0; y < 8; ++y) sum += rows[y * 8 + u] * cosTable[v][y];
+                            blocks.push_back((short int)std::lround(sum / 2 / table[n]));
+                        }
+                        blockComponents.push_back((unsigned char)i);
+                    }
+                }
+            }
+        }
+    }
+
+    // two passes over the blocks: count the symbols, then write them with the tables built from the counts
+    QeJPEGHuffmanTable dcTables[2], acTables[2];
+    std::vector<unsigned char> out = {0xFF, 0xD8};
+    for (int pass = 0; pass < 2; ++pass) {
+        size_t dcCounts[2][256] = {}, acCounts[2][256] = {};
+        QeJPEGWriter writer{out};
+        int dcPred[3] = {0, 0, 0};
+        const size_t blocksPerMCU = blockComponents.size() / (size_t(mcuWidth) * mcuHeight);
+        for (size_t b = 0; b < blockComponents.size(); ++b) {
+            size_t mcu = b / blocksPerMCU;
+            if (restartInterval > 0 && mcu > 0 && mcu % restartInterval == 0 && b % blocksPerMCU == 0) {
+                if (pass == 1) {
+                    writer.flush();
+                    out.insert(out.end(), {0xFF, (unsigned char)(0xD0 + (mcu / restartInterval - 1) % 8)});
+                }
+                dcPred[0] = dcPred[1] = dcPred[2] = 0;
+            }
+            const short int *block = blocks.data() + b * 64;
+            const int i = blockComponents[b], t = i == 0 ? 0 : 1;
+            auto emit = [&](QeJPEGHuffmanTable &table, size_t *counts, int symbol, int value, int category) {
+                if (pass == 0) {
+                    ++counts[symbol];
+                    return;
+                }
+                writer.write(table.code[symbol], table.size[symbol]);
+                if (category > 0) writer.write(value < 0 ? value - 1 : value, category);
+            };
+
+            int diff = block[0] - dcPred[i];
+            dcPred[i] = block[0];
+            emit(dcTables[t], dcCounts[t], getJPEGCategory(diff), diff, getJPEGCategory(diff));
+            int run = 0;
+            for (int k = 1; k < 64; ++k) {
+                if (block[k] == 0) {
+                    ++run;
+                    continue;
+                }
+                for (; run >= 16; run -= 16) emit(acTables[t], acCounts[t], 0xF0, 0, 0);
+                int category = getJPEGCategory(block[k]);
+                emit(acTables[t], acCounts[t], run << 4 | category, block[k], category);
+                run = 0;
+            }
+            if (run > 0) emit(acTables[t], acCounts[t], 0x00, 0, 0);
+        }
+        if (pass == 1) {
+            writer.flush();
+            break;
+        }
+
+        for (int t = 0; t < (componentNum == 3 ? 2 : 1); ++t) {
+            dcTables[t].build(dcCounts[t]);
+            acTables[t].build(acCounts[t]);
+        }
+        for (int t = 0; t < (componentNum == 3 ? 2 : 1); ++t) {
+            std::vector<unsigned char> dqt = {(unsigned char)t};
+            for (int k = 0; k < 64; ++k) dqt.push_back(quant[t][JPEG_ZIGZAG[k]]);
+            writeJPEGSegment(out, 0xDB, dqt);
+        }
+        std::vector<unsigned char> sof = {8, (unsigned char)(height >> 8), (unsigned char)height, (unsigned char)(width >> 8),
+                                          (unsigned char)width, (unsigned char)componentNum};
+        for (int i = 0; i < componentNum; ++i)
+            sof.insert(sof.end(),
+                       {(unsigned char)(i + 1), (unsigned char)(i == 0 ? sample * 0x11 : 0x11), (unsigned char)(i ? 1 : 0)});
+        writeJPEGSegment(out, 0xC0, sof);
+        for (int t = 0; t < (componentNum == 3 ? 2 : 1); ++t) {
+            for (int ac = 0; ac < 2; ++ac) {
+                QeJPEGHuffmanTable &table = ac ? acTables[t] : dcTables[t];
+                std::vector<unsigned char> dht = {(unsigned char)(ac << 4 | t)};
+                dht.insert(dht.end(), table.bits + 1, table.bits + 17);
+                dht.insert(dht.end(), table.values.begin(), table.values.end());
+                writeJPEGSegment(out, 0xC4, dht);
+            }
+        }
+        if (restartInterval > 0)
+            writeJPEGSegment(out, 0xDD, {(unsigned char)(restartInterval >> 8), (unsigned char)restartInterval});
+        std::vector<unsigned char> sos = {(unsigned char)componentNum};
+        for (int i = 0; i < componentNum; ++i) sos.insert(sos.end(), {(unsigned char)(i + 1), (unsigned char)(i ? 0x11 : 0x00)});
+        sos.insert(sos.end(), {0, 63, 0});
+        writeJPEGSegment(out, 0xDA, sos);
+    }
+    out.insert(out.end(), {0xFF, 0xD9});
+    return out;
+}
+
+// Scene of objects laid out as config.xml lays out its scenes: comments, components with many attributes, text values
+// and nested children.
+std::vector<unsigned char> writeSyntheticScene(int objectNum, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    std::string out = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!--synthetic scene-->\n<scene eid=\"" +
+                      std::to_string(seed) + "\">\n    <objects>\n";
+    for (int i = 0; i < objectNum; ++i) {
+        std::string id = std::to_string(i), space = "            ";
+        char position[64];
+        float x = coordinate(random), y = coordinate(random), z = coordinate(random);
+        std::snprintf(position, sizeof(position), "%.3f %.3f %.3f", x, y, z);
+        if (i % 4 == 0) out += "        <group oid=\"" + id + "\">\n";
+        if (i % 8 == 0) out += space + "<!-- object " + id + " -->\n";
+        out += space + "<Object type=\"1000\" oid=\"" + id + "\" eid=\"" + id + "\" name=\"object" + id + "\">\n";
+        out += space + "    <components>\n";
+        out += space + "        <Transform type=\"1\" oid=\"" + id + "\" eid=\"1\" position=\"" + position +
+               "\" scale=\"1 1 1\" faceEular=\"0 0 0\" rotateSpeed=\"0 0 0\" revoluteSpeed=\"0 0 0\" />\n";
+        out += space + "        <Model type=\"5\" oid=\"" + id + "\" eid=\"" + std::to_string(random() % 16) +
+               "\" obj=\"box.gltf\" materialOID=\"" + id + "\" />\n";
+        out += space + "        <Material type=\"8\" oid=\"" + id + "\" baseMap=\"texture" + std::to_string(random() % 64) +
+               ".png\" baseColor=\"1 1 1 1\" metallicRoughnessEmissive=\"0.5 0.5 0 1\" />\n";
+        out += space + "        <name>  object " + id + "  </name>\n";
+        out += space + "    </components>\n" + space + "</Object>\n";
+        if (i % 4 == 3 || i + 1 == objectNum) out += "        </group>\n";
+    }
+    out += "    </objects>\n</scene>\n";
+    return std::vector<unsigned char>(out.begin(), out.end());
+}
+
+// glTF-like document: nodes with transforms and children, accessors with bounds, and a skin whose joint list and
+// inverse bind matrices are long numeric arrays. Wide nodes have extras of many members.
+std::vector<unsigned char> writeSyntheticGLTF(int nodeNum, uint32_t seed, bool bWide = false) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+    auto number = [&]() {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%g", coordinate(random));
+        return std::string(text);
+    };
+    std::string out = "{\n  \"asset\" : {\n    \"generator\" : \"testCommon \\\"synthetic\\\"\",\n";
+    out += "    \"version\" : \"2.0\"\n  },\n";
+    out += "  \"scene\" : 0,\n  \"scenes\" : [ { \"name\" : \"Scene\", \"nodes\" : [ 0 ] } ],\n  \"nodes\" : [\n";
+    for (int i = 0; i < nodeNum; ++i) {
+        std::string id = std::to_string(i);
+        out += "    {\n      \"name\" : \"node" + id + "\",\n";
+        out += "      \"translation\" : [ " + number() + ", " + number() + ", " + number() + " ],\n";
+        out += "      \"rotation\" : [ 0, 0, 0.7071068, 0.7071068 ],\n      \"scale\" : [ 1, 1, 1 ]";
+        if (i % 4 == 0) {
+            out += ",\n      \"children\" : [ ";
+            for (int j = i + 1; j < std::min(i + 4, nodeNum); ++j) out += (j > i + 1 ? ", " : "") + std::to_string(j);
+            out += " ]";
+        }
+        if (i % 16 == 0) out += ",\n      \"mesh\" : " + std::to_string(random() % 8);
+        if (i % 16 == 0 || bWide) {
+            out += ",\n      \"extras\" : {";
+            if (i % 16 == 0) out += " \"visible\" : true";
+            for (int j = 0; bWide && j < 24; ++j)
+                out += (j || i % 16 == 0 ? ", \"tag" : " \"tag") + std::to_string(j) + "\" : " + std::to_string(random() % 100);
+            out += " }";
+        }
+        out += i + 1 < nodeNum ? "\n    },\n" : "\n    }\n";
+    }
+    out += "  ],\n  \"accessors\" : [\n";
+    for (int i = 0; i < 8; ++i) {
+        out += "    { \"bufferView\" : " + std::to_string(i) + ", \"componentType\" : 5126, \"count\" : " +
+               std::to_string(random() % 4096) + ", \"type\" : \"VEC3\", \"max\" : [ " + number() + ", " + number() + ", " +
+               number() + " ], \"min\" : [ " + number() + ", " + number() + ", " + number() + " ] }";
+        out += i < 7 ? ",\n" : "\n";
+    }
+    out += "  ],\n  \"skins\" : [ {\n    \"joints\" : [ ";
+    for (int i = 0; i < nodeNum; ++i) out += (i ? ", " : "") + std::to_string(i);
+    out += " ],\n    \"extras\" : { \"inverseBindMatrices\" : [ ";
+    for (int i = 0; i < nodeNum * 16; ++i) out += (i ? ", " : "") + number();
+    out += " ] }\n  } ]\n}\n";
+    return std::vector<unsigned char>(out.begin(), out.end());
+}
+
+// Benchmark --------------------------------------------------------------------------------------------------------
+
+struct QeCorpusFile {
+    std::string name;
+    std::string type;  // png, jpg, bmp, xml or json
+    std::vector<unsigned char> data;
+    std::vector<unsigned char> rgba{};  // decoded, the input of the texture stages
+    std::vector<char> snapshot{};       // compiled, the input of the snapshot stages
+    int width = 0;
+    int height = 0;
+};
+
+struct QeDecodeResult {
+    std::vector<unsigned char> output;
+    int width = 0;
+    int height = 0;
+    int bytes = 0;
+    size_t inputSize = 0;
+};
+
+struct QeCodecStage {
+    const char *name;
+    const char *type;  // files the stage applies to, empty for every image
+    std::function<QeDecodeResult(const QeCorpusFile &)> run;
+    // PSNR of a lossy output against the file, untimed; a file under minPSNR fails the run
+    std::function<double(const QeCorpusFile &, const QeDecodeResult &)> psnr = nullptr;
+    double minPSNR = 0;
+};
+
+struct QeStageTotals {
+    size_t files = 0;
+    size_t inputBytes = 0;
+    size_t outputBytes = 0;
+    double pixels = 0;
+    double milliseconds = 0;
+    size_t allocations = 0;
+    size_t allocatedBytes = 0;
+    size_t peakHeap = 0;
+    size_t peakRSS = 0;  // KB
+    double minPSNR = 99;
+};
+
+// Concatenated IDAT data of a PNG, with the scanline layout from IHDR.
+struct QePNGData {
+    std::vector<unsigned char> idat;
+    size_t linebytes = 0;
+    size_t bytewidth = 0;
+    size_t height = 0;
+};
+
+bool readPNGData(const std::vector<unsigned char> &file, QePNGData &png) {
+    const unsigned char *buffer = file.data();
+    if (file.size() < 0x21) return false;
+
+    size_t width = readBigEndian(buffer + 0x10);
+    png.height = readBigEndian(buffer + 0x14);
+    unsigned int channels[7] = {1, 0, 3, 1, 2, 0, 4};
+    size_t bits = buffer[0x18] * channels[buffer[0x19] % 7];
+    png.bytewidth = (bits + 7) / 8;
+    png.linebytes = (width * bits + 7) / 8;
+
+    size_t index = 0x21;
+    while (index + 12 <= file.size()) {
+        size_t chunkLength = readBigEndian(buffer + index);
+        if (chunkLength > file.size() - index - 12) break;
+        if (memcmp(buffer + index + 4, "IDAT", 4) == 0)
+            png.idat.insert(png.idat.end(), buffer + index + 8, buffer + index + 8 + chunkLength);
+        index += chunkLength + 12;
+    }
+    return !png.idat.empty();
+}
+
+QeDecodeResult unfilterPNG(const QeCorpusFile &file, bool bSIMD) {
+    QeDecodeResult result;
+    QePNGData png;
+    if (!readPNGData(file.data, png)) return result;
+    std::vector<unsigned char> scanlines = COM_ENCODE.decodeDeflate(png.idat.data(), png.idat.size());
+    if (scanlines.size() != (1 + png.linebytes) * png.height) return result;
+
+    result.output.resize(png.linebytes * png.height);
+    for (size_t row = 0; row < png.height; ++row) {
+        const unsigned char *scanline = scanlines.data() + (1 + png.linebytes) * row;
+        unsigned char *recon = result.output.data() + png.linebytes * row;
+        COM_ENCODE.unfilterPNGScanline(recon, scanline + 1, row > 0 ? recon - png.linebytes : nullptr, png.linebytes,
+                                       png.bytewidth, scanline[0], bSIMD);
+    }
+    result.width = int(png.linebytes);
+    result.height = int(png.height);
+    result.bytes = 1;
+    result.inputSize = png.idat.size();
+    return result;
+}
+
+// Full mip chain of the decoded RGBA8 image.
+QeDecodeResult generateMipmaps(const QeCorpusFile &file, AeMipmapFilter filter, bool bSRGB, bool bParallel) {
+    QeDecodeResult result;
+    if (file.rgba.empty()) return result;
+    unsigned int levels = AeTextureEncode::getMipLevels(file.width, file.height);
+    result.output.resize(AeTextureEncode::getMipmapSize(file.width, file.height, 4, levels));
+    memcpy(result.output.data(), file.rgba.data(), file.rgba.size());
+    COM_TEXTURE.generateMipmaps(result.output.data(), file.width, file.height, 4, levels, filter, bSRGB, bParallel);
+    result.width = file.width;
+    result.height = file.height;
+    result.bytes = 4;
+    result.inputSize = file.rgba.size();
+    return result;
+}
+
+// Floors of the block stages on every corpus file, a few dB under the worst the encoder does today.
+const double BC1_MIN_PSNR = 22, BC3_MIN_PSNR = 22, BC4_MIN_PSNR = 32, BC7_MIN_PSNR = 23;
+
+QeDecodeResult encodeBlocks(const QeCorpusFile &file, AeBlockFormat format, AeBlockQuality quality, bool bParallel) {
+    QeDecodeResult result;
+    result.output = COM_TEXTURE.encodeBlocks(file.rgba.data(), file.width, file.height, 1, format, quality, bParallel);
+    result.width = file.width;
+    result.height = file.height;
+    result.bytes = int(AeTextureEncode::getBlockBytes(format));
+    result.inputSize = file.rgba.size();
+    return result;
+}
+
+// Round trip through the reference decoder over the channels the format keeps. BC1 is held to the cut-out of the file,
+// transparent black under alpha 128 and opaque above.
+std::function<double(const QeCorpusFile &, const QeDecodeResult &)> getBlockPSNR(AeBlockFormat format,
+                                                                                 unsigned int channelMask) {
+    return [=](const QeCorpusFile &file, const QeDecodeResult &result) {
+        const size_t pixels = size_t(file.width) * file.height;
+        std::vector<unsigned char> decoded = COM_TEXTURE.decodeBlocks(result.output.data(), file.width, file.height, 1, format);
+        if (format != eBlockFormat_BC1) return AeTextureEncode::getPSNR(file.rgba.data(), decoded.data(), pixels, channelMask);
+        std::vector<unsigned char> cutout = file.rgba;
+        for (size_t i = 0; i < pixels; ++i) {
+            if (cutout[i * 4 + 3] < 128)
+                memset(&cutout[i * 4], 0, 4);
+            else
+                cutout[i * 4 + 3] = 255;
+        }
+        return AeTextureEncode::getPSNR(cutout.data(), decoded.data(), pixels, channelMask);
+    };
+}
+
+// Reads of a scene as the object loaders do them, a few attributes and a component on every node, over several passes.
+// Model.name has no attribute on Model, so it reads the name child of the node itself, as components has one.
+const int XML_QUERY_PASSES = 8;
+
+void queryXMLNode(AeXMLNode *node, bool bPath, std::string &out) {
+    static const AeXMLPath type("type"), oid("oid"), eid("eid"), name("name");
+    static const AeXMLPath position("components.Transform.position"), model("components.Model.eid");
+    static const AeXMLPath modelName("Model.name");
+    AeArray<float, 3> xyz;
+    char line[200];
+    if (bPath) {
+        xyz = node->getXMLValues<float, 3>(position);
+        std::snprintf(line, sizeof(line), "%d %d %d %s %g %g %g %d %s\n", node->getXMLValue<int>(type),
+                      node->getXMLValue<int>(oid), node->getXMLValue<int>(eid),
+                      node->getXMLValue<std::string>(name).c_str(), xyz[0], xyz[1], xyz[2], node->getXMLValue<int>(model),
+                      node->getXMLValue<std::string>(modelName).c_str());
+    } else {
+        xyz = node->getXMLValues<float, 3>("components.Transform.position");
+        std::snprintf(line, sizeof(line), "%d %d %d %s %g %g %g %d %s\n", node->getXMLValue<int>("type"),
+                      node->getXMLValue<int>("oid"), node->getXMLValue<int>("eid"),
+                      node->getXMLValue<std::string>("name").c_str(), xyz[0], xyz[1], xyz[2],
+                      node->getXMLValue<int>("components.Model.eid"), node->getXMLValue<std::string>("Model.name").c_str());
+    }
+    out += line;
+    for (const auto &next : node->data->nexts) queryXMLNode(next, bPath, out);
+}
+
+QeDecodeResult queryXML(const QeCorpusFile &file, bool bPath, bool bSnapshot = false) {
+    QeDecodeResult result;
+    std::string text, content;
+    AeXMLNode *node;
+    if (bSnapshot) {
+        node = AeXMLSnapshot::decode((const unsigned char *)file.snapshot.data(), file.snapshot.size(), 0);
+    } else {
+        text.assign(file.data.begin(), file.data.end());
+        int index = 0;
+        node = COM_ENCODE.decodeXML(text.c_str(), index);
+    }
+    for (int i = 0; i < XML_QUERY_PASSES; ++i) {
+        content.clear();
+        queryXMLNode(node, bPath, content);
+    }
+    delete node;
+    result.output.assign(content.begin(), content.end());
+    result.inputSize = file.data.size();
+    return result;
+}
+
+// The tree of AeXMLReader over the file, or over a stream of it read in chunks of chunkSize.
+QeDecodeResult readXML(const QeCorpusFile &file, size_t chunkSize) {
+    QeDecodeResult result;
+    AeXMLReader reader;
+    std::istringstream stream;
+    if (chunkSize) {
+        stream.str(std::string(file.data.begin(), file.data.end()));
+        reader.open(stream, chunkSize);
+    } else {
+        reader.open((const char *)file.data.data(), file.data.size());
+    }
+    AeXMLNode *node = reader.readXMLDocument();
+    if (!node) return result;
+    std::string content;
+    node->outputXML(nullptr, 0, &content);
+    delete node;
+    result.output.assign(content.begin(), content.end());
+    result.inputSize = file.data.size();
+    return result;
+}
+
+// What a scene load needs from the events alone: a line for every element with a type, as spawnComponent reads it,
+// and nothing built for the rest. define elements are skipped unread.
+QeDecodeResult spawnXML(const QeCorpusFile &file) {
+    QeDecodeResult result;
+    AeXMLReader reader;
+    reader.open((const char *)file.data.data(), file.data.size());
+    std::string content;
+    char line[160];
+    AeXMLEvent event;
+    while ((event = reader.next()) != eXMLEvent_end) {
+        if (event == eXMLEvent_error) return result;
+        if (event == eXMLEvent_startElement && reader.getKey() == "define") {
+            if (!reader.skipXMLElement()) return result;
+        } else if (event == eXMLEvent_attribute && reader.getKey() == "type") {
+            std::snprintf(line, sizeof(line), "%zu %d\n", reader.getDepth(), atoi(std::string(reader.getValue()).c_str()));
+            content += line;
+        }
+    }
+    result.output.assign(content.begin(), content.end());
+    result.inputSize = file.data.size();
+    return result;
+}
+
+// Saves of a tree edited between them as the editor edits config.xml, one attribute each time: outputXML writing all
+// of it, or an AeXMLWriter writing the edited nodes and copying the rest. The text of the last save is the output.
+const int XML_SAVES = 16;
+
+void collectXMLElements(AeXMLNode *node, std::vector<AeXMLNode *> &nodes) {
+    if (node->data->elements.size()) nodes.push_back(node);
+    for (AeXMLNode *next : node->data->nexts) collectXMLElements(next, nodes);
+}
+
+QeDecodeResult saveXML(const QeCorpusFile &file, bool bDirty) {
+    QeDecodeResult result;
+    AeXMLReader reader;
+    reader.open((const char *)file.data.data(), file.data.size());
+    AeXMLNode *root = reader.readXMLDocument();
+    if (!root) return result;
+    std::vector<AeXMLNode *> nodes;
+    collectXMLElements(root, nodes);
+
+    AeXMLWriter writer;
+    std::string content;
+    const std::string *text = &content;
+    for (int i = 0; i <= XML_SAVES; ++i) {
+        if (i && nodes.size()) {
+            AeXMLNode *node = nodes[size_t(i) * 7919 % nodes.size()];
+            const AeNode element = node->data->elements[0];
+            node->setXMLValue(element.key.c_str(), (element.value + " " + std::to_string(i)).c_str());
+        }
+        if (bDirty) {
+            text = &writer.write(root);
+        } else {
+            content.clear();
+            root->outputXML(nullptr, 0, &content);
+        }
+    }
+    result.output.assign(text->begin(), text->end());
+    result.inputSize = file.data.size();
+    delete root;
+    return result;
+}
+
+// Reads of a glTF document as decodeGLTF does them: members of every node and accessor, and a few deep paths, over
+// several passes. Floats go through float as decodeGLTF stores them, so both APIs print the same text.
+const int JSON_QUERY_PASSES = 8;
+
+void queryJSONNode(AeJSONNode *root, std::string &out) {
+    char line[160];
+    const char *version = root->getJSONValue(2, "asset", "version");
+    const char *position = root->getJSONValue(4, "meshes", "primitives", "attributes", "POSITION");
+    std::snprintf(line, sizeof(line), "%s %d\n", version ? version : "-", position ? atoi(position) : -1);
+    out += line;
+    std::vector<AeJSONNode *> *nodes = root->getJSONArrayNodes(1, "nodes");
+    for (size_t i = 0; nodes && i < nodes->size(); ++i) {
+        AeJSONNode *node = (*nodes)[i];
+        const char *name = node->getJSONValue(1, "name");
+        const char *mesh = node->getJSONValue(1, "mesh");
+        const char *tag = node->getJSONValue(2, "extras", "tag17");
+        std::vector<std::string> *children = node->getJSONArrayValues(1, "children");
+        std::vector<std::string> *translation = node->getJSONArrayValues(1, "translation");
+        std::snprintf(line, sizeof(line), "%s %d %d %zu %g\n", name ? name : "-", mesh ? atoi(mesh) : -1,
+                      tag ? atoi(tag) : -1, children ? children->size() : 0,
+                      translation && !translation->empty() ? float(atof((*translation)[0].c_str())) : 0.0f);
+        out += line;
+    }
+    std::vector<AeJSONNode *> *accessors = root->getJSONArrayNodes(1, "accessors");
+    for (size_t i = 0; accessors && i < accessors->size(); ++i) {
+        AeJSONNode *accessor = (*accessors)[i];
+        const char *bufferView = accessor->getJSONValue(1, "bufferView");
+        const char *count = accessor->getJSONValue(1, "count");
+        const char *componentType = accessor->getJSONValue(1, "componentType");
+        std::snprintf(line, sizeof(line), "%d %d %d\n", bufferView ? atoi(bufferView) : -1, count ? atoi(count) : -1,
+                      componentType ? atoi(componentType) : -1);
+        out += line;
+    }
+}
+
+void queryJSONValue(AeJSONValue *root, std::string &out) {
+    static const AeJSONPath version("asset.version"), position("meshes.primitives.attributes.POSITION");
+    static const AeJSONPath nodes("nodes"), name("name"), mesh("mesh"), tag("extras.tag17"), children("children");
+    static const AeJSONPath translation("translation"), accessors("accessors"), bufferView("bufferView"), count("count");
+    static const AeJSONPath componentType("componentType");
+    auto getInt = [](AeJSONValue *object, const AeJSONPath &path) {
+        AeJSONValue *value = object->getJSONValue(path);
+        return value ? int(value->getJSONInt()) : -1;
+    };
+    char line[160];
+    AeJSONValue *value = root->getJSONValue(version);
+    std::snprintf(line, sizeof(line), "%s %d\n", value ? std::string(value->string).c_str() : "-", getInt(root, position));
+    out += line;
+    AeJSONValue *array = root->getJSONValue(nodes);
+    for (uint32_t i = 0; array && i < array->size; ++i) {
+        AeJSONValue *node = array->getJSONElement(i);
+        AeJSONValue *nameValue = node->getJSONValue(name);
+        AeJSONValue *childrenValue = node->getJSONValue(children);
+        AeJSONValue *translationValue = node->getJSONValue(translation);
+        std::snprintf(line, sizeof(line), "%s %d %d %zu %g\n", nameValue ? std::string(nameValue->string).c_str() : "-",
+                      getInt(node, mesh), getInt(node, tag), childrenValue ? size_t(childrenValue->size) : 0,
+                      translationValue && translationValue->floats ? translationValue->floats[0] : 0.0f);
+        out += line;
+    }
+    array = root->getJSONValue(accessors);
+    for (uint32_t i = 0; array && i < array->size; ++i) {
+        AeJSONValue *accessor = array->getJSONElement(i);
+        std::snprintf(line, sizeof(line), "%d %d %d\n", getInt(accessor, bufferView), getInt(accessor, count),
+                      getInt(accessor, componentType));
+        out += line;
+    }
+}
+
+QeDecodeResult queryJSON(const QeCorpusFile &file, bool bPath) {
+    QeDecodeResult result;
+    std::string content;
+    if (bPath) {
+        AeJSONDocument document;
+        if (!document.parse(std::vector<char>(file.data.begin(), file.data.end()))) return result;
+        for (int i = 0; i < JSON_QUERY_PASSES; ++i) {
+            content.clear();
+            queryJSONValue(document.getRoot(), content);
+        }
+    } else {
+        std::string text(file.data.begin(), file.data.end());
+        int index = 0;
+        AeJSONNode *node = COM_ENCODE.decodeJSON(text.c_str(), index);
+        for (int i = 0; i < JSON_QUERY_PASSES; ++i) {
+            content.clear();
+            queryJSONNode(node, content);
+        }
+        delete node;
+    }
+    result.output.assign(content.begin(), content.end());
+    result.inputSize = file.data.size();
+    return result;
+}
+
+// Both JSON dumps are the values as the parser keeps them, so the two stages do not compare.
+void dumpJSONNode(const AeJSONNode *node, std::string &out) {
+    const AeJSON *data = node->data;
+    out += "{";
+    for (size_t i = 0; i < data->eValues.size(); ++i) out += data->eKeysforValues[i] + "=" + data->eValues[i] + ";";
+    for (size_t i = 0; i < data->eNodes.size(); ++i) {
+        out += data->eKeysforNodes[i] + "=";
+        dumpJSONNode(data->eNodes[i], out);
+    }
+    for (size_t i = 0; i < data->eArrayValues.size(); ++i) {
+        out += data->eKeysforArrayValues[i] + "=[";
+        for (const std::string &value : data->eArrayValues[i]) out += value + ",";
+        out += "]";
+    }
+    for (size_t i = 0; i < data->eArrayNodes.size(); ++i) {
+        out += data->eKeysforArrayNodes[i] + "=[";
+        for (const AeJSONNode *element : data->eArrayNodes[i]) dumpJSONNode(element, out);
+        out += "]";
+    }
+    out += "}";
+}
+
+void dumpJSONValue(const AeJSONValue *value, std::string &out) {
+    char text[32];
+    switch (value->type) {
+        case eJSON_null:
+            out += "null";
+            break;
+        case eJSON_bool:
+            out += value->boolean ? "true" : "false";
+            break;
+        case eJSON_int:
+            out += std::to_string(value->integer);
+            break;
+        case eJSON_double:
+            std::snprintf(text, sizeof(text), "%.17g", value->number);
+            out += text;
+            break;
+        case eJSON_string:
+            out += "\"";
+            out += value->string;
+            out += "\"";
+            break;
+        case eJSON_array:
+            out += "[";
+            for (uint32_t i = 0; i < value->size; ++i) {
+                if (value->ints) {
+                    out += std::to_string(value->ints[i]);
+                } else if (value->floats) {
+                    std::snprintf(text, sizeof(text), "%.9g", value->floats[i]);
+                    out += text;
+                } else {
+                    dumpJSONValue(value->elements + i, out);
+                }
+                out += ",";
+            }
+            out += "]";
+            break;
+        case eJSON_object:
+            out += "{";
+            for (uint32_t i = 0; i < value->size; ++i) {
+                out += value->members[i].key;
+                out += "=";
+                dumpJSONValue(&value->members[i].value, out);
+                out += ";";
+            }
+            out += "}";
+            break;
+    }
+}
+
+std::vector<QeCodecStage> getCodecStages() {
+    auto decodeImage = [](const QeCorpusFile &file, AeImageFormat format, bool bParallel, unsigned int scale) {
+        QeDecodeResult result;
+        unsigned char *buffer = (unsigned char *)file.data.data();
+        if (file.type == "png")
+            result.output = COM_ENCODE.decodePNG(buffer, file.data.size(), &result.width, &result.height, &result.bytes, format);
+        else if (file.type == "jpg")
+            result.output = COM_ENCODE.decodeJPEG(buffer, file.data.size(), &result.width, &result.height, &result.bytes, format,
+                                                  bParallel, scale);
+        else
+            result.output = COM_ENCODE.decodeBMP(buffer, file.data.size(), &result.width, &result.height, &result.bytes, format);
+        result.inputSize = file.data.size();
+        return result;
+    };
+    return {
+        {"deflate", "png",
+         [](const QeCorpusFile &file) {
+             QeDecodeResult result;
+             QePNGData png;
+             if (!readPNGData(file.data, png)) return result;
+             result.output = COM_ENCODE.decodeDeflate(png.idat.data(), png.idat.size());
+             result.width = int(result.output.size());
+             result.height = result.bytes = 1;
+             result.inputSize = png.idat.size();
+             return result;
+         }},
+        {"png-unfilter", "png", [](const QeCorpusFile &file) { return unfilterPNG(file, true); }},
+        {"png-unfilter-scalar", "png", [](const QeCorpusFile &file) { return unfilterPNG(file, false); }},
+        {"png", "png", [=](const QeCorpusFile &file) { return decodeImage(file, eImageFormat_native, false, 1); }},
+        {"png-rgba8", "png", [=](const QeCorpusFile &file) { return decodeImage(file, eImageFormat_RGBA8, false, 1); }},
+        {"jpeg", "jpg", [=](const QeCorpusFile &file) { return decodeImage(file, eImageFormat_native, false, 1); }},
+        {"jpeg-rgba8", "jpg", [=](const QeCorpusFile &file) { return decodeImage(file, eImageFormat_RGBA8, false, 1); }},
+        {"jpeg-rgba8-parallel", "jpg", [=](const QeCorpusFile &file) { return decodeImage(file, eImageFormat_RGBA8, true, 1); }},
+        {"jpeg-quarter", "jpg", [=](const QeCorpusFile &file) { return decodeImage(file, eImageFormat_RGBA8, false, 4); }},
+        {"bmp", "bmp", [=](const QeCorpusFile &file) { return decodeImage(file, eImageFormat_native, false, 1); }},
+        {"bmp-rgba8", "bmp", [=](const QeCorpusFile &file) { return decodeImage(file, eImageFormat_RGBA8, false, 1); }},
+        {"mipmap-box", "", [](const QeCorpusFile &file) { return generateMipmaps(file, eMipmapFilter_box, false, false); }},
+        {"mipmap-box-srgb", "", [](const QeCorpusFile &file) { return generateMipmaps(file, eMipmapFilter_box, true, false); }},
+        {"mipmap-kaiser", "", [](const QeCorpusFile &file) { return generateMipmaps(file, eMipmapFilter_kaiser, false, false); }},
+        {"mipmap-kaiser-srgb-par", "",
+         [](const QeCorpusFile &file) { return generateMipmaps(file, eMipmapFilter_kaiser, true, true); }},
+        {"bc1", "", [](const QeCorpusFile &file) { return encodeBlocks(file, eBlockFormat_BC1, eBlockQuality_normal, false); },
+         getBlockPSNR(eBlockFormat_BC1, 0xF), BC1_MIN_PSNR},
+        {"bc1-fast", "", [](const QeCorpusFile &file) { return encodeBlocks(file, eBlockFormat_BC1, eBlockQuality_fast, false); },
+         getBlockPSNR(eBlockFormat_BC1, 0xF), BC1_MIN_PSNR},
+        {"bc3", "", [](const QeCorpusFile &file) { return encodeBlocks(file, eBlockFormat_BC3, eBlockQuality_normal, false); },
+         getBlockPSNR(eBlockFormat_BC3, 0xF), BC3_MIN_PSNR},
+        {"bc4", "", [](const QeCorpusFile &file) { return encodeBlocks(file, eBlockFormat_BC4, eBlockQuality_normal, false); },
+         getBlockPSNR(eBlockFormat_BC4, 0x1), BC4_MIN_PSNR},
+        {"bc5", "", [](const QeCorpusFile &file) { return encodeBlocks(file, eBlockFormat_BC5, eBlockQuality_normal, false); },
+         getBlockPSNR(eBlockFormat_BC5, 0x3), BC4_MIN_PSNR},
+        {"bc7", "", [](const QeCorpusFile &file) { return encodeBlocks(file, eBlockFormat_BC7, eBlockQuality_normal, false); },
+         getBlockPSNR(eBlockFormat_BC7, 0xF), BC7_MIN_PSNR},
+        {"bc7-high-par", "",
+         [](const QeCorpusFile &file) { return encodeBlocks(file, eBlockFormat_BC7, eBlockQuality_high, true); },
+         getBlockPSNR(eBlockFormat_BC7, 0xF), BC7_MIN_PSNR},
+        // mapped from COM_IMAGE_CACHE after the first run
+        {"xml-dom", "xml",
+         [](const QeCorpusFile &file) {
+             QeDecodeResult result;
+             std::string text(file.data.begin(), file.data.end());
+             int index = 0;
+             AeXMLNode *node = COM_ENCODE.decodeXML(text.c_str(), index);
+             std::string content;
+             node->outputXML(nullptr, 0, &content);
+             delete node;
+             result.output.assign(content.begin(), content.end());
+             result.inputSize = file.data.size();
+             return result;
+         }},
+        {"xml-arena", "xml",
+         [](const QeCorpusFile &file) {
+             QeDecodeResult result;
+             AeXMLDocument document;
+             if (!document.parse(std::vector<char>(file.data.begin(), file.data.end()))) return result;
+             std::string content;
+             document.outputXML(content);
+             result.output.assign(content.begin(), content.end());
+             result.inputSize = file.data.size();
+             return result;
+         }},
+        {"xml-reader", "xml", [](const QeCorpusFile &file) { return readXML(file, 0); }},
+        {"xml-reader-stream", "xml", [](const QeCorpusFile &file) { return readXML(file, 4096); }},
+        {"xml-reader-events", "xml", spawnXML},
+        {"xml-save-full", "xml", [](const QeCorpusFile &file) { return saveXML(file, false); }},
+        {"xml-save-dirty", "xml", [](const QeCorpusFile &file) { return saveXML(file, true); }},
+        // startup: the text parsed, or the image compiled from it
+        {"xml-snapshot", "xml",
+         [](const QeCorpusFile &file) {
+             QeDecodeResult result;
+             AeXMLNode *node = AeXMLSnapshot::decode((const unsigned char *)file.snapshot.data(), file.snapshot.size(), 0);
+             if (!node) return result;
+             std::string content;
+             node->outputXML(nullptr, 0, &content);
+             delete node;
+             result.output.assign(content.begin(), content.end());
+             result.inputSize = file.snapshot.size();
+             return result;
+         }},
+        {"xml-query", "xml", [](const QeCorpusFile &file) { return queryXML(file, false); }},
+        {"xml-query-path", "xml", [](const QeCorpusFile &file) { return queryXML(file, true); }},
+        {"xml-query-snapshot", "xml", [](const QeCorpusFile &file) { return queryXML(file, true, true); }},
+        {"json-node", "json",
+         [](const QeCorpusFile &file) {
+             QeDecodeResult result;
+             std::string text(file.data.begin(), file.data.end()), content;
+             int index = 0;
+             AeJSONNode *node = COM_ENCODE.decodeJSON(text.c_str(), index);
+             dumpJSONNode(node, content);
+             delete node;
+             result.output.assign(content.begin(), content.end());
+             result.inputSize = file.data.size();
+             return result;
+         }},
+        {"json-document", "json",
+         [](const QeCorpusFile &file) {
+             QeDecodeResult result;
+             AeJSONDocument document;
+             if (!document.parse(std::vector<char>(file.data.begin(), file.data.end()))) return result;
+             std::string content;
+             dumpJSONValue(document.getRoot(), content);
+             result.output.assign(content.begin(), content.end());
+             result.inputSize = file.data.size();
+             return result;
+         }},
+        {"json-query", "json", [](const QeCorpusFile &file) { return queryJSON(file, false); }},
+        {"json-query-path", "json", [](const QeCorpusFile &file) { return queryJSON(file, true); }},
+        {"cache-rgba8", "", [=](const QeCorpusFile &file) {
+             std::string key = file.name + "|rgba8";
+             std::vector<std::string> sources;
+             if (file.name.compare(0, 10, "synthetic/") != 0) sources.push_back(file.name);
+             AeCachedImage cached;
+             if (COM_IMAGE_CACHE.load(key, sources, cached)) {
+                 QeDecodeResult result;
+                 result.output.assign(cached.data, cached.data + cached.dataSize);
+                 result.width = cached.width;
+                 result.height = cached.height;
+                 result.bytes = cached.bytes;
+                 result.inputSize = cached.file.size();
+                 return result;
+             }
+             QeDecodeResult result = decodeImage(file, eImageFormat_RGBA8, file.type == "jpg", 1);
+             COM_IMAGE_CACHE.save(key, sources, result.output.data(), result.output.size(), result.width, result.height,
+                                  result.bytes, 1);
+             return result;
+         }},
+    };
+}
+
+std::vector<QeCorpusFile> loadCorpus(const char *texturePath, const char *xmlPath, const char *modelPath) {
+    std::vector<QeCorpusFile> corpus;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(texturePath, error)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".jpeg") extension = ".jpg";
+        if (extension != ".png" && extension != ".jpg" && extension != ".bmp") continue;
+
+        std::vector<char> data = COM_MGR.loadFile(entry.path().string().c_str());
+        corpus.push_back(
+            {entry.path().generic_string(), extension.substr(1), std::vector<unsigned char>(data.begin(), data.end())});
+    }
+    if (error) std::cout << texturePath << ": " << error.message() << "\n";
+    error.clear();
+    for (const auto &entry : std::filesystem::directory_iterator(xmlPath, error)) {
+        if (entry.path().extension().string() != ".xml") continue;
+        std::vector<char> data = COM_MGR.loadFile(entry.path().string().c_str());
+        corpus.push_back({entry.path().generic_string(), "xml", std::vector<unsigned char>(data.begin(), data.end())});
+    }
+    if (error) std::cout << xmlPath << ": " << error.message() << "\n";
+    error.clear();
+    for (const auto &entry : std::filesystem::directory_iterator(modelPath, error)) {
+        if (entry.path().extension().string() != ".gltf") continue;
+        std::vector<char> data = COM_MGR.loadFile(entry.path().string().c_str());
+        corpus.push_back({entry.path().generic_string(), "json", std::vector<unsigned char>(data.begin(), data.end())});
+    }
+    if (error) std::cout << modelPath << ": " << error.message() << "\n";
+    std::sort(corpus.begin(), corpus.end(), [](const QeCorpusFile &a, const QeCorpusFile &b) { return a.name < b.name; });
+
+    const int sizes[3] = {64, 512, 2048};
+    const char *colorNames[7] = {"grey", "", "rgb", "palette", "grey-alpha", "", "rgba"};
+    for (int size : sizes) {
+        for (int colorType : {0, 2, 3, 4, 6}) {
+            std::string name = "synthetic/" + std::to_string(size) + "-" + colorNames[colorType] + ".png";
+            corpus.push_back({name, "png", writeSyntheticPNG(size, size * 3 / 4, colorType, size + colorType)});
+        }
+        std::string prefix = "synthetic/" + std::to_string(size);
+        corpus.push_back({prefix + "-grey.jpg", "jpg", writeSyntheticJPEG(size, size * 3 / 4, 1, false, 0, size)});
+        corpus.push_back({prefix + "-444.jpg", "jpg", writeSyntheticJPEG(size, size * 3 / 4, 3, false, 0, size + 1)});
+        corpus.push_back({prefix + "-420.jpg", "jpg", writeSyntheticJPEG(size, size * 3 / 4, 3, true, 0, size + 2)});
+        corpus.push_back(
+            {prefix + "-420-restart.jpg", "jpg", writeSyntheticJPEG(size, size * 3 / 4, 3, true, size / 16, size + 3)});
+        corpus.push_back({prefix + "-24.bmp", "bmp", writeSyntheticBMP(size, size * 3 / 4, 24, size)});
+        corpus.push_back({prefix + "-32.bmp", "bmp", writeSyntheticBMP(size, size * 3 / 4, 32, size + 1)});
+    }
+    for (int objectNum : {100, 1000, 10000})
+        corpus.push_back(
+            {"synthetic/scene-" + std::to_string(objectNum) + ".xml", "xml", writeSyntheticScene(objectNum, objectNum)});
+    for (int nodeNum : {100, 1000, 10000})
+        corpus.push_back(
+            {"synthetic/model-" + std::to_string(nodeNum) + ".gltf", "json", writeSyntheticGLTF(nodeNum, nodeNum)});
+    corpus.push_back({"synthetic/wide-1000.gltf", "json", writeSyntheticGLTF(1000, 1000, true)});
+    return corpus;
+}
+
+std::map<std::string, uint64_t> loadReference(const char *path) {
+    std::map<std::string, uint64_t> reference;
+    std::ifstream file(path);
+    std::string key;
+    uint64_t hash;
+    while (file >> key >> std::hex >> hash) reference[key] = hash;
+    return reference;
+}
+
+int main(int argc, char *argv[]) {
+    const char *texturePath = "data/textures";
+    const char *xmlPath = "data";
+    const char *modelPath = "data/models";
+    const char *savePath = nullptr;
+    const char *verifyPath = nullptr;
+    int repeat = 5;
+    bool bVerbose = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--textures" && i + 1 < argc)
+            texturePath = argv[++i];
+        else if (arg == "--xml" && i + 1 < argc)
+            xmlPath = argv[++i];
+        else if (arg == "--models" && i + 1 < argc)
+            modelPath = argv[++i];
+        else if (arg == "--repeat" && i + 1 < argc)
+            repeat = std::max(1, atoi(argv[++i]));
+        else if (arg == "--save" && i + 1 < argc)
+            savePath = argv[++i];
+        else if (arg == "--verify" && i + 1 < argc)
+            verifyPath = argv[++i];
+        else if (arg == "--verbose")
+            bVerbose = true;
+        else {
+            std::cout << "usage: " << argv[0]
+                      << " [--textures dir] [--xml dir] [--models dir] [--repeat n] [--save file] [--verify file] [--verbose]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<QeCorpusFile> corpus = loadCorpus(texturePath, xmlPath, modelPath);
+    std::filesystem::path cachePath = std::filesystem::temp_directory_path() / "testCommon_cache";
+    std::error_code error;
+    std::filesystem::remove_all(cachePath, error);  // the first run of cache-rgba8 decodes and fills it
+    COM_IMAGE_CACHE.setDirectory(cachePath.string().c_str());
+    for (QeCorpusFile &file : corpus) {
+        unsigned char *buffer = file.data.data();
+        int bytes;
+        if (file.type == "png")
+            file.rgba = COM_ENCODE.decodePNG(buffer, file.data.size(), &file.width, &file.height, &bytes, eImageFormat_RGBA8);
+        else if (file.type == "jpg")
+            file.rgba = COM_ENCODE.decodeJPEG(buffer, file.data.size(), &file.width, &file.height, &bytes, eImageFormat_RGBA8);
+        else if (file.type == "bmp")
+            file.rgba = COM_ENCODE.decodeBMP(buffer, file.data.size(), &file.width, &file.height, &bytes, eImageFormat_RGBA8);
+        else if (file.type == "xml") {
+            std::string text(file.data.begin(), file.data.end());
+            int index = 0;
+            AeXMLNode *node = COM_ENCODE.decodeXML(text.c_str(), index);
+            AeXMLSnapshot::compile(node, 0, file.snapshot);
+            delete node;
+        }
+    }
+    std::vector<QeCodecStage> stages = getCodecStages();
+    std::map<std::string, uint64_t> reference;
+    if (verifyPath) reference = loadReference(verifyPath);
+    std::map<std::string, uint64_t> hashes;
+    int failed = 0;
+
+    std::printf("%-22s %5s %9s %9s %9s %8s %10s %10s %10s %10s\n", "stage", "files", "in MB", "out MB", "out MB/s", "MP/s",
+                "allocs", "alloc MB", "heap MB", "RSS MB");
+    for (const QeCodecStage &stage : stages) {
+        QeStageTotals totals;
+        for (const QeCorpusFile &file : corpus) {
+            if (stage.type[0] ? file.type != stage.type : file.type == "xml" || file.type == "json") continue;
+
+            // the first run counts allocations, the best of all runs is the time
+            resetPeakRSS();
+            size_t count = allocationStats.count, bytes = allocationStats.bytes, live = allocationStats.live;
+            allocationStats.peak = live;
+            double best = 0;
+            QeDecodeResult result;
+            for (int i = 0; i < repeat; ++i) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                QeDecodeResult decoded = stage.run(file);
+                std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+                if (i == 0) {
+                    totals.allocations += allocationStats.count - count;
+                    totals.allocatedBytes += allocationStats.bytes - bytes;
+                    totals.peakHeap = std::max(totals.peakHeap, allocationStats.peak - live);
+                    result = std::move(decoded);
+                }
+                best = i == 0 ? time.count() : std::min(best, time.count());
+            }
+            totals.peakRSS = std::max(totals.peakRSS, getPeakRSS());
+            double psnr = stage.psnr && !result.output.empty() ? stage.psnr(file, result) : 99;
+            totals.minPSNR = std::min(totals.minPSNR, psnr);
+            if (psnr < stage.minPSNR) {
+                ++failed;
+                std::printf("%s:%s: PSNR %.2f dB under %.2f\n", stage.name, file.name.c_str(), psnr, stage.minPSNR);
+            }
+
+            ++totals.files;
+            totals.inputBytes += result.inputSize;
+            totals.outputBytes += result.output.size();
+            totals.pixels += double(result.width) * result.height;
+            totals.milliseconds += best;
+
+            std::string key = std::string(stage.name) + ":" + file.name;
+            uint64_t hash = hashBytes(result.output.data(), result.output.size(),
+                                      hashBytes((const unsigned char *)&result.width, sizeof(int) * 3));
+            hashes[key] = hash;
+            bool bMatch = true;
+            if (verifyPath) {
+                auto it = reference.find(key);
+                bMatch = it != reference.end() && it->second == hash;
+                if (!bMatch) {
+                    ++failed;
+                    std::cout << key << (it == reference.end() ? ": no reference\n" : ": MISMATCH\n");
+                }
+            }
+            if (bVerbose && stage.psnr)
+                std::printf("  %-60s %5dx%-5d %8.3f ms %6.2f dB\n", file.name.c_str(), result.width, result.height, best, psnr);
+            else if (bVerbose)
+                std::printf("  %-60s %5dx%-5d %8.3f ms%s\n", file.name.c_str(), result.width, result.height, best,
+                            result.output.empty() ? " failed" : "");
+        }
+        if (totals.files == 0) continue;
+
+        const double megabyte = 1024.0 * 1024.0, seconds = totals.milliseconds / 1000.0;
+        std::printf("%-22s %5zu %9.2f %9.2f %9.1f %8.1f %10zu %10.2f %10.2f %10.1f\n", stage.name, totals.files,
+                    totals.inputBytes / megabyte, totals.outputBytes / megabyte, totals.outputBytes / megabyte / seconds,
+                    totals.pixels / 1e6 / seconds, totals.allocations, totals.allocatedBytes / megabyte,
+                    totals.peakHeap / megabyte, totals.peakRSS / 1024.0);
+        if (stage.psnr) std::printf("%-22s min PSNR %.2f dB\n", "", totals.minPSNR);
+    }
+
+    // the scalar and the SIMD unfilter have to agree whatever the reference says, and so do the XML DOMs, the snapshot,
+    // the XML reader, the XML saves and the XML and JSON queries
+    for (const auto &entry : hashes) {
+        if (entry.first.compare(0, 13, "png-unfilter:") == 0) {
+            auto scalar = hashes.find("png-unfilter-scalar:" + entry.first.substr(13));
+            if (scalar != hashes.end() && scalar->second != entry.second) {
+                ++failed;
+                std::cout << entry.first << ": scalar and SIMD unfilter differ\n";
+            }
+        } else if (entry.first.compare(0, 10, "xml-query:") == 0) {
+            auto path = hashes.find("xml-query-path:" + entry.first.substr(10));
+            if (path != hashes.end() && path->second != entry.second) {
+                ++failed;
+                std::cout << entry.first << ": compiled paths read other values\n";
+            }
+            auto snapshot = hashes.find("xml-query-snapshot:" + entry.first.substr(10));
+            if (snapshot != hashes.end() && snapshot->second != entry.second) {
+                ++failed;
+                std::cout << entry.first << ": the snapshot numbers read other values\n";
+            }
+        } else if (entry.first.compare(0, 14, "xml-save-full:") == 0) {
+            auto dirty = hashes.find("xml-save-dirty:" + entry.first.substr(14));
+            if (dirty != hashes.end() && dirty->second != entry.second) {
+                ++failed;
+                std::cout << entry.first << ": the dirty saves write another text\n";
+            }
+        } else if (entry.first.compare(0, 11, "json-query:") == 0) {
+            auto path = hashes.find("json-query-path:" + entry.first.substr(11));
+            if (path != hashes.end() && path->second != entry.second) {
+                ++failed;
+                std::cout << entry.first << ": JSON paths read other values\n";
+            }
+        } else if (entry.first.compare(0, 8, "xml-dom:") == 0) {
+            auto arena = hashes.find("xml-arena:" + entry.first.substr(8));
+            if (arena != hashes.end() && arena->second != entry.second) {
+                ++failed;
+                std::cout << entry.first << ": the arena DOM writes another document\n";
+            }
+            auto snapshot = hashes.find("xml-snapshot:" + entry.first.substr(8));
+            if (snapshot != hashes.end() && snapshot->second != entry.second) {
+                ++failed;
+                std::cout << entry.first << ": the snapshot loads another tree\n";
+            }
+            for (const char *reader : {"xml-reader:", "xml-reader-stream:"}) {
+                auto it = hashes.find(reader + entry.first.substr(8));
+                if (it != hashes.end() && it->second != entry.second) {
+                    ++failed;
+                    std::cout << entry.first << ": " << reader << " reads another tree\n";
+                }
+            }
+        }
+    }
+
+    if (savePath) {
+        std::ofstream file(savePath);
+        for (const auto &entry : hashes) file << entry.first << " " << std::hex << entry.second << "\n";
+        std::cout << "saved " << hashes.size() << " hashes to " << savePath << "\n";
+    }
+    if (verifyPath) std::cout << (failed ? "verify failed: " : "verify passed: ") << hashes.size() << " outputs\n";
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,1054 @@
+#include "common.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AE_SSE2
+#include <emmintrin.h>
+#endif
+
+SINGLETON_INSTANCE(AeTextureEncode)
+AeTextureEncode::AeTextureEncode() {}
+AeTextureEncode::~AeTextureEncode() {}
+
+unsigned int AeTextureEncode::getMipLevels(int width, int height) {
+    unsigned int levels = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1) ++levels;
+    return levels;
+}
+
+size_t AeTextureEncode::getMipmapSize(int width, int height, int bytes, unsigned int levels) {
+    size_t size = 0;
+    for (unsigned int level = 0; level < levels; ++level) {
+        size += size_t(width) * height * bytes;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return size;
+}
+
+// 8-bit value to linear float, and linear float to 8-bit through a 16-bit index.
+struct QeMipmapTables {
+    float toLinear[2][256];  // [bSRGB]
+    unsigned char fromLinear[2][65536];
+
+    QeMipmapTables() {
+        for (int i = 0; i < 256; ++i) {
+            float value = i / 255.0f;
+            toLinear[0][i] = value;
+            toLinear[1][i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 65536; ++i) {
+            float value = i / 65535.0f;
+            fromLinear[0][i] = (unsigned char)(value * 255.0f + 0.5f);
+            float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            fromLinear[1][i] = (unsigned char)(std::min(1.0f, srgb) * 255.0f + 0.5f);
+        }
+    }
+};
+
+const QeMipmapTables &getMipmapTables() {
+    static QeMipmapTables tables;
+    return tables;
+}
+
+// Source taps and weights of every destination pixel along one axis, the same count for each.
+struct QeMipmapKernel {
+    int taps = 0;
+    std::vector<int> indices;
+    std::vector<float> weights;
+};
+
+float getBesselI0(float x) {
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+QeMipmapKernel getMipmapKernel(int srcSize, int dstSize, AeMipmapFilter filter) {
+    const float scale = float(srcSize) / dstSize;
+    const float KAISER_WIDTH = 3.0f, KAISER_ALPHA = 4.0f;  // in destination pixels
+    const float support = filter == eMipmapFilter_kaiser ? KAISER_WIDTH * scale : scale / 2;
+
+    QeMipmapKernel kernel;
+    kernel.taps = int(std::ceil(support * 2)) + 1;
+    kernel.indices.resize(size_t(dstSize) * kernel.taps);
+    kernel.weights.resize(size_t(dstSize) * kernel.taps);
+    for (int i = 0; i < dstSize; ++i) {
+        const float center = (i + 0.5f) * scale;
+        const int first = int(std::floor(center - support));
+        float sum = 0;
+        for (int k = 0; k < kernel.taps; ++k) {
+            const int j = first + k;
+            float weight;
+            if (filter == eMipmapFilter_kaiser) {
+                float t = (j + 0.5f - center) / scale;
+                if (std::fabs(t) >= KAISER_WIDTH)
+                    weight = 0;
+                else {
+                    float sinc = t == 0 ? 1.0f : std::sin(3.14159265f * t) / (3.14159265f * t);
+                    float x = t / KAISER_WIDTH;
+                    weight = sinc * getBesselI0(KAISER_ALPHA * std::sqrt(1 - x * x)) / getBesselI0(KAISER_ALPHA);
+                }
+            } else  // the part of source pixel j the destination pixel covers
+                weight = std::max(0.0f, std::min(float(j + 1), center + support) - std::max(float(j), center - support));
+            kernel.indices[size_t(i) * kernel.taps + k] = std::min(std::max(j, 0), srcSize - 1);
+            kernel.weights[size_t(i) * kernel.taps + k] = weight;
+            sum += weight;
+        }
+        for (int k = 0; k < kernel.taps; ++k) kernel.weights[size_t(i) * kernel.taps + k] /= sum;
+    }
+    return kernel;
+}
+
+// 2x2 average with rounding, 4 bytes per pixel, even source size.
+void downsampleMipmapBox4(const unsigned char *src, int srcWidth, unsigned char *dst, int dstWidth, int row) {
+    const unsigned char *row0 = src + size_t(srcWidth) * 4 * (row * 2);
+    const unsigned char *row1 = row0 + size_t(srcWidth) * 4;
+    unsigned char *out = dst + size_t(dstWidth) * 4 * row;
+    int x = 0;
+#ifdef AE_SSE2
+    const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+    for (; x + 4 <= dstWidth; x += 4) {  // 8 source pixels to 4
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8)), a1 = _mm_loadu_si128((const __m128i *)(row0 + x * 8 + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x * 8)), b1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8 + 16));
+        __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));  // pixels 0, 1
+        __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));  // pixels 2, 3
+        __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+        __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+        __m128i p01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+        __m128i p23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+        p01 = _mm_srli_epi16(_mm_add_epi16(p01, two), 2);
+        p23 = _mm_srli_epi16(_mm_add_epi16(p23, two), 2);
+        _mm_storeu_si128((__m128i *)(out + x * 4), _mm_packus_epi16(p01, p23));
+    }
+#endif
+    for (; x < dstWidth; ++x) {
+        for (int c = 0; c < 4; ++c)
+            out[x * 4 + c] =
+                (unsigned char)((row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c] + 2) >> 2);
+    }
+}
+
+// Linear floats of a row back to 8 bits.
+void storeMipmapRow(unsigned char *out, float *values, size_t size, int bytes, const unsigned char *const *fromLinear) {
+    size_t i = 0;
+#ifdef AE_SSE2
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), scale = _mm_set1_ps(65535.0f), half = _mm_set1_ps(0.5f);
+    alignas(16) int32_t indices[4];
+    for (; bytes == 4 && i + 4 <= size; i += 4) {
+        __m128 value = _mm_min_ps(one, _mm_max_ps(zero, _mm_loadu_ps(values + i)));
+        _mm_store_si128((__m128i *)indices, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half)));
+        for (int c = 0; c < 4; ++c) out[i + c] = fromLinear[c][indices[c]];
+    }
+#endif
+    for (; i < size; i += bytes) {
+        for (int c = 0; c < bytes; ++c) {
+            float value = std::min(1.0f, std::max(0.0f, values[i + c]));
+            out[i + c] = fromLinear[c][int(value * 65535.0f + 0.5f)];
+        }
+    }
+}
+
+// 2x2 average in linear light, even source size.
+void downsampleMipmapBox(const unsigned char *src, int srcWidth, unsigned char *dst, int dstWidth, int bytes, bool bSRGB,
+                         int row) {
+    const QeMipmapTables &tables = getMipmapTables();
+    const float *toLinear[4];
+    const unsigned char *fromLinear[4];
+    for (int c = 0; c < bytes; ++c) {
+        bool bLinear = bSRGB && !(bytes == 4 && c == 3);
+        toLinear[c] = tables.toLinear[bLinear];
+        fromLinear[c] = tables.fromLinear[bLinear];
+    }
+
+    const size_t srcStride = size_t(srcWidth) * bytes, dstStride = size_t(dstWidth) * bytes;
+    const unsigned char *row0 = src + srcStride * (row * 2);
+    const unsigned char *row1 = row0 + srcStride;
+    float sums[4 * 64];
+    for (int x = 0; x < dstWidth; x += 64) {
+        const int count = std::min(64, dstWidth - x);
+        for (int i = 0; i < count; ++i) {
+            const size_t s = size_t(x + i) * 2 * bytes;
+            for (int c = 0; c < bytes; ++c) {
+                sums[i * bytes + c] = (toLinear[c][row0[s + c]] + toLinear[c][row0[s + bytes + c]] + toLinear[c][row1[s + c]] +
+                                       toLinear[c][row1[s + bytes + c]]) * 0.25f;
+            }
+        }
+        storeMipmapRow(dst + dstStride * row + size_t(x) * bytes, sums, size_t(count) * bytes, bytes, fromLinear);
+    }
+}
+
+// Rows first to last of the destination through the separable kernels, in linear float.
+void resampleMipmapRows(const unsigned char *src, int srcWidth, unsigned char *dst, int dstWidth, int bytes, bool bSRGB,
+                        const QeMipmapKernel &kernelX, const QeMipmapKernel &kernelY, int first, int last) {
+    const QeMipmapTables &tables = getMipmapTables();
+    const float *toLinear[4];
+    const unsigned char *fromLinear[4];
+    for (int c = 0; c < bytes; ++c) {
+        bool bLinear = bSRGB && !(bytes == 4 && c == 3);
+        toLinear[c] = tables.toLinear[bLinear];
+        fromLinear[c] = tables.fromLinear[bLinear];
+    }
+
+    // horizontal pass of every source row the destination rows read
+    int srcFirst = INT_MAX, srcLast = 0;
+    for (int y = first; y < last; ++y) {
+        for (int k = 0; k < kernelY.taps; ++k) {
+            srcFirst = std::min(srcFirst, kernelY.indices[size_t(y) * kernelY.taps + k]);
+            srcLast = std::max(srcLast, kernelY.indices[size_t(y) * kernelY.taps + k]);
+        }
+    }
+    const size_t srcStride = size_t(srcWidth) * bytes, dstStride = size_t(dstWidth) * bytes;
+    std::vector<float> line(srcStride);
+    std::vector<float> rows((srcLast - srcFirst + 1) * dstStride);
+    for (int sy = srcFirst; sy <= srcLast; ++sy) {
+        const unsigned char *in = src + srcStride * sy;
+        for (size_t i = 0; i < srcStride; i += bytes) {
+            for (int c = 0; c < bytes; ++c) line[i + c] = toLinear[c][in[i + c]];
+        }
+
+        float *out = rows.data() + (sy - srcFirst) * dstStride;
+        for (int x = 0; x < dstWidth; ++x) {
+            const int *indices = kernelX.indices.data() + size_t(x) * kernelX.taps;
+            const float *weights = kernelX.weights.data() + size_t(x) * kernelX.taps;
+#ifdef AE_SSE2
+            if (bytes == 4) {
+                __m128 sum = _mm_setzero_ps();
+                for (int k = 0; k < kernelX.taps; ++k)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(line.data() + indices[k] * 4)));
+                _mm_storeu_ps(out + x * 4, sum);
+                continue;
+            }
+#endif
+            for (int c = 0; c < bytes; ++c) {
+                float sum = 0;
+                for (int k = 0; k < kernelX.taps; ++k) sum += weights[k] * line[indices[k] * bytes + c];
+                out[x * bytes + c] = sum;
+            }
+        }
+    }
+
+    // vertical pass, then back to 8 bits
+    std::vector<float> sums(dstStride);
+    for (int y = first; y < last; ++y) {
+        const int *indices = kernelY.indices.data() + size_t(y) * kernelY.taps;
+        const float *weights = kernelY.weights.data() + size_t(y) * kernelY.taps;
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        for (int k = 0; k < kernelY.taps; ++k) {
+            const float *row = rows.data() + (indices[k] - srcFirst) * dstStride;
+            size_t i = 0;
+#ifdef AE_SSE2
+            const __m128 weight = _mm_set1_ps(weights[k]);
+            for (; i + 4 <= dstStride; i += 4)
+                _mm_storeu_ps(sums.data() + i,
+                              _mm_add_ps(_mm_loadu_ps(sums.data() + i), _mm_mul_ps(weight, _mm_loadu_ps(row + i))));
+#endif
+            for (; i < dstStride; ++i) sums[i] += weights[k] * row[i];
+        }
+        storeMipmapRow(dst + dstStride * y, sums.data(), dstStride, bytes, fromLinear);
+    }
+}
+
+void AeTextureEncode::generateMipmaps(unsigned char *chain, int width, int height, int bytes, unsigned int levels,
+                                      AeMipmapFilter filter, bool bSRGB, bool bParallel) {
+    if (bytes < 1 || bytes > 4) return;
+
+    const int BAND_ROWS = 32;
+    unsigned char *src = chain;
+    for (unsigned int level = 1; level < levels; ++level) {
+        const int dstWidth = std::max(1, width / 2), dstHeight = std::max(1, height / 2);
+        unsigned char *dst = src + size_t(width) * height * bytes;
+        const int bands = (dstHeight + BAND_ROWS - 1) / BAND_ROWS;
+
+        std::function<void(size_t)> band;
+        QeMipmapKernel kernelX, kernelY;
+        if (filter == eMipmapFilter_box && width % 2 == 0 && height % 2 == 0) {
+            band = [&](size_t i) {
+                int last = std::min(dstHeight, int(i + 1) * BAND_ROWS);
+                for (int y = int(i) * BAND_ROWS; y < last; ++y) {
+                    if (!bSRGB && bytes == 4)
+                        downsampleMipmapBox4(src, width, dst, dstWidth, y);
+                    else
+                        downsampleMipmapBox(src, width, dst, dstWidth, bytes, bSRGB, y);
+                }
+            };
+        } else {
+            kernelX = getMipmapKernel(width, dstWidth, filter);
+            kernelY = getMipmapKernel(height, dstHeight, filter);
+            band = [&](size_t i) {
+                resampleMipmapRows(src, width, dst, dstWidth, bytes, bSRGB, kernelX, kernelY, int(i) * BAND_ROWS,
+                                   std::min(dstHeight, int(i + 1) * BAND_ROWS));
+            };
+        }
+        if (bParallel && bands > 1)
+            COM_THREAD.parallelFor(bands, band);
+        else
+            for (int i = 0; i < bands; ++i) band(i);
+
+        src = dst;
+        width = dstWidth;
+        height = dstHeight;
+    }
+}
+
+size_t AeTextureEncode::getBlockBytes(AeBlockFormat format) {
+    switch (format) {
+        case eBlockFormat_BC1:
+        case eBlockFormat_BC4:
+            return 8;
+        case eBlockFormat_BC3:
+        case eBlockFormat_BC5:
+        case eBlockFormat_BC7:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t AeTextureEncode::getCompressedSize(int width, int height, AeBlockFormat format, unsigned int levels) {
+    size_t size = 0;
+    for (unsigned int level = 0; level < levels; ++level) {
+        size += size_t((width + 3) / 4) * ((height + 3) / 4) * getBlockBytes(format);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return size;
+}
+
+// A 4x4 block, channel after channel so SSE reads 4 pixels of one channel at once.
+struct QeBlockPixels {
+    alignas(16) float values[4][16];
+};
+
+// Nearest palette entry of every pixel over the first channels, with its squared distance.
+void selectBlockIndices(const float (*values)[16], int channels, const float (*palette)[4], int paletteSize,
+                        unsigned char *indices, float *errors) {
+#ifdef AE_SSE2
+    for (int i = 0; i < 16; i += 4) {
+        __m128 best = _mm_set1_ps(3.0e38f), bestIndex = _mm_setzero_ps();
+        for (int k = 0; k < paletteSize; ++k) {
+            __m128 distance = _mm_setzero_ps();
+            for (int c = 0; c < channels; ++c) {
+                __m128 diff = _mm_sub_ps(_mm_load_ps(values[c] + i), _mm_set1_ps(palette[k][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(diff, diff));
+            }
+            __m128 less = _mm_cmplt_ps(distance, best);
+            best = _mm_min_ps(distance, best);
+            bestIndex = _mm_or_ps(_mm_and_ps(less, _mm_set1_ps(float(k))), _mm_andnot_ps(less, bestIndex));
+        }
+        alignas(16) float found[4];
+        _mm_store_ps(found, bestIndex);
+        _mm_storeu_ps(errors + i, best);
+        for (int j = 0; j < 4; ++j) indices[i + j] = (unsigned char)found[j];
+    }
+#else
+    for (int i = 0; i < 16; ++i) {
+        errors[i] = 3.0e38f;
+        for (int k = 0; k < paletteSize; ++k) {
+            float distance = 0;
+            for (int c = 0; c < channels; ++c) distance += (values[c][i] - palette[k][c]) * (values[c][i] - palette[k][c]);
+            if (distance < errors[i]) {
+                errors[i] = distance;
+                indices[i] = (unsigned char)k;
+            }
+        }
+    }
+#endif
+}
+
+// Ends of the principal axis through the pixels not skipped, clamped to [0, 255].
+void getBlockAxisEndpoints(const float (*values)[16], int channels, const bool *bSkip, float *end0, float *end1) {
+    float mean[4] = {}, covariance[4][4] = {};
+    int count = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (bSkip && bSkip[i]) continue;
+        for (int c = 0; c < channels; ++c) mean[c] += values[c][i];
+        ++count;
+    }
+    if (count == 0) count = 1;
+    for (int c = 0; c < channels; ++c) mean[c] /= count;
+    for (int i = 0; i < 16; ++i) {
+        if (bSkip && bSkip[i]) continue;
+        for (int a = 0; a < channels; ++a)
+            for (int b = a; b < channels; ++b) covariance[a][b] += (values[a][i] - mean[a]) * (values[b][i] - mean[b]);
+    }
+    float axis[4] = {1, 1, 1, 1};
+    for (int iteration = 0; iteration < 8; ++iteration) {  // power iteration
+        float next[4] = {}, length = 0;
+        for (int a = 0; a < channels; ++a) {
+            for (int b = 0; b < channels; ++b) next[a] += covariance[std::min(a, b)][std::max(a, b)] * axis[b];
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if (length < 1e-6f) break;
+        for (int c = 0; c < channels; ++c) axis[c] = next[c] / length;
+    }
+    float length = 0;
+    for (int c = 0; c < channels; ++c) length += axis[c] * axis[c];
+    length = std::sqrt(length);
+    for (int c = 0; c < channels; ++c) axis[c] /= length;
+
+    float low = 0, high = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (bSkip && bSkip[i]) continue;
+        float t = 0;
+        for (int c = 0; c < channels; ++c) t += (values[c][i] - mean[c]) * axis[c];
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+    for (int c = 0; c < channels; ++c) {
+        end0[c] = std::min(255.0f, std::max(0.0f, mean[c] + low * axis[c]));
+        end1[c] = std::min(255.0f, std::max(0.0f, mean[c] + high * axis[c]));
+    }
+}
+
+// Least squares endpoints for the pixels not skipped, each at weight w between them; false when degenerate.
+bool solveBlockEndpoints(const float (*values)[16], int channels, const float *weights, const unsigned char *indices,
+                         const bool *bSkip, float *end0, float *end1) {
+    float aa = 0, ab = 0, bb = 0, x[4] = {}, y[4] = {};
+    for (int i = 0; i < 16; ++i) {
+        if (bSkip && bSkip[i]) continue;
+        float w = weights[indices[i]];
+        if (w < 0) continue;  // a constant palette entry
+        float a = 1 - w;
+        aa += a * a;
+        ab += a * w;
+        bb += w * w;
+        for (int c = 0; c < channels; ++c) {
+            x[c] += a * values[c][i];
+            y[c] += w * values[c][i];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) return false;
+    for (int c = 0; c < channels; ++c) {
+        end0[c] = std::min(255.0f, std::max(0.0f, (bb * x[c] - ab * y[c]) / determinant));
+        end1[c] = std::min(255.0f, std::max(0.0f, (aa * y[c] - ab * x[c]) / determinant));
+    }
+    return true;
+}
+
+int getBlockRefinements(AeBlockQuality quality) {
+    return quality == eBlockQuality_fast ? 0 : quality == eBlockQuality_normal ? 2 : 6;
+}
+
+// Little-endian bit packing of a block.
+struct QeBlockBits {
+    unsigned char *out;
+    int position = 0;
+
+    void write(uint32_t value, int bits) {
+        for (int i = 0; i < bits; ++i, ++position)
+            if ((value >> i) & 1) out[position >> 3] |= (unsigned char)(1 << (position & 7));
+    }
+};
+
+struct QeBlockBitsReader {
+    const unsigned char *in;
+    int position = 0;
+
+    uint32_t read(int bits) {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; ++i, ++position) value |= uint32_t((in[position >> 3] >> (position & 7)) & 1) << i;
+        return value;
+    }
+};
+
+// BC1
+
+void expandBC1Color(uint16_t color, int *rgb) {
+    int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+uint16_t packBC1Color(const float *rgb) {
+    int r = std::min(31, std::max(0, int(rgb[0] * 31 / 255 + 0.5f)));
+    int g = std::min(63, std::max(0, int(rgb[1] * 63 / 255 + 0.5f)));
+    int b = std::min(31, std::max(0, int(rgb[2] * 31 / 255 + 0.5f)));
+    return uint16_t((r << 11) | (g << 5) | b);
+}
+
+// The 4 colours a BC1 block decodes to; the 4th is transparent black in 3-colour mode.
+void getBC1Palette(uint16_t color0, uint16_t color1, bool bFourColors, unsigned char (*palette)[4]) {
+    int c0[3], c1[3];
+    expandBC1Color(color0, c0);
+    expandBC1Color(color1, c1);
+    for (int c = 0; c < 3; ++c) {
+        palette[0][c] = (unsigned char)c0[c];
+        palette[1][c] = (unsigned char)c1[c];
+        palette[2][c] = (unsigned char)(bFourColors ? (2 * c0[c] + c1[c]) / 3 : (c0[c] + c1[c]) / 2);
+        palette[3][c] = (unsigned char)(bFourColors ? (c0[c] + 2 * c1[c]) / 3 : 0);
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = bFourColors ? 255 : 0;
+}
+
+// Endpoints whose 2/3 interpolant is closest to every 5 and 6 bit value, for blocks of one colour.
+struct QeBC1SolidTables {
+    unsigned char match5[256][2], match6[256][2];
+
+    QeBC1SolidTables() {
+        fill(match5, 31, [](int v) { return (v << 3) | (v >> 2); });
+        fill(match6, 63, [](int v) { return (v << 2) | (v >> 4); });
+    }
+
+    template <class Expand>
+    static void fill(unsigned char (*match)[2], int maximum, Expand expand) {
+        for (int value = 0; value < 256; ++value) {
+            int best = 1 << 30;
+            for (int a = 0; a <= maximum; ++a)
+                for (int b = 0; b <= maximum; ++b) {
+                    int error = std::abs((2 * expand(a) + expand(b)) / 3 - value);
+                    if (error < best) {
+                        best = error;
+                        match[value][0] = (unsigned char)a;
+                        match[value][1] = (unsigned char)b;
+                    }
+                }
+        }
+    }
+};
+
+const QeBC1SolidTables &getBC1SolidTables() {
+    static QeBC1SolidTables tables;
+    return tables;
+}
+
+struct QeBC1Candidate {
+    uint16_t color0 = 0, color1 = 0;
+    unsigned char indices[16] = {};
+    float error = 3.0e38f;
+};
+
+// Orders the endpoints for the mode, then picks indices; skipped pixels take the transparent entry.
+void evaluateBC1(const QeBlockPixels &pixels, const bool *bSkip, bool bFourColors, uint16_t color0, uint16_t color1,
+                 QeBC1Candidate &best) {
+    if (bFourColors ? color0 < color1 : color0 > color1) std::swap(color0, color1);
+    unsigned char palette8[4][4];
+    getBC1Palette(color0, color1, bFourColors, palette8);
+    float palette[4][4];
+    for (int k = 0; k < 4; ++k)
+        for (int c = 0; c < 3; ++c) palette[k][c] = palette8[k][c];
+
+    QeBC1Candidate candidate;
+    candidate.color0 = color0;
+    candidate.color1 = color1;
+    float errors[16];
+    selectBlockIndices(pixels.values, 3, palette, bFourColors ? 4 : 3, candidate.indices, errors);
+    candidate.error = 0;
+    for (int i = 0; i < 16; ++i) {
+        if (bSkip && bSkip[i])
+            candidate.indices[i] = 3;
+        else
+            candidate.error += errors[i];
+    }
+    if (candidate.error < best.error) best = candidate;
+}
+
+void encodeBC1Block(const QeBlockPixels &pixels, bool bPunchThrough, AeBlockQuality quality, unsigned char *out) {
+    bool bSkip[16] = {};
+    int transparent = 0;
+    if (bPunchThrough)
+        for (int i = 0; i < 16; ++i)
+            if (pixels.values[3][i] < 128) {
+                bSkip[i] = true;
+                ++transparent;
+            }
+
+    QeBC1Candidate best;
+    const bool bFourColors = transparent == 0;
+    if (transparent == 16) {
+        best.color0 = best.color1 = 0;
+        for (int i = 0; i < 16; ++i) best.indices[i] = 3;
+    } else {
+        int first = 0;
+        while (bSkip[first]) ++first;
+        bool bSolid = true;
+        for (int i = first + 1; i < 16 && bSolid; ++i)
+            if (!bSkip[i])
+                for (int c = 0; c < 3; ++c) bSolid = bSolid && pixels.values[c][i] == pixels.values[c][first];
+        if (bSolid) {
+            const QeBC1SolidTables &tables = getBC1SolidTables();
+            int r = int(pixels.values[0][first]), g = int(pixels.values[1][first]), b = int(pixels.values[2][first]);
+            uint16_t color0 = uint16_t((tables.match5[r][0] << 11) | (tables.match6[g][0] << 5) | tables.match5[b][0]);
+            uint16_t color1 = uint16_t((tables.match5[r][1] << 11) | (tables.match6[g][1] << 5) | tables.match5[b][1]);
+            if (bFourColors) evaluateBC1(pixels, bSkip, true, color0, color1, best);
+            float rgb[3] = {float(r), float(g), float(b)};
+            evaluateBC1(pixels, bSkip, bFourColors, packBC1Color(rgb), packBC1Color(rgb), best);
+        } else {
+            float end0[4], end1[4];
+            getBlockAxisEndpoints(pixels.values, 3, bSkip, end0, end1);
+            evaluateBC1(pixels, bSkip, bFourColors, packBC1Color(end0), packBC1Color(end1), best);
+
+            // palette entries as weights from color0 to color1
+            const float FOUR_WEIGHTS[4] = {0, 1, 1 / 3.0f, 2 / 3.0f}, THREE_WEIGHTS[4] = {0, 1, 0.5f, -1};
+            for (int i = getBlockRefinements(quality); i > 0; --i) {
+                QeBC1Candidate last = best;
+                if (!solveBlockEndpoints(pixels.values, 3, bFourColors ? FOUR_WEIGHTS : THREE_WEIGHTS, best.indices, bSkip,
+                                         end0, end1))
+                    break;
+                evaluateBC1(pixels, bSkip, bFourColors, packBC1Color(end0), packBC1Color(end1), best);
+                if (best.error >= last.error) break;
+            }
+        }
+    }
+
+    out[0] = (unsigned char)best.color0;
+    out[1] = (unsigned char)(best.color0 >> 8);
+    out[2] = (unsigned char)best.color1;
+    out[3] = (unsigned char)(best.color1 >> 8);
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; ++i) bits |= uint32_t(best.indices[i]) << (i * 2);
+    for (int i = 0; i < 4; ++i) out[4 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+void decodeBC1Block(const unsigned char *in, bool bAlwaysFour, unsigned char (*pixels)[4]) {
+    uint16_t color0 = uint16_t(in[0] | (in[1] << 8)), color1 = uint16_t(in[2] | (in[3] << 8));
+    unsigned char palette[4][4];
+    getBC1Palette(color0, color1, bAlwaysFour || color0 > color1, palette);
+    uint32_t bits = uint32_t(in[4]) | (uint32_t(in[5]) << 8) | (uint32_t(in[6]) << 16) | (uint32_t(in[7]) << 24);
+    for (int i = 0; i < 16; ++i) memcpy(pixels[i], palette[(bits >> (i * 2)) & 3], 4);
+}
+
+// BC4
+
+// The 8 values a BC4 block decodes to: interpolated between the ends, or 6 of them then 0 and 255.
+void getBC4Palette(int value0, int value1, int *palette) {
+    palette[0] = value0;
+    palette[1] = value1;
+    if (value0 > value1)
+        for (int i = 1; i < 7; ++i) palette[i + 1] = ((7 - i) * value0 + i * value1 + 3) / 7;
+    else {
+        for (int i = 1; i < 5; ++i) palette[i + 1] = ((5 - i) * value0 + i * value1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+struct QeBC4Candidate {
+    int value0 = 0, value1 = 0;
+    unsigned char indices[16] = {};
+    float error = 3.0e38f;
+};
+
+void evaluateBC4(const float *values, int value0, int value1, QeBC4Candidate &best) {
+    int palette8[8];
+    getBC4Palette(value0, value1, palette8);
+    float palette[8][4];
+    for (int k = 0; k < 8; ++k) palette[k][0] = float(palette8[k]);
+    QeBC4Candidate candidate;
+    candidate.value0 = value0;
+    candidate.value1 = value1;
+    float errors[16];
+    selectBlockIndices((const float(*)[16])values, 1, palette, 8, candidate.indices, errors);
+    candidate.error = 0;
+    for (int i = 0; i < 16; ++i) candidate.error += errors[i];
+    if (candidate.error < best.error) best = candidate;
+}
+
+void encodeBC4Block(const float *values, AeBlockQuality quality, unsigned char *out) {
+    float low = values[0], high = values[0];
+    for (int i = 1; i < 16; ++i) {
+        low = std::min(low, values[i]);
+        high = std::max(high, values[i]);
+    }
+    QeBC4Candidate best;
+    if (low == high)
+        evaluateBC4(values, int(low), int(low), best);
+    else {
+        evaluateBC4(values, int(high), int(low), best);
+        const float EIGHT_WEIGHTS[8] = {0, 1, 1 / 7.0f, 2 / 7.0f, 3 / 7.0f, 4 / 7.0f, 5 / 7.0f, 6 / 7.0f};
+        for (int i = getBlockRefinements(quality); i > 0; --i) {
+            float end0, end1;
+            QeBC4Candidate last = best;
+            if (!solveBlockEndpoints((const float(*)[16])values, 1, EIGHT_WEIGHTS, best.indices, nullptr, &end0, &end1))
+                break;
+            int value0 = int(end0 + 0.5f), value1 = int(end1 + 0.5f);
+            if (value0 == value1) break;
+            if (value0 < value1) std::swap(value0, value1);  // the index weights flip with the ends
+            evaluateBC4(values, value0, value1, best);
+            if (best.error >= last.error) break;
+        }
+        if (quality == eBlockQuality_high) {  // 6 values between the inner extremes, and exact 0 and 255
+            float innerLow = 255, innerHigh = 0;
+            for (int i = 0; i < 16; ++i)
+                if (values[i] > 0 && values[i] < 255) {
+                    innerLow = std::min(innerLow, values[i]);
+                    innerHigh = std::max(innerHigh, values[i]);
+                }
+            if (innerLow <= innerHigh) evaluateBC4(values, int(innerLow), int(innerHigh), best);
+        }
+    }
+
+    out[0] = (unsigned char)best.value0;
+    out[1] = (unsigned char)best.value1;
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; ++i) bits |= uint64_t(best.indices[i]) << (i * 3);
+    for (int i = 0; i < 6; ++i) out[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+void decodeBC4Block(const unsigned char *in, unsigned char (*pixels)[4], int channel) {
+    int palette[8];
+    getBC4Palette(in[0], in[1], palette);
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; ++i) bits |= uint64_t(in[2 + i]) << (i * 8);
+    for (int i = 0; i < 16; ++i) pixels[i][channel] = (unsigned char)palette[(bits >> (i * 3)) & 7];
+}
+
+// BC7, modes 5 and 6
+
+const float BC7_WEIGHTS2[4] = {0, 21, 43, 64};
+const float BC7_WEIGHTS3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+const float BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+int interpolateBC7(int value0, int value1, float weight) {
+    int w = int(weight);
+    return ((64 - w) * value0 + w * value1 + 32) >> 6;
+}
+
+struct QeBC7Candidate {
+    int mode = 6;
+    int rotation = 0;
+    int color[2][4] = {};  // stored endpoint bits, p-bit included for mode 6
+    int alpha[2] = {};     // mode 5
+    unsigned char indices[16] = {}, alphaIndices[16] = {};
+    float error = 3.0e38f;
+};
+
+// Mode 6: 7-bit RGBA endpoints with a p-bit each and 4-bit indices.
+void evaluateBC7Mode6(const QeBlockPixels &pixels, const float *end0, const float *end1, bool bSearchBits,
+                      QeBC7Candidate &best) {
+    for (int bits = 0; bits < 4; ++bits) {
+        int pbit[2] = {bits & 1, bits >> 1};
+        QeBC7Candidate candidate;
+        const float *ends[2] = {end0, end1};
+        if (!bSearchBits) {  // the p-bit each endpoint rounds closest with
+            if (bits) break;
+            for (int e = 0; e < 2; ++e) {
+                float error[2] = {};
+                for (int p = 0; p < 2; ++p)
+                    for (int c = 0; c < 4; ++c) {
+                        int q = std::min(127, std::max(0, int((ends[e][c] - p) / 2 + 0.5f)));
+                        error[p] += (q * 2 + p - ends[e][c]) * (q * 2 + p - ends[e][c]);
+                    }
+                pbit[e] = error[1] < error[0];
+            }
+        }
+        float palette[16][4];
+        int expanded[2][4];
+        for (int e = 0; e < 2; ++e)
+            for (int c = 0; c < 4; ++c) {
+                int q = std::min(127, std::max(0, int((ends[e][c] - pbit[e]) / 2 + 0.5f)));
+                candidate.color[e][c] = q * 2 + pbit[e];
+                expanded[e][c] = candidate.color[e][c];
+            }
+        for (int k = 0; k < 16; ++k)
+            for (int c = 0; c < 4; ++c) palette[k][c] = float(interpolateBC7(expanded[0][c], expanded[1][c], BC7_WEIGHTS4[k]));
+        float errors[16];
+        selectBlockIndices(pixels.values, 4, palette, 16, candidate.indices, errors);
+        candidate.error = 0;
+        for (int i = 0; i < 16; ++i) candidate.error += errors[i];
+        if (candidate.error < best.error) best = candidate;
+    }
+}
+
+void encodeBC7Mode6(const QeBlockPixels &pixels, AeBlockQuality quality, QeBC7Candidate &best) {
+    float end0[4], end1[4];
+    getBlockAxisEndpoints(pixels.values, 4, nullptr, end0, end1);
+    const bool bSearchBits = quality == eBlockQuality_high;
+    QeBC7Candidate mode6;
+    evaluateBC7Mode6(pixels, end0, end1, bSearchBits, mode6);
+
+    float weights[16];
+    for (int k = 0; k < 16; ++k) weights[k] = BC7_WEIGHTS4[k] / 64;
+    for (int i = getBlockRefinements(quality); i > 0; --i) {
+        float last = mode6.error;
+        if (!solveBlockEndpoints(pixels.values, 4, weights, mode6.indices, nullptr, end0, end1)) break;
+        evaluateBC7Mode6(pixels, end0, end1, bSearchBits, mode6);
+        if (mode6.error >= last) break;
+    }
+    if (mode6.error < best.error) best = mode6;
+}
+
+// Mode 5: the channel swapped with alpha by rotation gets its own 8-bit endpoints, 7-bit RGB; 2-bit indices for both.
+void encodeBC7Mode5(const QeBlockPixels &source, int rotation, AeBlockQuality quality, QeBC7Candidate &best) {
+    QeBlockPixels pixels = source;
+    if (rotation) std::swap(pixels.values[rotation - 1], pixels.values[3]);
+
+    QeBC7Candidate candidate;
+    candidate.mode = 5;
+    candidate.rotation = rotation;
+    float weights[4];
+    for (int k = 0; k < 4; ++k) weights[k] = BC7_WEIGHTS2[k] / 64;
+
+    float end0[4], end1[4], colorError = 3.0e38f;
+    getBlockAxisEndpoints(pixels.values, 3, nullptr, end0, end1);
+    for (int i = 0; i <= getBlockRefinements(quality); ++i) {
+        if (i > 0 && !solveBlockEndpoints(pixels.values, 3, weights, candidate.indices, nullptr, end0, end1)) break;
+        int color[2][4], expanded[2][4];
+        for (int c = 0; c < 3; ++c) {
+            color[0][c] = std::min(127, std::max(0, int(end0[c] * 127 / 255 + 0.5f)));
+            color[1][c] = std::min(127, std::max(0, int(end1[c] * 127 / 255 + 0.5f)));
+            for (int e = 0; e < 2; ++e) expanded[e][c] = (color[e][c] << 1) | (color[e][c] >> 6);
+        }
+        float palette[4][4];
+        for (int k = 0; k < 4; ++k)
+            for (int c = 0; c < 3; ++c) palette[k][c] = float(interpolateBC7(expanded[0][c], expanded[1][c], BC7_WEIGHTS2[k]));
+        unsigned char indices[16];
+        float errors[16], error = 0;
+        selectBlockIndices(pixels.values, 3, palette, 4, indices, errors);
+        for (int j = 0; j < 16; ++j) error += errors[j];
+        if (error >= colorError) break;
+        colorError = error;
+        memcpy(candidate.color, color, sizeof(color));
+        memcpy(candidate.indices, indices, sizeof(indices));
+    }
+
+    float low = pixels.values[3][0], high = pixels.values[3][0], alphaError = 3.0e38f;
+    for (int i = 1; i < 16; ++i) {
+        low = std::min(low, pixels.values[3][i]);
+        high = std::max(high, pixels.values[3][i]);
+    }
+    const float(*alphaValues)[16] = pixels.values + 3;
+    for (int i = 0; i <= getBlockRefinements(quality); ++i) {
+        if (i > 0 && !solveBlockEndpoints(alphaValues, 1, weights, candidate.alphaIndices, nullptr, &low, &high)) break;
+        int alpha[2] = {int(low + 0.5f), int(high + 0.5f)};
+        float palette[4][4];
+        for (int k = 0; k < 4; ++k) palette[k][0] = float(interpolateBC7(alpha[0], alpha[1], BC7_WEIGHTS2[k]));
+        unsigned char indices[16];
+        float errors[16], error = 0;
+        selectBlockIndices(alphaValues, 1, palette, 4, indices, errors);
+        for (int j = 0; j < 16; ++j) error += errors[j];
+        if (error >= alphaError) break;
+        alphaError = error;
+        candidate.alpha[0] = alpha[0];
+        candidate.alpha[1] = alpha[1];
+        memcpy(candidate.alphaIndices, indices, sizeof(indices));
+    }
+    candidate.error = colorError + alphaError;
+    if (candidate.error < best.error) best = candidate;
+}
+
+void encodeBC7Block(const QeBlockPixels &pixels, AeBlockQuality quality, unsigned char *out) {
+    QeBC7Candidate best;
+    encodeBC7Mode6(pixels, quality, best);
+    if (quality == eBlockQuality_high && best.error > 0)
+        for (int rotation = 0; rotation < 4; ++rotation) encodeBC7Mode5(pixels, rotation, quality, best);
+
+    // the first index drops its top bit, so it has to be in the lower half; flipping the ends mirrors the indices
+    memset(out, 0, 16);
+    QeBlockBits bits = {out};
+    if (best.mode == 6) {
+        if (best.indices[0] >= 8) {
+            std::swap(best.color[0], best.color[1]);
+            for (int i = 0; i < 16; ++i) best.indices[i] = (unsigned char)(15 - best.indices[i]);
+        }
+        bits.write(1 << 6, 7);
+        for (int c = 0; c < 4; ++c)
+            for (int e = 0; e < 2; ++e) bits.write(best.color[e][c] >> 1, 7);
+        bits.write(best.color[0][0] & 1, 1);
+        bits.write(best.color[1][0] & 1, 1);
+        bits.write(best.indices[0], 3);
+        for (int i = 1; i < 16; ++i) bits.write(best.indices[i], 4);
+    } else {
+        if (best.indices[0] >= 2) {
+            std::swap(best.color[0], best.color[1]);
+            for (int i = 0; i < 16; ++i) best.indices[i] = (unsigned char)(3 - best.indices[i]);
+        }
+        if (best.alphaIndices[0] >= 2) {
+            std::swap(best.alpha[0], best.alpha[1]);
+            for (int i = 0; i < 16; ++i) best.alphaIndices[i] = (unsigned char)(3 - best.alphaIndices[i]);
+        }
+        bits.write(1 << 5, 6);
+        bits.write(best.rotation, 2);
+        for (int c = 0; c < 3; ++c)
+            for (int e = 0; e < 2; ++e) bits.write(best.color[e][c], 7);
+        bits.write(best.alpha[0], 8);
+        bits.write(best.alpha[1], 8);
+        bits.write(best.indices[0], 1);
+        for (int i = 1; i < 16; ++i) bits.write(best.indices[i], 2);
+        bits.write(best.alphaIndices[0], 1);
+        for (int i = 1; i < 16; ++i) bits.write(best.alphaIndices[i], 2);
+    }
+}
+
+void decodeBC7Block(const unsigned char *in, unsigned char (*pixels)[4]) {
+    int mode = 0;
+    while (mode < 8 && !((in[0] >> mode) & 1)) ++mode;
+    memset(pixels, 0, 64);
+    if (mode < 4 || mode > 6) return;
+
+    QeBlockBitsReader bits = {in, mode + 1};
+    int rotation = 0, indexMode = 0, color[2][4], colorBits = mode == 4 ? 5 : 7, alphaBits = mode == 4 ? 6 : mode == 5 ? 8 : 7;
+    if (mode != 6) rotation = int(bits.read(2));
+    if (mode == 4) indexMode = int(bits.read(1));
+    for (int c = 0; c < 4; ++c)
+        for (int e = 0; e < 2; ++e) color[e][c] = int(bits.read(c < 3 ? colorBits : alphaBits));
+    if (mode == 6) {
+        for (int e = 0; e < 2; ++e) {
+            int pbit = int(bits.read(1));
+            for (int c = 0; c < 4; ++c) color[e][c] = color[e][c] << 1 | pbit;
+        }
+    } else {
+        for (int e = 0; e < 2; ++e) {
+            for (int c = 0; c < 3; ++c) color[e][c] = color[e][c] << (8 - colorBits) | color[e][c] >> (2 * colorBits - 8);
+            color[e][3] = color[e][3] << (8 - alphaBits) | color[e][3] >> (2 * alphaBits - 8);
+        }
+    }
+
+    // mode 4 and 5 carry a second index set; mode 4 stores the 2-bit set first and picks which one colour uses
+    int indexBits[2] = {mode == 6 ? 4 : 2, mode == 4 ? 3 : 2}, indices[2][16] = {};
+    for (int set = 0; set < (mode == 6 ? 1 : 2); ++set)
+        for (int i = 0; i < 16; ++i) indices[set][i] = int(bits.read(i == 0 ? indexBits[set] - 1 : indexBits[set]));
+
+    auto weight = [](int indexBits, int index) {
+        return indexBits == 2 ? BC7_WEIGHTS2[index] : indexBits == 3 ? BC7_WEIGHTS3[index] : BC7_WEIGHTS4[index];
+    };
+    for (int i = 0; i < 16; ++i) {
+        int colorSet = indexMode, alphaSet = mode == 6 ? 0 : 1 - indexMode;
+        for (int c = 0; c < 4; ++c) {
+            int set = c < 3 ? colorSet : alphaSet;
+            pixels[i][c] = (unsigned char)interpolateBC7(color[0][c], color[1][c], weight(indexBits[set], indices[set][i]));
+        }
+        if (rotation) std::swap(pixels[i][rotation - 1], pixels[i][3]);
+    }
+}
+
+// Block layout of one mip level
+
+void loadBlockPixels(const unsigned char *src, int width, int height, int blockX, int blockY, QeBlockPixels &pixels) {
+    for (int y = 0; y < 4; ++y) {
+        const unsigned char *row = src + size_t(std::min(blockY * 4 + y, height - 1)) * width * 4;
+        for (int x = 0; x < 4; ++x) {
+            const unsigned char *pixel = row + size_t(std::min(blockX * 4 + x, width - 1)) * 4;
+            for (int c = 0; c < 4; ++c) pixels.values[c][y * 4 + x] = pixel[c];
+        }
+    }
+}
+
+void encodeBlock(const QeBlockPixels &pixels, AeBlockFormat format, AeBlockQuality quality, unsigned char *out) {
+    switch (format) {
+        case eBlockFormat_BC1:
+            encodeBC1Block(pixels, true, quality, out);
+            break;
+        case eBlockFormat_BC3:
+            encodeBC4Block(pixels.values[3], quality, out);
+            encodeBC1Block(pixels, false, quality, out + 8);
+            break;
+        case eBlockFormat_BC4:
+            encodeBC4Block(pixels.values[0], quality, out);
+            break;
+        case eBlockFormat_BC5:
+            encodeBC4Block(pixels.values[0], quality, out);
+            encodeBC4Block(pixels.values[1], quality, out + 8);
+            break;
+        case eBlockFormat_BC7:
+            encodeBC7Block(pixels, quality, out);
+            break;
+        default:
+            break;
+    }
+}
+
+void decodeBlock(const unsigned char *in, AeBlockFormat format, unsigned char (*pixels)[4]) {
+    for (int i = 0; i < 16; ++i) {
+        pixels[i][0] = pixels[i][1] = pixels[i][2] = 0;
+        pixels[i][3] = 255;
+    }
+    switch (format) {
+        case eBlockFormat_BC1:
+            decodeBC1Block(in, false, pixels);
+            break;
+        case eBlockFormat_BC3:
+            decodeBC1Block(in + 8, true, pixels);
+            decodeBC4Block(in, pixels, 3);
+            break;
+        case eBlockFormat_BC4:
+            decodeBC4Block(in, pixels, 0);
+            break;
+        case eBlockFormat_BC5:
+            decodeBC4Block(in, pixels, 0);
+            decodeBC4Block(in + 8, pixels, 1);
+            break;
+        case eBlockFormat_BC7:
+            decodeBC7Block(in, pixels);
+            break;
+        default:
+            break;
+    }
+}
+
+std::vector<unsigned char> AeTextureEncode::encodeBlocks(const unsigned char *chain, int width, int height,
+                                                         unsigned int levels, AeBlockFormat format, AeBlockQuality quality,
+                                                         bool bParallel) {
+    std::vector<unsigned char> blocks(getCompressedSize(width, height, format, levels));
+    encodeBlocks(chain, width, height, levels, format, blocks.data(), quality, bParallel);
+    return blocks;
+}
+
+void AeTextureEncode::encodeBlocks(const unsigned char *chain, int width, int height, unsigned int levels,
+                                   AeBlockFormat format, unsigned char *out, AeBlockQuality quality, bool bParallel) {
+    const size_t blockBytes = getBlockBytes(format);
+    if (blockBytes == 0) return;
+    for (unsigned int level = 0; level < levels; ++level) {
+        const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        auto row = [&, chain, out, width, height](size_t y) {
+            QeBlockPixels pixels;
+            for (int x = 0; x < blocksX; ++x) {
+                loadBlockPixels(chain, width, height, x, int(y), pixels);
+                encodeBlock(pixels, format, quality, out + (y * blocksX + x) * blockBytes);
+            }
+        };
+        if (bParallel && blocksY > 1)
+            COM_THREAD.parallelFor(blocksY, row);
+        else
+            for (int y = 0; y < blocksY; ++y) row(y);
+
+        chain += size_t(width) * height * 4;
+        out += size_t(blocksX) * blocksY * blockBytes;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+}
+
+std::vector<unsigned char> AeTextureEncode::decodeBlocks(const unsigned char *blocks, int width, int height,
+                                                         unsigned int levels, AeBlockFormat format) {
+    std::vector<unsigned char> chain(getMipmapSize(width, height, 4, levels));
+    const size_t blockBytes = getBlockBytes(format);
+    if (blockBytes == 0) return chain;
+    unsigned char *out = chain.data();
+    for (unsigned int level = 0; level < levels; ++level) {
+        const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        for (int blockY = 0; blockY < blocksY; ++blockY)
+            for (int blockX = 0; blockX < blocksX; ++blockX, blocks += blockBytes) {
+                unsigned char pixels[16][4];
+                decodeBlock(blocks, format, pixels);
+                for (int y = 0; y < 4 && blockY * 4 + y < height; ++y)
+                    for (int x = 0; x < 4 && blockX * 4 + x < width; ++x)
+                        memcpy(out + (size_t(blockY * 4 + y) * width + blockX * 4 + x) * 4, pixels[y * 4 + x], 4);
+            }
+        out += size_t(width) * height * 4;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return chain;
+}
+
+double AeTextureEncode::getPSNR(const unsigned char *a, const unsigned char *b, size_t pixels, unsigned int channelMask) {
+    double sum = 0;
+    size_t count = 0;
+    for (int c = 0; c < 4; ++c) {
+        if (!((channelMask >> c) & 1)) continue;
+        for (size_t i = 0; i < pixels; ++i) {
+            int diff = int(a[i * 4 + c]) - int(b[i * 4 + c]);
+            sum += diff * diff;
+        }
+        count += pixels;
+    }
+    if (count == 0 || sum == 0) return 99.0;  // identical
+    return std::min(99.0, 10 * std::log10(255.0 * 255.0 * count / sum));
+}
@@ -0,0 +1,108 @@
+#include "common.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+
+SINGLETON_INSTANCE(AeThreadPool)
+
+// One parallelFor call. Threads claim indices until none are left; the last one to finish wakes the caller.
+struct QeThreadJob {
+    const std::function<void(size_t)> *task = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+struct QeThreadPoolData {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<QeThreadJob>> jobs;
+    bool bStop = false;
+};
+
+void runThreadJob(QeThreadJob &job) {
+    size_t count = 0;
+    for (size_t i = job.next++; i < job.count; i = job.next++, ++count) (*job.task)(i);
+    if (count > 0 && job.done.fetch_add(count) + count == job.count) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.finished.notify_all();
+    }
+}
+
+void removeThreadJob(QeThreadPoolData &data, const std::shared_ptr<QeThreadJob> &job) {
+    std::lock_guard<std::mutex> lock(data.mutex);
+    for (auto it = data.jobs.begin(); it != data.jobs.end(); ++it) {
+        if (*it == job) {
+            data.jobs.erase(it);
+            break;
+        }
+    }
+}
+
+void runThreadWorker(QeThreadPoolData *data) {
+    while (1) {
+        std::shared_ptr<QeThreadJob> job;
+        {
+            std::unique_lock<std::mutex> lock(data->mutex);
+            data->wake.wait(lock, [data] { return data->bStop || !data->jobs.empty(); });
+            if (data->bStop) return;
+            job = data->jobs.front();
+            if (job->next >= job->count) {  // every index is taken, the owner removes it when done
+                data->jobs.pop_front();
+                continue;
+            }
+        }
+        runThreadJob(*job);
+    }
+}
+
+AeThreadPool::AeThreadPool() : data(new QeThreadPoolData()) {
+    unsigned int count = std::thread::hardware_concurrency();
+    for (unsigned int i = 1; i < count; ++i) data->threads.emplace_back(runThreadWorker, data);
+}
+
+AeThreadPool::~AeThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(data->mutex);
+        data->bStop = true;
+    }
+    data->wake.notify_all();
+    for (std::thread &thread : data->threads) thread.join();
+    delete data;
+    data = nullptr;
+}
+
+size_t AeThreadPool::getThreadCount() { return data->threads.size() + 1; }
+
+void AeThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &task) {
+    if (count == 0) return;
+    if (count == 1 || data->threads.empty()) {
+        for (size_t i = 0; i < count; ++i) task(i);
+        return;
+    }
+
+    std::shared_ptr<QeThreadJob> job = std::make_shared<QeThreadJob>();
+    job->task = &task;
+    job->count = count;
+    {
+        std::lock_guard<std::mutex> lock(data->mutex);
+        data->jobs.push_back(job);
+    }
+    if (count - 1 >= data->threads.size())
+        data->wake.notify_all();
+    else
+        for (size_t i = 1; i < count; ++i) data->wake.notify_one();
+
+    runThreadJob(*job);
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&job] { return job->done == job->count; });
+    }
+    removeThreadJob(*data, job);
+}
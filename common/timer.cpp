@@ -6,7 +6,7 @@ QeTimer::~QeTimer() {
     lastTime = nullptr;
 }
 
-std::chrono::steady_clock::time_point QeTimer::getNowTime() { return std::chrono::high_resolution_clock::now(); }
+std::chrono::steady_clock::time_point QeTimer::getNowTime() { return std::chrono::steady_clock::now(); }
 
 void QeTimer::initTime() { *lastTime = getNowTime(); }
 
@@ -0,0 +1,950 @@
+#include "common.h"
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+std::shared_mutex xmlAtomMutex;  // shared to find atoms, exclusive to intern keys
+std::unordered_map<std::string, AeXMLAtom> xmlAtoms;
+std::atomic<uint64_t> xmlGeneration(1);  // bumped by every AeXMLNode edit, checked by the cache of AeXMLPath
+
+AeXMLAtom internXMLKey(std::string_view key) {  // under an exclusive xmlAtomMutex
+    std::string name(key);
+    std::unordered_map<std::string, AeXMLAtom>::iterator it = xmlAtoms.find(name);
+    if (it != xmlAtoms.end()) return it->second;
+    return xmlAtoms.emplace(std::move(name), AeXMLAtom(xmlAtoms.size() + 1)).first->second;
+}
+
+AeXMLAtom findXMLKey(std::string_view key) {  // under xmlAtomMutex
+    std::unordered_map<std::string, AeXMLAtom>::iterator it = xmlAtoms.find(std::string(key));
+    return it == xmlAtoms.end() ? 0 : it->second;
+}
+
+AeXMLAtom AeXMLPath::getAtom(std::string_view key) {
+    std::unique_lock<std::shared_mutex> lock(xmlAtomMutex);
+    return internXMLKey(key);
+}
+
+AeXMLAtom AeXMLPath::findAtom(std::string_view key) {
+    std::shared_lock<std::shared_mutex> lock(xmlAtomMutex);
+    return findXMLKey(key);
+}
+
+AeXMLPath::AeXMLPath(const char *path) {
+    std::string_view rest(path);
+    std::unique_lock<std::shared_mutex> lock(xmlAtomMutex);
+    while (true) {
+        size_t dot = rest.find('.');
+        atoms.push_back(internXMLKey(rest.substr(0, dot)));
+        if (dot == std::string_view::npos) break;
+        rest.remove_prefix(dot + 1);
+    }
+}
+
+uint32_t getXMLSlot(AeXMLAtom atom, size_t mask) { return uint32_t((atom * 2654435761u) & mask); }
+
+// Slots for more than a few keys, a power of two at least twice their count; the first of equal keys wins.
+void buildXMLSlots(std::vector<uint32_t> &slots, const std::vector<AeXMLAtom> &atoms) {
+    slots.clear();
+    if (atoms.size() <= 8) return;
+    size_t size = 32;
+    while (size < atoms.size() * 2) size *= 2;
+    slots.resize(size, 0);
+    for (size_t i = 0; i < atoms.size(); ++i) {
+        size_t slot = getXMLSlot(atoms[i], size - 1);
+        while (slots[slot] && atoms[slots[slot] - 1] != atoms[i]) slot = (slot + 1) & (size - 1);
+        if (!slots[slot]) slots[slot] = uint32_t(i + 1);
+    }
+}
+
+int findXMLAtom(const std::vector<AeXMLAtom> &atoms, const std::vector<uint32_t> &slots, AeXMLAtom atom) {
+    if (slots.empty()) {
+        for (size_t i = 0; i < atoms.size(); ++i)
+            if (atoms[i] == atom) return int(i);
+        return -1;
+    }
+    const size_t mask = slots.size() - 1;
+    for (size_t slot = getXMLSlot(atom, mask); slots[slot]; slot = (slot + 1) & mask)
+        if (atoms[slots[slot] - 1] == atom) return int(slots[slot] - 1);
+    return -1;
+}
+
+void internXMLIndex(AeXMLData &data) {  // under an exclusive xmlAtomMutex
+    data.nextAtoms.resize(data.nexts.size());
+    for (size_t i = 0; i < data.nexts.size(); ++i) data.nextAtoms[i] = internXMLKey(data.nexts[i]->data->key);
+    data.elementAtoms.resize(data.elements.size());
+    for (size_t i = 0; i < data.elements.size(); ++i) data.elementAtoms[i] = internXMLKey(data.elements[i].key);
+}
+
+void AeXMLNode::buildXMLIndex() {
+    {
+        std::unique_lock<std::shared_mutex> lock(xmlAtomMutex);
+        internXMLIndex(*data);
+    }
+    buildXMLSlots(data->nextSlots, data->nextAtoms);
+    buildXMLSlots(data->elementSlots, data->elementAtoms);
+}
+
+// Interns the keys of the whole tree under one lock.
+void AeXMLNode::buildXMLTreeIndex() {
+    std::vector<AeXMLNode *> nodes(1, this);
+    for (size_t i = 0; i < nodes.size(); ++i) nodes.insert(nodes.end(), nodes[i]->data->nexts.begin(), nodes[i]->data->nexts.end());
+    {
+        std::unique_lock<std::shared_mutex> lock(xmlAtomMutex);
+        for (AeXMLNode *node : nodes) internXMLIndex(*node->data);
+    }
+    for (AeXMLNode *node : nodes) {
+        buildXMLSlots(node->data->nextSlots, node->data->nextAtoms);
+        buildXMLSlots(node->data->elementSlots, node->data->elementAtoms);
+    }
+}
+
+void AeXMLNode::invalidateXMLIndex() {
+    buildXMLIndex();
+    expireXMLPaths();
+    setXMLDirty();
+}
+
+void AeXMLNode::expireXMLPaths() { ++xmlGeneration; }
+
+// The parents of a dirty node are dirty, so this stops at the first one.
+void AeXMLNode::setXMLDirty() {
+    for (AeXMLNode *node = this; node && !node->data->bDirty; node = node->data->parent) node->data->bDirty = true;
+}
+
+AeXMLNode *AeXMLNode::getXMLNext(AeXMLAtom atom) {
+    int i = findXMLAtom(data->nextAtoms, data->nextSlots, atom);
+    return i < 0 ? nullptr : data->nexts[i];
+}
+
+int AeXMLNode::getXMLElementIndex(AeXMLAtom atom) {
+    return findXMLAtom(data->elementAtoms, data->elementSlots, atom);
+}
+
+// The index interns every key of the node, so a key without an atom after it is not there.
+AeXMLNode *AeXMLNode::getXMLNext(std::string_view key) {
+    AeXMLAtom atom = AeXMLPath::findAtom(key);
+    int i = atom ? findXMLAtom(data->nextAtoms, data->nextSlots, atom) : -1;
+    return i < 0 ? nullptr : data->nexts[i];
+}
+
+int AeXMLNode::getXMLElementIndex(std::string_view key) {
+    AeXMLAtom atom = AeXMLPath::findAtom(key);
+    return atom ? findXMLAtom(data->elementAtoms, data->elementSlots, atom) : -1;
+}
+
+AeXMLNode *AeXMLNode::getXMLNode(const AeXMLPath &path, size_t keyNum) {
+    AeXMLNode *current = this;
+    keyNum = std::min(keyNum, path.atoms.size());
+    for (size_t i = 0; i < keyNum && current; ++i) current = current->getXMLNext(path.atoms[i]);
+    return current;
+}
+
+// The value of node, or its attribute element, and the AeXMLNumbers of the snapshot that still stand for it.
+const std::string *findXMLText(AeXMLNode *node, int element, AeXMLNode **owner, const AeXMLNumbers **numbers) {
+    if (owner) *owner = node;
+    AeXMLData &data = *node->data;
+    const std::string *text = element < 0 ? &data.value : &data.elements[element].value;
+    if (numbers) {
+        const uint16_t slot = uint16_t(element + 1);
+        for (uint32_t i = 0; i < data.numberCount; ++i) {
+            if (data.numbers[i].slot != slot) continue;
+            if (data.numbers[i].hasXMLText(*text)) *numbers = &data.numbers[i];
+            break;
+        }
+    }
+    return text;
+}
+
+const std::string *AeXMLNode::findXMLValue(const AeXMLPath &path, AeXMLNode **owner, const AeXMLNumbers **numbers) {
+    if (numbers) *numbers = nullptr;
+    if (path.cachedStart != this || path.cachedGeneration != xmlGeneration) {
+        const size_t last = path.atoms.size() - 1;
+        AeXMLNode *current = getXMLNode(path, last);
+        if (!current) return nullptr;
+        int element = current->getXMLElementIndex(path.atoms[last]);
+        if (element < 0) {
+            current = getXMLNext(path.atoms[last]);
+            if (!current) return nullptr;
+        }
+        path.cachedStart = this;
+        path.cachedNode = current;
+        path.cachedElement = element;
+        path.cachedGeneration = xmlGeneration;
+    }
+    return findXMLText(path.cachedNode, path.cachedElement, owner, numbers);
+}
+
+const std::string *AeXMLNode::findXMLValue(const char *key, AeXMLNode **owner, const AeXMLNumbers **numbers) {
+    if (numbers) *numbers = nullptr;
+    std::string_view rest(key);
+    AeXMLNode *current = this;
+    size_t dot;
+    while ((dot = rest.find('.')) != std::string_view::npos) {
+        current = current->getXMLNext(rest.substr(0, dot));
+        if (!current) return nullptr;
+        rest.remove_prefix(dot + 1);
+    }
+    int element = current->getXMLElementIndex(rest);
+    if (element < 0) {
+        current = getXMLNext(rest);
+        if (!current) return nullptr;
+    }
+    return findXMLText(current, element, owner, numbers);
+}
+
+AeArena::~AeArena() { clear(); }
+
+void *AeArena::allocate(size_t size, size_t alignment) {
+    size_t padding = (alignment - (uintptr_t(current) & (alignment - 1))) & (alignment - 1);
+    if (current == nullptr || padding + size > remaining) {
+        if (size + alignment > blockSize) {  // a block of its own, the current one keeps its space
+            char *block = new char[size + alignment];
+            blocks.push_back(block);
+            return block + ((alignment - (uintptr_t(block) & (alignment - 1))) & (alignment - 1));
+        }
+        current = new char[blockSize];
+        blocks.push_back(current);
+        remaining = blockSize;
+        padding = (alignment - (uintptr_t(current) & (alignment - 1))) & (alignment - 1);
+    }
+    char *ret = current + padding;
+    current = ret + size;
+    remaining -= padding + size;
+    return ret;
+}
+
+std::string_view AeArena::copyString(std::string_view s) {
+    if (s.empty()) return {};
+    char *copy = (char *)allocate(s.size(), 1);
+    memcpy(copy, s.data(), s.size());
+    return std::string_view(copy, s.size());
+}
+
+void AeArena::clear() {
+    for (char *block : blocks) delete[] block;
+    blocks.clear();
+    current = nullptr;
+    remaining = 0;
+}
+
+const char *XML_SPACES = " \t\n\r\f\v";
+
+bool isXMLSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+std::string_view trimXML(std::string_view s) {
+    size_t first = s.find_first_not_of(XML_SPACES);
+    if (first == std::string_view::npos) return {};
+    return s.substr(first, s.find_last_not_of(XML_SPACES) - first + 1);
+}
+
+AeXMLElement *AeXMLElement::getXMLNode(std::string_view path) {
+    AeXMLElement *current = this;
+    while (!path.empty()) {
+        size_t dot = path.find('.');
+        std::string_view key = path.substr(0, dot);
+        AeXMLElement *child = current->children;
+        while (child && child->key != key) child = child->next;
+        if (!child) return nullptr;
+        current = child;
+        if (dot == std::string_view::npos) break;
+        path.remove_prefix(dot + 1);
+    }
+    return current;
+}
+
+AeXMLAttribute *AeXMLElement::getXMLAttribute(std::string_view key) {
+    for (AeXMLAttribute *attribute = attributes; attribute; attribute = attribute->next)
+        if (attribute->key == key) return attribute;
+    return nullptr;
+}
+
+AeXMLElement *AeXMLElement::getXMLValue(std::string_view &value, std::string_view path) {
+    value = {};
+    size_t dot = path.rfind('.');
+    AeXMLElement *current = dot == std::string_view::npos ? this : getXMLNode(path.substr(0, dot));
+    if (!current) return nullptr;
+
+    std::string_view key = dot == std::string_view::npos ? path : path.substr(dot + 1);
+    AeXMLAttribute *attribute = current->getXMLAttribute(key);
+    if (attribute) {
+        value = attribute->value;
+        return current;
+    }
+    current = current->getXMLNode(key);
+    if (!current) return nullptr;
+    value = current->value;
+    return current;
+}
+
+bool AeXMLDocument::open(const char *path) {
+    clear();
+    if (!file.open(path)) return false;
+    if (parse((const char *)file.data(), file.size())) return true;
+    clear();
+    return false;
+}
+
+bool AeXMLDocument::parse(std::vector<char> &&_buffer) {
+    clear();
+    buffer = std::move(_buffer);
+    if (parse(buffer.data(), buffer.size())) return true;
+    clear();
+    return false;
+}
+
+void AeXMLDocument::clear() {
+    arena.clear();
+    root = nullptr;
+    version = {};
+    file.close();
+    std::vector<char>().swap(buffer);
+}
+
+// One pass over the text with the open element as the only state; stops after the root closes.
+bool AeXMLDocument::parse(const char *text, size_t size) {
+    const char *p = text, *end = text + size;
+    auto find = [end](const char *from, std::string_view token) -> const char * {
+        size_t at = std::string_view(from, end - from).find(token);
+        return at == std::string_view::npos ? nullptr : from + at;
+    };
+    AeXMLElement *current = nullptr;
+    AeXMLComment *comments = nullptr, **nextComment = &comments;  // for the next element
+
+    while (true) {
+        const char *tag = (const char *)memchr(p, '<', end - p);
+        if (tag == nullptr || tag + 1 == end) return false;
+
+        if (tag[1] == '/') {
+            const char *close = (const char *)memchr(tag, '>', end - tag);
+            if (close == nullptr || current == nullptr) return false;
+            p = close + 1;
+            current = current->parent;
+            if (current == nullptr) return true;
+            continue;
+        }
+        if (tag[1] == '?') {
+            const char *close = find(tag + 2, "?>");
+            if (close == nullptr) return false;
+            if (root == nullptr) version = trimXML(std::string_view(tag + 2, close - tag - 2));
+            p = close + 2;
+            continue;
+        }
+        if (end - tag >= 4 && memcmp(tag + 1, "!--", 3) == 0) {
+            const char *close = find(tag + 4, "-->");
+            if (close == nullptr) return false;
+            std::string_view s = trimXML(std::string_view(tag + 4, close - tag - 4));
+            if (!s.empty()) {
+                AeXMLComment *comment = arena.create<AeXMLComment>();
+                comment->text = s;
+                *nextComment = comment;
+                nextComment = &comment->next;
+            }
+            p = close + 3;
+            continue;
+        }
+
+        const char *q = tag + 1;
+        while (q < end && !isXMLSpace(*q) && *q != '/' && *q != '>') ++q;
+        if (q == tag + 1) return false;
+        AeXMLElement *element = arena.create<AeXMLElement>();
+        element->key = std::string_view(tag + 1, q - tag - 1);
+        element->comments = comments;
+        comments = nullptr;
+        nextComment = &comments;
+        element->parent = current;
+        if (current == nullptr)
+            root = element;
+        else if (current->lastChild == nullptr)
+            current->children = current->lastChild = element;
+        else
+            current->lastChild = current->lastChild->next = element;
+
+        AeXMLAttribute **nextAttribute = &element->attributes;
+        while (true) {
+            while (q < end && isXMLSpace(*q)) ++q;
+            if (q == end) return false;
+            if (*q == '/') {
+                if (q + 1 == end || q[1] != '>') return false;
+                p = q + 2;
+                if (current == nullptr) return true;
+                break;
+            }
+            if (*q == '>') {
+                current = element;
+                p = q + 1;
+                const char *next = (const char *)memchr(p, '<', end - p);
+                if (next) element->value = trimXML(std::string_view(p, next - p));
+                break;
+            }
+
+            const char *equal = q;
+            while (equal < end && *equal != '=' && *equal != '>' && *equal != '/') ++equal;
+            if (equal == end || *equal != '=') return false;
+            const char *quote = equal + 1;
+            while (quote < end && isXMLSpace(*quote)) ++quote;
+            if (quote == end || (*quote != '"' && *quote != '\'')) return false;
+            const char *close = (const char *)memchr(quote + 1, *quote, end - quote - 1);
+            if (close == nullptr) return false;
+
+            AeXMLAttribute *attribute = arena.create<AeXMLAttribute>();
+            attribute->key = trimXML(std::string_view(q, equal - q));
+            attribute->value = trimXML(std::string_view(quote + 1, close - quote - 1));
+            *nextAttribute = attribute;
+            nextAttribute = &attribute->next;
+            q = close + 1;
+        }
+    }
+}
+
+void AeXMLDocument::setXMLKey(AeXMLElement *element, std::string_view key) { element->key = arena.copyString(key); }
+
+void AeXMLDocument::setXMLValue(AeXMLElement *element, std::string_view value) { element->value = arena.copyString(value); }
+
+void AeXMLDocument::setXMLValue(AeXMLElement *element, std::string_view key, std::string_view value) {
+    AeXMLAttribute **next = &element->attributes;
+    for (; *next; next = &(*next)->next) {
+        if ((*next)->key == key) {
+            (*next)->value = arena.copyString(value);
+            return;
+        }
+    }
+    AeXMLAttribute *attribute = arena.create<AeXMLAttribute>();
+    attribute->key = arena.copyString(key);
+    attribute->value = arena.copyString(value);
+    *next = attribute;
+}
+
+AeXMLElement *AeXMLDocument::addXMLNode(AeXMLElement *parent, std::string_view key) {
+    AeXMLElement *element = arena.create<AeXMLElement>();
+    element->key = arena.copyString(key);
+    element->parent = parent;
+    if (parent == nullptr) {
+        if (root) return nullptr;
+        root = element;
+    } else if (parent->lastChild == nullptr)
+        parent->children = parent->lastChild = element;
+    else
+        parent->lastChild = parent->lastChild->next = element;
+    return element;
+}
+
+void AeXMLDocument::removeXMLNode(AeXMLElement *element) {
+    if (element == root) {
+        root = nullptr;
+        return;
+    }
+    AeXMLElement *parent = element->parent, *previous = nullptr;
+    if (parent == nullptr) return;
+    for (AeXMLElement *child = parent->children; child; previous = child, child = child->next) {
+        if (child != element) continue;
+        (previous ? previous->next : parent->children) = child->next;
+        if (parent->lastChild == child) parent->lastChild = previous;
+        return;
+    }
+}
+
+void outputXMLElement(const AeXMLElement *element, int level, std::string &content) {
+    const size_t indent = size_t(level) * 4;
+    for (const AeXMLComment *comment = element->comments; comment; comment = comment->next) {
+        content.append(indent, ' ');
+        content += "<!--";
+        content += comment->text;
+        content += "-->\n";
+    }
+
+    content.append(indent, ' ');
+    content += "<";
+    content += element->key;
+    for (const AeXMLAttribute *attribute = element->attributes; attribute; attribute = attribute->next) {
+        content += " ";
+        content += attribute->key;
+        content += "=\"";
+        content += attribute->value;
+        content += "\"";
+    }
+    if (element->children == nullptr) {
+        if (element->value.length()) {
+            content += ">";
+            content += element->value;
+            content += "</";
+            content += element->key;
+            content += ">\n";
+        } else {
+            content += " />\n";
+        }
+    } else {
+        content += ">\n";
+        for (const AeXMLElement *child = element->children; child; child = child->next)
+            outputXMLElement(child, level + 1, content);
+
+        content.append(indent, ' ');
+        content += "</";
+        content += element->key;
+        content += ">\n";
+    }
+}
+
+void AeXMLDocument::outputXML(std::string &content) const {
+    if (root == nullptr) return;
+    if (version.length()) {
+        content += "<?";
+        content += version;
+        content += "?>\n";
+    }
+    outputXMLElement(root, 0, content);
+}
+
+void AeXMLDocument::outputXML(const char *path) const {
+    std::string content;
+    outputXML(content);
+    std::ofstream ofile;
+    ofile.open(path);
+
+    ofile << content << std::endl;
+    ofile.close();
+}
+
+bool AeXMLReader::open(const char *path) {
+    reset();
+    if (!file.open(path)) return false;
+    text = (const char *)file.data();
+    size = file.size();
+    return true;
+}
+
+void AeXMLReader::open(const char *_text, size_t _size) {
+    reset();
+    text = _text;
+    size = _size;
+}
+
+void AeXMLReader::open(std::istream &_stream, size_t _chunkSize) {
+    reset();
+    stream = &_stream;
+    chunkSize = std::max(_chunkSize, size_t(16));
+}
+
+void AeXMLReader::reset() {
+    file.close();
+    stream = nullptr;
+    text = nullptr;
+    size = pos = 0;
+    state = eRead_content;
+    keyStack.clear();
+    keyStarts.clear();
+    bPop = false;
+    key = value = {};
+}
+
+// Moves what is left from pos to the front of chunk and reads after it until n bytes are there; chunk only grows for
+// a token longer than it.
+bool AeXMLReader::fillXML(size_t n) {
+    do {
+        if (stream == nullptr || !*stream) return false;
+        size_t kept = size - pos;
+        if (kept && pos) memmove(chunk.data(), chunk.data() + pos, kept);
+        if (chunk.size() < kept + chunkSize) chunk.resize(kept + chunkSize);
+        stream->read(chunk.data() + kept, chunk.size() - kept);
+        size_t count = size_t(stream->gcount());
+        text = chunk.data();
+        size = kept + count;
+        pos = 0;
+        if (count == 0) return false;
+    } while (size < n);
+    return true;
+}
+
+size_t AeXMLReader::findXML(size_t from, char c) {
+    while (true) {
+        if (from < size - pos) {
+            const char *p = (const char *)memchr(text + pos + from, c, size - pos - from);
+            if (p) return p - (text + pos);
+            from = size - pos;
+        }
+        if (!fillXML()) return std::string_view::npos;
+    }
+}
+
+size_t AeXMLReader::findXML(size_t from, std::string_view token) {
+    while (true) {
+        size_t at = std::string_view(text + pos, size - pos).find(token, from);
+        if (at != std::string_view::npos) return at;
+        if (size - pos >= token.size()) from = std::max(from, size - pos - token.size() + 1);
+        if (!fillXML()) return std::string_view::npos;
+    }
+}
+
+AeXMLEvent AeXMLReader::endXMLElement() {
+    key = std::string_view(keyStack).substr(keyStarts.back());
+    bPop = true;
+    return eXMLEvent_endElement;
+}
+
+void appendXMLUTF8(std::string &out, uint32_t code) {
+    if (code < 0x80) {
+        out += char(code);
+    } else if (code < 0x800) {
+        out += char(0xC0 | (code >> 6));
+        out += char(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += char(0xE0 | (code >> 12));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    } else {
+        out += char(0xF0 | (code >> 18));
+        out += char(0x80 | ((code >> 12) & 0x3F));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    }
+}
+
+// The five predefined entities and character references; anything else stays as it is written.
+std::string_view AeXMLReader::unescapeXML(std::string_view s) {
+    if (s.find('&') == std::string_view::npos) return s;
+    unescaped.clear();
+    size_t from = 0, at;
+    while ((at = s.find('&', from)) != std::string_view::npos) {
+        unescaped.append(s.data() + from, at - from);
+        from = at + 1;
+        size_t semicolon = s.find(';', at);
+        if (semicolon == std::string_view::npos || semicolon - at > 10) {
+            unescaped += '&';
+            continue;
+        }
+        std::string_view name = s.substr(at + 1, semicolon - at - 1);
+        static const std::pair<std::string_view, char> entities[] = {
+            {"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}};
+        bool bKnown = false;
+        for (const auto &entity : entities) {
+            if (name != entity.first) continue;
+            unescaped += entity.second;
+            bKnown = true;
+        }
+        if (!bKnown && name.size() > 1 && name[0] == '#') {
+            const bool bHex = name[1] == 'x' || name[1] == 'X';
+            const uint32_t base = bHex ? 16 : 10;
+            uint32_t code = 0;
+            size_t i = bHex ? 2 : 1;
+            bool bDigits = i < name.size();
+            for (; bDigits && i < name.size(); ++i) {
+                const char c = name[i], lower = char(c | 0x20);
+                const int digit = c >= '0' && c <= '9' ? c - '0' : bHex && lower >= 'a' && lower <= 'f' ? lower - 'a' + 10 : -1;
+                if (digit < 0) bDigits = false;
+                code = code * base + uint32_t(digit);
+            }
+            if (bDigits && code > 0 && code <= 0x10FFFF) {
+                appendXMLUTF8(unescaped, code);
+                bKnown = true;
+            }
+        }
+        if (bKnown)
+            from = semicolon + 1;
+        else
+            unescaped += '&';
+    }
+    unescaped.append(s.data() + from, s.size() - from);
+    return unescaped;
+}
+
+AeXMLEvent AeXMLReader::failXML() {
+    state = eRead_error;
+    key = value = {};
+    return eXMLEvent_error;
+}
+
+// The same steps as AeXMLDocument::parse, one event at a time. Offsets count from pos, which a refill of chunk moves.
+AeXMLEvent AeXMLReader::next() {
+    if (bPop) {
+        bPop = false;
+        keyStack.resize(keyStarts.back());
+        keyStarts.pop_back();
+        if (keyStarts.empty()) state = eRead_end;
+    }
+    key = value = {};
+
+    while (true) {
+        switch (state) {
+            case eRead_end:
+                return eXMLEvent_end;
+            case eRead_error:
+                return eXMLEvent_error;
+
+            case eRead_tag: {
+                while (hasXML(1) && isXMLSpace(text[pos])) ++pos;
+                if (!hasXML(1)) return failXML();
+                if (text[pos] == '/') {
+                    if (!hasXML(2) || text[pos + 1] != '>') return failXML();
+                    pos += 2;
+                    state = eRead_content;
+                    return endXMLElement();
+                }
+                if (text[pos] == '>') {
+                    ++pos;
+                    state = eRead_text;
+                    continue;
+                }
+
+                size_t equal = 0;
+                char c = 0;
+                while (hasXML(equal + 1) && (c = text[pos + equal]) != '=' && c != '>' && c != '/') ++equal;
+                if (c != '=' || !hasXML(equal + 1)) return failXML();
+                size_t quote = equal + 1;
+                while (hasXML(quote + 1) && isXMLSpace(text[pos + quote])) ++quote;
+                if (!hasXML(quote + 1) || (text[pos + quote] != '"' && text[pos + quote] != '\'')) return failXML();
+                size_t close = findXML(quote + 1, text[pos + quote]);
+                if (close == std::string_view::npos) return failXML();
+
+                key = trimXML(std::string_view(text + pos, equal));
+                value = unescapeXML(trimXML(std::string_view(text + pos + quote + 1, close - quote - 1)));
+                pos += close + 1;
+                return eXMLEvent_attribute;
+            }
+
+            case eRead_text: {
+                size_t next = findXML(0, '<');
+                if (next == std::string_view::npos) return failXML();
+                value = unescapeXML(trimXML(std::string_view(text + pos, next)));
+                pos += next;
+                state = eRead_content;
+                if (value.length()) return eXMLEvent_text;
+                continue;
+            }
+
+            case eRead_content: {
+                size_t tag = findXML(0, '<');
+                if (tag == std::string_view::npos) return failXML();
+                pos += tag;
+                if (!hasXML(2)) return failXML();
+
+                if (text[pos + 1] == '/') {
+                    size_t close = findXML(2, '>');
+                    if (close == std::string_view::npos || keyStarts.empty()) return failXML();
+                    pos += close + 1;
+                    return endXMLElement();
+                }
+                if (text[pos + 1] == '?') {
+                    size_t close = findXML(2, "?>");
+                    if (close == std::string_view::npos) return failXML();
+                    value = trimXML(std::string_view(text + pos + 2, close - 2));
+                    pos += close + 2;
+                    return eXMLEvent_version;
+                }
+                if (hasXML(4) && memcmp(text + pos + 1, "!--", 3) == 0) {
+                    size_t close = findXML(4, "-->");
+                    if (close == std::string_view::npos) return failXML();
+                    value = trimXML(std::string_view(text + pos + 4, close - 4));
+                    pos += close + 3;
+                    if (value.length()) return eXMLEvent_comment;
+                    continue;
+                }
+
+                size_t end = 1;
+                char c = 0;
+                while (hasXML(end + 1) && !isXMLSpace(c = text[pos + end]) && c != '/' && c != '>') ++end;
+                if (end == 1 || !hasXML(end + 1)) return failXML();
+                keyStarts.push_back(keyStack.size());
+                keyStack.append(text + pos + 1, end - 1);
+                key = std::string_view(keyStack).substr(keyStarts.back());
+                pos += end;
+                state = eRead_tag;
+                return eXMLEvent_startElement;
+            }
+        }
+    }
+}
+
+bool AeXMLReader::skipXMLElement() {
+    size_t depth = getDepth();
+    while (true) {
+        switch (next()) {
+            case eXMLEvent_endElement:
+                if (getDepth() == depth) return true;
+                break;
+            case eXMLEvent_end:
+            case eXMLEvent_error:
+                return false;
+            default:
+                break;
+        }
+    }
+}
+
+// Comments go to the element after them, as decodeXML keeps them; those after the last element inside are dropped.
+AeXMLNode *AeXMLReader::readXMLNode(AeXMLNode *parent) {
+    AeXMLNode *node = new AeXMLNode(), *current = node;
+    node->data->key = key;
+    node->data->parent = parent;
+    std::vector<std::string> comments;
+
+    while (true) {
+        switch (next()) {
+            case eXMLEvent_attribute:
+                current->data->elements.push_back({std::string(key), std::string(value)});
+                break;
+            case eXMLEvent_text:
+                current->data->value = value;
+                break;
+            case eXMLEvent_comment:
+                comments.emplace_back(value);
+                break;
+            case eXMLEvent_startElement: {
+                AeXMLNode *child = new AeXMLNode();
+                child->data->key = key;
+                child->data->parent = current;
+                child->data->comments.swap(comments);
+                current->data->nexts.push_back(child);
+                current = child;
+            } break;
+            case eXMLEvent_endElement:
+                if (current == node) {
+                    node->buildXMLTreeIndex();
+                    return node;
+                }
+                current = current->data->parent;
+                break;
+            case eXMLEvent_version:
+                break;
+            case eXMLEvent_end:
+            case eXMLEvent_error:
+                delete node;
+                return nullptr;
+        }
+    }
+}
+
+AeXMLNode *AeXMLReader::readXMLDocument() {
+    std::string version;
+    std::vector<std::string> comments;
+    while (true) {
+        switch (next()) {
+            case eXMLEvent_version:
+                version = value;
+                break;
+            case eXMLEvent_comment:
+                comments.emplace_back(value);
+                break;
+            case eXMLEvent_startElement: {
+                AeXMLNode *root = readXMLNode();
+                if (root == nullptr) return nullptr;
+                root->data->version.swap(version);
+                root->data->comments.swap(comments);
+                return root;
+            }
+            default:
+                return nullptr;
+        }
+    }
+}
+
+std::atomic<uint32_t> xmlWriterId(0);  // 0 is no writer, see AeXMLData::textWriter
+
+void appendXMLEscaped(std::string &content, const std::string &s, bool bAttribute) {
+    const char *special = bAttribute ? "&<\"" : "&<";
+    size_t from = 0, at;
+    while ((at = s.find_first_of(special, from)) != std::string::npos) {
+        content.append(s, from, at - from);
+        content += s[at] == '&' ? "&amp;" : s[at] == '<' ? "&lt;" : "&quot;";
+        from = at + 1;
+    }
+    content.append(s, from, std::string::npos);
+}
+
+// Everything of node before its children, or all of it without children; the text AeXMLNode::outputXML wrote.
+void writeXMLHead(const AeXMLData &data, int level, std::string &content) {
+    const size_t indent = size_t(level) * 4;
+    if (data.version.length()) {
+        content += "<?";
+        content += data.version;
+        content += "?>\n";
+    }
+    for (const auto &comment : data.comments) {
+        content.append(indent, ' ');
+        content += "<!--";
+        content += comment;
+        content += "-->\n";
+    }
+
+    content.append(indent, ' ');
+    content += "<";
+    content += data.key;
+    for (const auto &element : data.elements) {
+        content += " ";
+        content += element.key;
+        content += "=\"";
+        appendXMLEscaped(content, element.value, true);
+        content += "\"";
+    }
+    if (data.nexts.size()) {
+        content += ">\n";
+    } else if (data.value.length()) {
+        content += ">";
+        appendXMLEscaped(content, data.value, false);
+        content += "</";
+        content += data.key;
+        content += ">\n";
+    } else {
+        content += " />\n";
+    }
+}
+
+void writeXMLTail(const AeXMLData &data, int level, std::string &content) {
+    if (data.nexts.empty()) return;
+    content.append(size_t(level) * 4, ' ');
+    content += "</";
+    content += data.key;
+    content += ">\n";
+}
+
+AeXMLWriter::AeXMLWriter() : id(++xmlWriterId) {}
+
+void AeXMLWriter::writeXMLNode(const AeXMLNode *node, int level, std::string &content) {
+    writeXMLHead(*node->data, level, content);
+    for (const AeXMLNode *next : node->data->nexts) writeXMLNode(next, level + 1, content);
+    writeXMLTail(*node->data, level, content);
+}
+
+// lastStart is where the node starts in lastText, npos when it is not there.
+void AeXMLWriter::writeXMLNode(AeXMLNode *node, int level, size_t lastStart) {
+    AeXMLData &data = *node->data;
+    if (lastStart != std::string::npos && !data.bDirty) {
+        text.append(lastText, lastStart, data.textSize);
+        return;
+    }
+    ++writtenNodeCount;
+    const size_t start = text.size();
+    writeXMLHead(data, level, text);
+    for (AeXMLNode *next : data.nexts) {
+        AeXMLData &nextData = *next->data;
+        const size_t nextStart = text.size();
+        writeXMLNode(next, level + 1,
+                     lastStart != std::string::npos && nextData.textWriter == id ? lastStart + nextData.textOffset
+                                                                                 : std::string::npos);
+        nextData.textOffset = uint32_t(nextStart - start);
+        nextData.textWriter = id;
+    }
+    writeXMLTail(data, level, text);
+    data.textSize = uint32_t(text.size() - start);
+    data.bDirty = false;
+}
+
+const std::string &AeXMLWriter::write(AeXMLNode *root) {
+    lastText.swap(text);
+    text.clear();
+    writtenNodeCount = 0;
+    const bool bLast = root == lastRoot && root->data->textWriter == id;
+    writeXMLNode(root, 0, bLast ? 0 : std::string::npos);
+    root->data->textOffset = 0;
+    root->data->textWriter = id;
+    lastRoot = root;
+    return text;
+}
+
+bool AeXMLWriter::save(AeXMLNode *root, const char *path) {
+    write(root);
+    std::ofstream file(path);
+    if (!file.is_open()) return false;
+    file.write(text.data(), text.size());
+    file << std::endl;
+    return bool(file);
+}
@@ -63,7 +63,7 @@ vec3 BRDF(vec3 L, vec3 V, vec3 N, vec3 F0, float metallic, float roughness, vec3
 vec3 getNormal() {
     float u_NormalScale = 1.0;
     vec3 N;
-    if (modelData.param1.y == 1) {
+    if (modelData.param1.y != 0) {
         // mat3 TBN = mat3(inTangent, inBiTanget, inNormal);
 
         vec3 t = inTangent;
@@ -76,8 +76,9 @@ vec3 getNormal() {
         t = normalize(t - ng * dot(ng, t));
         vec3 b = normalize(cross(ng, t));
         mat3 TBN = mat3(t, b, ng);
-        N = texture(normalMapSampler, inUV).rgb;
-        N = normalize(TBN * ((2.0 * N - 1.0) * vec3(u_NormalScale, u_NormalScale, 1.0)));
+        N = 2.0 * texture(normalMapSampler, inUV).rgb - 1.0;
+        if (modelData.param1.y == 2) N.z = sqrt(max(0.0, 1.0 - dot(N.xy, N.xy)));  // BC5 keeps only xy
+        N = normalize(TBN * (N * vec3(u_NormalScale, u_NormalScale, 1.0)));
     } else {
         N = normalize(inNormal * vec3(u_NormalScale, u_NormalScale, 1.0));
     }
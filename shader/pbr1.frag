@@ -43,6 +43,7 @@ void main() {
     // vec3 n = texture(normalSampler, inUV).rgb;
     // n = normalize(tbn * ((2.0 * n - 1.0) * vec3(u_NormalScale, u_NormalScale, 1.0)));
     vec3 n = 2 * texture(normalMapSampler, inUV).rgb - 1.0;
+    if (modelData.param1.y == 2) n.z = sqrt(max(0.0, 1.0 - dot(n.xy, n.xy)));  // BC5 keeps only xy, as in pbr.frag
     n = normalize(mat3(inTangent, inBiTanget, inNormal) * n);
 
     float lightType = lights[0].param.x;
@@ -112,7 +112,7 @@ QeMatrix4x4f QeAnimation::getBoneTransfrom(const char *boneName) {
     if (!size) return bufferData.model;
 
     for (size_t i = 0; i < size; ++i) {
-        if (!strcmp(boneName, modelData->jointsAnimation[i].name)) return bufferData.model * jointTransforms[i];
+        if (modelData->jointsAnimation[i].name == boneName) return bufferData.model * jointTransforms[i];
         // return bufferData.model*bufferData.joints[i];
     }
     return bufferData.model;
@@ -4,8 +4,10 @@ void AngryEngine::run() {
     bClosed = false;
 
     LOGOBJ.setOutput(*CONFIG, "AngeryEngine_");
+    COM_IMAGE_CACHE.setDirectory(CONFIG->getXMLValue<std::string>("setting.path.textureCache").c_str());
     UI->initialize();
     VK->initialize();
+    G_AST.setTextureSetting(CONFIG->getXMLNode("setting.texture"));  // after VK, which knows the block formats
     initialize();
     mainLoop();
 }
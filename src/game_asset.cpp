@@ -163,7 +163,7 @@ QeAssetModel *QeGameAsset::getModel(const char *_filename, bool bCubeMap, float
     }
 
     QeAssetModel *model = nullptr;
-    AeJSONNode *json = nullptr;
+    AeJSONDocument *json = nullptr;
     std::vector<char> buffer;
     QeVertex vertex;
     float index = 0.f;
@@ -174,8 +174,8 @@ QeAssetModel *QeGameAsset::getModel(const char *_filename, bool bCubeMap, float
         // model = ENCODE->decodeOBJ(buffer.data());
         //	break;
         case eModelData_gltf:
-            json = COM_MGR.getJSON(_filePath.c_str());
-            model = G_ENCODE.decodeGLTF(json, bCubeMap);
+            json = COM_MGR.getJSONDocument(_filePath.c_str());
+            if (json) model = G_ENCODE.decodeGLTF(json->getRoot(), bCubeMap);
             break;
             // case 2:
             //	model = ENCODE->decodeGLB(0);
@@ -505,9 +505,9 @@ QeAssetMaterial *QeGameAsset::getMaterialImage(const char *_filename, bool bCube
 
     if (_filePath.length() == 0) {
     } else if (bCubeMap)
-        mtl->image.pCubeMap = getImage(_filename, bCubeMap, true);
+        mtl->image.pCubeMap = getImage(_filename, bCubeMap, eTextureUsage_color);
     else
-        mtl->image.pBaseColorMap = getImage(_filename, bCubeMap, true);
+        mtl->image.pBaseColorMap = getImage(_filename, bCubeMap, eTextureUsage_color);
 
     // VK->createBuffer(mtl->uboBuffer, sizeof(mtl->value), (void*)&mtl->value);
     // VK->createUniformBuffer(sizeof(mtl->value), mtl->uboBuffer.buffer,
@@ -519,51 +519,114 @@ QeAssetMaterial *QeGameAsset::getMaterialImage(const char *_filename, bool bCube
     return mtl;
 }
 
-QeVKImage *QeGameAsset::getImage(const char *_filename, bool bCubeMap, bool bGamma) {
-    std::string _filePath = combinePath(_filename, eAssetTexture);
-    std::map<std::string, QeVKImage *>::iterator it = astTextures.find(_filePath.c_str());
+void QeGameAsset::setTextureSetting(AeXMLNode *node) {
+    if (!node) return;
+    for (const AeNode &element : node->data->elements) {
+        int value = atoi(element.value.c_str());
+        if (element.key == "mipmapFilter")
+            mipmapFilter = AeMipmapFilter(value);
+        else if (element.key == "blockQuality")
+            blockQuality = AeBlockQuality(value);
+        else if (element.key == "colorFormat")
+            blockFormats[eTextureUsage_color] = AeBlockFormat(value);
+        else if (element.key == "normalFormat")
+            blockFormats[eTextureUsage_normal] = AeBlockFormat(value);
+        else if (element.key == "dataFormat")
+            blockFormats[eTextureUsage_data] = AeBlockFormat(value);
+    }
+    for (AeXMLNode *format : node->data->nexts) {
+        if (format->data->key != "format") continue;
+        std::string file;
+        int value = eBlockFormat_none;
+        for (const AeNode &element : format->data->elements) {
+            if (element.key == "file")
+                file = element.value;
+            else if (element.key == "value")
+                value = atoi(element.value.c_str());
+        }
+        if (!file.empty()) textureBlockFormats[file] = AeBlockFormat(value);
+    }
+}
 
-    if (it != astTextures.end()) return it->second;
+AeBlockFormat QeGameAsset::getBlockFormat(const std::string &_filePath, QeTextureUsage usage) {
+    if (!VK->bTextureCompressionBC) return eBlockFormat_none;
+    size_t slash = _filePath.find_last_of("\\/");
+    std::map<std::string, AeBlockFormat>::iterator it =
+        textureBlockFormats.find(slash == std::string::npos ? _filePath : _filePath.substr(slash + 1));
+    return it != textureBlockFormats.end() ? it->second : blockFormats[usage];
+}
 
-    char type = 0;  // 0:BMP, 1:PNG, 2:JPEG
+std::shared_ptr<QeAssetImageData> QeGameAsset::loadImageContainer(const std::string &_filePath, bool bCubeMap,
+                                                                   QeTextureUsage usage) {
+    std::shared_ptr<QeAssetImageData> image = std::make_shared<QeAssetImageData>();
+    AeTextureContainer &container = image->container;
+    if (!container.open(_filePath.c_str()) || container.bCubeMap != bCubeMap) return nullptr;
+    // a legacy DDS does not say, so it goes by what the texture is used for, as a decoded one does
+    const bool bSRGB = container.bColorSpace ? container.bSRGB : usage == eTextureUsage_color;
+    if (container.blockFormat != eBlockFormat_none) {
+        if (!VK->bTextureCompressionBC) return nullptr;
+        image->format = VK->getBlockFormat(container.blockFormat, bSRGB);
+    } else if (container.pixelFormat == eImageFormat_BGRA8)
+        image->format = bSRGB ? VK_FORMAT_B8G8R8A8_SRGB : VK_FORMAT_B8G8R8A8_UNORM;
+    else
+        image->format = bSRGB ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+
+    // cube layers in the order of the face files of decodeImage: +Z, -Z, -X, +X, +Y, -Y
+    const int CUBE_FACES[6] = {4, 5, 1, 0, 2, 3};
+    image->regionOffsets.resize(container.regionOffsets.size());
+    for (int layer = 0; layer < container.layers; ++layer) {
+        int face = bCubeMap ? CUBE_FACES[layer] : layer;
+        for (int level = 0; level < container.levels; ++level)
+            image->regionOffsets[size_t(layer) * container.levels + level] =
+                container.regionOffsets[size_t(face) * container.levels + level];
+    }
+    image->data = container.data;
+    image->layerSize = container.dataSize;
+    image->layers = container.layers;
+    image->mipLevels = uint32_t(container.levels);
+    image->size = {uint32_t(container.width), uint32_t(container.height)};
+    return image;
+}
 
-    char *ret = strrchr((char *)_filePath.c_str(), '.');
+std::shared_ptr<QeAssetImageData> QeGameAsset::decodeImage(const std::string &_filePath, bool bCubeMap, QeTextureUsage usage) {
+    const char *ret = strrchr(_filePath.c_str(), '.');
+    if (ret == nullptr) return nullptr;
+    // precompressed and pre-mipped: uploaded as stored, whatever the texture settings say
+    if (strcmp(ret + 1, "dds") == 0 || strcmp(ret + 1, "ktx2") == 0) return loadImageContainer(_filePath, bCubeMap, usage);
 
-    VkFormat format;
+    char type = 0;  // 0:BMP, 1:PNG, 2:JPEG
+    std::shared_ptr<QeAssetImageData> image = std::make_shared<QeAssetImageData>();
+    AeImageFormat decodeFormat = eImageFormat_RGBA8;
+    const bool bGamma = usage == eTextureUsage_color;
+    const AeBlockFormat blockFormat = getBlockFormat(_filePath, usage);
 
     if (strcmp(ret + 1, "bmp") == 0) {
+        decodeFormat = eImageFormat_BGRA8;
         type = 0;
         if (bGamma)
-            format = VK_FORMAT_B8G8R8A8_SRGB;
+            image->format = VK_FORMAT_B8G8R8A8_SRGB;
         else
-            format = VK_FORMAT_B8G8R8A8_UNORM;
+            image->format = VK_FORMAT_B8G8R8A8_UNORM;
     } else if (strcmp(ret + 1, "png") == 0) {
         type = 1;
         if (bGamma)
-            format = VK_FORMAT_R8G8B8A8_SRGB;
+            image->format = VK_FORMAT_R8G8B8A8_SRGB;
         else
-            format = VK_FORMAT_R8G8B8A8_UNORM;
+            image->format = VK_FORMAT_R8G8B8A8_UNORM;
     } else if (strcmp(ret + 1, "jpg") == 0 || strcmp(ret + 1, "jpeg") == 0) {
         type = 2;
         if (bGamma)
-            format = VK_FORMAT_R8G8B8A8_SRGB;
+            image->format = VK_FORMAT_R8G8B8A8_SRGB;
         else
-            format = VK_FORMAT_R8G8B8A8_UNORM;
+            image->format = VK_FORMAT_R8G8B8A8_UNORM;
     } else
         return nullptr;
-
-    QeVKImage *image;
-
-    if (bCubeMap)
-        image = new QeVKImage(eImage_cube);
-    else
-        image = new QeVKImage(eImage_2D);
-    // image->sampler = VK->createTextureSampler();
+    if (blockFormat != eBlockFormat_none) {  // the encoder reads RGBA8 whatever the file
+        decodeFormat = eImageFormat_RGBA8;
+        image->format = VK->getBlockFormat(blockFormat, bGamma);
+    }
 
     std::vector<std::string> imageList;
-    VkExtent2D imageSize;
-    VkDeviceSize imageDataSize;
-    std::vector<unsigned char> imageDatas;
 
     if (bCubeMap) {
         /*
@@ -580,63 +643,212 @@ QeVKImage *QeGameAsset::getImage(const char *_filename, bool bCubeMap, bool bGam
 
     int size = int(imageList.size());
     int cIndex = int(ret - _filePath.c_str());
-    std::vector<unsigned char> data;
-    int width, height, bytes;
 
-    for (int i = 0; i < size; ++i) {
-        std::string path(_filePath);
-        path.insert(cIndex, imageList[i]);
-        std::vector<char> buffer = COM_MGR.loadFile(path.c_str());
+    std::vector<std::string> paths(size, _filePath);
+    for (int i = 0; i < size; ++i) paths[i].insert(cIndex, imageList[i]);
+
+    // decoded before with the same sources: map the pixels and upload them as they are
+    std::string cacheKey = _filePath + (bCubeMap ? "|cube|" : "|2d|") + std::to_string(decodeFormat) + "|" +
+                           std::to_string(mipmapFilter) + "|" + std::to_string(blockFormat) + "|" + std::to_string(blockQuality);
+    if (COM_IMAGE_CACHE.load(cacheKey, paths, image->cached) && image->cached.blockFormat == blockFormat) {
+        image->data = image->cached.data;
+        image->layerSize = image->cached.dataSize / image->cached.layers;
+        image->layers = image->cached.layers;
+        image->mipLevels = image->cached.levels;
+        image->size = {uint32_t(image->cached.width), uint32_t(image->cached.height)};
+        return image;
+    }
+
+    // The faces decode at the same time, JPEG splitting further on the same pool, each straight into its layer of a
+    // staging buffer the first of them to know its size makes. The mip chain is generated there, or in pixels when
+    // the blocks of it go there instead. Generating it reads back what the decode wrote, too slow from uncached
+    // memory, so the layers go to image->pixels unless the staging buffer is host cached and mapped.
+    std::mutex stagingMutex;
+    std::vector<int> widths(size), heights(size), bytes(size);
+    std::vector<char> decoded(size, 0);
+    auto getLayer = [&](size_t i, VkDeviceSize layerSize) -> unsigned char * {
+        std::lock_guard<std::mutex> lock(stagingMutex);
+        if (image->layerSize == 0) {
+            image->layerSize = layerSize;
+            image->size = {uint32_t(widths[i]), uint32_t(heights[i])};
+            VK->createBuffer(image->staging, layerSize * size, nullptr);
+            if (!image->staging.bHostCached || image->staging.mapped == nullptr) image->pixels.resize(layerSize * size);
+        } else if (layerSize != image->layerSize || uint32_t(widths[i]) != image->size.width ||
+                   uint32_t(heights[i]) != image->size.height)
+            return nullptr;  // createImage takes the faces all of one size
+        if (!image->pixels.empty()) return image->pixels.data() + layerSize * i;
+        return (unsigned char *)image->staging.mapped + layerSize * i;
+    };
+    COM_THREAD.parallelFor(size, [&](size_t i) {
+        std::vector<char> buffer = COM_MGR.loadFile(paths[i].c_str());
+        std::vector<unsigned char> pixels;
+        unsigned char *chain = nullptr;
+        unsigned int levels = 1;
+        auto allocate = [&](size_t) -> unsigned char * {
+            levels = AeTextureEncode::getMipLevels(widths[i], heights[i]);
+            size_t chainSize = AeTextureEncode::getMipmapSize(widths[i], heights[i], bytes[i], levels);
+            if (blockFormat == eBlockFormat_none)
+                chain = getLayer(i, chainSize);
+            else {
+                pixels.resize(chainSize);
+                chain = pixels.data();
+            }
+            return chain;
+        };
 
+        bool bDecoded = false;
         switch (type) {
             case 0:
-                data = COM_ENCODE.decodeBMP((unsigned char *)buffer.data(), &width, &height, &bytes);
+                bDecoded = COM_ENCODE.decodeBMP((unsigned char *)buffer.data(), buffer.size(), &widths[i], &heights[i], &bytes[i],
+                                                allocate, decodeFormat);
                 break;
             case 1:
-                data = COM_ENCODE.decodePNG((unsigned char *)buffer.data(), &width, &height, &bytes);
+                bDecoded = COM_ENCODE.decodePNG((unsigned char *)buffer.data(), buffer.size(), &widths[i], &heights[i], &bytes[i],
+                                                allocate, decodeFormat);
                 break;
             case 2:
-                data = COM_ENCODE.decodeJPEG((unsigned char *)buffer.data(), buffer.size(), &width, &height, &bytes);
+                bDecoded = COM_ENCODE.decodeJPEG((unsigned char *)buffer.data(), buffer.size(), &widths[i], &heights[i],
+                                                 &bytes[i], allocate, decodeFormat, true);
                 break;
         }
-        if (bytes != 4) imageFillto32bits(&data, bytes);
+        if (!bDecoded) return;
+
+        // full mip chain after level 0, filtered in linear light for sRGB textures
+        COM_TEXTURE.generateMipmaps(chain, widths[i], heights[i], bytes[i], levels, mipmapFilter, bGamma, true);
+        if (blockFormat != eBlockFormat_none) {
+            unsigned char *blocks = getLayer(i, AeTextureEncode::getCompressedSize(widths[i], heights[i], blockFormat, levels));
+            if (blocks == nullptr) return;
+            COM_TEXTURE.encodeBlocks(chain, widths[i], heights[i], levels, blockFormat, blocks, blockQuality, true);
+        }
+        decoded[i] = 1;
+    });
+    for (int i = 0; i < size; ++i)
+        if (!decoded[i]) return nullptr;
+
+    image->layers = size;
+    image->mipLevels = AeTextureEncode::getMipLevels(widths[0], heights[0]);
+    const VkDeviceSize dataSize = image->layerSize * size;
+    if (image->pixels.empty()) {
+        COM_IMAGE_CACHE.save(cacheKey, paths, (unsigned char *)image->staging.mapped, dataSize, widths[0], heights[0], bytes[0],
+                             size, image->mipLevels, blockFormat);
+        return image;
+    }
+    COM_IMAGE_CACHE.save(cacheKey, paths, image->pixels.data(), dataSize, widths[0], heights[0], bytes[0], size,
+                         image->mipLevels, blockFormat);
+    if (image->staging.mapped) {  // one write-only pass, which uncached memory takes well
+        memcpy(image->staging.mapped, image->pixels.data(), dataSize);
+        std::vector<unsigned char>().swap(image->pixels);
+    } else
+        image->data = image->pixels.data();  // createImage makes its own staging buffer
+    return image;
+}
 
-        // uint32_t mipLevels = 1;//
-        // static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+QeAssetImageFuture QeGameAsset::requestImageData(const std::string &_filePath, bool *bDecode) {
+    std::lock_guard<std::mutex> lock(textureMutex);
+    std::map<std::string, QeAssetImageFuture>::iterator it = astImageDatas.find(_filePath);
+    *bDecode = it == astImageDatas.end();
+    if (!*bDecode) return it->second;
 
-        // VK->createImageData((void*)data.data(), format, data.size(), width,
-        // height, image->image, image->memory, i, bCubeMap);
+    QeAssetImageFuture &request = astImageDatas[_filePath];
+    request.promise = std::make_shared<std::promise<std::shared_ptr<QeAssetImageData>>>();
+    request.future = request.promise->get_future().share();
+    return request;
+}
 
-        imageDatas.insert(imageDatas.end(), data.begin(), data.end());
-        // if(i == 0)	VK->createImage(*image, data.size(), imageSize, format,
-        // (void*)data.data()); else		VK->setMemoryImage(*image, data.size(),
-        // imageSize, format, (void*)data.data(), i);
+void QeGameAsset::fulfillImageData(QeAssetImageFuture &request, const std::string &_filePath, bool bCubeMap,
+                                   QeTextureUsage usage) {
+    try {
+        request.promise->set_value(decodeImage(_filePath, bCubeMap, usage));
+    } catch (...) {
+        request.promise->set_exception(std::current_exception());
     }
-    // image->view = VK->createImageView(image->image, format,
-    // VK_IMAGE_ASPECT_COLOR_BIT, bCubeMap, mipLevels);
-    imageSize = {uint32_t(width), uint32_t(height)};
-    imageDataSize = data.size();
-
-    VK->createImage(*image, imageDataSize, size, imageSize, format, (void *)imageDatas.data());
+}
 
-    astTextures[_filePath] = image;
+void QeGameAsset::prefetchImages(AeXMLNode *node) {
+    // texture fields of MaterialBase, see QeMaterial::initialize
+    struct QeImageRequest {
+        std::string path;
+        bool bCubeMap;
+        QeTextureUsage usage;
+    };
+    std::vector<QeImageRequest> requests;
+    std::function<void(AeXMLNode *)> collect = [&](AeXMLNode *current) {
+        for (const AeNode &element : current->data->elements) {
+            if (element.value.empty()) continue;
+            bool bCubeMap = element.key == "cubeMap";
+            if (element.key == "baseMap" || bCubeMap)
+                requests.push_back({combinePath(element.value.c_str(), eAssetTexture), bCubeMap, eTextureUsage_color});
+            else if (element.key == "normalMap")
+                requests.push_back({combinePath(element.value.c_str(), eAssetTexture), false, eTextureUsage_normal});
+            else if (element.key == "metallicRoughnessMap")
+                requests.push_back({combinePath(element.value.c_str(), eAssetTexture), false, eTextureUsage_data});
+        }
+        for (AeXMLNode *next : current->data->nexts) collect(next);
+    };
+    if (node) collect(node);
+
+    std::vector<std::pair<QeImageRequest, QeAssetImageFuture>> decodes;
+    for (const QeImageRequest &request : requests) {
+        {
+            std::lock_guard<std::mutex> lock(textureMutex);
+            if (astTextures.find(request.path) != astTextures.end()) continue;
+        }
+        bool bDecode;
+        QeAssetImageFuture future = requestImageData(request.path, &bDecode);
+        if (bDecode) decodes.push_back({request, future});
+    }
+    COM_THREAD.parallelFor(decodes.size(), [&](size_t i) {
+        const QeImageRequest &request = decodes[i].first;
+        fulfillImageData(decodes[i].second, request.path, request.bCubeMap, request.usage);
+    });
+}
 
-    return image;
+void QeGameAsset::releasePrefetchedImages() {
+    std::lock_guard<std::mutex> lock(textureMutex);
+    astImageDatas.clear();
 }
 
-void QeGameAsset::imageFillto32bits(std::vector<unsigned char> *data, int bytes) {
-    unsigned char c = 0xff;
+QeVKImage *QeGameAsset::getImage(const char *_filename, bool bCubeMap, QeTextureUsage usage) {
+    std::string _filePath = combinePath(_filename, eAssetTexture);
+    {
+        std::lock_guard<std::mutex> lock(textureMutex);
+        std::map<std::string, QeVKImage *>::iterator it = astTextures.find(_filePath);
+        if (it != astTextures.end()) return it->second;
+    }
+
+    // the first caller decodes, the others wait for it
+    bool bDecode;
+    QeAssetImageFuture request = requestImageData(_filePath, &bDecode);
+    if (bDecode) fulfillImageData(request, _filePath, bCubeMap, usage);
+    std::shared_ptr<QeAssetImageData> data = request.future.get();
+    if (!data) return nullptr;
+
+    std::lock_guard<std::mutex> uploadLock(uploadMutex);
+    {
+        std::lock_guard<std::mutex> lock(textureMutex);
+        std::map<std::string, QeVKImage *>::iterator it = astTextures.find(_filePath);
+        if (it != astTextures.end()) return it->second;
+    }
+
+    QeVKImage *image;
+
+    if (bCubeMap)
+        image = new QeVKImage(eImage_cube);
+    else
+        image = new QeVKImage(eImage_2D);
+    // image->sampler = VK->createTextureSampler();
 
-    size_t size = data->size();
-    size_t index = bytes;
-    short int addBytes = 4 - bytes;
+    // image->view = VK->createImageView(image->image, format,
+    // VK_IMAGE_ASPECT_COLOR_BIT, bCubeMap, mipLevels);
+    VK->createImage(*image, data->layerSize, data->layers, data->size, data->format, (void *)data->data, VK_SAMPLE_COUNT_1_BIT,
+                    data->mipLevels, data->regionOffsets.empty() ? nullptr : data->regionOffsets.data(),
+                    data->staging.mapped ? &data->staging : nullptr);
 
-    while (index <= size) {
-        for (int i = 0; i < addBytes; ++i) data->insert(data->begin() + index + i, c);
+    std::lock_guard<std::mutex> lock(textureMutex);
+    astTextures[_filePath] = image;
+    astImageDatas.erase(_filePath);
 
-        index += 4;
-        size = data->size();
-    }
+    return image;
 }
 
 VkShaderModule QeGameAsset::getShader(const char *_filename) {
@@ -19,7 +19,7 @@ struct QeVertex {
 struct QeDataJoint {
     unsigned char id = 0;
     std::vector<QeDataJoint *> children;
-    const char *name = nullptr;
+    std::string_view name;  // in the glTF document, kept by COM_MGR
     // QeVector3f translation;
     // QeVector4f rotation;
     // QeVector3f scale;
@@ -91,6 +91,28 @@ struct QeAssetImage {
     QeVKImage *pMetallicRoughnessMap = nullptr;
 };
 
+// Pixels or blocks of a texture ready for createImage, decoded into a staging buffer, mapped from COM_IMAGE_CACHE or
+// mapped from a DDS or KTX2 file.
+struct QeAssetImageData {
+    QeVKBuffer staging{eBuffer_staging};  // decoded layers back to back
+    std::vector<unsigned char> pixels;  // the decode in place of staging when that is not host cached or not mapped
+    AeCachedImage cached;
+    AeTextureContainer container;
+    const unsigned char *data = nullptr;  // layers back to back in cached; the payload of container
+    VkDeviceSize layerSize = 0;  // with every mip level; all of data for a container
+    std::vector<VkDeviceSize> regionOffsets;  // of a container, see QeVulkan::createImage
+    int layers = 0;
+    uint32_t mipLevels = 1;
+    VkExtent2D size = {0, 0};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+};
+
+// Decode of one texture path, shared by every caller that asks for it while it runs.
+struct QeAssetImageFuture {
+    std::shared_ptr<std::promise<std::shared_ptr<QeAssetImageData>>> promise;
+    std::shared_future<std::shared_ptr<QeAssetImageData>> future;
+};
+
 struct QeAssetGraphicsShader {
     VkShaderModule vert = VK_NULL_HANDLE;
     VkShaderModule tesc = VK_NULL_HANDLE;
@@ -114,6 +136,13 @@ class QeGameAsset {
     std::map<std::string, QeAssetMaterial *> astMaterials;
     std::map<std::string, VkShaderModule> astShaders;
     std::map<std::string, QeVKImage *> astTextures;
+    std::map<std::string, QeAssetImageFuture> astImageDatas;  // decoding, or decoded and not created yet
+    std::mutex textureMutex;                                 // astTextures and astImageDatas
+    std::mutex uploadMutex;                                  // createImage
+    AeMipmapFilter mipmapFilter = eMipmapFilter_box;
+    AeBlockQuality blockQuality = eBlockQuality_normal;
+    AeBlockFormat blockFormats[3] = {eBlockFormat_none, eBlockFormat_none, eBlockFormat_none};  // [QeTextureUsage]
+    std::map<std::string, AeBlockFormat> textureBlockFormats;  // by file name, over blockFormats
     //std::map<int, QeAssetParticleRule *> astParticles;
 
     AeXMLNode *getXMLEditNode(AE_GAMEOBJECT_TYPE _type, ID eid);
@@ -121,11 +150,22 @@ class QeGameAsset {
     QeAssetModel *getModel(const char *_filename, bool bCubeMap = false, float *param = nullptr);
     // QeAssetMaterial* getMaterial(const char* _filename);
     QeAssetMaterial *getMaterialImage(const char *_filename, bool bCubeMap = false);
-    QeVKImage *getImage(const char *_filename, bool bCubeMap = false, bool bGamma = false);
+    // Thread-safe. Concurrent calls for the same path decode it once.
+    QeVKImage *getImage(const char *_filename, bool bCubeMap = false, QeTextureUsage usage = eTextureUsage_data);
+    // Decodes the textures of every material under node on COM_THREAD; getImage then only creates them.
+    void prefetchImages(AeXMLNode *node);
+    void releasePrefetchedImages();  // decoded images no getImage asked for
+    // setting.texture of the config: mipmapFilter, blockQuality and a block format for each QeTextureUsage, with
+    // <format file="" value=""> children for single textures.
+    void setTextureSetting(AeXMLNode *node);
+    AeBlockFormat getBlockFormat(const std::string &_filePath, QeTextureUsage usage);
+    std::shared_ptr<QeAssetImageData> decodeImage(const std::string &_filePath, bool bCubeMap, QeTextureUsage usage);
+    std::shared_ptr<QeAssetImageData> loadImageContainer(const std::string &_filePath, bool bCubeMap, QeTextureUsage usage);
+    QeAssetImageFuture requestImageData(const std::string &_filePath, bool *bDecode);
+    void fulfillImageData(QeAssetImageFuture &request, const std::string &_filePath, bool bCubeMap, QeTextureUsage usage);
     VkShaderModule getShader(const char *_filename);
     //QeAssetParticleRule *getParticle(int eid);
 
-    void imageFillto32bits(std::vector<unsigned char> *data, int bytes);
     std::string combinePath(const char *_filename, QeGameAssetType dataType);
 
     void setGraphicsShader(QeAssetGraphicsShader &shader, AeXMLNode *shaderData, const char *defaultShaderType);
@@ -122,13 +122,39 @@ QeAssetMaterial *QeEncode::decodeMTL(char *buffer) {
 QeGameEncode::QeGameEncode() {}
 QeGameEncode::~QeGameEncode() {}
 
-QeAssetModel *QeGameEncode::decodeGLTF(AeJSONNode *json, bool bCubeMap) {
+// An integer member of a glTF object; byteOffset and the like are optional.
+int getGLTFInt(AeJSONValue *object, const AeJSONPath &key, int defaultValue = 0) {
+    AeJSONValue *value = object ? object->getJSONValue(key) : nullptr;
+    return value ? int(value->getJSONInt(defaultValue)) : defaultValue;
+}
+
+QeAssetModel *QeGameEncode::decodeGLTF(AeJSONValue *json, bool bCubeMap) {
+    // Compiled once, so the loops over accessors, bufferViews and channels only index arrays and compare key hashes.
+    static const AeJSONPath uriPath("buffers.uri"), accessorsPath("accessors"), bufferViewsPath("bufferViews");
+    static const AeJSONPath indicesPath("meshes.primitives.indices"), attributesPath("meshes.primitives.attributes");
+    static const AeJSONPath attributePaths[] = {AeJSONPath("POSITION"), AeJSONPath("NORMAL"),   AeJSONPath("TEXCOORD_0"),
+                                                AeJSONPath("TANGENT"),  AeJSONPath("JOINTS_0"), AeJSONPath("WEIGHTS_0")};
+    static const AeJSONPath scalePath("nodes.scale"), inverseBindMatricesPath("skins.inverseBindMatrices");
+    static const AeJSONPath jointsPath("skins.joints"), nodesPath("nodes"), namePath("name"), childrenPath("children");
+    static const AeJSONPath channelsPath("animations.channels"), samplersPath("animations.samplers");
+    static const AeJSONPath targetPath("target"), nodePath("node"), pathPath("path");
+    static const AeJSONPath inputPath("input"), outputPath("output");
+    static const AeJSONPath bufferViewPath("bufferView"), countPath("count"), componentTypePath("componentType");
+    static const AeJSONPath byteOffsetPath("byteOffset"), byteLengthPath("byteLength");
+    static const AeJSONPath baseColorTexturePath("materials.pbrMetallicRoughness.baseColorTexture.index");
+    static const AeJSONPath normalTexturePath("materials.normalTexture.index"), imagesPath("images"), imageUriPath("uri");
+    static const AeJSONPath baseColorFactorPath("materials.pbrMetallicRoughness.baseColorFactor");
+    static const AeJSONPath metallicFactorPath("materials.pbrMetallicRoughness.metallicFactor");
+    static const AeJSONPath roughnessFactorPath("materials.pbrMetallicRoughness.roughnessFactor");
+
     QeAssetModel *model = new QeAssetModel();
 
-    const char *binData = json->getJSONValue(2, "buffers", "uri");
-    char *ret = strrchr((char *)binData, '.');
+    AeJSONValue *uri = json->getJSONValue(uriPath);
+    std::string binName(uri ? uri->string : std::string_view());
+    const char *binData = binName.c_str();
+    const char *ret = strrchr(binData, '.');
     std::vector<char> buf;
-    if (strcmp(ret + 1, "bin") == 0) {
+    if (ret && strcmp(ret + 1, "bin") == 0) {
         std::string _filePath = G_AST.combinePath(binData, eAssetBin);
         buf = COM_MGR.loadFile(_filePath.c_str());
         binData = buf.data();
@@ -150,9 +176,9 @@ QeAssetModel *QeGameEncode::decodeGLTF(AeJSONNode *json, bool bCubeMap) {
     "MAT3" 		9
     "MAT4" 		16
     */
-    std::vector<AeJSONNode *> *jaccessors = json->getJSONArrayNodes(1, "accessors");
-    std::vector<AeJSONNode *> *jbufferViews = json->getJSONArrayNodes(1, "bufferViews");
-    std::vector<std::string> *sv;
+    AeJSONValue *jaccessors = json->getJSONValue(accessorsPath);
+    AeJSONValue *jbufferViews = json->getJSONValue(bufferViewsPath);
+    AeJSONValue *sv;
     size_t size, size1, size2;
     unsigned char index;
     unsigned int offset, count, length, componentType;
@@ -160,48 +186,37 @@ QeAssetModel *QeGameEncode::decodeGLTF(AeJSONNode *json, bool bCubeMap) {
 
     unsigned char bufferViews[256];
     memset(bufferViews, 0xFF, 256 * sizeof(char));
-    const char *c = json->getJSONValue(3, "meshes", "primitives", "indices");
-    if (c != nullptr) bufferViews[0] = atoi(c);
-
-    c = json->getJSONValue(4, "meshes", "primitives", "attributes", "POSITION");
-    if (c != nullptr) bufferViews[1] = atoi(c);
-
-    c = json->getJSONValue(4, "meshes", "primitives", "attributes", "NORMAL");
-    if (c != nullptr) bufferViews[2] = atoi(c);
-
-    c = json->getJSONValue(4, "meshes", "primitives", "attributes", "TEXCOORD_0");
-    if (c != nullptr) bufferViews[3] = atoi(c);
+    AeJSONValue *c = json->getJSONValue(indicesPath);
+    if (c != nullptr) bufferViews[0] = (unsigned char)c->getJSONInt();
 
-    c = json->getJSONValue(4, "meshes", "primitives", "attributes", "TANGENT");
-    if (c != nullptr) bufferViews[4] = atoi(c);
-
-    c = json->getJSONValue(4, "meshes", "primitives", "attributes", "JOINTS_0");
-    if (c != nullptr) bufferViews[5] = atoi(c);
-
-    c = json->getJSONValue(4, "meshes", "primitives", "attributes", "WEIGHTS_0");
-    if (c != nullptr) bufferViews[6] = atoi(c);
+    AeJSONValue *attributes = json->getJSONValue(attributesPath);
+    for (i = 0; attributes && i < 6; ++i) {
+        c = attributes->getJSONValue(attributePaths[i]);
+        if (c != nullptr) bufferViews[i + 1] = (unsigned char)c->getJSONInt();
+    }
 
-    sv = json->getJSONArrayValues(2, "nodes", "scale");
-    if (sv == nullptr || sv->empty())
+    sv = json->getJSONValue(scalePath);
+    if (sv == nullptr || sv->floats == nullptr || sv->size < 3)
         model->scale = {1.0f, 1.0f, 1.0f};
     else
-        model->scale = {float(atof((*sv)[0].c_str())), float(atof((*sv)[1].c_str())), float(atof((*sv)[2].c_str()))};
+        model->scale = {sv->floats[0], sv->floats[1], sv->floats[2]};
 
-    c = json->getJSONValue(2, "skins", "inverseBindMatrices");
+    c = json->getJSONValue(inverseBindMatricesPath);
     if (c != nullptr) {
         // skeletal animation
-        bufferViews[7] = atoi(c);
-        std::vector<std::string> *jboneID = json->getJSONArrayValues(2, "skins", "joints");
-        size = jboneID->size();
+        bufferViews[7] = (unsigned char)c->getJSONInt();
+        AeJSONValue *jboneID = json->getJSONValue(jointsPath);
+        size = jboneID->ints ? jboneID->size : 0;
         model->jointsAnimation.resize(size);
 
-        std::vector<AeJSONNode *> *jboneName = json->getJSONArrayNodes(1, "nodes");
+        AeJSONValue *jboneName = json->getJSONValue(nodesPath);
 
         for (i = 0; i < size; ++i) {
-            model->jointsAnimation[i].id = atoi((*jboneID)[i].c_str());
-            model->jointsAnimation[i].name = (*jboneName)[model->jointsAnimation[i].id]->getJSONValue(1, "name");
+            model->jointsAnimation[i].id = (unsigned char)jboneID->ints[i];
+            AeJSONValue *name = jboneName->getJSONElement(model->jointsAnimation[i].id)->getJSONValue(namePath);
+            model->jointsAnimation[i].name = name->string;
 
-            if (strncmp(model->jointsAnimation[i].name, BONE_ROOT_NAME, 13) == 0) model->rootJoint = &model->jointsAnimation[i];
+            if (name->string.substr(0, 13) == BONE_ROOT_NAME) model->rootJoint = &model->jointsAnimation[i];
 
             /*sv = AST->getJSONArrayValues((*jboneName)[model->jointsAnimation[i].id],
             1, "translation"); if (sv != nullptr) {
@@ -231,12 +246,12 @@ QeAssetModel *QeGameEncode::decodeGLTF(AeJSONNode *json, bool bCubeMap) {
         // setChildrenJointTranform(model->rootJoint, mat);
 
         for (i = 0; i < size; ++i) {
-            sv = (*jboneName)[model->jointsAnimation[i].id]->getJSONArrayValues(1, "children");
-            if (sv != nullptr) {
-                size1 = sv->size();
+            sv = jboneName->getJSONElement(model->jointsAnimation[i].id)->getJSONValue(childrenPath);
+            if (sv != nullptr && sv->ints) {
+                size1 = sv->size;
                 model->jointsAnimation[i].children.resize(size1);
                 for (j = 0; j < size1; ++j) {
-                    index = atoi((*sv)[j].c_str());
+                    index = (unsigned char)sv->ints[j];
                     size2 = model->jointsAnimation.size();
                     for (k = 0; k < size2; ++k) {
                         if (index == model->jointsAnimation[k].id)
@@ -246,26 +261,27 @@ QeAssetModel *QeGameEncode::decodeGLTF(AeJSONNode *json, bool bCubeMap) {
             }
         }
 
-        std::vector<AeJSONNode *> *jchannels = json->getJSONArrayNodes(2, "animations", "channels");
-        std::vector<AeJSONNode *> *jsmaplers = json->getJSONArrayNodes(2, "animations", "samplers");
-        size1 = jchannels->size();
-        const char *path = nullptr;
+        AeJSONValue *jchannels = json->getJSONValue(channelsPath);
+        AeJSONValue *jsmaplers = json->getJSONValue(samplersPath);
+        size1 = jchannels->size;
+        std::string_view path;
 
         for (i = 0; i < size1; ++i) {
-            j = atoi((*jchannels)[i]->getJSONValue(2, "target", "node"));
+            AeJSONValue *target = jchannels->getJSONElement(i)->getJSONValue(targetPath);
+            j = getGLTFInt(target, nodePath);
 
             for (k = 0; k < size; ++k) {
                 if (model->jointsAnimation[k].id == j) {
-                    path = (*jchannels)[i]->getJSONValue(2, "target", "path");
-                    index = atoi((*jsmaplers)[i]->getJSONValue(1, "input"));
-                    count = atoi((*jaccessors)[index]->getJSONValue(1, "count"));
-                    offset = atoi((*jbufferViews)[index]->getJSONValue(1, "byteOffset"));
-                    length = atoi((*jbufferViews)[index]->getJSONValue(1, "byteLength"));
+                    path = target->getJSONValue(pathPath)->string;
+                    index = getGLTFInt(jsmaplers->getJSONElement(i), inputPath);
+                    count = getGLTFInt(jaccessors->getJSONElement(index), countPath);
+                    offset = getGLTFInt(jbufferViews->getJSONElement(index), byteOffsetPath);
+                    length = getGLTFInt(jbufferViews->getJSONElement(index), byteLengthPath);
 
-                    if (strncmp(path, "translation", 11) == 0) {
+                    if (path == "translation") {
                         model->jointsAnimation[k].translationInput.resize(count);
                         memcpy(model->jointsAnimation[k].translationInput.data(), binData + offset, length);
-                    } else if (strncmp(path, "rotation", 8) == 0) {
+                    } else if (path == "rotation") {
                         model->jointsAnimation[k].rotationInput.resize(count);
                         memcpy(model->jointsAnimation[k].rotationInput.data(), binData + offset, length);
                     }
@@ -274,15 +290,15 @@ QeAssetModel *QeGameEncode::decodeGLTF(AeJSONNode *json, bool bCubeMap) {
                     //	memcpy(model->jointsAnimation[k].scaleInput.data(), binData +
                     // offset, length);
                     //}
-                    index = atoi((*jsmaplers)[i]->getJSONValue(1, "output"));
-                    count = atoi((*jaccessors)[index]->getJSONValue(1, "count"));
-                    offset = atoi((*jbufferViews)[index]->getJSONValue(1, "byteOffset"));
-                    length = atoi((*jbufferViews)[index]->getJSONValue(1, "byteLength"));
+                    index = getGLTFInt(jsmaplers->getJSONElement(i), outputPath);
+                    count = getGLTFInt(jaccessors->getJSONElement(index), countPath);
+                    offset = getGLTFInt(jbufferViews->getJSONElement(index), byteOffsetPath);
+                    length = getGLTFInt(jbufferViews->getJSONElement(index), byteLengthPath);
 
-                    if (strncmp(path, "translation", 11) == 0) {
+                    if (path == "translation") {
                         model->jointsAnimation[k].translationOutput.resize(count);
                         memcpy(model->jointsAnimation[k].translationOutput.data(), binData + offset, length);
-                    } else if (strncmp(path, "rotation", 8) == 0) {
+                    } else if (path == "rotation") {
                         model->jointsAnimation[k].rotationOutput.resize(count);
                         memcpy(model->jointsAnimation[k].rotationOutput.data(), binData + offset, length);
                     }
@@ -338,14 +354,15 @@ QeAssetModel *QeGameEncode::decodeGLTF(AeJSONNode *json, bool bCubeMap) {
         model->animationEndFrames.push_back(unsigned int(i) - 1);
         model->animationNum = unsigned char(model->animationEndFrames.size());
     }
-    size = jbufferViews->size();
+    size = jbufferViews->size;
 
     for (i = 0; i < size; ++i) {
-        index = atoi((*jaccessors)[i]->getJSONValue(1, "bufferView"));
-        count = atoi((*jaccessors)[i]->getJSONValue(1, "count"));
-        componentType = atoi((*jaccessors)[i]->getJSONValue(1, "componentType"));
-        offset = atoi((*jbufferViews)[i]->getJSONValue(1, "byteOffset"));
-        length = atoi((*jbufferViews)[i]->getJSONValue(1, "byteLength"));
+        AeJSONValue *accessor = jaccessors->getJSONElement(i), *bufferView = jbufferViews->getJSONElement(i);
+        index = getGLTFInt(accessor, bufferViewPath);
+        count = getGLTFInt(accessor, countPath);
+        componentType = getGLTFInt(accessor, componentTypePath);
+        offset = getGLTFInt(bufferView, byteOffsetPath);
+        length = getGLTFInt(bufferView, byteLengthPath);
 
         if (index == bufferViews[0]) {  // indices
             if (componentType == 5121) {
@@ -430,52 +447,46 @@ QeAssetModel *QeGameEncode::decodeGLTF(AeJSONNode *json, bool bCubeMap) {
     QeAssetMaterial *pMaterial = new QeAssetMaterial();
     // pMaterial->type = eMaterialPBR;
     model->pMaterial = pMaterial;
-    c = json->getJSONValue(4, "materials", "pbrMetallicRoughness", "baseColorTexture", "index");
+    c = json->getJSONValue(baseColorTexturePath);
     if (c) {
-        int textureIndex = atoi(c);
-        std::vector<AeJSONNode *> *imageJSON = json->getJSONArrayNodes(1, "images");
-        const char *texturePath = (*imageJSON)[textureIndex]->getJSONValue(1, "uri");
+        int textureIndex = int(c->getJSONInt());
+        AeJSONValue *imageJSON = json->getJSONValue(imagesPath);
+        std::string texturePath(imageJSON->getJSONElement(textureIndex)->getJSONValue(imageUriPath)->string);
 
         if (bCubeMap)
-            pMaterial->image.pCubeMap = G_AST.getImage(texturePath, bCubeMap, true);
+            pMaterial->image.pCubeMap = G_AST.getImage(texturePath.c_str(), bCubeMap, eTextureUsage_color);
         else
-            pMaterial->image.pBaseColorMap = G_AST.getImage(texturePath, bCubeMap, true);
+            pMaterial->image.pBaseColorMap = G_AST.getImage(texturePath.c_str(), bCubeMap, eTextureUsage_color);
     }
 
-    c = json->getJSONValue(3, "materials", "normalTexture", "index");
+    c = json->getJSONValue(normalTexturePath);
     if (c) {
-        int textureIndex = atoi(json->getJSONValue(3, "materials", "normalTexture", "index"));
-        std::vector<AeJSONNode *> *imageJSON = json->getJSONArrayNodes(1, "images");
-        const char *texturePath = (*imageJSON)[textureIndex]->getJSONValue(1, "uri");
+        int textureIndex = int(c->getJSONInt());
+        AeJSONValue *imageJSON = json->getJSONValue(imagesPath);
+        std::string texturePath(imageJSON->getJSONElement(textureIndex)->getJSONValue(imageUriPath)->string);
 
-        pMaterial->image.pNormalMap = G_AST.getImage(texturePath, bCubeMap);
+        pMaterial->image.pNormalMap = G_AST.getImage(texturePath.c_str(), bCubeMap, eTextureUsage_normal);
     }
-    std::vector<std::string> *baseColorJ = json->getJSONArrayValues(3, "materials", "pbrMetallicRoughness", "baseColorFactor");
+    AeJSONValue *baseColorJ = json->getJSONValue(baseColorFactorPath);
     // QeDataMaterialPBR mtl;
     QeDataMaterial mtl;
 
-    if (baseColorJ != nullptr) {
-        mtl.baseColor.x = float(atof((*baseColorJ)[0].c_str()));
-        mtl.baseColor.y = float(atof((*baseColorJ)[1].c_str()));
-        mtl.baseColor.z = float(atof((*baseColorJ)[2].c_str()));
-        mtl.baseColor.w = float(atof((*baseColorJ)[3].c_str()));
+    if (baseColorJ != nullptr && baseColorJ->floats && baseColorJ->size >= 4) {
+        mtl.baseColor.x = baseColorJ->floats[0];
+        mtl.baseColor.y = baseColorJ->floats[1];
+        mtl.baseColor.z = baseColorJ->floats[2];
+        mtl.baseColor.w = baseColorJ->floats[3];
     } else {
         mtl.baseColor.x = 1.0f;
         mtl.baseColor.y = 1.0f;
         mtl.baseColor.z = 1.0f;
         mtl.baseColor.w = 1.0f;
     }
-    const char *value = json->getJSONValue(3, "materials", "pbrMetallicRoughness", "metallicFactor");
-    if (value == nullptr)
-        mtl.metallicRoughnessEmissive.x = 1.0f;
-    else
-        mtl.metallicRoughnessEmissive.x = float(atof(value));
+    AeJSONValue *value = json->getJSONValue(metallicFactorPath);
+    mtl.metallicRoughnessEmissive.x = value ? float(value->getJSONNumber(1.0)) : 1.0f;
 
-    value = json->getJSONValue(3, "materials", "pbrMetallicRoughness", "roughnessFactor");
-    if (value == nullptr)
-        mtl.metallicRoughnessEmissive.y = 1.0f;
-    else
-        mtl.metallicRoughnessEmissive.y = float(atof(value));
+    value = json->getJSONValue(roughnessFactorPath);
+    mtl.metallicRoughnessEmissive.y = value ? float(value->getJSONNumber(1.0)) : 1.0f;
 
     mtl.metallicRoughnessEmissive.z = 1.0f;
     pMaterial->value = mtl;
@@ -5,7 +5,7 @@ class QeGameEncode {
     SINGLETON_CLASS(QeGameEncode);
 
     // QeAssetModel* decodeOBJ(char* buffer);
-    QeAssetModel *decodeGLTF(AeJSONNode *json, bool bCubeMap = false);
+    QeAssetModel *decodeGLTF(AeJSONValue *json, bool bCubeMap = false);
     //QeAssetParticleRule *decodeParticle(AeXMLNode *node);
     // QeAssetModel* decodeGLB(char* buffer);
     // QeAssetMaterial* decodeMTL(char* buffer);
@@ -11,6 +11,8 @@
 #include <functional>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <future>
 #include <commctrl.h>
 #include <utility>
 #include <conio.h>
@@ -106,6 +108,13 @@ enum QeGameAssetType {
     eAssetTexture = 4,
 };
 
+// What a texture holds, which picks its block format and whether it is sRGB.
+enum QeTextureUsage {
+    eTextureUsage_color = 0,  // base color and cube maps, sRGB
+    eTextureUsage_normal = 1,
+    eTextureUsage_data = 2,  // metallic, roughness and the like
+};
+
 enum QeVKBufferType {
     eBuffer = 0,
     eBuffer_vertex = 1,
@@ -114,6 +123,7 @@ enum QeVKBufferType {
     eBuffer_vertex_texel = 4,
     eBuffer_uniform = 5,
     eBuffer_storage = 6,
+    eBuffer_staging = 7,  // host cached when the device has it, mapped by createBuffer
 };
 
 enum QeVKImageType {
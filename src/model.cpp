@@ -102,7 +102,8 @@ QeDataDescriptorSetModel QeModel::createDescriptorSetModel() {
         if (materialData->image.pNormalMap) {
             descriptorSetData.normalMapImageView = materialData->image.pNormalMap->view;
             descriptorSetData.normalMapSampler = materialData->image.pNormalMap->sampler;
-            bufferData.param1.y = 1;
+            // 2: two channels only, the shader rebuilds z
+            bufferData.param1.y = materialData->image.pNormalMap->format == VK_FORMAT_BC5_UNORM_BLOCK ? 2 : 1;
         }
         if (materialData->image.pCubeMap) {
             descriptorSetData.cubeMapImageView = materialData->image.pCubeMap->view;
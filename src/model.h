@@ -5,7 +5,7 @@
 struct QeDataModel {
     QeMatrix4x4f model;
     QeMatrix4x4f joints[MAX_JOINT_NUM];
-    AeArray<float,4> param1;  // 0: bColorMap, 1: bCubeMap, 2: bNormalMap, 3:
+    AeArray<float,4> param1;  // 0: bColorMap, 1: bNormalMap (2: two-channel), 2: bCubeMap, 3:
                         // bMetallicRoughnessMap
     AeArray<float, 4> param2;  // 0: outlineWidth, 1: vertexNum
     QeDataMaterial material;
@@ -2,11 +2,13 @@
 
 void AeObjectManager::loadScene(ID _eid) {
     AeXMLNode *node = G_AST.getXMLEditNode(eGAMEOBJECT_Scene, _eid);
+    G_AST.prefetchImages(node);
 
     if (SCENE)
         SCENE->initialize(node, nullptr);
     else
         SCENE = (QeScene*)spwanComponent(node, nullptr);
+    G_AST.releasePrefetchedImages();
 }
 
 AeObjectManager::~AeObjectManager() {
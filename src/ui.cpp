@@ -77,7 +77,7 @@ void AeUI::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
                         break;
                     case eUIType_btnSaveAll: {
                         adjustComponetData(CONFIG);
-                        CONFIG->outputXML(CONFIG_PATH);
+                        COM_MGR.saveXML(CONFIG_PATH);
                         ENGINE->initialize();
                     } break;
                     case eUIType_btnLoadScene:
@@ -283,7 +283,13 @@ void AeUI::adjustComponetData(AeXMLNode *node) {
                     }
                 }
             }
-            node->data->elements = elements;
+            bool bChanged = elements.size() != node->data->elements.size();
+            for (size_t i = 0; !bChanged && i < elements.size(); ++i)
+                bChanged = elements[i].key != node->data->elements[i].key || elements[i].value != node->data->elements[i].value;
+            if (bChanged) {  // or saveXML writes every component again
+                node->data->elements = elements;
+                node->invalidateXMLIndex();
+            }
         }
     }
     for (const auto &n : node->data->nexts) {
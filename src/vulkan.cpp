@@ -188,6 +188,9 @@ void QeVulkan::pickPhysicalDevice() {
     if (physicalDevice == VK_NULL_HANDLE) LOG("failed to find a suitable GPU!");
 
     vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    bTextureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
     // vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
     // vkGetPhysicalDeviceMemoryProperties(physicalDevice,
     // &deviceMemoryProperties);
@@ -212,6 +215,7 @@ void QeVulkan::createLogicalDevice() {
 
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.textureCompressionBC = bTextureCompressionBC ? VK_TRUE : VK_FALSE;
     deviceFeatures.fillModeNonSolid = VK_TRUE;
     deviceFeatures.multiViewport = VK_TRUE;
     deviceFeatures.geometryShader = VK_TRUE;
@@ -641,6 +645,43 @@ VkFormat QeVulkan::findDepthStencilFormat() {
                                VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
+VkFormat QeVulkan::getBlockFormat(AeBlockFormat format, bool bSRGB) {
+    switch (format) {
+        case eBlockFormat_BC1:
+            return bSRGB ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case eBlockFormat_BC3:
+            return bSRGB ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+        case eBlockFormat_BC4:
+            return VK_FORMAT_BC4_UNORM_BLOCK;
+        case eBlockFormat_BC5:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case eBlockFormat_BC7:
+            return bSRGB ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+AeBlockFormat QeVulkan::getBlockFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            return eBlockFormat_BC1;
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+            return eBlockFormat_BC3;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return eBlockFormat_BC4;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            return eBlockFormat_BC5;
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            return eBlockFormat_BC7;
+        default:
+            return eBlockFormat_none;
+    }
+}
+
 /*bool QeVulkan::hasStencilComponent(VkFormat format) {
         return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format ==
 VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT;
@@ -728,23 +769,34 @@ void QeVulkan::transitionImageLayout(VkCommandBuffer cmdBuf, QeVKImage &image, V
     if (cmdBuf == VK_NULL_HANDLE) endSingleTimeCommands(commandBuffer);
 }
 
-void QeVulkan::copyBufferToImage(VkBuffer buffer, VkImage image, VkDeviceSize dataSize, int imageCount, VkExtent2D &imageSize) {
+void QeVulkan::copyBufferToImage(VkBuffer buffer, VkImage image, VkDeviceSize dataSize, int imageCount, VkExtent2D &imageSize,
+                                 VkFormat format, uint32_t mipLevels, const VkDeviceSize *regionOffsets) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
     std::vector<VkBufferImageCopy> bufferCopyRegions;
     VkDeviceSize offset = 0;
+    AeBlockFormat blockFormat = getBlockFormat(format);
+    VkDeviceSize pixelSize = dataSize / AeTextureEncode::getMipmapSize(imageSize.width, imageSize.height, 1, mipLevels);
 
     for (int i = 0; i < imageCount; ++i) {
-        VkBufferImageCopy bufferCopyRegion = {};
-        bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        bufferCopyRegion.imageSubresource.mipLevel = 0;
-        bufferCopyRegion.imageSubresource.baseArrayLayer = i;
-        bufferCopyRegion.imageSubresource.layerCount = 1;
-        bufferCopyRegion.imageExtent = {imageSize.width, imageSize.height, 1};
-        bufferCopyRegion.bufferOffset = offset;
-
-        bufferCopyRegions.push_back(bufferCopyRegion);
-        offset += dataSize;
+        uint32_t width = imageSize.width, height = imageSize.height;
+        for (uint32_t level = 0; level < mipLevels; ++level) {
+            VkBufferImageCopy bufferCopyRegion = {};
+            bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            bufferCopyRegion.imageSubresource.mipLevel = level;
+            bufferCopyRegion.imageSubresource.baseArrayLayer = i;
+            bufferCopyRegion.imageSubresource.layerCount = 1;
+            bufferCopyRegion.imageExtent = {width, height, 1};
+            bufferCopyRegion.bufferOffset = regionOffsets ? regionOffsets[i * mipLevels + level] : offset;
+
+            bufferCopyRegions.push_back(bufferCopyRegion);
+            if (blockFormat == eBlockFormat_none)
+                offset += pixelSize * width * height;
+            else
+                offset += AeTextureEncode::getCompressedSize(width, height, blockFormat);
+            width = std::max(1u, width / 2);
+            height = std::max(1u, height / 2);
+        }
     }
 
     /*VkBufferImageCopy region = {};
@@ -822,6 +874,15 @@ uint32_t QeVulkan::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags pro
     return VK_NULL_HANDLE;
 }
 
+bool QeVulkan::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) return true;
+    return false;
+}
+
 VkSemaphore QeVulkan::createSyncObjectSemaphore() {
     VkSemaphoreCreateInfo semaphoreInfo = {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -1703,6 +1764,11 @@ void QeVulkan::createBuffer(QeVKBuffer &buffer, VkDeviceSize size, void *data) {
         case eBuffer_uniform:
             usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
             break;
+
+        case eBuffer_staging:
+            usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;  // mip generation reads level 0 back
+            break;
     }
     // buffer
     if (bBuffer) {
@@ -1723,11 +1789,15 @@ void QeVulkan::createBuffer(QeVKBuffer &buffer, VkDeviceSize size, void *data) {
         VkMemoryAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
+        if (buffer.type == eBuffer_staging && !hasMemoryType(memRequirements.memoryTypeBits, properties))
+            properties &= ~VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        buffer.bHostCached = (properties & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
         allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
         if (vkAllocateMemory(device, &allocInfo, nullptr, &buffer.memory) != VK_SUCCESS) LOG("failed to allocate buffer memory!");
 
         vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+        if (buffer.type == eBuffer_staging) vkMapMemory(device, buffer.memory, 0, size, 0, &buffer.mapped);
     }
 
     // view
@@ -1763,9 +1833,8 @@ void QeVulkan::setMemoryBuffer(QeVKBuffer &buffer, VkDeviceSize size, void *data
 }
 
 void QeVulkan::createImage(QeVKImage &image, VkDeviceSize dataSize, int imageCount, VkExtent2D &imageSize, VkFormat format,
-                           void *data, VkSampleCountFlagBits sampleCount) {
-    uint32_t mipLevels = 1;  // static_cast<uint32_t>(std::floor(std::log2(std::max(width,
-                             // height)))) + 1;
+                           void *data, VkSampleCountFlagBits sampleCount, uint32_t mipLevels,
+                           const VkDeviceSize *regionOffsets, QeVKBuffer *stagingBuffer) {
     VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL;
     VkImageUsageFlags usage;
     VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -1850,6 +1919,7 @@ void QeVulkan::createImage(QeVKImage &image, VkDeviceSize dataSize, int imageCou
         imageInfo.mipLevels = mipLevels;
         imageInfo.arrayLayers = arrayLayers;
         imageInfo.format = format;
+        image.format = format;
         imageInfo.tiling = tiling;
         imageInfo.initialLayout = layout_src;  // VK_IMAGE_LAYOUT_PREINITIALIZED;
         imageInfo.usage = usage;
@@ -1914,25 +1984,27 @@ void QeVulkan::createImage(QeVKImage &image, VkDeviceSize dataSize, int imageCou
         samplerInfo.mipLodBias = 0;
         samplerInfo.anisotropyEnable = VK_FALSE;
         samplerInfo.minLod = 0;
-        samplerInfo.maxLod = 1;
+        samplerInfo.maxLod = float(mipLevels);
 
         if (vkCreateSampler(VK->device, &samplerInfo, nullptr, &image.sampler) != VK_SUCCESS)
             LOG("failed to create texture sampler!");
     }
 
-    if (data) {
-        transitionImageLayout(VK_NULL_HANDLE, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageCount /*, mipLevels*/);
+    if (data || stagingBuffer) {
+        transitionImageLayout(VK_NULL_HANDLE, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageCount, mipLevels);
         if (dataSize == 0) dataSize = imageSize.width * imageSize.height * 4;
 
         // uint32_t mipLevels = 1;
         // //static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) +
         // 1;
         QeVKBuffer staging(eBuffer);
-        createBuffer(staging, dataSize * imageCount, data);
+        if (stagingBuffer == nullptr) {
+            createBuffer(staging, regionOffsets ? dataSize : dataSize * imageCount, data);
+            stagingBuffer = &staging;
+        }
 
-        copyBufferToImage(staging.buffer, image.image, dataSize, imageCount, imageSize /*, layer*/);
+        copyBufferToImage(stagingBuffer->buffer, image.image, dataSize, imageCount, imageSize, format, mipLevels, regionOffsets);
         layout_src = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     }
-    if (bLayout) transitionImageLayout(VK_NULL_HANDLE, image, layout_dst, imageCount /*, mipLevels*/);
-    // generateMipmaps(image, width, height, mipLevels);
+    if (bLayout) transitionImageLayout(VK_NULL_HANDLE, image, layout_dst, imageCount, mipLevels);
 }
@@ -74,6 +74,7 @@ struct QeVKBuffer {
     VkDeviceMemory memory = VK_NULL_HANDLE;
     VkBufferView view = VK_NULL_HANDLE;
     void *mapped = nullptr;
+    bool bHostCached = false;  // memory reads back fast, see eBuffer_staging
 
     QeVKBuffer(QeVKBufferType _type) : type(_type) {}
     ~QeVKBuffer();
@@ -86,6 +87,7 @@ struct QeVKImage {
     VkDeviceMemory memory = VK_NULL_HANDLE;
     VkImageView view = VK_NULL_HANDLE;
     VkSampler sampler = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;  // of image, set by createImage
     // void* mapped = nullptr;
 
     QeVKImage(QeVKImageType _type) : type(_type) {}
@@ -195,6 +197,7 @@ class QeVulkan {
     bool bInit = false;
     bool bShowMesh = false;
     bool bShowNormal = false;
+    bool bTextureCompressionBC = false;  // the device samples BC1 to BC7
     QeVKImage emptyImage2D;
     QeVKImage emptyImageCube;
 
@@ -261,12 +264,15 @@ class QeVulkan {
     void createCommandPool();
     VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkFormat findDepthStencilFormat();
+    static VkFormat getBlockFormat(AeBlockFormat format, bool bSRGB);
+    static AeBlockFormat getBlockFormat(VkFormat format);  // eBlockFormat_none for pixel formats
     // bool hasStencilComponent(VkFormat format);
 
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes);
@@ -298,9 +304,14 @@ class QeVulkan {
 
     void createBuffer(QeVKBuffer &buffer, VkDeviceSize size, void *data);
     void setMemoryBuffer(QeVKBuffer &buffer, VkDeviceSize size, void *data);
+    // dataSize is one layer with all its mip levels, laid out as AeTextureEncode::generateMipmaps or encodeBlocks writes
+    // them. With regionOffsets, the offset of layer l and level m at [l * mipLevels + m], dataSize is all of data.
+    // stagingBuffer, an eBuffer_staging already holding the layers, is copied from in place of data.
     void createImage(QeVKImage &image, VkDeviceSize dataSize, int imageCount, VkExtent2D &imageSize, VkFormat format, void *data,
-                     VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT);
+                     VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT, uint32_t mipLevels = 1,
+                     const VkDeviceSize *regionOffsets = nullptr, QeVKBuffer *stagingBuffer = nullptr);
     void transitionImageLayout(VkCommandBuffer cmdBuf, QeVKImage &image, VkImageLayout newLayout, int imageCount,
                                uint32_t mipLevels = 1);
-    void copyBufferToImage(VkBuffer buffer, VkImage image, VkDeviceSize dataSize, int imageCount, VkExtent2D &imageSize);
+    void copyBufferToImage(VkBuffer buffer, VkImage image, VkDeviceSize dataSize, int imageCount, VkExtent2D &imageSize,
+                           VkFormat format, uint32_t mipLevels = 1, const VkDeviceSize *regionOffsets = nullptr);
 };